@@ -1,11 +1,37 @@
 #ifndef CARD_TAP_WATCHER_H
 #define CARD_TAP_WATCHER_H
 
-#include <Arduino.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 
 #include "NFCManager.h"
 
+// Longest cardUid: a UID of up to 8 bytes as a decimal number, or a longer
+// one as hex, is at most 20 characters.
+constexpr size_t MAX_CARD_UID_LENGTH = 20;
+
+// A new card in the field. Two cards answering one scan, e.g. a wallet, is
+// ambiguous: both are reported and neither may be taken as the rider's. So
+// is a new card while one of another protocol answers that protocol's scan.
+struct CardTap {
+  std::string cardUid;
+  hal::CardProtocol protocol = hal::CardProtocol::Iso14443A;
+  // Only set for an ambiguous tap.
+  std::string otherCardUid;
+
+  bool ambiguous() const { return !otherCardUid.empty(); }
+};
+
+// A reported card has left the field. dwellMs runs from the first scan that
+// saw it to the last one.
+struct CardRemoval {
+  std::string cardUid;
+  hal::CardProtocol protocol = hal::CardProtocol::Iso14443A;
+  uint32_t dwellMs = 0;
+};
+
 class CardTapWatcher {
 public:
   CardTapWatcher(
@@ -15,27 +41,97 @@ public:
     uint16_t scanTimeoutMs = 75
   );
 
-  bool poll(std::string& cardUidOut);
+  bool poll(CardTap& tapOut);
+  // Removals are found by poll() and queued until taken, oldest first.
+  bool hasRemoval() const;
+  bool takeRemoval(CardRemoval& removalOut);
+  uint64_t nextPollDueAt() const;
+  // Takes effect from the next poll.
+  void setPollInterval(unsigned long pollIntervalMs);
+  unsigned long currentPollInterval() const;
+  // A card was read and has not been missed since.
+  bool cardInField() const;
+  // A new card waits for the other protocols' scans; poll() runs them
+  // without waiting for the poll interval.
+  bool confirmingCard() const;
+  // Powers the reader down after each empty scan, for slow poll rates where
+  // the wake-up is cheap next to the gap.
+  void setParkBetweenPolls(bool park);
+  // Each poll scans for the next enabled protocol in turn. With more than
+  // one enabled, a new card is reported once every other protocol has been
+  // scanned too, so a card is reported at most two rotations after it
+  // arrives. 0 means ISO14443A.
+  void setProtocols(hal::CardProtocolMask protocols);
+  // A card held in the field is reported again every retapMs; 0 waits for
+  // it to be taken away.
+  void setRetapInterval(unsigned long retapMs);
 
 private:
   NFCManager& nfcManager;
-  const unsigned long pollInterval;
+  unsigned long pollInterval;
   const unsigned long debounceInterval;
   const uint16_t scanTimeout;
-  unsigned long lastRecoverTick = 0;
-  unsigned long lastHealthCheckAt = 0;
+  bool parkBetweenPolls = false;
+  unsigned long retapInterval = 0;
+  uint64_t lastRecoverTick = 0;
+  uint64_t lastHealthCheckAt = 0;
 
-  unsigned long lastPollTime = 0;
-  unsigned long lastPublishTime = 0;
+  hal::CardProtocolMask protocols = hal::cardProtocolBit(hal::CardProtocol::Iso14443A);
+  uint8_t enabledProtocols = 1;
+  uint8_t nextProtocol = 0;
+
+  uint64_t lastPollTime = 0;
+  uint64_t lastPublishTime = 0;
   std::string lastPublishedUid;
-  bool cardPresent = false;
-  uint8_t consecutiveMisses = 0;
+  // Every card seen since the field was last empty: one session each, from
+  // the scan that first saw it until MAX_MISSES_BEFORE_RESET scans of its
+  // protocol miss it. None of them is reported again within its session
+  // unless retapping is on, so pulling one card out of a wallet that was
+  // read as ambiguous does not turn into a tap.
+  struct PresentCard {
+    std::string uid;
+    hal::CardProtocol protocol = hal::CardProtocol::Iso14443A;
+    uint64_t firstSeenAt = 0;
+    uint64_t lastSeenAt = 0;
+    uint64_t reportedAt = 0;
+    // Scans of its protocol in a row that did not see it.
+    uint8_t misses = 0;
+    // Only reported cards have their removal reported.
+    bool reported = false;
+  };
+  static constexpr size_t MAX_PRESENT_CARDS = 4;
+  std::array<PresentCard, MAX_PRESENT_CARDS> presentCards;
+  size_t presentCount = 0;
+  // A lone new card waiting for the other protocols' scans; reported once
+  // pendingScansLeft reaches 0 without another card turning up.
+  PresentCard pendingCard;
+  uint8_t pendingScansLeft = 0;
+  std::array<CardRemoval, MAX_PRESENT_CARDS> removals;
+  size_t removalCount = 0;
   static constexpr uint8_t MAX_MISSES_BEFORE_RESET = 3;
   uint16_t consecutiveFailedScans = 0;
   static constexpr uint16_t FAILED_SCAN_THRESHOLD_FOR_HEALTH_CHECK = 5;
   static constexpr unsigned long HEALTH_CHECK_INTERVAL_MS = 1000;
   static constexpr unsigned long RECOVER_TICK_INTERVAL_MS = 5;
 
+  hal::CardProtocol takeNextProtocol();
+  // Counts a scan that found no new card against the pending one.
+  bool releasePending(CardTap& tapOut, uint64_t now);
+  bool reportCard(const std::string& uid, hal::CardProtocol protocol, uint64_t now, CardTap& tapOut);
+  bool reportAmbiguous(const std::string& uid, hal::CardProtocol protocol, const std::string& otherUid, CardTap& tapOut);
+  // Records uid as seen; true when it starts a session or is due a retap.
+  bool markPresent(const std::string& uid, hal::CardProtocol protocol, uint64_t now);
+  void markReported(const std::string& uid, uint64_t now);
+  // Drops every session without reporting removals, for a reader that
+  // stopped answering rather than a field that emptied.
+  void clearPresent();
+  // Counts a miss against each of the protocol's cards the scan did not
+  // see, a card only answering scans for its own protocol, and ends the
+  // sessions that reach MAX_MISSES_BEFORE_RESET, queuing their removals.
+  void ageSessions(hal::CardProtocol protocol, const std::string* seenUids, uint8_t seenCount);
+
+  static constexpr uint8_t MAX_TARGETS = 2;
+  static constexpr uint16_t SHORT_SCAN_TIMEOUT_MS = 30;
   static std::string convertUidToDecimal(const uint8_t* uidBytes, uint8_t length);
 };
 
@@ -3,9 +3,11 @@
 
 #include <string>
 
-std::string getMacAddress();
+#include "hal/WifiLink.h"
+
+std::string getMacAddress(const hal::WifiLink &wifi);
 
 // Example: base "esp/status" -> "esp/status/AA11BB22CC33".
-std::string makeTopicWithMac(const std::string &baseTopic);
+std::string makeTopicWithMac(const hal::WifiLink &wifi, const std::string &baseTopic);
 
 #endif // DEVICEUTILS_H
@@ -0,0 +1,92 @@
+#ifndef FIXED_STRING_H
+#define FIXED_STRING_H
+
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+// NUL-terminated string stored inline with a compile-time capacity. Used for
+// state that lives as long as the device runs, so it never fragments the
+// heap.
+template <size_t MaxLength>
+class FixedString
+{
+public:
+    static constexpr size_t MAX_LENGTH = MaxLength;
+
+    // Replaces the contents; fails and leaves the string empty when the text
+    // does not fit.
+    bool assign(std::string_view text)
+    {
+        clear();
+        return text.size() <= MaxLength && append(text);
+    }
+
+    // Appends as much as fits; false when the text was truncated.
+    bool append(std::string_view text)
+    {
+        const size_t room = MaxLength - length;
+        const size_t count = text.size() < room ? text.size() : room;
+        std::memcpy(buffer + length, text.data(), count);
+        length += count;
+        buffer[length] = '\0';
+        return count == text.size();
+    }
+
+    void clear()
+    {
+        length = 0;
+        buffer[0] = '\0';
+    }
+
+    const char *c_str() const
+    {
+        return buffer;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+    bool empty() const
+    {
+        return length == 0;
+    }
+
+    std::string_view view() const
+    {
+        return std::string_view(buffer, length);
+    }
+
+    operator std::string_view() const
+    {
+        return view();
+    }
+
+    bool operator==(std::string_view other) const
+    {
+        return view() == other;
+    }
+
+    bool operator!=(std::string_view other) const
+    {
+        return view() != other;
+    }
+
+    friend bool operator==(std::string_view lhs, const FixedString &rhs)
+    {
+        return rhs == lhs;
+    }
+
+    friend bool operator!=(std::string_view lhs, const FixedString &rhs)
+    {
+        return rhs != lhs;
+    }
+
+private:
+    char buffer[MaxLength + 1] = {};
+    size_t length = 0;
+};
+
+#endif // FIXED_STRING_H
@@ -1,8 +1,21 @@
 #ifndef HARDWARE_CONFIG_H
 #define HARDWARE_CONFIG_H
 
+#include <cstddef>
 #include <cstdint>
 
+// Readers on this controller. A single reader sits directly on the I2C bus;
+// a docking station builds with -DNFC_BAY_COUNT=<bays> and puts bay n on
+// channel n of a TCA9548A.
+#ifndef NFC_BAY_COUNT
+#define NFC_BAY_COUNT 1
+#endif
+
+// Boards with a switch on the lock bolt build with -DLOCK_SENSOR_WIRED=1.
+#ifndef LOCK_SENSOR_WIRED
+#define LOCK_SENSOR_WIRED 0
+#endif
+
 namespace HardwareConfig {
 constexpr uint8_t I2C_SDA_PIN = 21;
 constexpr uint8_t I2C_SCL_PIN = 22;
@@ -10,6 +23,17 @@ constexpr uint8_t I2C_SCL_PIN = 22;
 // Leaving these defined keeps Adafruit_PN532 happy even when IRQ/RST are not wired.
 constexpr uint8_t PN532_IRQ_PIN = 4;
 constexpr uint8_t PN532_RESET_PIN = 5;
+// PN532 on HSPI, used when NFC_BUS=spi and the board's interface switches are
+// set to SPI.
+constexpr uint8_t PN532_SPI_SCK_PIN = 14;
+constexpr uint8_t PN532_SPI_MISO_PIN = 27;
+constexpr uint8_t PN532_SPI_MOSI_PIN = 13;
+constexpr uint8_t PN532_SPI_SS_PIN = 15;
+constexpr size_t NFC_BAYS = NFC_BAY_COUNT;
+// One per mux channel.
+constexpr size_t MAX_NFC_BAYS = 8;
+static_assert(NFC_BAYS >= 1 && NFC_BAYS <= MAX_NFC_BAYS, "NFC_BAY_COUNT must be 1 to 8");
+constexpr uint8_t I2C_MUX_ADDRESS = 0x70;
 constexpr uint8_t LED_RED_PIN = 16;
 constexpr uint8_t LED_YELLOW_PIN = 17;
 constexpr uint8_t LED_GREEN_PIN = 18;
@@ -26,6 +50,23 @@ constexpr uint8_t LED_PULSE_MAX_BRIGHTNESS = 255;
 constexpr unsigned long LED_FAST_BLINK_INTERVAL = 200;
 constexpr unsigned long LED_SLOW_PULSE_PERIOD = 2000;
 constexpr unsigned long LED_SOLID_UPDATE_INTERVAL = 100;
+constexpr unsigned long LED_PULSE_FRAME_INTERVAL = 20;
+// Solenoid lock behind a relay or MOSFET, energized to release the bolt.
+// Hardware timer LOCK_PULSE_TIMER ends each pulse.
+constexpr uint8_t LOCK_COIL_PIN = 25;
+constexpr bool LOCK_COIL_ACTIVE_HIGH = true;
+constexpr uint8_t LOCK_PULSE_TIMER = 0;
+// Bolt switch to ground, read with the pull-up on.
+constexpr bool LOCK_SENSOR = LOCK_SENSOR_WIRED != 0;
+constexpr uint8_t LOCK_SENSOR_PIN = 26;
+constexpr bool LOCK_SENSOR_LOCKED_LEVEL = false;
+// For commands without a durationMs. Longer requests are cut to the most
+// the coil is rated to stay energized for.
+constexpr uint32_t LOCK_DEFAULT_PULSE_MS = 500;
+constexpr uint32_t LOCK_MAX_PULSE_MS = 3000;
+// A pulse this far past its end has lost its timer and is forced off.
+constexpr uint32_t LOCK_WATCHDOG_MARGIN_MS = 100;
+constexpr unsigned long LOCK_SENSOR_POLL_MS = 2;
 } // namespace HardwareConfig
 
 #endif // HARDWARE_CONFIG_H
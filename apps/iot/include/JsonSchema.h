@@ -0,0 +1,159 @@
+#ifndef JSON_SCHEMA_H
+#define JSON_SCHEMA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "JsonWriter.h"
+
+// Compile-time description of a flat JSON object whose keys never change.
+// Each field names a key and a member of the message struct; the key is
+// turned into its ,"key": fragment at compile time, so serializing is a
+// sequence of memcpy calls and value formatting, in declaration order:
+//
+//   constexpr auto PING_SCHEMA = jsonSchema(jsonField("deviceId", &Ping::deviceId),
+//                                           jsonField("uptimeMs", &Ping::uptimeMs));
+//   const size_t length = PING_SCHEMA.serialize(ping, buffer, sizeof(buffer));
+//
+// std::optional members are left out entirely when empty. Other member types
+// need a writeJsonValue(JsonWriter &, const T &) overload.
+
+template <size_t NameSize>
+struct JsonKey
+{
+    // ',' '"' name '"' ':'; the first field of an object skips the comma.
+    static constexpr size_t LENGTH = NameSize + 3;
+    char text[LENGTH];
+};
+
+template <size_t NameSize>
+constexpr JsonKey<NameSize> jsonKey(const char (&name)[NameSize])
+{
+    JsonKey<NameSize> key{};
+    key.text[0] = ',';
+    key.text[1] = '"';
+    for (size_t index = 0; index + 1 < NameSize; ++index)
+    {
+        key.text[index + 2] = name[index];
+    }
+    key.text[NameSize + 1] = '"';
+    key.text[NameSize + 2] = ':';
+    return key;
+}
+
+inline void writeJsonValue(JsonWriter &writer, const char *value)
+{
+    writer.writeString(value);
+}
+
+inline void writeJsonValue(JsonWriter &writer, bool value)
+{
+    writer.writeBool(value);
+}
+
+inline void writeJsonValue(JsonWriter &writer, uint32_t value)
+{
+    writer.writeUnsigned(value);
+}
+
+inline void writeJsonValue(JsonWriter &writer, uint64_t value)
+{
+    writer.writeUnsigned(value);
+}
+
+template <typename Value>
+struct IsOptionalJsonValue : std::false_type
+{
+};
+
+template <typename Value>
+struct IsOptionalJsonValue<std::optional<Value>> : std::true_type
+{
+};
+
+template <typename Message, typename Value, size_t NameSize>
+struct JsonField
+{
+    using MessageType = Message;
+    static constexpr bool OPTIONAL = IsOptionalJsonValue<Value>::value;
+
+    JsonKey<NameSize> key;
+    Value Message::*member;
+
+    template <bool First>
+    void write(JsonWriter &writer, const Message &message) const
+    {
+        const Value &value = message.*member;
+        constexpr size_t skip = First ? 1 : 0;
+        if constexpr (OPTIONAL)
+        {
+            if (!value.has_value())
+            {
+                return;
+            }
+            writer.writeRaw(key.text + skip, key.LENGTH - skip);
+            writeJsonValue(writer, *value);
+        }
+        else
+        {
+            writer.writeRaw(key.text + skip, key.LENGTH - skip);
+            writeJsonValue(writer, value);
+        }
+    }
+};
+
+template <typename Message, typename Value, size_t NameSize>
+constexpr JsonField<Message, Value, NameSize> jsonField(const char (&name)[NameSize], Value Message::*member)
+{
+    return JsonField<Message, Value, NameSize>{jsonKey(name), member};
+}
+
+template <typename Message, typename... Fields>
+class JsonSchema
+{
+public:
+    constexpr explicit JsonSchema(Fields... fields)
+        : fields(fields...)
+    {
+    }
+
+    // Same contract as serializeJson into a char buffer, except that text
+    // which does not fit yields 0 instead of a truncated object.
+    size_t serialize(const Message &message, char *buffer, size_t capacity) const
+    {
+        JsonWriter writer(buffer, capacity);
+        write(writer, message);
+        return writer.finish();
+    }
+
+    void write(JsonWriter &writer, const Message &message) const
+    {
+        writer.writeRaw('{');
+        writeFields(writer, message, std::index_sequence_for<Fields...>{});
+        writer.writeRaw('}');
+    }
+
+private:
+    template <size_t... Index>
+    void writeFields(JsonWriter &writer, const Message &message, std::index_sequence<Index...>) const
+    {
+        (std::get<Index>(fields).template write<Index == 0>(writer, message), ...);
+    }
+
+    std::tuple<Fields...> fields;
+};
+
+template <typename First, typename... Rest>
+constexpr JsonSchema<typename First::MessageType, First, Rest...> jsonSchema(First first, Rest... rest)
+{
+    // Whether a comma is needed is decided at compile time, so the object
+    // must open with a field that is always present.
+    static_assert(!First::OPTIONAL, "the first field of a JSON schema cannot be optional");
+    return JsonSchema<typename First::MessageType, First, Rest...>(first, rest...);
+}
+
+#endif // JSON_SCHEMA_H
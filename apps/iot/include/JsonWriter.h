@@ -0,0 +1,102 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// Appends compact JSON text to a caller-owned buffer, with the escape set
+// and number formatting modelled on ArduinoJson 6. Nothing is written past
+// the buffer; once a write does not fit the writer stops and finish()
+// reports 0.
+class JsonWriter
+{
+public:
+    // capacity includes room for the terminating NUL.
+    JsonWriter(char *buffer, size_t capacity)
+        : buffer(buffer), capacity(capacity)
+    {
+    }
+
+    void writeRaw(char c)
+    {
+        if (length + 1 >= capacity)
+        {
+            overflowed = true;
+            return;
+        }
+        buffer[length++] = c;
+    }
+
+    void writeRaw(const char *text, size_t textLength)
+    {
+        if (length + textLength >= capacity)
+        {
+            overflowed = true;
+            return;
+        }
+        std::memcpy(buffer + length, text, textLength);
+        length += textLength;
+    }
+
+    // Quoted, escaping only what ArduinoJson escapes; nullptr becomes null.
+    void writeString(const char *text);
+    void writeUnsigned(uint64_t value);
+
+    void writeBool(bool value)
+    {
+        if (value)
+        {
+            writeRaw("true", 4);
+        }
+        else
+        {
+            writeRaw("false", 5);
+        }
+    }
+
+    // Free space after the text written so far, for serializers that write
+    // into the buffer themselves. commit() accounts for what they wrote.
+    char *cursor()
+    {
+        return buffer + length;
+    }
+
+    size_t remaining() const
+    {
+        return overflowed || length >= capacity ? 0 : capacity - length;
+    }
+
+    void commit(size_t written)
+    {
+        length += written;
+    }
+
+    void fail()
+    {
+        overflowed = true;
+    }
+
+    // Terminates the text and returns its length, or 0 if anything was cut.
+    size_t finish()
+    {
+        if (overflowed || capacity == 0)
+        {
+            if (capacity > 0)
+            {
+                buffer[0] = '\0';
+            }
+            return 0;
+        }
+        buffer[length] = '\0';
+        return length;
+    }
+
+private:
+    char *buffer;
+    size_t capacity;
+    size_t length = 0;
+    bool overflowed = false;
+};
+
+#endif // JSON_WRITER_H
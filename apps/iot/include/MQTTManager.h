@@ -1,15 +1,21 @@
 #ifndef MQTTMANAGER_H
 #define MQTTMANAGER_H
 
-#include <PubSubClient.h>
-#include <WiFiClient.h>
 #include <string>
 #include <string_view>
 
+#include "FixedString.h"
+#include "hal/MqttTransport.h"
+
 class MQTTManager
 {
 public:
-    MQTTManager(WiFiClient &wifiClient,
+    // Client id, broker host and credentials are kept inline at these
+    // lengths; isConfigValid() rejects anything longer.
+    static constexpr size_t MAX_CLIENT_ID_LENGTH = 47;
+    static constexpr size_t MAX_SETTING_LENGTH = 63;
+
+    MQTTManager(hal::MqttTransport &transport,
                 std::string_view clientId,
                 std::string_view brokerIP,
                 int port,
@@ -21,16 +27,16 @@ public:
     bool publish(std::string_view topic, std::string_view message, bool retained = false, bool logMessage = true);
     bool subscribe(const char *topic);
     bool subscribe(std::string_view topic);
-    void setCallback(void (*callback)(char *, byte *, unsigned int));
+    void setCallback(hal::MqttTransport::MessageCallback callback);
     bool isConnected();
 
 private:
-    PubSubClient _client;
-    std::string _clientId;
-    std::string _brokerIP;
+    hal::MqttTransport &_client;
+    FixedString<MAX_CLIENT_ID_LENGTH> _clientId;
+    FixedString<MAX_SETTING_LENGTH> _brokerIP;
     int _port;
-    std::string _username;
-    std::string _password;
+    FixedString<MAX_SETTING_LENGTH> _username;
+    FixedString<MAX_SETTING_LENGTH> _password;
 };
 
 #endif // MQTTMANAGER_H
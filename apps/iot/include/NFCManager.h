@@ -1,20 +1,71 @@
 #ifndef NFCMANAGER_H
 #define NFCMANAGER_H
 
-#include <Arduino.h>
-#include "Adafruit_PN532.h"
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "hal/I2CBus.h"
+#include "hal/NfcReader.h"
+
+// How the PN532 is wired, from NFC_BUS in the config. The board's mode
+// switches have to match.
+enum class NfcBusMode : uint8_t
+{
+    // "i2c" or unset: 400 kHz, dropping to 100 kHz for good when the chip
+    // only answers there or keeps failing soon after every recovery.
+    I2cAdaptive,
+    // "i2c-100k": the standard-mode clock, never changed.
+    I2cStandard,
+    // "spi": the bay's SPI reader, or adaptive I2C when it has none.
+    Spi,
+};
+
+// Empty when the name is not one of the above.
+std::optional<NfcBusMode> parseNfcBusMode(std::string_view name);
+
+// NFC_PROTOCOLS: a comma-separated list of cardProtocolName()s, e.g.
+// "iso14443a,felica". Unset means ISO14443A only; empty when a name is
+// unknown.
+std::optional<hal::CardProtocolMask> parseCardProtocols(std::string_view names);
+// "iso14443a", "iso14443b" or "felica", as in config and tap events.
+const char *cardProtocolName(hal::CardProtocol protocol);
 
 class NFCManager
 {
 public:
-    NFCManager();
+    static constexpr uint32_t I2C_FAST_CLOCK_HZ = 400000;
+    static constexpr uint32_t I2C_STANDARD_CLOCK_HZ = 100000;
+    // Adafruit_PN532 runs hardware SPI at a fixed 1 MHz.
+    static constexpr uint32_t SPI_CLOCK_HZ = 1000000;
+
+    // bay only labels log lines.
+    NFCManager(hal::NfcReader &reader,
+               hal::I2CBus &i2c,
+               uint8_t bay = 0,
+               NfcBusMode busMode = NfcBusMode::I2cStandard,
+               hal::NfcReader *spiReader = nullptr);
+    ~NFCManager();
     bool begin();
     void recoverTick();
     void markUnhealthy();
     bool isHealthy() const; // const is because it does not modify any member variables
     bool isRecovering() const;
+    // True from a recovery's I2C end() until its begin(). Other bays on the
+    // same bus must leave it alone until then.
+    bool busStopped() const;
+    uint64_t nextRecoveryActionAt() const;
     bool healthCheck(); // not const because it may modify member variables
-    bool scanForCard(uint8_t *uid, uint8_t *uidLength, uint16_t timeoutMs = 30);
+    // Number of cards of protocol that answered, up to maxTargets.
+    uint8_t scanForCards(hal::CardProtocol protocol,
+                         hal::PassiveTarget *targets,
+                         uint8_t maxTargets,
+                         uint16_t timeoutMs = 30);
+    // Powers a healthy reader down until the next scan or health check,
+    // which wake it first. Parking is part of Healthy, not a state of its
+    // own, so recovery never sees a sleeping chip.
+    bool park();
+    bool isParked() const;
 
 private:
     enum class HealthState : uint8_t
@@ -24,22 +75,43 @@ private:
         Recovering
     };
 
+    void setHealthState(HealthState next);
     void startRecovery();
     bool performReinitialization();
+    bool usesI2c() const;
+    // Wakes the chip and returns its firmware version, 0 if it did not
+    // answer. In adaptive mode a quick failure is retried at 100 kHz.
+    uint32_t wakeChip();
+    void stepDownClock();
+    // False when a parked chip did not come back.
+    bool wakeIfParked();
 
+    static constexpr uint16_t I2C_TIMEOUT_MS = 50;
     static constexpr unsigned long I2C_RESTART_DELAY_MS = 10;
     static constexpr unsigned long RECOVERY_BACKOFF_INITIAL_MS = 1000;
     static constexpr unsigned long RECOVERY_BACKOFF_MAX_MS = 15000;
+    // A chip that answers at 400 kHz after each bus restart but fails again
+    // within FAST_CLOCK_STABLE_MS is moved to 100 kHz on the recovery after
+    // this many such failures in a row.
+    static constexpr uint8_t FAST_CLOCK_FAILURES_BEFORE_STEP_DOWN = 3;
+    static constexpr unsigned long FAST_CLOCK_STABLE_MS = 60000;
 
     HealthState healthState = HealthState::Unhealthy; // Start as unhealty 
     uint8_t recoveryStep = 0;
-    unsigned long nextActionAt = 0;
-    unsigned long lastRecoveryAttemptAt = 0;
+    uint64_t nextActionAt = 0;
+    uint64_t nextRecoveryAttemptAt = 0;
     unsigned long recoveryBackoffMs = RECOVERY_BACKOFF_INITIAL_MS;
-    unsigned long recoveryStartedAt = 0;
+    uint64_t recoveryStartedAt = 0;
     uint32_t recoveryAttempts = 0;
+    bool parked = false;
+    uint64_t healthySince = 0;
+    uint8_t fastClockFailures = 0;
 
-    Adafruit_PN532 nfc;
+    NfcBusMode busMode;
+    // The reader the configured transport talks through.
+    hal::NfcReader &nfc;
+    hal::I2CBus &i2c;
+    uint8_t bay;
 };
 
 #endif
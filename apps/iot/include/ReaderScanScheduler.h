@@ -0,0 +1,92 @@
+#ifndef READER_SCAN_SCHEDULER_H
+#define READER_SCAN_SCHEDULER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "CardTapWatcher.h"
+#include "HardwareConfig.h"
+#include "NFCManager.h"
+#include "hal/Platform.h"
+
+// How often a bay scans, and for what. Scanning an empty field costs the
+// whole scan timeout in I2C traffic and RF, so bays nobody is using drop to
+// a slower rate and come back to the fast one on activity.
+struct NfcPollPolicy
+{
+    // Scanned one per poll in turn. With n enabled a card is read within n
+    // polls and reported within 2n - 1, once the others have had a scan.
+    hal::CardProtocolMask protocols = hal::cardProtocolBit(hal::CardProtocol::Iso14443A);
+    unsigned long activeIntervalMs = 80;
+    // 0 keeps every bay at activeIntervalMs.
+    unsigned long idleIntervalMs = 400;
+    // How long a tap, a card left in the field or station activity keeps a
+    // bay fast.
+    unsigned long activeHoldMs = 10000;
+    // Idle bays power their PN532 down between scans.
+    bool powerDownWhenIdle = true;
+    // See CardTapWatcher::setRetapInterval().
+    unsigned long retapIntervalMs = 0;
+};
+
+// Interleaves the station's readers on the device task. Each poll serves at
+// most one bay, the next due one after the bay served last, so a bay waits
+// for at most one scan or recovery step per other bay, plus the confirming
+// scans of a card found on a multi-protocol bay. A reader stuck in
+// recovery costs its neighbours one recovery step, never its whole cycle.
+// Bays sharing a bus with a bay that has stopped it to recover wait until
+// it is restarted.
+class ReaderScanScheduler
+{
+public:
+    static constexpr size_t MAX_BAYS = HardwareConfig::MAX_NFC_BAYS;
+
+    // Bays past MAX_BAYS are ignored.
+    ReaderScanScheduler(const hal::NfcBay *nfcBays,
+                        size_t nfcBayCount,
+                        NfcBusMode busMode = NfcBusMode::I2cAdaptive,
+                        const NfcPollPolicy &pollPolicy = NfcPollPolicy());
+
+    // Starts each bus once and brings up every reader. False when none
+    // answered; the others recover in the background.
+    bool begin();
+
+    // True with bay and tap set when the bay served saw a new card.
+    bool poll(uint8_t &bay, CardTap &tap);
+    // The oldest removal not yet taken, lowest bay first.
+    bool takeRemoval(uint8_t &bay, CardRemoval &removal);
+    uint64_t nextPollDueAt() const;
+    // Keeps every bay at the fast rate for the hold time, e.g. while a
+    // rental started elsewhere is expected to end at the station.
+    void noteActivity();
+
+    size_t bayCount() const;
+    const NFCManager &reader(size_t bay) const;
+
+private:
+    struct Bay
+    {
+        Bay(const hal::NfcBay &bay, uint8_t index, NfcBusMode busMode, const NfcPollPolicy &policy);
+
+        NFCManager manager;
+        CardTapWatcher watcher;
+        hal::I2CBus &bus;
+        uint64_t activeUntil = 0;
+    };
+
+    void updatePollRates(uint64_t now);
+    // Another bay on index's bus that has it stopped, or nullptr.
+    const Bay *busHolder(size_t index) const;
+
+    // Only configured bays are allocated.
+    std::array<std::unique_ptr<Bay>, MAX_BAYS> bays;
+    size_t count = 0;
+    size_t lastServed = 0;
+    NfcPollPolicy policy;
+    size_t activeBays = SIZE_MAX;
+};
+
+#endif // READER_SCAN_SCHEDULER_H
@@ -0,0 +1,83 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Lock-free ring for exactly one producer task and one consumer task. Slots
+// are filled and read in place, so nothing is copied through the ring and
+// nothing is allocated. The producer owns head and the consumer owns tail;
+// each only reads the other's index, with release/acquire ordering so a
+// slot's contents are visible before the index that publishes it.
+template <typename T, size_t Capacity>
+class SpscRing
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    static constexpr size_t CAPACITY = Capacity;
+
+    // Producer: the slot the next commit() publishes, or nullptr when the
+    // ring is full. Calling it again before commit() returns the same slot.
+    T *reserve()
+    {
+        const uint32_t currentHead = head.load(std::memory_order_relaxed);
+        if (currentHead - tail.load(std::memory_order_acquire) >= Capacity)
+        {
+            return nullptr;
+        }
+        return &slots[currentHead & INDEX_MASK];
+    }
+
+    // Producer: hands the reserved slot to the consumer.
+    void commit()
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consumer: the oldest committed slot, or nullptr when empty. It stays
+    // owned by the consumer until pop().
+    T *front()
+    {
+        const uint32_t currentTail = tail.load(std::memory_order_relaxed);
+        if (head.load(std::memory_order_acquire) == currentTail)
+        {
+            return nullptr;
+        }
+        return &slots[currentTail & INDEX_MASK];
+    }
+
+    // Consumer: returns the front slot to the producer.
+    void pop()
+    {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Either side; a snapshot that the other side may change right after.
+    size_t size() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    bool full() const
+    {
+        return size() >= Capacity;
+    }
+
+private:
+    static constexpr uint32_t INDEX_MASK = static_cast<uint32_t>(Capacity - 1);
+
+    std::array<T, Capacity> slots{};
+    // Free-running; unsigned differences stay correct across wraparound.
+    std::atomic<uint32_t> head{0};
+    std::atomic<uint32_t> tail{0};
+};
+
+#endif // SPSC_RING_H
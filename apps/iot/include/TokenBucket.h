@@ -0,0 +1,86 @@
+#ifndef TOKEN_BUCKET_H
+#define TOKEN_BUCKET_H
+
+#include <algorithm>
+#include <cstdint>
+
+// Allows bursts of up to capacity events and capacity more each time
+// capacity * refillMs passes. Tokens come back whole, one per refillMs, so
+// there is no fractional state to drift. A refillMs of 0 never limits.
+class TokenBucket
+{
+public:
+    // Starts full.
+    void configure(uint16_t capacity, uint32_t refillMs, uint64_t now)
+    {
+        bucketCapacity = capacity;
+        tokenRefillMs = refillMs;
+        tokens = capacity;
+        refilledAt = now;
+    }
+
+    bool limited() const
+    {
+        return tokenRefillMs != 0;
+    }
+
+    bool tryTake(uint64_t now)
+    {
+        if (!limited())
+        {
+            return true;
+        }
+        refill(now);
+        if (tokens == 0)
+        {
+            return false;
+        }
+        // Leaving a full bucket starts the refill clock.
+        if (tokens == bucketCapacity)
+        {
+            refilledAt = now;
+        }
+        --tokens;
+        return true;
+    }
+
+    uint16_t available(uint64_t now) const
+    {
+        if (!limited())
+        {
+            return bucketCapacity;
+        }
+        const uint64_t earned = (now - refilledAt) / tokenRefillMs;
+        return static_cast<uint16_t>(std::min<uint64_t>(bucketCapacity, tokens + earned));
+    }
+
+    // When the bucket is next full, now or earlier if it already is.
+    uint64_t fullAt() const
+    {
+        return refilledAt + static_cast<uint64_t>(bucketCapacity - tokens) * tokenRefillMs;
+    }
+
+private:
+    void refill(uint64_t now)
+    {
+        if (tokens == bucketCapacity)
+        {
+            return;
+        }
+        const uint64_t earned = (now - refilledAt) / tokenRefillMs;
+        if (tokens + earned >= bucketCapacity)
+        {
+            tokens = bucketCapacity;
+            return;
+        }
+        tokens = static_cast<uint16_t>(tokens + earned);
+        refilledAt += earned * tokenRefillMs;
+    }
+
+    uint16_t bucketCapacity = 0;
+    uint32_t tokenRefillMs = 0;
+    uint16_t tokens = 0;
+    uint64_t refilledAt = 0;
+};
+
+#endif // TOKEN_BUCKET_H
@@ -4,20 +4,35 @@
 #include <memory>
 
 #include "Config.h"
-#include "NFCManager.h"
+#include "ReaderScanScheduler.h"
+#include "app/AppEvents.h"
 #include "app/DeviceContext.h"
+#include "app/LoopProfiler.h"
+#include "app/NetworkTask.h"
 #include "app/RuntimeState.h"
+#include "app/RuntimeStateTracker.h"
+#include "app/Scheduler.h"
+#include "app/TaskChannels.h"
+#include "app/WakeSignal.h"
+#include "app/WallClock.h"
 #include "drivers/LedController.h"
+#include "drivers/LockActuator.h"
+#include "hal/Platform.h"
 #include "services/CommandConsumer.h"
-#include "services/ConnectivityService.h"
 #include "services/FeedbackController.h"
+#include "services/MetricsPublisher.h"
+#include "services/OutboundQueue.h"
 #include "services/ProvisioningService.h"
 #include "services/RuntimeStatusPublisher.h"
 #include "services/TapPublisher.h"
 
+// setup() runs once and starts the network task; loop() is the device task
+// (reader, commands, feedback, status and metrics) and runs on the caller,
+// which on the board is Arduino's loop task on core 1.
 class App
 {
 public:
+    explicit App(hal::Platform &platform);
     ~App();
 
     void setup();
@@ -27,20 +42,39 @@ private:
     void initializeLogging();
     bool loadRuntimeConfig();
     void initializeRuntimeServices();
+    bool servicesAvailable() const;
+    void applyLinkUpdates();
+    void runDueServices();
+    void scheduleNextDeadlines();
+    void sleepUntilNextDeadline();
     void applyFeedback();
     void setRuntimeState(RuntimeState state);
 
+    hal::Platform &platform;
     AppConfig config;
     RuntimeState runtimeState = RuntimeState::Booting;
+    AppEventBus events;
+    RuntimeStateTracker stateTracker;
+    Scheduler scheduler;
+    WakeSignal wakeSignal;
+    WallClock wallClock;
+    LoopProfiler loopProfiler;
     DeviceContext deviceContext;
+    // Shared with the network task; see NetworkTask.
+    OutboundQueue outboundQueue;
+    InboundCommandRing inboundCommands;
+    LinkStatusRing linkUpdates;
     LedController ledController;
-    std::unique_ptr<NFCManager> nfcManager;
-    std::unique_ptr<ConnectivityService> connectivityService;
+    std::unique_ptr<ReaderScanScheduler> readers;
+    std::unique_ptr<NetworkTask> networkTask;
     std::unique_ptr<TapPublisher> tapPublisher;
     std::unique_ptr<CommandConsumer> commandConsumer;
+    std::unique_ptr<AuthorizationCache> authorizationCache;
+    std::unique_ptr<LockActuator> lockActuator;
     std::unique_ptr<FeedbackController> feedbackController;
     std::unique_ptr<ProvisioningService> provisioningService;
     std::unique_ptr<RuntimeStatusPublisher> statusPublisher;
+    std::unique_ptr<MetricsPublisher> metricsPublisher;
     bool setupFailed = false;
 };
 
@@ -0,0 +1,68 @@
+#ifndef APP_APP_EVENTS_H
+#define APP_APP_EVENTS_H
+
+#include <cstdint>
+
+#include "app/EventBus.h"
+#include "drivers/LockActuator.h"
+
+// Events on the device task's bus. App dispatches them once per loop pass,
+// after the reader and command queue have been serviced, so every
+// subscriber sees a pass's taps and commands before status and feedback go
+// out.
+
+// A card was read and its tap event queued. While MQTT is down nothing is
+// queued and the tap is left to the authorization cache instead.
+struct TapDetected
+{
+    uint64_t cardDetectedUs = 0;
+    // See AuthorizationCache::cardKey(); 0 when the UID has none.
+    uint64_t cardKey = 0;
+    uint8_t bay = 0;
+    bool queued = true;
+    // A second card was in the field; cardKey is the first one's.
+    bool ambiguous = false;
+};
+
+enum class CommandOutcome : uint8_t
+{
+    // Unlock executed.
+    Granted,
+    // The backend, or the authorization cache while offline, refused access.
+    Denied,
+    // Invalid payload or unknown action.
+    Rejected,
+    // Ran without rider-facing feedback, e.g. ping or diagnostics.
+    Handled,
+};
+
+// A command was executed and its ack queued.
+struct CommandReceived
+{
+    CommandOutcome outcome = CommandOutcome::Handled;
+};
+
+// The lock finished a pulse, for a command or an offline grant.
+struct LockActuated
+{
+    LockActuation actuation;
+};
+
+// Either half of the link changed, as reported by the network task.
+struct ConnectivityChanged
+{
+    bool wifiConnected = false;
+    bool mqttConnected = false;
+};
+
+// A bay's PN532 failed, started recovering or came back.
+struct ReaderHealthChanged
+{
+    uint8_t bay = 0;
+    bool healthy = false;
+    bool recovering = false;
+};
+
+using AppEventBus = EventBus<16, 4, TapDetected, CommandReceived, LockActuated, ConnectivityChanged, ReaderHealthChanged>;
+
+#endif // APP_APP_EVENTS_H
@@ -1,35 +1,62 @@
 #ifndef APP_DEVICE_CONTEXT_H
 #define APP_DEVICE_CONTEXT_H
 
-#include <string>
+#include <cstddef>
+#include <string_view>
+
+#include "FixedString.h"
+
+// Longest bike id the device accepts; every topic below is sized from it.
+// The backend's Bike.id is a UUID, which is always 36 characters.
+constexpr size_t MAX_DEVICE_ID_LENGTH = 36;
+// "device/<id>/events/card" is the longest topic.
+constexpr size_t MAX_TOPIC_LENGTH = 63;
+static_assert(sizeof("device/") - 1 + MAX_DEVICE_ID_LENGTH + sizeof("/events/card") - 1 <= MAX_TOPIC_LENGTH,
+              "topics must fit the longest device id");
+
+using DeviceId = FixedString<MAX_DEVICE_ID_LENGTH>;
+using Topic = FixedString<MAX_TOPIC_LENGTH>;
 
 struct DeviceTopics
 {
-    std::string tapEventTopic;
-    std::string commandTopic;
-    std::string ackTopic;
-    std::string statusTopic;
+    Topic tapEventTopic;
+    Topic cardEventTopic;
+    Topic commandTopic;
+    Topic ackTopic;
+    Topic statusTopic;
+    Topic metricsTopic;
 };
 
+// Identity and topic table. App builds it once when the runtime services
+// start and every service holds a const reference to that one copy.
 struct DeviceContext
 {
-    std::string deviceId;
+    DeviceId deviceId;
     DeviceTopics topics;
 };
 
-inline DeviceContext makeDeviceContext(const std::string &deviceId)
+inline Topic makeDeviceTopic(std::string_view deviceId, std::string_view suffix)
+{
+    Topic topic;
+    topic.assign("device/");
+    topic.append(deviceId);
+    topic.append(suffix);
+    return topic;
+}
+
+// Ids longer than MAX_DEVICE_ID_LENGTH are rejected by isConfigValid() and
+// never reach this point.
+inline DeviceContext makeDeviceContext(std::string_view deviceId)
 {
-    const std::string baseTopic = std::string("device/") + deviceId;
-
-    return DeviceContext{
-        deviceId,
-        DeviceTopics{
-            baseTopic + "/events/tap",
-            baseTopic + "/commands",
-            baseTopic + "/acks",
-            baseTopic + "/status",
-        },
-    };
+    DeviceContext context;
+    context.deviceId.assign(deviceId);
+    context.topics.tapEventTopic = makeDeviceTopic(context.deviceId, "/events/tap");
+    context.topics.cardEventTopic = makeDeviceTopic(context.deviceId, "/events/card");
+    context.topics.commandTopic = makeDeviceTopic(context.deviceId, "/commands");
+    context.topics.ackTopic = makeDeviceTopic(context.deviceId, "/acks");
+    context.topics.statusTopic = makeDeviceTopic(context.deviceId, "/status");
+    context.topics.metricsTopic = makeDeviceTopic(context.deviceId, "/metrics");
+    return context;
 }
 
 #endif // APP_DEVICE_CONTEXT_H
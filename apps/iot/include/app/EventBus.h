@@ -0,0 +1,120 @@
+#ifndef APP_EVENT_BUS_H
+#define APP_EVENT_BUS_H
+
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <variant>
+
+// Counts events published into a full queue as "events.dropped".
+void recordDroppedEvent();
+
+// Typed publish/subscribe between services on the device task. Subscribers
+// register one handler per event type at init; publish() only queues, and
+// dispatch() delivers everything queued, including events handlers publish
+// while it runs, in publish order. The queue and the subscriber tables are
+// sized at compile time, so nothing allocates. Single task only: the network
+// task reaches the device task through its rings, never through here.
+template <size_t QueueCapacity, size_t MaxSubscribers, typename... Events>
+class EventBus
+{
+    static_assert(sizeof...(Events) > 0, "EventBus needs at least one event type");
+
+public:
+    template <typename Event>
+    using Handler = void (*)(void *context, const Event &event);
+
+    // False when Event already has MaxSubscribers handlers.
+    template <typename Event>
+    bool subscribe(Handler<Event> handler, void *context)
+    {
+        Subscribers<Event> &list = std::get<Subscribers<Event>>(subscribers);
+        if (list.count == MaxSubscribers)
+        {
+            return false;
+        }
+        list.entries[list.count++] = Subscriber<Event>{handler, context};
+        return true;
+    }
+
+    // Binds a member function, e.g.
+    // bus.subscribe<TapDetected, &FeedbackController::onTapDetected>(*this).
+    template <typename Event, auto Method, typename Target>
+    bool subscribe(Target &target)
+    {
+        return subscribe<Event>([](void *context, const Event &event)
+                                { (static_cast<Target *>(context)->*Method)(event); },
+                                &target);
+    }
+
+    // False when the queue is full; the event is dropped and counted.
+    template <typename Event>
+    bool publish(const Event &event)
+    {
+        if (queued == QueueCapacity)
+        {
+            recordDroppedEvent();
+            return false;
+        }
+        queue[(head + queued) % QueueCapacity] = event;
+        ++queued;
+        return true;
+    }
+
+    // Returns the number of events delivered.
+    size_t dispatch()
+    {
+        size_t delivered = 0;
+        while (queued > 0)
+        {
+            // Copied out so handlers can publish while it is delivered.
+            const QueuedEvent event = queue[head];
+            head = (head + 1) % QueueCapacity;
+            --queued;
+            std::visit([this](const auto &value)
+                       { deliver(value); },
+                       event);
+            ++delivered;
+        }
+        return delivered;
+    }
+
+    bool empty() const
+    {
+        return queued == 0;
+    }
+
+private:
+    using QueuedEvent = std::variant<Events...>;
+
+    template <typename Event>
+    struct Subscriber
+    {
+        Handler<Event> handler = nullptr;
+        void *context = nullptr;
+    };
+
+    template <typename Event>
+    struct Subscribers
+    {
+        std::array<Subscriber<Event>, MaxSubscribers> entries{};
+        size_t count = 0;
+    };
+
+    template <typename Event>
+    void deliver(const Event &event) const
+    {
+        const Subscribers<Event> &list = std::get<Subscribers<Event>>(subscribers);
+        for (size_t index = 0; index < list.count; ++index)
+        {
+            list.entries[index].handler(list.entries[index].context, event);
+        }
+    }
+
+    std::tuple<Subscribers<Events>...> subscribers;
+    std::array<QueuedEvent, QueueCapacity> queue{};
+    size_t head = 0;
+    size_t queued = 0;
+};
+
+#endif // APP_EVENT_BUS_H
@@ -0,0 +1,46 @@
+#ifndef APP_LOOP_PROFILER_H
+#define APP_LOOP_PROFILER_H
+
+#include <cstddef>
+#include <cstdint>
+
+enum class LoopStage : uint8_t
+{
+    Connectivity,
+    CommandDrain,
+    TapPoll,
+    StatusPublish,
+    Feedback,
+    OutboundDrain,
+    Count,
+};
+
+const char *loopStageName(LoopStage stage);
+
+// Times App::loop and NetworkTask stages into the "loop.<stage>_us"
+// registry histograms, which MetricsPublisher exports and resets with every
+// flush.
+class LoopProfiler
+{
+public:
+    static constexpr size_t STAGE_COUNT = static_cast<size_t>(LoopStage::Count);
+
+    class ScopedTimer
+    {
+    public:
+        ScopedTimer(LoopProfiler &profiler, LoopStage stage);
+        ~ScopedTimer();
+
+        ScopedTimer(const ScopedTimer &) = delete;
+        ScopedTimer &operator=(const ScopedTimer &) = delete;
+
+    private:
+        LoopProfiler &profiler;
+        LoopStage stage;
+        unsigned long startedAtUs;
+    };
+
+    void record(LoopStage stage, uint32_t micros);
+};
+
+#endif // APP_LOOP_PROFILER_H
@@ -0,0 +1,62 @@
+#ifndef APP_NETWORK_TASK_H
+#define APP_NETWORK_TASK_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "Config.h"
+#include "app/DeviceContext.h"
+#include "app/LoopProfiler.h"
+#include "app/TaskChannels.h"
+#include "app/WakeSignal.h"
+#include "hal/Platform.h"
+#include "services/ConnectivityService.h"
+#include "services/OutboundQueue.h"
+
+// The connectivity half of the firmware: WiFi, the MQTT session and the
+// outbound drain, on its own task pinned to core 0 next to the WiFi stack.
+// App::loop stays on core 1 with the reader, commands and feedback. The two
+// share nothing mutable but their rings: this task drains OutboundQueue and
+// pushes received commands and link changes to the device task, waking it
+// after every push. A reconnect or a stalled socket blocks this task only.
+class NetworkTask
+{
+public:
+    NetworkTask(const AppConfig &config,
+                const DeviceContext &deviceContext,
+                hal::Platform &platform,
+                OutboundQueue &outboundQueue,
+                InboundCommandRing &inboundCommands,
+                LinkStatusRing &linkUpdates,
+                WakeSignal &deviceWake);
+
+    bool start();
+    // Parks the task for good; App's destructor needs it gone first.
+    void stop();
+
+private:
+    static void run(void *argument);
+    void loopOnce();
+    void onMessage(char *topic, uint8_t *payload, unsigned int length);
+    void publishLinkStatus();
+    void sleepUntilNextDeadline();
+
+    hal::Platform &platform;
+    const DeviceContext &deviceContext;
+    OutboundQueue &outboundQueue;
+    InboundCommandRing &inboundCommands;
+    LinkStatusRing &linkUpdates;
+    WakeSignal &deviceWake;
+    WakeSignal wakeSignal;
+    LoopProfiler loopProfiler;
+    ConnectivityService connectivityService;
+    LinkStatus publishedLink;
+    bool linkUpdatePending = false;
+    bool connectivityDue = true;
+    uint64_t nextConnectivityAt = 0;
+    bool started = false;
+    std::atomic<bool> stopRequested{false};
+    std::atomic<bool> parked{false};
+};
+
+#endif // APP_NETWORK_TASK_H
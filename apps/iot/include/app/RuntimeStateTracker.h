@@ -0,0 +1,43 @@
+#ifndef APP_RUNTIME_STATE_TRACKER_H
+#define APP_RUNTIME_STATE_TRACKER_H
+
+#include <cstdint>
+#include <optional>
+
+#include "app/AppEvents.h"
+#include "app/RuntimeState.h"
+
+// Keeps the runtime state from the events that change it, so App no longer
+// re-reads the link and the reader on every pass.
+class RuntimeStateTracker
+{
+public:
+    void subscribe(AppEventBus &events);
+
+    RuntimeState state() const;
+    bool wifiConnected() const;
+    bool online() const;
+    // Every bay that has reported is healthy.
+    bool readerHealthy() const;
+    // Bit n set while bay n is healthy; empty until a second bay reports.
+    std::optional<uint32_t> healthyBays() const;
+
+    // Tap and command states last for the pass they happened in.
+    void endPass();
+
+private:
+    void onTapDetected(const TapDetected &event);
+    void onCommandReceived(const CommandReceived &event);
+    void onConnectivityChanged(const ConnectivityChanged &event);
+    void onReaderHealthChanged(const ReaderHealthChanged &event);
+
+    ConnectivityChanged link;
+    // Bit n per bay, set once the bay has reported.
+    uint32_t reportedBays = 0;
+    uint32_t healthyBayMask = 0;
+    uint32_t recoveringBayMask = 0;
+    bool tapThisPass = false;
+    bool commandThisPass = false;
+};
+
+#endif // APP_RUNTIME_STATE_TRACKER_H
@@ -0,0 +1,68 @@
+#ifndef APP_SCHEDULER_H
+#define APP_SCHEDULER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+enum class ScheduledService : uint8_t
+{
+    Provisioning,
+    CommandDrain,
+    TapPolling,
+    StatusPublish,
+    Feedback,
+    MetricsPublish,
+    LockActuator,
+    Count,
+};
+
+// Deadlines are hal::uptimeMs() values. The 64-bit counter does not wrap,
+// so these are plain comparisons; they stay as helpers so call sites read
+// the same as they did with the 32-bit millis() arithmetic.
+inline bool deadlineReached(uint64_t now, uint64_t deadline)
+{
+    return now >= deadline;
+}
+
+inline uint64_t earlierDeadline(uint64_t lhs, uint64_t rhs)
+{
+    return lhs <= rhs ? lhs : rhs;
+}
+
+inline uint64_t laterDeadline(uint64_t lhs, uint64_t rhs)
+{
+    return lhs >= rhs ? lhs : rhs;
+}
+
+class Scheduler
+{
+public:
+    // Upper bound on a single idle sleep so a missed wake source can never
+    // stall the loop for longer than this.
+    static constexpr unsigned long MAX_SLEEP_MS = 1000;
+
+    void scheduleAt(ScheduledService service, uint64_t deadline);
+    void markDue(ScheduledService service);
+    void cancel(ScheduledService service);
+
+    bool isDue(ScheduledService service, uint64_t now) const;
+    unsigned long millisUntilNextDeadline(uint64_t now) const;
+
+private:
+    struct Slot
+    {
+        uint64_t deadline = 0;
+        bool armed = false;
+        bool forced = true; // Everything runs once on the first pass.
+    };
+
+    static constexpr size_t SERVICE_COUNT = static_cast<size_t>(ScheduledService::Count);
+
+    Slot &slot(ScheduledService service);
+    const Slot &slot(ScheduledService service) const;
+
+    std::array<Slot, SERVICE_COUNT> slots{};
+};
+
+#endif // APP_SCHEDULER_H
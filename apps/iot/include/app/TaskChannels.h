@@ -0,0 +1,50 @@
+#ifndef APP_TASK_CHANNELS_H
+#define APP_TASK_CHANNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "FixedString.h"
+#include "SpscRing.h"
+
+// What the network task hands the device task. Outbound messages go the
+// other way through OutboundQueue. Every ring has one producer and one
+// consumer task, and each push is followed by a WakeSignal notify so the
+// receiving side does not wait out its sleep.
+
+// A payload from the command topic, copied out of the MQTT client's buffer.
+struct InboundCommand
+{
+    // Longer commands are rejected as invalid rather than buffered.
+    static constexpr size_t MAX_PAYLOAD_LENGTH = 511;
+
+    // hal::uptimeUs() when the MQTT client handed it over.
+    uint64_t receivedAtUs = 0;
+    // Empty when the payload did not fit.
+    FixedString<MAX_PAYLOAD_LENGTH> payload;
+};
+
+// Commands arriving while the ring is full are dropped unacknowledged and
+// counted in command.inbound_dropped.
+using InboundCommandRing = SpscRing<InboundCommand, 4>;
+
+// Pushed whenever either half of the link changes.
+struct LinkStatus
+{
+    bool wifiConnected = false;
+    bool mqttConnected = false;
+
+    bool operator==(const LinkStatus &other) const
+    {
+        return wifiConnected == other.wifiConnected && mqttConnected == other.mqttConnected;
+    }
+
+    bool operator!=(const LinkStatus &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+using LinkStatusRing = SpscRing<LinkStatus, 4>;
+
+#endif // APP_TASK_CHANNELS_H
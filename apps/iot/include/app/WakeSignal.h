@@ -0,0 +1,46 @@
+#ifndef APP_WAKE_SIGNAL_H
+#define APP_WAKE_SIGNAL_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "hal/Platform.h"
+
+namespace WakeEvent
+{
+constexpr uint32_t MQTT_SOCKET = 1U << 0;
+constexpr uint32_t NFC_IRQ = 1U << 1;
+constexpr uint32_t SERIAL_RX = 1U << 2;
+constexpr uint32_t WIFI = 1U << 3;
+// Posted between the device and network tasks alongside their rings.
+constexpr uint32_t COMMAND_RECEIVED = 1U << 4;
+constexpr uint32_t LINK_CHANGED = 1U << 5;
+constexpr uint32_t OUTBOUND_QUEUED = 1U << 6;
+constexpr uint32_t OUTBOUND_SPACE = 1U << 7;
+} // namespace WakeEvent
+
+// Blocks a task until a deadline passes or an external source fires. ISRs,
+// driver callbacks and the other task post into an eventfd that is waited on
+// together with the MQTT socket, so socket data, NFC IRQ, UART RX, WiFi and
+// cross-task events all end an idle sleep immediately.
+class WakeSignal
+{
+public:
+    // Registers the driver callbacks for the NFC_IRQ, SERIAL_RX and WIFI
+    // bits set in sources; each task listens to its own drivers.
+    bool begin(hal::Platform &platform, uint32_t sources);
+
+    // Returns the WakeEvent bits observed since the previous call.
+    uint32_t wait(unsigned long timeoutMs, int socketFd);
+
+    void notify(uint32_t events);
+    void notifyFromIsr(uint32_t events);
+
+private:
+    static constexpr unsigned long FALLBACK_POLL_INTERVAL_MS = 5;
+
+    int eventFd = -1;
+    std::atomic<uint32_t> pendingEvents{0};
+};
+
+#endif // APP_WAKE_SIGNAL_H
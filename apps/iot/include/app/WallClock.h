@@ -0,0 +1,66 @@
+#ifndef APP_WALL_CLOCK_H
+#define APP_WALL_CLOCK_H
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "hal/FileStorage.h"
+#include "hal/NetworkTime.h"
+
+enum class TimeSyncQuality : uint8_t
+{
+    // No sync since boot; there is no wall-clock time to report.
+    None,
+    // Last sync is recent enough that drift is negligible.
+    Synced,
+    // Synced once, but the server has not answered for a while.
+    Stale,
+};
+
+const char *timeSyncQualityName(TimeSyncQuality quality);
+
+struct WallTime
+{
+    // Unix time in milliseconds, 0 when quality is None.
+    uint64_t epochMs = 0;
+    TimeSyncQuality quality = TimeSyncQuality::None;
+};
+
+// Maps hal::uptimeMs() onto wall-clock time using the latest network sync.
+// Payloads carry both: uptime orders events within a boot, the boot counter
+// orders boots, and epochMs places them in real time once it is known.
+class WallClock
+{
+public:
+    // A sync older than this is reported as stale. SNTP resyncs hourly, so
+    // this allows a few missed rounds before anyone needs to care.
+    static constexpr uint64_t FRESH_SYNC_WINDOW_MS = 3ULL * 60ULL * 60ULL * 1000ULL;
+
+    explicit WallClock(hal::NetworkTime &networkTime);
+
+    // Advances the persisted boot counter and starts syncing.
+    void begin(hal::FileStorage &storage, const std::string &server);
+
+    WallTime now() const;
+    // Wall-clock time of an earlier hal::uptimeUs() reading.
+    WallTime at(uint64_t uptimeUs) const;
+    uint32_t bootCount() const;
+
+    // Fills the "epochMs" (when known), "timeSync" and "boot" fields of an
+    // outbound message.
+    template <typename Message>
+    void stamp(Message &message) const
+    {
+        const WallTime time = now();
+        message.epochMs = time.quality != TimeSyncQuality::None ? std::optional<uint64_t>(time.epochMs) : std::nullopt;
+        message.timeSync = timeSyncQualityName(time.quality);
+        message.boot = boot;
+    }
+
+private:
+    hal::NetworkTime &networkTime;
+    uint32_t boot = 0;
+};
+
+#endif // APP_WALL_CLOCK_H
@@ -1,7 +1,9 @@
 #ifndef DRIVERS_LED_CONTROLLER_H
 #define DRIVERS_LED_CONTROLLER_H
 
-#include <Arduino.h>
+#include <cstdint>
+
+#include "hal/PwmOutput.h"
 
 enum class LedMode : uint8_t
 {
@@ -19,9 +21,12 @@ enum class LedMode : uint8_t
 class LedController
 {
 public:
+    explicit LedController(hal::PwmOutput &pwm);
+
     void begin();
     void setMode(LedMode mode);
     void update();
+    uint64_t nextUpdateAt(uint64_t now) const;
 
 private:
     void turnOffAll();
@@ -29,8 +34,9 @@ private:
     void setYellow(uint8_t brightness);
     void setGreen(uint8_t brightness);
 
+    hal::PwmOutput &pwm;
     LedMode currentMode = LedMode::Off;
-    unsigned long lastUpdateAt = 0;
+    uint64_t lastUpdateAt = 0;
     bool blinkOn = false;
 };
 
@@ -0,0 +1,71 @@
+#ifndef DRIVERS_LOCK_ACTUATOR_H
+#define DRIVERS_LOCK_ACTUATOR_H
+
+#include <cstdint>
+#include <optional>
+
+#include "hal/DigitalInput.h"
+#include "hal/PulseOutput.h"
+
+enum class LockOutcome : uint8_t
+{
+    // The bolt switch saw the lock open during the pulse.
+    Released,
+    // No bolt switch; the coil ran its full pulse.
+    Pulsed,
+    // The pulse ended with the bolt switch still reading locked.
+    Jammed,
+    // The pulse timer never fired and the coil was forced off.
+    WatchdogTripped,
+};
+
+const char *lockOutcomeName(LockOutcome outcome);
+
+struct LockActuation
+{
+    // Which unlock() this was, see LockActuator::lastPulse().
+    uint32_t pulse = 0;
+    LockOutcome outcome = LockOutcome::Pulsed;
+    // From energizing the coil to the bolt opening, or to the end of the
+    // pulse without a switch; 0 when the lock did not open.
+    uint32_t actuationMs = 0;
+    // How long the coil was actually energized.
+    uint32_t pulseMs = 0;
+};
+
+// Releases a solenoid lock with one timed coil pulse, without blocking: the
+// hardware timer behind the PulseOutput ends the pulse, and poll() picks up
+// the result on the device task. The lock is fail-secure, so the coil being
+// off is the safe state, and the pulse is forced off if its timer misses.
+class LockActuator
+{
+public:
+    // sensor is null when the bolt has no switch.
+    LockActuator(hal::PulseOutput &coil, hal::DigitalInput *sensor);
+
+    bool begin();
+    // 0 for the default pulse. False while a pulse is running.
+    bool unlock(uint32_t durationMs);
+    bool busy() const;
+    // Counts the pulses started since boot.
+    uint32_t lastPulse() const;
+    // The result once the pulse is over, and only once.
+    std::optional<LockActuation> poll();
+    // hal::uptimeMs() deadline for the next poll().
+    uint64_t nextPollAt() const;
+
+private:
+    bool boltOpen();
+    LockActuation finish(LockOutcome outcome, uint64_t releasedAtUs);
+
+    hal::PulseOutput &coil;
+    hal::DigitalInput *sensor;
+    bool pulsing = false;
+    uint32_t pulseCount = 0;
+    uint64_t startedAtUs = 0;
+    uint32_t pulseUs = 0;
+    // When the switch first read open, 0 until then.
+    uint64_t openedAtUs = 0;
+};
+
+#endif // DRIVERS_LOCK_ACTUATOR_H
@@ -0,0 +1,22 @@
+#ifndef HAL_CLOCK_H
+#define HAL_CLOCK_H
+
+#include <cstdint>
+
+// Monotonic time since boot. On the device these are the Arduino counters;
+// the native build backs them with a clock that can run in real or virtual
+// time.
+namespace hal
+{
+unsigned long millis();
+unsigned long micros();
+void delayMs(unsigned long durationMs);
+
+// The same time base as 64-bit counters that do not wrap while the device
+// is up. Absolute times and deadlines are kept in these; the 32-bit
+// counters are only for short durations.
+uint64_t uptimeMs();
+uint64_t uptimeUs();
+} // namespace hal
+
+#endif // HAL_CLOCK_H
@@ -0,0 +1,18 @@
+#ifndef HAL_DIGITAL_INPUT_H
+#define HAL_DIGITAL_INPUT_H
+
+namespace hal
+{
+// A single input pin, e.g. a switch to ground with the pull-up on.
+class DigitalInput
+{
+public:
+    virtual ~DigitalInput() = default;
+
+    virtual bool begin() = 0;
+    // True when the pin reads high.
+    virtual bool read() = 0;
+};
+} // namespace hal
+
+#endif // HAL_DIGITAL_INPUT_H
@@ -0,0 +1,11 @@
+#ifndef HAL_EVENT_FD_H
+#define HAL_EVENT_FD_H
+
+namespace hal
+{
+// Creates an eventfd that can be select()ed next to sockets and written from
+// interrupt context. Returns -1 if the platform cannot provide one.
+int createEventFd();
+} // namespace hal
+
+#endif // HAL_EVENT_FD_H
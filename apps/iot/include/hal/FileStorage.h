@@ -0,0 +1,21 @@
+#ifndef HAL_FILE_STORAGE_H
+#define HAL_FILE_STORAGE_H
+
+#include <string>
+#include <string_view>
+
+namespace hal
+{
+// Whole-file access to the persistent filesystem (SPIFFS on the device).
+class FileStorage
+{
+public:
+    virtual ~FileStorage() = default;
+
+    virtual bool mount() = 0;
+    virtual bool readFile(const char *path, std::string &contents) = 0;
+    virtual bool writeFile(const char *path, std::string_view contents) = 0;
+};
+} // namespace hal
+
+#endif // HAL_FILE_STORAGE_H
@@ -0,0 +1,31 @@
+#ifndef HAL_FLASH_REGION_H
+#define HAL_FLASH_REGION_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace hal
+{
+// A raw flash partition, read in place through a memory mapping. Writes
+// follow NOR rules: a sector reads as 0xFF after it is erased, and writes
+// can only clear bits.
+class FlashRegion
+{
+public:
+    static constexpr size_t SECTOR_SIZE = 4096;
+
+    virtual ~FlashRegion() = default;
+
+    // Maps the region; false when it does not exist.
+    virtual bool begin() = 0;
+    // Whole sectors, 0 before begin().
+    virtual size_t size() const = 0;
+    // The mapped region; written bytes show up here once write() returns.
+    virtual const uint8_t *data() const = 0;
+    // offset must be sector aligned.
+    virtual bool eraseSector(size_t offset) = 0;
+    virtual bool write(size_t offset, const void *bytes, size_t length) = 0;
+};
+} // namespace hal
+
+#endif // HAL_FLASH_REGION_H
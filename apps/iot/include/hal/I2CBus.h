@@ -0,0 +1,25 @@
+#ifndef HAL_I2C_BUS_H
+#define HAL_I2C_BUS_H
+
+#include <cstdint>
+
+namespace hal
+{
+// Bus level control only; transfers go through the device drivers. Pins are
+// a property of the implementation. begin() after end() keeps the clock and
+// timeout last set.
+class I2CBus
+{
+public:
+    virtual ~I2CBus() = default;
+
+    virtual bool begin() = 0;
+    virtual void end() = 0;
+    virtual void setClock(uint32_t frequencyHz) = 0;
+    virtual void setTimeout(uint16_t timeoutMs) = 0;
+    // 0 until setClock() is called.
+    virtual uint32_t clockHz() const = 0;
+};
+} // namespace hal
+
+#endif // HAL_I2C_BUS_H
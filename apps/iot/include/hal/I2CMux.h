@@ -0,0 +1,19 @@
+#ifndef HAL_I2C_MUX_H
+#define HAL_I2C_MUX_H
+
+#include <cstdint>
+
+namespace hal
+{
+// A TCA9548A style switch that connects one downstream channel to the bus.
+class I2CMux
+{
+public:
+    virtual ~I2CMux() = default;
+
+    // False when the switch did not acknowledge.
+    virtual bool select(uint8_t channel) = 0;
+};
+} // namespace hal
+
+#endif // HAL_I2C_MUX_H
@@ -0,0 +1,13 @@
+#ifndef HAL_ISR_ATTR_H
+#define HAL_ISR_ATTR_H
+
+// Code reachable from an interrupt must live in IRAM on the ESP32 so it
+// still runs while flash cache is disabled.
+#if defined(ESP32)
+#include <esp_attr.h>
+#define HAL_ISR_ATTR IRAM_ATTR
+#else
+#define HAL_ISR_ATTR
+#endif
+
+#endif // HAL_ISR_ATTR_H
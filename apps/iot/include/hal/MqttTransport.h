@@ -0,0 +1,41 @@
+#ifndef HAL_MQTT_TRANSPORT_H
+#define HAL_MQTT_TRANSPORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace hal
+{
+// MQTT 3.1.1 client session, shaped after PubSubClient which backs it on the
+// device.
+class MqttTransport
+{
+public:
+    using MessageCallback = std::function<void(char *topic, uint8_t *payload, unsigned int length)>;
+
+    virtual ~MqttTransport() = default;
+
+    virtual void setServer(const char *host, uint16_t port) = 0;
+    virtual void setBufferSize(uint16_t size) = 0;
+    virtual void setCallback(MessageCallback callback) = 0;
+
+    // username may be null for anonymous sessions.
+    virtual bool connect(const char *clientId, const char *username, const char *password) = 0;
+    virtual bool connected() = 0;
+    virtual int state() = 0;
+
+    virtual bool publish(const char *topic, const uint8_t *payload, size_t length, bool retained) = 0;
+    virtual bool subscribe(const char *topic) = 0;
+
+    // Handles at most one inbound packet plus keepalive.
+    virtual bool loop() = 0;
+
+    // Socket to select() on, or -1; bytesBuffered() covers data already
+    // pulled off the socket.
+    virtual int socketFd() const = 0;
+    virtual int bytesBuffered() = 0;
+};
+} // namespace hal
+
+#endif // HAL_MQTT_TRANSPORT_H
@@ -0,0 +1,35 @@
+#ifndef HAL_MUXED_NFC_READER_H
+#define HAL_MUXED_NFC_READER_H
+
+#include "hal/I2CMux.h"
+#include "hal/NfcReader.h"
+
+namespace hal
+{
+// A reader behind an I2C multiplexer. Every transaction first switches the
+// mux to the reader's channel, so PN532s that all answer on 0x24 can share
+// one bus. A failed switch fails the call the way a silent chip would.
+class MuxedNfcReader : public NfcReader
+{
+public:
+    MuxedNfcReader(NfcReader &reader, I2CMux &mux, uint8_t channel);
+
+    void begin() override;
+    uint32_t firmwareVersion() override;
+    bool configureSam() override;
+    uint8_t listPassiveTargets(CardProtocol protocol,
+                               PassiveTarget *targets,
+                               uint8_t maxTargets,
+                               uint16_t timeoutMs) override;
+    bool powerDown() override;
+    bool wakeUp() override;
+    void onIrq(IrqCallback callback, void *argument) override;
+
+private:
+    NfcReader &reader;
+    I2CMux &mux;
+    uint8_t channel;
+};
+} // namespace hal
+
+#endif // HAL_MUXED_NFC_READER_H
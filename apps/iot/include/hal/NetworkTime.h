@@ -0,0 +1,30 @@
+#ifndef HAL_NETWORK_TIME_H
+#define HAL_NETWORK_TIME_H
+
+#include <cstdint>
+
+namespace hal
+{
+// Wall-clock time from the network, SNTP on the device. Syncs run in the
+// background; callers only see the latest completed one.
+class NetworkTime
+{
+public:
+    struct Sample
+    {
+        // Unix time in microseconds at the moment of the sync...
+        int64_t epochUs = 0;
+        // ...and hal::uptimeUs() at that same moment.
+        uint64_t uptimeUs = 0;
+    };
+
+    virtual ~NetworkTime() = default;
+
+    // Starts periodic syncs against the server, replacing any previous one.
+    virtual void begin(const char *server) = 0;
+    // False until the first sync has completed.
+    virtual bool lastSync(Sample &sample) const = 0;
+};
+} // namespace hal
+
+#endif // HAL_NETWORK_TIME_H
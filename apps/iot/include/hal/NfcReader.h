@@ -0,0 +1,73 @@
+#ifndef HAL_NFC_READER_H
+#define HAL_NFC_READER_H
+
+#include <cstdint>
+
+namespace hal
+{
+// The card families a scan can look for. Each is its own
+// InListPassiveTarget, with the PN532 modulating the field differently.
+enum class CardProtocol : uint8_t
+{
+    // Mifare, DESFire and most phones.
+    Iso14443A,
+    // Calypso and other ISO14443B transit cards.
+    Iso14443B,
+    // Sony FeliCa at 212 kbps, e.g. Suica and Octopus.
+    FeliCa,
+};
+
+constexpr uint8_t CARD_PROTOCOL_COUNT = 3;
+
+// One bit per CardProtocol.
+using CardProtocolMask = uint8_t;
+
+constexpr CardProtocolMask cardProtocolBit(CardProtocol protocol)
+{
+    return static_cast<CardProtocolMask>(1u << static_cast<uint8_t>(protocol));
+}
+
+// A card that answered InListPassiveTarget. uid is the NFCID1 for type A,
+// the PUPI for type B and the IDm for FeliCa.
+struct PassiveTarget
+{
+    // Single, double and triple size UIDs are 4, 7 and 10 bytes.
+    static constexpr uint8_t MAX_UID_LENGTH = 10;
+
+    uint8_t uid[MAX_UID_LENGTH] = {};
+    uint8_t uidLength = 0;
+    CardProtocol protocol = CardProtocol::Iso14443A;
+};
+
+// The PN532 operations NFCManager relies on.
+class NfcReader
+{
+public:
+    using IrqCallback = void (*)(void *argument);
+
+    virtual ~NfcReader() = default;
+
+    virtual void begin() = 0;
+    // Returns 0 when the chip does not answer.
+    virtual uint32_t firmwareVersion() = 0;
+    virtual bool configureSam() = 0;
+    // Lists up to maxTargets cards of one protocol (the PN532 handles two)
+    // with one InListPassiveTarget. Returns how many answered; 0 for an
+    // empty field or a chip that did not answer.
+    virtual uint8_t listPassiveTargets(CardProtocol protocol,
+                                       PassiveTarget *targets,
+                                       uint8_t maxTargets,
+                                       uint16_t timeoutMs) = 0;
+    // PowerDown: RF off, woken by host interface traffic or an external RF
+    // field, raising IRQ when it wakes. False when the chip did not take it.
+    virtual bool powerDown() = 0;
+    // Wakes a powered-down chip and checks it answers again. Commands sent
+    // to a sleeping chip without this fail while it restarts.
+    virtual bool wakeUp() = 0;
+
+    // The callback may run in interrupt context.
+    virtual void onIrq(IrqCallback callback, void *argument) = 0;
+};
+} // namespace hal
+
+#endif // HAL_NFC_READER_H
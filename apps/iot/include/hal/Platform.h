@@ -0,0 +1,54 @@
+#ifndef HAL_PLATFORM_H
+#define HAL_PLATFORM_H
+
+#include <cstddef>
+
+#include "hal/DigitalInput.h"
+#include "hal/FileStorage.h"
+#include "hal/FlashRegion.h"
+#include "hal/I2CBus.h"
+#include "hal/MqttTransport.h"
+#include "hal/NetworkTime.h"
+#include "hal/NfcReader.h"
+#include "hal/PulseOutput.h"
+#include "hal/PwmOutput.h"
+#include "hal/SerialPort.h"
+#include "hal/System.h"
+#include "hal/WifiLink.h"
+
+namespace hal
+{
+// One PN532 and the bus NFCManager restarts when it wedges. Bays behind an
+// I2C multiplexer share a bus and their readers select the channel.
+struct NfcBay
+{
+    NfcReader &reader;
+    I2CBus &bus;
+    // The same chip over SPI, for NFC_BUS=spi; null when SPI is not wired.
+    NfcReader *spiReader = nullptr;
+};
+
+// Everything App touches outside the CPU. main.cpp wires the ESP32
+// implementations; host builds pass fakes.
+struct Platform
+{
+    SerialPort &serial;
+    FileStorage &storage;
+    PwmOutput &pwm;
+    // Bay n of the station is nfcBays[n].
+    const NfcBay *nfcBays;
+    size_t nfcBayCount;
+    WifiLink &wifi;
+    MqttTransport &mqtt;
+    System &system;
+    NetworkTime &networkTime;
+    // Holds the offline authorization cache; null on devices without the
+    // partition.
+    FlashRegion *authFlash = nullptr;
+    // The lock coil and its bolt switch; null when not fitted.
+    PulseOutput *lockCoil = nullptr;
+    DigitalInput *lockSensor = nullptr;
+};
+} // namespace hal
+
+#endif // HAL_PLATFORM_H
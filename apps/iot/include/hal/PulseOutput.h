@@ -0,0 +1,28 @@
+#ifndef HAL_PULSE_OUTPUT_H
+#define HAL_PULSE_OUTPUT_H
+
+#include <cstdint>
+
+namespace hal
+{
+// A digital output driven active for a set time and released by a hardware
+// timer, so the pulse ends on time even when the task that started it is
+// busy or stalled.
+class PulseOutput
+{
+public:
+    virtual ~PulseOutput() = default;
+
+    // Configures the pin and the timer and leaves the output released.
+    virtual bool begin() = 0;
+    // False while the previous pulse is still running.
+    virtual bool start(uint32_t durationUs) = 0;
+    virtual bool active() = 0;
+    // hal::uptimeUs() when the last pulse was released, 0 while one runs.
+    virtual uint64_t releasedAtUs() = 0;
+    // Releases the output now and disarms the timer.
+    virtual void forceRelease() = 0;
+};
+} // namespace hal
+
+#endif // HAL_PULSE_OUTPUT_H
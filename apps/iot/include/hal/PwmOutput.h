@@ -0,0 +1,20 @@
+#ifndef HAL_PWM_OUTPUT_H
+#define HAL_PWM_OUTPUT_H
+
+#include <cstdint>
+
+namespace hal
+{
+// LEDC style PWM: channels are configured once and bound to a pin.
+class PwmOutput
+{
+public:
+    virtual ~PwmOutput() = default;
+
+    virtual void setupChannel(uint8_t channel, uint32_t frequencyHz, uint8_t resolutionBits) = 0;
+    virtual void attachPin(uint8_t pin, uint8_t channel) = 0;
+    virtual void write(uint8_t channel, uint32_t duty) = 0;
+};
+} // namespace hal
+
+#endif // HAL_PWM_OUTPUT_H
@@ -0,0 +1,26 @@
+#ifndef HAL_SERIAL_PORT_H
+#define HAL_SERIAL_PORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace hal
+{
+class SerialPort
+{
+public:
+    virtual ~SerialPort() = default;
+
+    virtual void begin(unsigned long baudRate) = 0;
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual size_t write(const uint8_t *data, size_t length) = 0;
+    virtual void flush() = 0;
+
+    // Called from the driver task whenever bytes arrive.
+    virtual void onReceive(std::function<void()> callback) = 0;
+};
+} // namespace hal
+
+#endif // HAL_SERIAL_PORT_H
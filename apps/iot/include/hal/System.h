@@ -0,0 +1,18 @@
+#ifndef HAL_SYSTEM_H
+#define HAL_SYSTEM_H
+
+#include <cstdint>
+
+namespace hal
+{
+class System
+{
+public:
+    virtual ~System() = default;
+
+    virtual void restart() = 0;
+    virtual uint32_t freeHeapBytes() const = 0;
+};
+} // namespace hal
+
+#endif // HAL_SYSTEM_H
@@ -0,0 +1,29 @@
+#ifndef HAL_TASK_H
+#define HAL_TASK_H
+
+#include <cstdint>
+
+namespace hal
+{
+struct TaskSpec
+{
+    const char *name;
+    uint32_t stackBytes;
+    uint8_t priority;
+    // Core to pin to, or -1 to let the scheduler pick.
+    int core;
+};
+
+struct TaskHandle;
+using TaskEntry = void (*)(void *argument);
+
+// FreeRTOS tasks on the device, std::thread on the host. Tasks never return.
+TaskHandle *startTask(const TaskSpec &spec, TaskEntry entry, void *argument);
+
+// Direct-to-task notification: notifications collapse into one pending flag
+// that waitForNotification() consumes on the notified task.
+void notifyTask(TaskHandle *task);
+bool waitForNotification(unsigned long timeoutMs);
+} // namespace hal
+
+#endif // HAL_TASK_H
@@ -0,0 +1,15 @@
+#ifndef HAL_WAIT_READABLE_H
+#define HAL_WAIT_READABLE_H
+
+#include <cstddef>
+
+namespace hal
+{
+// Blocks until one of fds is readable or timeoutMs passes; negative entries
+// are skipped. readable[i] reports each entry. Returns the number of
+// readable descriptors, 0 on timeout and -1 on error. select() on the
+// device, poll() on the host where descriptors can exceed FD_SETSIZE.
+int waitReadable(const int *fds, bool *readable, size_t count, unsigned long timeoutMs);
+} // namespace hal
+
+#endif // HAL_WAIT_READABLE_H
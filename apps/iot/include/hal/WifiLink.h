@@ -0,0 +1,31 @@
+#ifndef HAL_WIFI_LINK_H
+#define HAL_WIFI_LINK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace hal
+{
+class WifiLink
+{
+public:
+    // 802.11 SSID and WPA2 passphrase limits.
+    static constexpr size_t MAX_SSID_LENGTH = 32;
+    static constexpr size_t MAX_PASSWORD_LENGTH = 63;
+
+    virtual ~WifiLink() = default;
+
+    virtual void startStation() = 0;
+    virtual void begin(const char *ssid, const char *password) = 0;
+    virtual void reconnect() = 0;
+    virtual bool isConnected() const = 0;
+    virtual int32_t rssi() const = 0;
+    virtual void macAddress(uint8_t mac[6]) const = 0;
+
+    // Called from the network task on any link state change.
+    virtual void onEvent(std::function<void()> callback) = 0;
+};
+} // namespace hal
+
+#endif // HAL_WIFI_LINK_H
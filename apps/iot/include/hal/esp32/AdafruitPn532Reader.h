@@ -0,0 +1,58 @@
+#ifndef HAL_ESP32_ADAFRUIT_PN532_READER_H
+#define HAL_ESP32_ADAFRUIT_PN532_READER_H
+
+#include <Adafruit_PN532.h>
+#include <SPI.h>
+#include <Wire.h>
+
+#include "hal/NfcReader.h"
+
+namespace hal
+{
+class AdafruitPn532Reader : public NfcReader
+{
+public:
+    // For IRQ or reset lines that are not wired. Without IRQ the library
+    // polls the chip's status byte; without reset begin() only wakes it.
+    static constexpr uint8_t NO_PIN = 0xFF;
+
+    struct SpiPins
+    {
+        uint8_t sck;
+        uint8_t miso;
+        uint8_t mosi;
+        uint8_t ss;
+    };
+
+    AdafruitPn532Reader(uint8_t irqPin, uint8_t resetPin, TwoWire &wire = Wire);
+    // The chip with its interface switches set to SPI. The library polls the
+    // status byte over SPI, so no IRQ line is used.
+    AdafruitPn532Reader(SPIClass &spi, const SpiPins &pins);
+
+    void begin() override;
+    uint32_t firmwareVersion() override;
+    bool configureSam() override;
+    uint8_t listPassiveTargets(CardProtocol protocol,
+                               PassiveTarget *targets,
+                               uint8_t maxTargets,
+                               uint16_t timeoutMs) override;
+    bool powerDown() override;
+    bool wakeUp() override;
+    void onIrq(IrqCallback callback, void *argument) override;
+
+private:
+    // Adafruit_PN532 only parses single-target type A replies, so
+    // InListPassiveTarget replies are read here.
+    bool responseReady();
+    bool waitForResponse(uint16_t timeoutMs);
+    void readResponse(uint8_t *frame, size_t length);
+
+    Adafruit_PN532 nfc;
+    uint8_t irqPin;
+    TwoWire *wire = nullptr;
+    SPIClass *spi = nullptr;
+    SpiPins spiPins{};
+};
+} // namespace hal
+
+#endif // HAL_ESP32_ADAFRUIT_PN532_READER_H
@@ -0,0 +1,24 @@
+#ifndef HAL_ESP32_DIGITAL_INPUT_H
+#define HAL_ESP32_DIGITAL_INPUT_H
+
+#include <cstdint>
+
+#include "hal/DigitalInput.h"
+
+namespace hal
+{
+// Reads a GPIO with its internal pull-up on.
+class Esp32DigitalInput : public DigitalInput
+{
+public:
+    explicit Esp32DigitalInput(uint8_t pin);
+
+    bool begin() override;
+    bool read() override;
+
+private:
+    uint8_t pin;
+};
+} // namespace hal
+
+#endif // HAL_ESP32_DIGITAL_INPUT_H
@@ -0,0 +1,30 @@
+#ifndef HAL_ESP32_I2C_BUS_H
+#define HAL_ESP32_I2C_BUS_H
+
+#include <Wire.h>
+
+#include "hal/I2CBus.h"
+
+namespace hal
+{
+class Esp32I2CBus : public I2CBus
+{
+public:
+    Esp32I2CBus(TwoWire &wire, uint8_t sdaPin, uint8_t sclPin);
+
+    bool begin() override;
+    void end() override;
+    void setClock(uint32_t frequencyHz) override;
+    void setTimeout(uint16_t timeoutMs) override;
+    uint32_t clockHz() const override;
+
+private:
+    TwoWire &wire;
+    uint8_t sdaPin;
+    uint8_t sclPin;
+    uint32_t frequencyHz = 0;
+    uint16_t timeoutMs = 0;
+};
+} // namespace hal
+
+#endif // HAL_ESP32_I2C_BUS_H
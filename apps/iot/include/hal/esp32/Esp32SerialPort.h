@@ -0,0 +1,27 @@
+#ifndef HAL_ESP32_SERIAL_PORT_H
+#define HAL_ESP32_SERIAL_PORT_H
+
+#include <Arduino.h>
+
+#include "hal/SerialPort.h"
+
+namespace hal
+{
+class Esp32SerialPort : public SerialPort
+{
+public:
+    explicit Esp32SerialPort(HardwareSerial &serial);
+
+    void begin(unsigned long baudRate) override;
+    int available() override;
+    int read() override;
+    size_t write(const uint8_t *data, size_t length) override;
+    void flush() override;
+    void onReceive(std::function<void()> callback) override;
+
+private:
+    HardwareSerial &serial;
+};
+} // namespace hal
+
+#endif // HAL_ESP32_SERIAL_PORT_H
@@ -0,0 +1,16 @@
+#ifndef HAL_ESP32_SYSTEM_H
+#define HAL_ESP32_SYSTEM_H
+
+#include "hal/System.h"
+
+namespace hal
+{
+class Esp32System : public System
+{
+public:
+    void restart() override;
+    uint32_t freeHeapBytes() const override;
+};
+} // namespace hal
+
+#endif // HAL_ESP32_SYSTEM_H
@@ -0,0 +1,21 @@
+#ifndef HAL_ESP32_WIFI_LINK_H
+#define HAL_ESP32_WIFI_LINK_H
+
+#include "hal/WifiLink.h"
+
+namespace hal
+{
+class Esp32WifiLink : public WifiLink
+{
+public:
+    void startStation() override;
+    void begin(const char *ssid, const char *password) override;
+    void reconnect() override;
+    bool isConnected() const override;
+    int32_t rssi() const override;
+    void macAddress(uint8_t mac[6]) const override;
+    void onEvent(std::function<void()> callback) override;
+};
+} // namespace hal
+
+#endif // HAL_ESP32_WIFI_LINK_H
@@ -0,0 +1,17 @@
+#ifndef HAL_ESP32_LEDC_PWM_OUTPUT_H
+#define HAL_ESP32_LEDC_PWM_OUTPUT_H
+
+#include "hal/PwmOutput.h"
+
+namespace hal
+{
+class LedcPwmOutput : public PwmOutput
+{
+public:
+    void setupChannel(uint8_t channel, uint32_t frequencyHz, uint8_t resolutionBits) override;
+    void attachPin(uint8_t pin, uint8_t channel) override;
+    void write(uint8_t channel, uint32_t duty) override;
+};
+} // namespace hal
+
+#endif // HAL_ESP32_LEDC_PWM_OUTPUT_H
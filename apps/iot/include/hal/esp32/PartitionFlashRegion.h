@@ -0,0 +1,31 @@
+#ifndef HAL_ESP32_PARTITION_FLASH_REGION_H
+#define HAL_ESP32_PARTITION_FLASH_REGION_H
+
+#include <esp_partition.h>
+
+#include "hal/FlashRegion.h"
+
+namespace hal
+{
+// A data partition from partitions.csv, mapped into the data cache so
+// reads are plain loads.
+class PartitionFlashRegion : public FlashRegion
+{
+public:
+    explicit PartitionFlashRegion(const char *label);
+
+    bool begin() override;
+    size_t size() const override;
+    const uint8_t *data() const override;
+    bool eraseSector(size_t offset) override;
+    bool write(size_t offset, const void *bytes, size_t length) override;
+
+private:
+    const char *label;
+    const esp_partition_t *partition = nullptr;
+    const uint8_t *mapped = nullptr;
+    spi_flash_mmap_handle_t mapHandle = 0;
+};
+} // namespace hal
+
+#endif // HAL_ESP32_PARTITION_FLASH_REGION_H
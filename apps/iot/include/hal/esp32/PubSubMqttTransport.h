@@ -0,0 +1,34 @@
+#ifndef HAL_ESP32_PUBSUB_MQTT_TRANSPORT_H
+#define HAL_ESP32_PUBSUB_MQTT_TRANSPORT_H
+
+#include <PubSubClient.h>
+#include <WiFiClient.h>
+
+#include "hal/MqttTransport.h"
+
+namespace hal
+{
+class PubSubMqttTransport : public MqttTransport
+{
+public:
+    PubSubMqttTransport();
+
+    void setServer(const char *host, uint16_t port) override;
+    void setBufferSize(uint16_t size) override;
+    void setCallback(MessageCallback callback) override;
+    bool connect(const char *clientId, const char *username, const char *password) override;
+    bool connected() override;
+    int state() override;
+    bool publish(const char *topic, const uint8_t *payload, size_t length, bool retained) override;
+    bool subscribe(const char *topic) override;
+    bool loop() override;
+    int socketFd() const override;
+    int bytesBuffered() override;
+
+private:
+    WiFiClient wifiClient;
+    PubSubClient client;
+};
+} // namespace hal
+
+#endif // HAL_ESP32_PUBSUB_MQTT_TRANSPORT_H
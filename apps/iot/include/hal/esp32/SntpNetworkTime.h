@@ -0,0 +1,24 @@
+#ifndef HAL_ESP32_SNTP_NETWORK_TIME_H
+#define HAL_ESP32_SNTP_NETWORK_TIME_H
+
+#include <string>
+
+#include "hal/NetworkTime.h"
+
+namespace hal
+{
+// lwIP SNTP client. It is a single instance inside the IDF, so there should
+// be only one of these.
+class SntpNetworkTime : public NetworkTime
+{
+public:
+    void begin(const char *server) override;
+    bool lastSync(Sample &sample) const override;
+
+private:
+    // lwIP keeps the pointer, not a copy.
+    std::string serverName;
+};
+} // namespace hal
+
+#endif // HAL_ESP32_SNTP_NETWORK_TIME_H
@@ -0,0 +1,17 @@
+#ifndef HAL_ESP32_SPIFFS_FILE_STORAGE_H
+#define HAL_ESP32_SPIFFS_FILE_STORAGE_H
+
+#include "hal/FileStorage.h"
+
+namespace hal
+{
+class SpiffsFileStorage : public FileStorage
+{
+public:
+    bool mount() override;
+    bool readFile(const char *path, std::string &contents) override;
+    bool writeFile(const char *path, std::string_view contents) override;
+};
+} // namespace hal
+
+#endif // HAL_ESP32_SPIFFS_FILE_STORAGE_H
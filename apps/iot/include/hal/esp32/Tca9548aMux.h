@@ -0,0 +1,25 @@
+#ifndef HAL_ESP32_TCA9548A_MUX_H
+#define HAL_ESP32_TCA9548A_MUX_H
+
+#include <Wire.h>
+
+#include "hal/I2CMux.h"
+
+namespace hal
+{
+class Tca9548aMux : public I2CMux
+{
+public:
+    static constexpr uint8_t CHANNEL_COUNT = 8;
+
+    Tca9548aMux(TwoWire &wire, uint8_t address);
+
+    bool select(uint8_t channel) override;
+
+private:
+    TwoWire &wire;
+    uint8_t address;
+};
+} // namespace hal
+
+#endif // HAL_ESP32_TCA9548A_MUX_H
@@ -0,0 +1,46 @@
+#ifndef HAL_ESP32_TIMER_PULSE_OUTPUT_H
+#define HAL_ESP32_TIMER_PULSE_OUTPUT_H
+
+#include <Arduino.h>
+
+#include <atomic>
+#include <cstdint>
+
+#include "hal/IsrAttr.h"
+#include "hal/PulseOutput.h"
+
+namespace hal
+{
+// A GPIO released from the alarm interrupt of one of the four general
+// purpose timers. The interrupt is allocated in IRAM and writes the GPIO
+// registers directly, so it keeps firing through SPIFFS and partition
+// writes that turn the flash cache off; that limits the pin to GPIO0-31.
+class TimerPulseOutput : public PulseOutput
+{
+public:
+    TimerPulseOutput(uint8_t pin, bool activeHigh, uint8_t timerNumber);
+
+    bool begin() override;
+    bool start(uint32_t durationUs) override;
+    bool active() override;
+    uint64_t releasedAtUs() override;
+    void forceRelease() override;
+
+private:
+    // The core's timer interrupt takes no argument, so only one instance
+    // can be started.
+    static void HAL_ISR_ATTR onAlarm();
+    static TimerPulseOutput *instance;
+
+    uint8_t pin;
+    uint32_t pinMask;
+    bool activeHigh;
+    uint8_t timerNumber;
+    hw_timer_t *timer = nullptr;
+    std::atomic<bool> running{false};
+    // Written before running is cleared.
+    volatile uint64_t releasedAt = 0;
+};
+} // namespace hal
+
+#endif // HAL_ESP32_TIMER_PULSE_OUTPUT_H
@@ -0,0 +1,34 @@
+#ifndef HAL_NATIVE_FAKE_DIGITAL_INPUT_H
+#define HAL_NATIVE_FAKE_DIGITAL_INPUT_H
+
+#include <cstdint>
+
+#include "hal/DigitalInput.h"
+#include "hal/native/FakePulseOutput.h"
+
+namespace hal
+{
+// An input set by the test, or a bolt switch that follows a lock coil: the
+// bolt opens travelUs after the coil is energized and closes travelUs after
+// it is released.
+class FakeDigitalInput : public DigitalInput
+{
+public:
+    bool begin() override;
+    bool read() override;
+
+    void setLevel(bool high);
+    void followBolt(FakePulseOutput &coil, uint32_t travelUs, bool lockedLevel);
+    // The bolt stays where it is, whatever the coil does.
+    void setJammed(bool jammed);
+
+private:
+    bool level = false;
+    FakePulseOutput *coil = nullptr;
+    uint32_t travelUs = 0;
+    bool lockedLevel = false;
+    bool jammed = false;
+};
+} // namespace hal
+
+#endif // HAL_NATIVE_FAKE_DIGITAL_INPUT_H
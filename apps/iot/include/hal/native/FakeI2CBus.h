@@ -0,0 +1,29 @@
+#ifndef HAL_NATIVE_FAKE_I2C_BUS_H
+#define HAL_NATIVE_FAKE_I2C_BUS_H
+
+#include "hal/I2CBus.h"
+
+namespace hal
+{
+class FakeI2CBus : public I2CBus
+{
+public:
+    bool begin() override;
+    void end() override;
+    void setClock(uint32_t frequencyHz) override;
+    void setTimeout(uint16_t timeoutMs) override;
+    uint32_t clockHz() const override;
+
+    bool isRunning() const;
+    uint32_t restartCount() const;
+    uint16_t timeoutMs() const;
+
+private:
+    bool running = false;
+    uint32_t restarts = 0;
+    uint32_t frequencyHz = 0;
+    uint16_t timeout = 0;
+};
+} // namespace hal
+
+#endif // HAL_NATIVE_FAKE_I2C_BUS_H
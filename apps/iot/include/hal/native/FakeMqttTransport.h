@@ -0,0 +1,63 @@
+#ifndef HAL_NATIVE_FAKE_MQTT_TRANSPORT_H
+#define HAL_NATIVE_FAKE_MQTT_TRANSPORT_H
+
+#include <deque>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "hal/MqttTransport.h"
+
+namespace hal
+{
+// In-process stand-in for a broker session. Publishes are recorded and
+// inbound messages are queued by the harness, then handed to the callback
+// one per loop() just like PubSubClient. socketFd() is an eventfd that is
+// readable while messages are queued, so deliveries wake the App.
+class FakeMqttTransport : public MqttTransport
+{
+public:
+    struct Message
+    {
+        std::string topic;
+        std::string payload;
+        bool retained = false;
+    };
+
+    FakeMqttTransport();
+    ~FakeMqttTransport() override;
+
+    void setServer(const char *host, uint16_t port) override;
+    void setBufferSize(uint16_t size) override;
+    void setCallback(MessageCallback callback) override;
+    bool connect(const char *clientId, const char *username, const char *password) override;
+    bool connected() override;
+    int state() override;
+    bool publish(const char *topic, const uint8_t *payload, size_t length, bool retained) override;
+    bool subscribe(const char *topic) override;
+    bool loop() override;
+    int socketFd() const override;
+    int bytesBuffered() override;
+
+    void setBrokerReachable(bool reachable);
+    void deliver(std::string_view topic, std::string_view payload);
+    std::vector<Message> takePublished();
+
+private:
+    void updateReadiness();
+
+    std::mutex mutex;
+    int readyFd = -1;
+    MessageCallback callback;
+    std::set<std::string> subscriptions;
+    std::deque<Message> inbound;
+    std::vector<Message> published;
+    uint16_t bufferSize = 256;
+    bool brokerReachable = true;
+    bool sessionUp = false;
+};
+} // namespace hal
+
+#endif // HAL_NATIVE_FAKE_MQTT_TRANSPORT_H
@@ -0,0 +1,32 @@
+#ifndef HAL_NATIVE_FAKE_NETWORK_TIME_H
+#define HAL_NATIVE_FAKE_NETWORK_TIME_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "hal/NetworkTime.h"
+
+namespace hal
+{
+// Never syncs on its own; the harness decides when a sync lands and what
+// wall-clock time it reports.
+class FakeNetworkTime : public NetworkTime
+{
+public:
+    void begin(const char *server) override;
+    bool lastSync(Sample &sample) const override;
+
+    // Records a sync that happened now, at the given Unix time.
+    void completeSync(int64_t epochMs);
+    std::string server() const;
+
+private:
+    mutable std::mutex mutex;
+    std::string serverName;
+    Sample latestSample;
+    bool hasSample = false;
+};
+} // namespace hal
+
+#endif // HAL_NATIVE_FAKE_NETWORK_TIME_H
@@ -0,0 +1,122 @@
+#ifndef HAL_NATIVE_FAKE_NFC_READER_H
+#define HAL_NATIVE_FAKE_NFC_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "hal/NfcReader.h"
+
+namespace hal
+{
+class FakeI2CBus;
+
+// A PN532 that answers from a card field the harness controls. Scans return
+// immediately unless setScanTiming() gives them a cost. Faults are scripted
+// with injectFault(); once attached to a bus, transactions also fail while
+// the bus is stopped and a hung bus costs its configured timeout. A chip
+// that was powered down fails the first transaction that is not wakeUp(),
+// which wakes it, as the real one does while its oscillator restarts.
+class FakeNfcReader : public NfcReader
+{
+public:
+    static constexpr uint32_t PN532_FIRMWARE_VERSION = 0x32010607;
+
+    enum class Fault : uint8_t
+    {
+        None,
+        // The chip does not ACK; every transaction fails at once.
+        Silent,
+        // SDA is held low; every transaction waits out the bus timeout and
+        // then fails.
+        BusHang,
+        // The next transaction is cut mid-frame and leaves the chip wedged
+        // until the I2C bus is restarted.
+        DropMidTransaction,
+        // Long wires or weak pull-ups: transactions fail while the attached
+        // bus runs faster than 100 kHz.
+        SlowBusOnly,
+        // Marginal wiring: faster than 100 kHz the chip answers a few
+        // transactions after each bus restart, then fails until the next.
+        // Only counts as answering at 100 kHz.
+        MarginalFastBus,
+    };
+
+    void begin() override;
+    uint32_t firmwareVersion() override;
+    bool configureSam() override;
+    uint8_t listPassiveTargets(CardProtocol protocol,
+                               PassiveTarget *targets,
+                               uint8_t maxTargets,
+                               uint16_t timeoutMs) override;
+    bool powerDown() override;
+    bool wakeUp() override;
+    void onIrq(IrqCallback callback, void *argument) override;
+
+    void attachBus(const FakeI2CBus &bus);
+
+    // presentCard() replaces whatever is in the field; addCard() holds
+    // another card next to it, as in a wallet. removeCard() empties it.
+    // A scan only sees the cards of the protocol it polls for.
+    void presentCard(const std::vector<uint8_t> &uid, CardProtocol protocol = CardProtocol::Iso14443A);
+    void addCard(const std::vector<uint8_t> &uid, CardProtocol protocol = CardProtocol::Iso14443A);
+    void removeCard();
+
+    void injectFault(Fault fault);
+    void clearFault();
+    // Transient errors: every nth transaction fails, 0 turns it off.
+    void failEveryNthTransaction(uint32_t n);
+
+    // How long a scan blocks the caller when a card is in the field and when
+    // it is empty. The empty case is capped at the scan timeout, as on the
+    // real reader.
+    void setScanTiming(unsigned long withCardMs, unsigned long emptyFieldMs);
+
+    // Whether the chip would answer a transaction right now.
+    bool isAnswering() const;
+    uint32_t scanCount() const;
+    uint32_t transactionCount() const;
+    // Transactions tried while the attached bus was stopped.
+    uint32_t stoppedBusTransactionCount() const;
+    // Time callers spent blocked on a hung bus.
+    unsigned long stalledMs() const;
+    bool isPoweredDown() const;
+    // Time spent powered down, including the current stretch.
+    unsigned long poweredDownMs() const;
+
+private:
+    struct Card
+    {
+        std::vector<uint8_t> uid;
+        CardProtocol protocol;
+    };
+
+    bool transact();
+    void leavePowerDownLocked();
+    bool answeringLocked() const;
+
+    mutable std::mutex mutex;
+    const FakeI2CBus *bus = nullptr;
+    std::vector<Card> cards;
+    Fault fault = Fault::None;
+    bool wedged = false;
+    uint32_t wedgedAtRestart = 0;
+    uint32_t marginalAtRestart = 0;
+    uint32_t marginalAnswered = 0;
+    uint32_t failEvery = 0;
+    uint32_t scans = 0;
+    uint32_t transactions = 0;
+    uint32_t stoppedBusTransactions = 0;
+    unsigned long stalled = 0;
+    bool poweredDown = false;
+    unsigned long poweredDownSince = 0;
+    unsigned long poweredDownTotal = 0;
+    unsigned long scanWithCardMs = 0;
+    unsigned long scanEmptyFieldMs = 0;
+    IrqCallback irqCallback = nullptr;
+    void *irqArgument = nullptr;
+};
+} // namespace hal
+
+#endif // HAL_NATIVE_FAKE_NFC_READER_H
@@ -0,0 +1,54 @@
+#ifndef HAL_NATIVE_FAKE_PLATFORM_H
+#define HAL_NATIVE_FAKE_PLATFORM_H
+
+#include "hal/Platform.h"
+#include "hal/native/FakeDigitalInput.h"
+#include "hal/native/FakeI2CBus.h"
+#include "hal/native/FakeMqttTransport.h"
+#include "hal/native/FakeNetworkTime.h"
+#include "hal/native/FakeNfcReader.h"
+#include "hal/native/FakePulseOutput.h"
+#include "hal/native/FakePwmOutput.h"
+#include "hal/native/FakeSerialPort.h"
+#include "hal/native/FakeWifiLink.h"
+#include "hal/native/MemoryFlashRegion.h"
+#include "hal/native/MemoryFileStorage.h"
+#include "hal/native/NativeSystem.h"
+
+namespace hal
+{
+// One simulated device worth of hardware.
+struct FakePlatform
+{
+    explicit FakePlatform(bool echoSerial = false)
+        : serial(echoSerial)
+    {
+        nfc.attachBus(i2c);
+        lockSensor.followBolt(lockCoil, 40 * 1000, false);
+    }
+
+    FakePlatform(const FakePlatform &) = delete;
+    FakePlatform &operator=(const FakePlatform &) = delete;
+
+    Platform view()
+    {
+        return Platform{serial, storage, pwm, &bay, 1, wifi, mqtt, system, networkTime, &authFlash, &lockCoil, &lockSensor};
+    }
+
+    FakeSerialPort serial;
+    MemoryFileStorage storage;
+    FakePwmOutput pwm;
+    FakeI2CBus i2c;
+    FakeNfcReader nfc;
+    NfcBay bay{nfc, i2c};
+    FakeWifiLink wifi;
+    FakeMqttTransport mqtt;
+    NativeSystem system;
+    FakeNetworkTime networkTime;
+    MemoryFlashRegion authFlash{64 * 1024};
+    FakePulseOutput lockCoil;
+    FakeDigitalInput lockSensor;
+};
+} // namespace hal
+
+#endif // HAL_NATIVE_FAKE_PLATFORM_H
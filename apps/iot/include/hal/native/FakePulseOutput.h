@@ -0,0 +1,39 @@
+#ifndef HAL_NATIVE_FAKE_PULSE_OUTPUT_H
+#define HAL_NATIVE_FAKE_PULSE_OUTPUT_H
+
+#include <cstdint>
+
+#include "hal/PulseOutput.h"
+
+namespace hal
+{
+// A pulse whose timer fires exactly on time, worked out from hal::uptimeUs()
+// whenever it is looked at, so it follows virtual time as well as real.
+class FakePulseOutput : public PulseOutput
+{
+public:
+    bool begin() override;
+    bool start(uint32_t durationUs) override;
+    bool active() override;
+    uint64_t releasedAtUs() override;
+    void forceRelease() override;
+
+    // A timer that never fires, leaving the output active until something
+    // forces it off.
+    void setTimerStuck(bool stuck);
+    uint64_t startedAtUs() const;
+    unsigned long pulses = 0;
+    unsigned long forcedReleases = 0;
+
+private:
+    void fireIfDue();
+
+    bool running = false;
+    bool timerStuck = false;
+    uint64_t startedAt = 0;
+    uint64_t deadline = 0;
+    uint64_t releasedAt = 0;
+};
+} // namespace hal
+
+#endif // HAL_NATIVE_FAKE_PULSE_OUTPUT_H
@@ -0,0 +1,26 @@
+#ifndef HAL_NATIVE_FAKE_PWM_OUTPUT_H
+#define HAL_NATIVE_FAKE_PWM_OUTPUT_H
+
+#include <array>
+
+#include "hal/PwmOutput.h"
+
+namespace hal
+{
+class FakePwmOutput : public PwmOutput
+{
+public:
+    static constexpr uint8_t CHANNEL_COUNT = 16;
+
+    void setupChannel(uint8_t channel, uint32_t frequencyHz, uint8_t resolutionBits) override;
+    void attachPin(uint8_t pin, uint8_t channel) override;
+    void write(uint8_t channel, uint32_t duty) override;
+
+    uint32_t duty(uint8_t channel) const;
+
+private:
+    std::array<uint32_t, CHANNEL_COUNT> duties{};
+};
+} // namespace hal
+
+#endif // HAL_NATIVE_FAKE_PWM_OUTPUT_H
@@ -0,0 +1,38 @@
+#ifndef HAL_NATIVE_FAKE_SERIAL_PORT_H
+#define HAL_NATIVE_FAKE_SERIAL_PORT_H
+
+#include <deque>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "hal/SerialPort.h"
+
+namespace hal
+{
+class FakeSerialPort : public SerialPort
+{
+public:
+    // echo copies everything the firmware writes to stdout.
+    explicit FakeSerialPort(bool echo = false);
+
+    void begin(unsigned long baudRate) override;
+    int available() override;
+    int read() override;
+    size_t write(const uint8_t *data, size_t length) override;
+    void flush() override;
+    void onReceive(std::function<void()> callback) override;
+
+    void injectInput(std::string_view text);
+    std::string takeOutput();
+
+private:
+    std::mutex mutex;
+    std::deque<uint8_t> input;
+    std::string output;
+    std::function<void()> receiveCallback;
+    bool echo;
+};
+} // namespace hal
+
+#endif // HAL_NATIVE_FAKE_SERIAL_PORT_H
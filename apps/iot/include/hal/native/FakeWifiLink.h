@@ -0,0 +1,33 @@
+#ifndef HAL_NATIVE_FAKE_WIFI_LINK_H
+#define HAL_NATIVE_FAKE_WIFI_LINK_H
+
+#include <atomic>
+
+#include "hal/WifiLink.h"
+
+namespace hal
+{
+// Associates instantly whenever the network is available.
+class FakeWifiLink : public WifiLink
+{
+public:
+    void startStation() override;
+    void begin(const char *ssid, const char *password) override;
+    void reconnect() override;
+    bool isConnected() const override;
+    int32_t rssi() const override;
+    void macAddress(uint8_t mac[6]) const override;
+    void onEvent(std::function<void()> callback) override;
+
+    void setNetworkAvailable(bool available);
+    void setMacAddress(const uint8_t mac[6]);
+
+private:
+    std::atomic<bool> networkAvailable{true};
+    std::atomic<bool> associated{false};
+    uint8_t mac[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+    std::function<void()> eventCallback;
+};
+} // namespace hal
+
+#endif // HAL_NATIVE_FAKE_WIFI_LINK_H
@@ -0,0 +1,23 @@
+#ifndef HAL_NATIVE_MEMORY_FILE_STORAGE_H
+#define HAL_NATIVE_MEMORY_FILE_STORAGE_H
+
+#include <map>
+#include <string>
+
+#include "hal/FileStorage.h"
+
+namespace hal
+{
+class MemoryFileStorage : public FileStorage
+{
+public:
+    bool mount() override;
+    bool readFile(const char *path, std::string &contents) override;
+    bool writeFile(const char *path, std::string_view contents) override;
+
+    std::map<std::string, std::string> files;
+    bool mountFails = false;
+};
+} // namespace hal
+
+#endif // HAL_NATIVE_MEMORY_FILE_STORAGE_H
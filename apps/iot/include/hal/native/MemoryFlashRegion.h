@@ -0,0 +1,33 @@
+#ifndef HAL_NATIVE_MEMORY_FLASH_REGION_H
+#define HAL_NATIVE_MEMORY_FLASH_REGION_H
+
+#include <cstddef>
+#include <vector>
+
+#include "hal/FlashRegion.h"
+
+namespace hal
+{
+// Flash in host memory with NOR semantics, so code that forgets an erase
+// reads back what the chip would give it. Allocated by begin(), so a
+// platform that never uses it costs nothing.
+class MemoryFlashRegion : public FlashRegion
+{
+public:
+    explicit MemoryFlashRegion(size_t size);
+
+    bool begin() override;
+    size_t size() const override;
+    const uint8_t *data() const override;
+    bool eraseSector(size_t offset) override;
+    bool write(size_t offset, const void *bytes, size_t length) override;
+
+    unsigned long sectorErases = 0;
+
+private:
+    size_t regionSize;
+    std::vector<uint8_t> bytes;
+};
+} // namespace hal
+
+#endif // HAL_NATIVE_MEMORY_FLASH_REGION_H
@@ -0,0 +1,25 @@
+#ifndef HAL_NATIVE_NATIVE_SYSTEM_H
+#define HAL_NATIVE_NATIVE_SYSTEM_H
+
+#include <atomic>
+
+#include "hal/System.h"
+
+namespace hal
+{
+// restart() is recorded rather than performed so a harness can rebuild the
+// App it belongs to.
+class NativeSystem : public System
+{
+public:
+    void restart() override;
+    uint32_t freeHeapBytes() const override;
+
+    uint32_t restartCount() const;
+
+private:
+    std::atomic<uint32_t> restarts{0};
+};
+} // namespace hal
+
+#endif // HAL_NATIVE_NATIVE_SYSTEM_H
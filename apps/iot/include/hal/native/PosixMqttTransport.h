@@ -0,0 +1,69 @@
+#ifndef HAL_NATIVE_POSIX_MQTT_TRANSPORT_H
+#define HAL_NATIVE_POSIX_MQTT_TRANSPORT_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "hal/MqttTransport.h"
+
+namespace hal
+{
+// MQTT 3.1.1 over a plain TCP socket for host builds that talk to a real
+// broker. Mirrors the PubSubClient behaviour the device relies on: QoS 0
+// only, clean sessions, SUBSCRIBE without waiting for SUBACK, one inbound
+// packet per loop() and the same state() codes.
+class PosixMqttTransport : public MqttTransport
+{
+public:
+    static constexpr uint16_t KEEPALIVE_SECONDS = 15;
+    static constexpr unsigned long SOCKET_TIMEOUT_MS = 15000;
+
+    PosixMqttTransport() = default;
+    ~PosixMqttTransport() override;
+
+    PosixMqttTransport(const PosixMqttTransport &) = delete;
+    PosixMqttTransport &operator=(const PosixMqttTransport &) = delete;
+
+    void setServer(const char *host, uint16_t port) override;
+    void setBufferSize(uint16_t size) override;
+    void setCallback(MessageCallback callback) override;
+    bool connect(const char *clientId, const char *username, const char *password) override;
+    bool connected() override;
+    int state() override;
+    bool publish(const char *topic, const uint8_t *payload, size_t length, bool retained) override;
+    bool subscribe(const char *topic) override;
+    bool loop() override;
+    int socketFd() const override;
+    int bytesBuffered() override;
+
+    // Shuts the socket down underneath the session, as a broker restart or
+    // a NAT timeout would. Safe to call from another thread; the owner sees
+    // the connection drop on its next loop().
+    void severConnection();
+
+private:
+    bool openSocket();
+    void closeSocket(int newState);
+    bool sendAll(const uint8_t *data, size_t length);
+    bool readExactly(uint8_t *data, size_t length);
+    bool readPacket(uint8_t &header, size_t &length);
+    size_t writeHeader(uint8_t header, size_t remainingLength);
+    static void writeString(std::vector<uint8_t> &packet, size_t &offset, const char *text);
+
+    std::string host;
+    uint16_t port = 1883;
+    std::atomic<int> fd{-1};
+    int lastState = -1;
+    std::vector<uint8_t> buffer = std::vector<uint8_t>(256);
+    MessageCallback callback;
+    uint16_t nextPacketId = 1;
+    unsigned long lastOutboundAt = 0;
+    unsigned long lastInboundAt = 0;
+    bool pingOutstanding = false;
+};
+} // namespace hal
+
+#endif // HAL_NATIVE_POSIX_MQTT_TRANSPORT_H
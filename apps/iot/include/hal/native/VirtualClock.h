@@ -0,0 +1,24 @@
+#ifndef HAL_NATIVE_VIRTUAL_CLOCK_H
+#define HAL_NATIVE_VIRTUAL_CLOCK_H
+
+#include <cstdint>
+
+namespace hal
+{
+// Host builds read a steady wall clock by default. Harnesses that need
+// deterministic timing switch to virtual time, where hal::delayMs() and
+// advance() are the only things that move the clock.
+class VirtualClock
+{
+public:
+    static void enable(uint64_t startUs = 0);
+    static void disable();
+    static bool isEnabled();
+
+    static void advanceMs(unsigned long durationMs);
+    static void advanceUs(uint64_t durationUs);
+    static uint64_t nowUs();
+};
+} // namespace hal
+
+#endif // HAL_NATIVE_VIRTUAL_CLOCK_H
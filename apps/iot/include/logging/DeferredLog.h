@@ -0,0 +1,259 @@
+#ifndef LOGGING_DEFERRED_LOG_H
+#define LOGGING_DEFERRED_LOG_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace hal
+{
+class SerialPort;
+}
+
+// Numeric levels match ArduinoLog so existing LOG_LEVEL_* values keep
+// working in build flags.
+#define LOG_LEVEL_SILENT 0
+#define LOG_LEVEL_FATAL 1
+#define LOG_LEVEL_ERROR 2
+#define LOG_LEVEL_WARNING 3
+#define LOG_LEVEL_NOTICE 4
+#define LOG_LEVEL_INFO 4
+#define LOG_LEVEL_TRACE 5
+#define LOG_LEVEL_VERBOSE 6
+
+// Anything above this level is compiled out, format strings included.
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_VERBOSE
+#endif
+
+enum class LogModule : uint8_t
+{
+    App,
+    Nfc,
+    Tap,
+    Command,
+    Connectivity,
+    Mqtt,
+    Status,
+    Metrics,
+    Provisioning,
+    Config,
+    Auth,
+    Lock,
+    Count,
+};
+
+const char *logModuleName(LogModule module);
+bool parseLogModule(std::string_view name, LogModule &module);
+
+enum class LogSeverity : uint8_t
+{
+    Fatal,
+    Error,
+    Warning,
+    Notice,
+    Info,
+    Trace,
+    Verbose,
+};
+
+constexpr uint8_t logSeverityLevel(LogSeverity severity)
+{
+    return severity == LogSeverity::Fatal     ? LOG_LEVEL_FATAL
+           : severity == LogSeverity::Error   ? LOG_LEVEL_ERROR
+           : severity == LogSeverity::Warning ? LOG_LEVEL_WARNING
+           : severity == LogSeverity::Notice  ? LOG_LEVEL_NOTICE
+           : severity == LogSeverity::Info    ? LOG_LEVEL_INFO
+           : severity == LogSeverity::Trace   ? LOG_LEVEL_TRACE
+                                              : LOG_LEVEL_VERBOSE;
+}
+
+// Log calls never format on the caller's task. They copy the format string
+// pointer (which doubles as the message ID, it lives in flash) plus a typed
+// binary encoding of the arguments into a RAM ring buffer; a low priority
+// task renders records to the serial port. When the ring is full the record
+// is dropped and counted instead of blocking.
+class DeferredLog
+{
+public:
+    static constexpr size_t RING_CAPACITY = 4096;
+    static constexpr size_t MAX_RECORD_SIZE = 384;
+    static constexpr size_t MAX_STRING_ARG_LENGTH = 192;
+    static constexpr uint8_t MAX_ARGS = 12;
+
+    enum class ArgType : uint8_t
+    {
+        Int32,
+        UInt32,
+        Int64,
+        UInt64,
+        Double,
+        Char,
+        Bool,
+        String,
+        Pointer,
+    };
+
+    static void begin(hal::SerialPort &output, uint8_t level);
+    static void setLevel(uint8_t level);
+    static void setModuleLevel(LogModule module, uint8_t level);
+    static uint8_t moduleLevel(LogModule module);
+
+    static bool isEnabled(LogSeverity severity, LogModule module)
+    {
+        return logSeverityLevel(severity) <= moduleLevels[static_cast<size_t>(module)].load(std::memory_order_relaxed);
+    }
+
+    template <typename... Args>
+    static void write(LogSeverity severity, LogModule module, const char *format, const Args &...args)
+    {
+        static_assert(sizeof...(Args) <= MAX_ARGS, "too many log arguments");
+        uint8_t record[MAX_RECORD_SIZE];
+        size_t length = RECORD_HEADER_SIZE;
+        (encodeArg(record, length, args), ...);
+        commit(record, length, severity, module, format, static_cast<uint8_t>(sizeof...(Args)));
+    }
+
+    // Renders everything queued so far on the calling task. Used before a
+    // restart so the last lines are not lost.
+    static void flush();
+
+private:
+    // length(2) severity(1) module(1) timestampMs(4) format(pointer) argCount(1)
+    static constexpr size_t RECORD_HEADER_SIZE = 9 + sizeof(const char *);
+
+    static void commit(uint8_t *record, size_t length, LogSeverity severity, LogModule module, const char *format, uint8_t argCount);
+
+    // Arguments that no longer fit are dropped; the renderer prints "<?>" for
+    // them rather than losing the whole record.
+    static void encodeRaw(uint8_t *record, size_t &length, ArgType type, const void *data, size_t size)
+    {
+        if (length + 1 + size > MAX_RECORD_SIZE)
+        {
+            return;
+        }
+        record[length++] = static_cast<uint8_t>(type);
+        std::memcpy(record + length, data, size);
+        length += size;
+    }
+
+    static void encodeString(uint8_t *record, size_t &length, const char *text, size_t textLength)
+    {
+        if (text == nullptr)
+        {
+            text = "(null)";
+            textLength = 6;
+        }
+        if (textLength > MAX_STRING_ARG_LENGTH)
+        {
+            textLength = MAX_STRING_ARG_LENGTH;
+        }
+        if (length + 2 > MAX_RECORD_SIZE)
+        {
+            return;
+        }
+        if (length + 2 + textLength > MAX_RECORD_SIZE)
+        {
+            textLength = MAX_RECORD_SIZE - length - 2;
+        }
+        record[length++] = static_cast<uint8_t>(ArgType::String);
+        record[length++] = static_cast<uint8_t>(textLength);
+        std::memcpy(record + length, text, textLength);
+        length += textLength;
+    }
+
+    template <typename T>
+    static void encodeArg(uint8_t *record, size_t &length, const T &value)
+    {
+        using Value = std::decay_t<T>;
+        if constexpr (std::is_same_v<Value, bool>)
+        {
+            const uint8_t flag = value ? 1 : 0;
+            encodeRaw(record, length, ArgType::Bool, &flag, sizeof(flag));
+        }
+        else if constexpr (std::is_same_v<Value, char>)
+        {
+            encodeRaw(record, length, ArgType::Char, &value, sizeof(value));
+        }
+        else if constexpr (std::is_enum_v<Value>)
+        {
+            encodeArg(record, length, static_cast<std::underlying_type_t<Value>>(value));
+        }
+        else if constexpr (std::is_integral_v<Value> && std::is_signed_v<Value>)
+        {
+            if constexpr (sizeof(Value) <= sizeof(int32_t))
+            {
+                const int32_t widened = value;
+                encodeRaw(record, length, ArgType::Int32, &widened, sizeof(widened));
+            }
+            else
+            {
+                const int64_t widened = value;
+                encodeRaw(record, length, ArgType::Int64, &widened, sizeof(widened));
+            }
+        }
+        else if constexpr (std::is_integral_v<Value>)
+        {
+            if constexpr (sizeof(Value) <= sizeof(uint32_t))
+            {
+                const uint32_t widened = value;
+                encodeRaw(record, length, ArgType::UInt32, &widened, sizeof(widened));
+            }
+            else
+            {
+                const uint64_t widened = value;
+                encodeRaw(record, length, ArgType::UInt64, &widened, sizeof(widened));
+            }
+        }
+        else if constexpr (std::is_floating_point_v<Value>)
+        {
+            const double widened = value;
+            encodeRaw(record, length, ArgType::Double, &widened, sizeof(widened));
+        }
+        else if constexpr (std::is_same_v<Value, const char *> || std::is_same_v<Value, char *>)
+        {
+            encodeString(record, length, value, value != nullptr ? std::strlen(value) : 0);
+        }
+        else if constexpr (std::is_same_v<Value, std::string> || std::is_same_v<Value, std::string_view>)
+        {
+            encodeString(record, length, value.data(), value.size());
+        }
+        else if constexpr (std::is_pointer_v<Value>)
+        {
+            const uintptr_t address = reinterpret_cast<uintptr_t>(value);
+            encodeRaw(record, length, ArgType::Pointer, &address, sizeof(address));
+        }
+        else
+        {
+            static_assert(std::is_void_v<Value>, "unsupported log argument type");
+        }
+    }
+
+    static std::atomic<uint8_t> moduleLevels[static_cast<size_t>(LogModule::Count)];
+};
+
+#define DEFERRED_LOG(severity, ...)                                                  \
+    do                                                                               \
+    {                                                                                \
+        if (logSeverityLevel(severity) <= LOG_COMPILE_LEVEL &&                       \
+            DeferredLog::isEnabled(severity, LOG_MODULE))                            \
+        {                                                                            \
+            DeferredLog::write(severity, LOG_MODULE, __VA_ARGS__);                   \
+        }                                                                            \
+    } while (0)
+
+// Each translation unit names its module with
+//   namespace { constexpr LogModule LOG_MODULE = LogModule::Nfc; }
+#define LOGF(...) DEFERRED_LOG(LogSeverity::Fatal, __VA_ARGS__)
+#define LOGE(...) DEFERRED_LOG(LogSeverity::Error, __VA_ARGS__)
+#define LOGW(...) DEFERRED_LOG(LogSeverity::Warning, __VA_ARGS__)
+#define LOGN(...) DEFERRED_LOG(LogSeverity::Notice, __VA_ARGS__)
+#define LOGI(...) DEFERRED_LOG(LogSeverity::Info, __VA_ARGS__)
+#define LOGT(...) DEFERRED_LOG(LogSeverity::Trace, __VA_ARGS__)
+#define LOGV(...) DEFERRED_LOG(LogSeverity::Verbose, __VA_ARGS__)
+
+#endif // LOGGING_DEFERRED_LOG_H
@@ -0,0 +1,46 @@
+#ifndef METRICS_LATENCY_HISTOGRAM_H
+#define METRICS_LATENCY_HISTOGRAM_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Fixed log2 buckets over microseconds. Bucket 0 holds samples below 1 us,
+// bucket i holds [2^(i-1), 2^i) us and the last bucket is open ended, which
+// puts everything from ~262 ms upwards into a single overflow bucket.
+// Recording is lock-free so any task may feed the same histogram.
+class LatencyHistogram
+{
+public:
+    static constexpr size_t BUCKET_COUNT = 20;
+
+    struct Snapshot
+    {
+        std::array<uint32_t, BUCKET_COUNT> buckets{};
+        uint32_t count = 0;
+        uint32_t maxMicros = 0;
+
+        // Upper bound of the bucket that contains the requested percentile,
+        // clamped to the observed maximum.
+        uint32_t percentileMicros(uint8_t percentile) const;
+        // Index of the last non-empty bucket plus one, for trimmed exports.
+        size_t usedBucketCount() const;
+    };
+
+    void record(uint32_t micros);
+    Snapshot snapshot() const;
+    // Snapshot and clear in one pass; samples racing with the reset land in
+    // either this window or the next one, never in neither.
+    Snapshot takeSnapshot();
+
+    static size_t bucketIndexFor(uint32_t micros);
+    static uint32_t bucketUpperBoundMicros(size_t index);
+
+private:
+    std::array<std::atomic<uint32_t>, BUCKET_COUNT> buckets{};
+    std::atomic<uint32_t> total{0};
+    std::atomic<uint32_t> maxValue{0};
+};
+
+#endif // METRICS_LATENCY_HISTOGRAM_H
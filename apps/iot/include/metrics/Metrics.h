@@ -0,0 +1,79 @@
+#ifndef METRICS_METRICS_H
+#define METRICS_METRICS_H
+
+#include <atomic>
+#include <cstdint>
+
+#include "metrics/LatencyHistogram.h"
+
+enum class MetricKind : uint8_t
+{
+    Counter,
+    Gauge,
+    Histogram,
+};
+
+// Metrics are defined as namespace-scope statics next to the code they
+// measure and link themselves into a global list during static
+// initialisation, before setup() runs. Names are exported verbatim, so keep
+// them to [a-z0-9._].
+class Metric
+{
+public:
+    Metric(const Metric &) = delete;
+    Metric &operator=(const Metric &) = delete;
+
+    const char *name() const;
+    MetricKind kind() const;
+    Metric *next() const;
+
+    static Metric *first();
+
+protected:
+    Metric(const char *name, MetricKind kind);
+    ~Metric() = default;
+
+private:
+    const char *metricName;
+    MetricKind metricKind;
+    Metric *nextMetric;
+};
+
+class MetricCounter : public Metric
+{
+public:
+    explicit MetricCounter(const char *name);
+
+    void increment(uint32_t amount = 1);
+    uint32_t value() const;
+
+private:
+    std::atomic<uint32_t> total{0};
+};
+
+class MetricGauge : public Metric
+{
+public:
+    explicit MetricGauge(const char *name);
+
+    void set(int32_t value);
+    int32_t value() const;
+
+private:
+    std::atomic<int32_t> current{0};
+};
+
+class MetricHistogram : public Metric
+{
+public:
+    explicit MetricHistogram(const char *name);
+
+    void record(uint32_t micros);
+    LatencyHistogram::Snapshot snapshot() const;
+    LatencyHistogram::Snapshot takeSnapshot();
+
+private:
+    LatencyHistogram histogram;
+};
+
+#endif // METRICS_METRICS_H
@@ -0,0 +1,136 @@
+#ifndef SERVICES_AUTHORIZATION_CACHE_H
+#define SERVICES_AUTHORIZATION_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "hal/FlashRegion.h"
+
+// The cards the backend would let unlock this bike, with when each one stops
+// being allowed, so a tap can still be decided while MQTT is down. The
+// backend pushes a whole snapshot at a time, sorted by card, and it is
+// searched in place in mapped flash: a binary search over the keys, with no
+// copy in RAM.
+//
+// The region is split into two slots. A snapshot is written into the one
+// not in use and only replaces the active one when it is committed, so a
+// sync cut short leaves the previous snapshot answering. Each slot is a
+// header, then every key, then every expiry in the same order.
+class AuthorizationCache
+{
+public:
+    struct Entry
+    {
+        uint64_t cardKey = 0;
+        // Unix seconds.
+        uint32_t expiresAt = 0;
+    };
+
+    enum class Verdict : uint8_t
+    {
+        Granted,
+        Expired,
+        NotCached,
+    };
+
+    enum class SyncResult : uint8_t
+    {
+        Ok,
+        // No region, or no sync in progress for that generation.
+        Unavailable,
+        TooLarge,
+        // A batch past the end of what was written so far.
+        OutOfOrder,
+        // Keys must be strictly increasing; the sync is abandoned.
+        Unsorted,
+        Incomplete,
+        WriteFailed,
+        // What reads back from flash is not what was written.
+        Corrupt,
+    };
+
+    static const char *syncResultName(SyncResult result);
+
+    // The key of a card is its cardUid read as a number; UIDs too long to
+    // be one cannot be cached.
+    static std::optional<uint64_t> cardKey(std::string_view cardUid);
+
+    explicit AuthorizationCache(hal::FlashRegion &flash);
+
+    // Maps the region and picks the newest committed snapshot that passes
+    // its checksums. False when the region is missing or too small.
+    bool begin();
+
+    bool hasSnapshot() const;
+    uint32_t generation() const;
+    uint32_t entryCount() const;
+    // Entries a slot can hold.
+    uint32_t capacity() const;
+
+    Verdict check(uint64_t cardKey, uint32_t nowEpochS) const;
+
+    // Erases as it goes, one sector whenever a write reaches a new one,
+    // rather than the whole slot up front.
+    SyncResult beginSync(uint32_t generation, uint32_t count);
+    // Entries must continue from where the last batch stopped. A batch that
+    // was written already, e.g. resent after a lost ack, is skipped.
+    SyncResult appendEntries(uint32_t generation, uint32_t offset, const Entry *entries, size_t count);
+    SyncResult commitSync(uint32_t generation);
+    // Entries written by the sync in progress.
+    uint32_t syncedCount() const;
+
+private:
+    struct SlotHeader
+    {
+        uint32_t magic;
+        // Bumped by every commit on this device; the newer slot wins.
+        uint32_t sequence;
+        uint32_t generation;
+        uint32_t count;
+        uint32_t keysCrc;
+        uint32_t expiriesCrc;
+        // Written last, so a slot without it was never completed.
+        uint32_t committed;
+        uint32_t reserved;
+    };
+    static constexpr size_t HEADER_SIZE = sizeof(SlotHeader);
+    static constexpr uint8_t SLOT_COUNT = 2;
+    // One bit per sector erased for the sync in progress.
+    static constexpr size_t MAX_SLOT_SECTORS = 64;
+
+    struct Snapshot
+    {
+        const uint64_t *keys = nullptr;
+        const uint32_t *expiries = nullptr;
+        uint32_t count = 0;
+        uint32_t generation = 0;
+        uint32_t sequence = 0;
+        uint8_t slot = 0;
+    };
+
+    size_t slotOffset(uint8_t slot) const;
+    bool readSnapshot(uint8_t slot, Snapshot &snapshot) const;
+    bool writeSlot(size_t offset, const void *bytes, size_t length);
+
+    hal::FlashRegion &flash;
+    size_t slotSize = 0;
+    std::optional<Snapshot> active;
+
+    struct Sync
+    {
+        uint32_t generation = 0;
+        uint32_t count = 0;
+        uint32_t written = 0;
+        uint64_t lastKey = 0;
+        uint32_t keysCrc = 0;
+        uint32_t expiriesCrc = 0;
+        uint32_t sequence = 0;
+        uint8_t slot = 0;
+        uint64_t erasedSectors = 0;
+    };
+    std::optional<Sync> sync;
+};
+
+#endif // SERVICES_AUTHORIZATION_CACHE_H
@@ -1,47 +1,124 @@
 #ifndef SERVICES_COMMAND_CONSUMER_H
 #define SERVICES_COMMAND_CONSUMER_H
 
-#include <Arduino.h>
-
+#include <ArduinoJson.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <optional>
-#include <string>
 #include <string_view>
 
+#include "FixedString.h"
+#include "app/AppEvents.h"
 #include "app/DeviceContext.h"
+#include "app/TaskChannels.h"
+#include "app/WallClock.h"
+#include "drivers/LockActuator.h"
+#include "services/AuthorizationCache.h"
+#include "services/OutboundQueue.h"
+#include "services/RequestTrace.h"
 
-class MQTTManager;
-class FeedbackController;
+class DiagnosticsReporter;
 
 struct DeviceCommand
 {
-    std::string action;
-    std::string requestId;
-    std::optional<std::string> reason;
+    static constexpr size_t MAX_ACTION_LENGTH = 31;
+    // Unlock and deny echo the tap's request id, which starts with the
+    // device id; see TapPublisher::MAX_REQUEST_ID_LENGTH.
+    static constexpr size_t MAX_REQUEST_ID_LENGTH = MAX_DEVICE_ID_LENGTH + 48;
+    static constexpr size_t MAX_REASON_LENGTH = 63;
+
+    FixedString<MAX_ACTION_LENGTH> action;
+    FixedString<MAX_REQUEST_ID_LENGTH> requestId;
+    // Empty when the command did not give one.
+    FixedString<MAX_REASON_LENGTH> reason;
     uint32_t durationMs = 0;
 };
 
+// Runs on the device task and executes commands the network task received,
+// one per call, oldest first. Each executed command is announced as a
+// CommandReceived event carrying its outcome.
+//
+// With a lock actuator, unlock pulses the lock for the command's durationMs
+// and is acked once the pulse is over, with what the lock did and how long
+// it took to open. Later commands wait for that ack.
+//
+// With an authorization cache, the backend keeps a snapshot of the cards
+// allowed to unlock in it:
+//   {"action":"auth_begin","generation":g,"count":n}
+//   {"action":"auth_batch","generation":g,"offset":i,"entries":"<hex>"}
+//   {"action":"auth_commit","generation":g}
+// each with a requestId and acked in turn. entries is up to
+// MAX_AUTH_BATCH_ENTRIES records of 24 hex digits, a 16-digit card key then
+// an 8-digit expiry in Unix seconds, sorted by key. Taps read while MQTT is
+// down are then decided from the cache, and every decision is reported as
+// an offline_decision event once the link is back.
 class CommandConsumer
 {
 public:
-    explicit CommandConsumer(const DeviceContext &deviceContext);
+    static constexpr size_t MAX_AUTH_BATCH_ENTRIES = 16;
+
+    CommandConsumer(const DeviceContext &deviceContext,
+                    const WallClock &wallClock,
+                    InboundCommandRing &inboundCommands,
+                    AppEventBus &events);
 
-    void attach(MQTTManager &mqttManager);
-    bool processPending(MQTTManager &mqttManager, FeedbackController &feedbackController);
+    void subscribe(AppEventBus &events);
+    void setDiagnosticsReporter(DiagnosticsReporter &reporter);
+    void setAuthorizationCache(AuthorizationCache &cache);
+    void setLockActuator(LockActuator &actuator);
+    // Leaves the command pending while the queue has no room for its ack.
+    // Reports an offline decision when no command is waiting.
+    bool processPending(OutboundQueue &outboundQueue);
+    bool hasPending() const;
+    // A snapshot is loaded, so taps are worth reading while offline.
+    bool authorizesOffline() const;
 
 private:
-    static void mqttCallback(char *topic, byte *payload, unsigned int length);
-    void onMessage(char *topic, byte *payload, unsigned int length);
-    bool parsePendingCommand(DeviceCommand &command);
-    void publishAck(MQTTManager &mqttManager,
+    // Kept until reported; the oldest is dropped when they outrun the link.
+    struct OfflineDecision
+    {
+        uint64_t cardKey = 0;
+        uint64_t decidedAtUs = 0;
+        uint32_t cacheGeneration = 0;
+        uint8_t bay = 0;
+        // Null when granted.
+        const char *denialReason = nullptr;
+    };
+    static constexpr size_t MAX_OFFLINE_DECISIONS = 16;
+
+    bool parseCommand(const InboundCommand &inbound, DeviceCommand &command, JsonDocument &doc);
+    void handleAuthCommand(OutboundQueue &outboundQueue, const DeviceCommand &command, const JsonDocument &doc);
+    void onTapDetected(const TapDetected &event);
+    void onLockActuated(const LockActuated &event);
+    void executeUnlock(OutboundQueue &outboundQueue, const DeviceCommand &command);
+    void finishUnlock(OutboundQueue &outboundQueue);
+    bool reportOfflineDecision(OutboundQueue &outboundQueue);
+    void announce(CommandOutcome outcome);
+    void publishAck(OutboundQueue &outboundQueue,
                     const DeviceCommand &command,
                     const char *status,
-                    std::optional<std::string_view> detail = std::nullopt);
-
-    static CommandConsumer *activeInstance;
+                    std::optional<std::string_view> detail = std::nullopt,
+                    std::optional<uint32_t> actuationMs = std::nullopt);
 
-    DeviceContext deviceContext;
-    bool hasPendingMessage = false;
-    std::string pendingPayload;
+    const DeviceContext &deviceContext;
+    const WallClock &wallClock;
+    InboundCommandRing &inboundCommands;
+    AppEventBus &events;
+    DiagnosticsReporter *diagnosticsReporter = nullptr;
+    AuthorizationCache *authorizationCache = nullptr;
+    LockActuator *lockActuator = nullptr;
+    // The unlock whose pulse is running, and then its result.
+    std::optional<DeviceCommand> pendingUnlock;
+    uint32_t pendingPulse = 0;
+    std::optional<LockActuation> unlockResult;
+    std::array<OfflineDecision, MAX_OFFLINE_DECISIONS> offlineDecisions;
+    size_t firstDecision = 0;
+    size_t decisionCount = 0;
+    // Stages of the command being processed and the "trace" object its
+    // sender asked to have echoed; both end up in the ack.
+    RequestTrace commandTrace;
+    StaticJsonDocument<256> echoedTrace;
 };
 
 #endif // SERVICES_COMMAND_CONSUMER_H
@@ -1,41 +1,54 @@
 #ifndef SERVICES_CONNECTIVITY_SERVICE_H
 #define SERVICES_CONNECTIVITY_SERVICE_H
 
-#include <optional>
-#include <string>
-
-#include <WiFiClient.h>
+#include <cstdint>
+#include <string_view>
 
 #include "Config.h"
+#include "FixedString.h"
 #include "MQTTManager.h"
 #include "app/DeviceContext.h"
+#include "hal/MqttTransport.h"
+#include "hal/WifiLink.h"
 
+// Keeps WiFi and the MQTT session up. Runs on the network task and keeps
+// its own copy of the settings it needs, so nothing it reads can change
+// underneath it from the device task.
 class ConnectivityService
 {
 public:
-    ConnectivityService(const AppConfig &config, const DeviceContext &deviceContext);
+    ConnectivityService(const AppConfig &config,
+                        const DeviceContext &deviceContext,
+                        hal::WifiLink &wifi,
+                        hal::MqttTransport &transport);
 
     void begin();
     void loop();
 
     bool isWifiConnected() const;
     bool isReady();
+    uint64_t nextServiceAt(uint64_t now);
+    int socketFd() const;
 
-    void setCommandTopic(const std::string &topic);
+    void setCommandTopic(std::string_view topic);
     MQTTManager &mqtt();
 
 private:
     void ensureWifiConnected();
     void ensureMqttConnected();
 
-    AppConfig config;
-    DeviceContext deviceContext;
-    WiFiClient wifiClient;
+    const DeviceContext &deviceContext;
+    FixedString<hal::WifiLink::MAX_SSID_LENGTH> wifiSsid;
+    FixedString<hal::WifiLink::MAX_PASSWORD_LENGTH> wifiPassword;
+    hal::WifiLink &wifi;
+    hal::MqttTransport &transport;
     MQTTManager mqttManager;
-    std::optional<std::string> commandTopic;
-    unsigned long lastWifiAttemptAt = 0;
-    unsigned long lastMqttAttemptAt = 0;
+    Topic commandTopic;
+    uint64_t lastWifiAttemptAt = 0;
+    uint64_t lastMqttAttemptAt = 0;
     bool wifiStarted = false;
+    bool wifiLinkUp = false;
+    bool mqttSessionUp = false;
     bool commandTopicSubscribed = false;
 };
 
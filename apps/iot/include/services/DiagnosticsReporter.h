@@ -0,0 +1,15 @@
+#ifndef SERVICES_DIAGNOSTICS_REPORTER_H
+#define SERVICES_DIAGNOSTICS_REPORTER_H
+
+class OutboundQueue;
+
+// Implemented by services that can answer the "diagnostics" device command.
+class DiagnosticsReporter
+{
+public:
+    virtual ~DiagnosticsReporter() = default;
+
+    virtual bool publishDiagnostics(OutboundQueue &outboundQueue) = 0;
+};
+
+#endif // SERVICES_DIAGNOSTICS_REPORTER_H
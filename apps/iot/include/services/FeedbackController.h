@@ -1,19 +1,20 @@
 #ifndef SERVICES_FEEDBACK_CONTROLLER_H
 #define SERVICES_FEEDBACK_CONTROLLER_H
 
-#include <Arduino.h>
+#include <cstdint>
 
+#include "app/AppEvents.h"
 #include "app/RuntimeState.h"
 #include "drivers/LedController.h"
 
+// Drives the LED from the runtime state, with short overrides for taps and
+// command outcomes picked up from the event bus.
 class FeedbackController
 {
 public:
-    void signalTapPublished();
-    void signalUnlockGranted();
-    void signalAccessDenied();
-    void signalCommandFailed();
+    void subscribe(AppEventBus &events);
     void update(LedController &ledController, RuntimeState baseState);
+    uint64_t nextUpdateAt(const LedController &ledController, uint64_t now) const;
 
 private:
     enum class OverrideMode : uint8_t
@@ -25,10 +26,15 @@ private:
         CommandFailed,
     };
 
+    void onTapDetected(const TapDetected &event);
+    void onCommandReceived(const CommandReceived &event);
+    void onLockActuated(const LockActuated &event);
     void setOverride(OverrideMode mode, unsigned long durationMs);
 
     OverrideMode overrideMode = OverrideMode::None;
-    unsigned long overrideUntil = 0;
+    uint64_t overrideUntil = 0;
+    // Set until update() has shown a new override.
+    bool overridePending = false;
 };
 
 #endif // SERVICES_FEEDBACK_CONTROLLER_H
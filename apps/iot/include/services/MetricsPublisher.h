@@ -0,0 +1,41 @@
+#ifndef SERVICES_METRICS_PUBLISHER_H
+#define SERVICES_METRICS_PUBLISHER_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "app/DeviceContext.h"
+#include "app/WallClock.h"
+#include "services/DiagnosticsReporter.h"
+#include "services/OutboundQueue.h"
+
+// Flushes every registered metric to device/<id>/metrics in as few messages
+// as an outbound queue slot allows. Counters are cumulative since boot, gauges
+// are instantaneous and histograms cover the window since the last flush.
+class MetricsPublisher : public DiagnosticsReporter
+{
+public:
+    MetricsPublisher(const DeviceContext &deviceContext, const WallClock &wallClock);
+
+    void publishIfDue(OutboundQueue &outboundQueue);
+    uint64_t nextPublishAt() const;
+
+    // On-demand snapshot; histogram windows keep running.
+    bool publishDiagnostics(OutboundQueue &outboundQueue) override;
+
+private:
+    bool flush(OutboundQueue &outboundQueue, const char *trigger, bool rollWindow);
+    bool openBatch(OutboundQueue &outboundQueue, const char *trigger, uint8_t part);
+    bool closeAndQueueBatch(OutboundQueue &outboundQueue);
+
+    const DeviceContext &deviceContext;
+    const WallClock &wallClock;
+    uint64_t lastFlushAt = 0;
+    uint32_t flushSequence = 0;
+    // Batches are written straight into a queue slot.
+    OutboundQueue::Message *batch = nullptr;
+    size_t payloadLength = 0;
+    bool batchEmpty = true;
+};
+
+#endif // SERVICES_METRICS_PUBLISHER_H
@@ -0,0 +1,146 @@
+#ifndef SERVICES_OUTBOUND_MESSAGES_H
+#define SERVICES_OUTBOUND_MESSAGES_H
+
+#include <ArduinoJson.h>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "JsonWriter.h"
+#include "services/RequestTrace.h"
+
+// The fixed-shape messages the device publishes on every tap, command and
+// state change. They are written straight into the caller's buffer from the
+// schemas in OutboundMessages.cpp rather than built as ArduinoJson documents.
+// String fields are borrowed and must outlive the serialize call.
+
+// The "trace" object: the members the command sender asked to have echoed,
+// in their original order, followed by this device's stage stamps.
+struct TraceJson
+{
+    const RequestTrace *stages = nullptr;
+    // Stages already present here are not written a second time.
+    const JsonDocument *echoed = nullptr;
+};
+
+void writeJsonValue(JsonWriter &writer, const TraceJson &trace);
+
+struct TapEventMessage
+{
+    const char *requestId = nullptr;
+    const char *deviceId = nullptr;
+    const char *cardUid = nullptr;
+    // cardProtocolName() of the card; left out for ISO14443A, the only type
+    // older firmware reads.
+    std::optional<const char *> cardType;
+    // Only when two cards were in the field together. The backend must not
+    // start a rental on either of them.
+    std::optional<bool> ambiguous;
+    std::optional<const char *> otherCardUid;
+    // Only on multi-reader stations.
+    std::optional<uint32_t> bay;
+    uint64_t timestampMs = 0;
+    std::optional<uint64_t> epochMs;
+    const char *timeSync = nullptr;
+    uint32_t boot = 0;
+    TraceJson trace;
+};
+
+// Card session events other than the arrival, which is the tap event.
+struct CardEventMessage
+{
+    const char *deviceId = nullptr;
+    // "card_removed".
+    const char *event = nullptr;
+    const char *cardUid = nullptr;
+    std::optional<const char *> cardType;
+    std::optional<uint32_t> bay;
+    // The tap that opened the session, when this boot published it.
+    std::optional<const char *> tapRequestId;
+    uint32_t dwellMs = 0;
+    uint64_t timestampMs = 0;
+    std::optional<uint64_t> epochMs;
+    const char *timeSync = nullptr;
+    uint32_t boot = 0;
+};
+
+// Taps a bay held back for going over its rate, counted into one event.
+struct TapsLimitedMessage
+{
+    const char *deviceId = nullptr;
+    // "taps_limited".
+    const char *event = nullptr;
+    std::optional<uint32_t> bay;
+    uint32_t suppressed = 0;
+    // The last card held back.
+    const char *cardUid = nullptr;
+    // From the first tap held back to this event.
+    uint32_t windowMs = 0;
+    uint64_t timestampMs = 0;
+    std::optional<uint64_t> epochMs;
+    const char *timeSync = nullptr;
+    uint32_t boot = 0;
+};
+
+// A tap decided from the authorization cache while MQTT was down, reported
+// once it is back so the backend can reconcile the rental.
+struct OfflineDecisionMessage
+{
+    const char *deviceId = nullptr;
+    // "offline_decision".
+    const char *event = nullptr;
+    // Omitted for UIDs the cache cannot hold.
+    std::optional<const char *> cardUid;
+    std::optional<uint32_t> bay;
+    // "granted" or "denied".
+    const char *decision = nullptr;
+    // Why a tap was denied: "expired", "not_cached", "no_time" or
+    // "ambiguous".
+    std::optional<const char *> reason;
+    uint32_t cacheGeneration = 0;
+    // When the tap was decided, not when it was reported.
+    uint64_t timestampMs = 0;
+    std::optional<uint64_t> epochMs;
+    const char *timeSync = nullptr;
+    uint32_t boot = 0;
+};
+
+struct RuntimeStatusMessage
+{
+    const char *deviceId = nullptr;
+    const char *runtimeState = nullptr;
+    bool wifiConnected = false;
+    bool mqttConnected = false;
+    bool nfcHealthy = false;
+    // Only on multi-reader stations: bit n is set while bay n is healthy.
+    std::optional<uint32_t> nfcHealthyBays;
+    uint64_t timestampMs = 0;
+    std::optional<uint64_t> epochMs;
+    const char *timeSync = nullptr;
+    uint32_t boot = 0;
+};
+
+struct CommandAckMessage
+{
+    const char *deviceId = nullptr;
+    const char *requestId = nullptr;
+    const char *action = nullptr;
+    const char *status = nullptr;
+    std::optional<uint64_t> epochMs;
+    const char *timeSync = nullptr;
+    uint32_t boot = 0;
+    std::optional<const char *> detail;
+    // Unlocks that drove the lock: coil on to bolt open.
+    std::optional<uint32_t> actuationMs;
+    TraceJson trace;
+};
+
+// Each returns the length written, or 0 if the message did not fit.
+size_t serializeTapEvent(const TapEventMessage &message, char *buffer, size_t capacity);
+size_t serializeCardEvent(const CardEventMessage &message, char *buffer, size_t capacity);
+size_t serializeTapsLimited(const TapsLimitedMessage &message, char *buffer, size_t capacity);
+size_t serializeOfflineDecision(const OfflineDecisionMessage &message, char *buffer, size_t capacity);
+size_t serializeRuntimeStatus(const RuntimeStatusMessage &message, char *buffer, size_t capacity);
+size_t serializeCommandAck(const CommandAckMessage &message, char *buffer, size_t capacity);
+
+#endif // SERVICES_OUTBOUND_MESSAGES_H
@@ -0,0 +1,88 @@
+#ifndef SERVICES_OUTBOUND_QUEUE_H
+#define SERVICES_OUTBOUND_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "SpscRing.h"
+
+class MQTTManager;
+class WakeSignal;
+
+// Higher priorities leave first and are guaranteed more of the pool.
+enum class OutboundPriority : uint8_t
+{
+    // Tap events and command acks; someone is standing at the bike.
+    Interactive,
+    // Runtime status; retained, so only the latest one really matters.
+    State,
+    // Metrics batches and diagnostics.
+    Telemetry,
+    Count,
+};
+
+const char *outboundPriorityName(OutboundPriority priority);
+
+// Outbound MQTT messages on their way from the device task to the network
+// task. Each priority has its own fixed ring of slots; producers serialize
+// straight into a slot and queue it, and the network task drains the rings
+// in priority order, FIFO within a priority, up to a byte budget. When a
+// priority's ring is full acquire() returns nullptr and the producer holds
+// off, so a slow socket backs up into the producers instead of growing
+// memory, and a backlog of status or metrics can never take the slots an
+// unlock ack needs.
+//
+// acquire/submit/release/canAccept belong to the device task and drain() to
+// the network task; the rings are the only state the two share.
+class OutboundQueue
+{
+public:
+    static constexpr size_t INTERACTIVE_SLOTS = 4;
+    static constexpr size_t STATE_SLOTS = 2;
+    static constexpr size_t TELEMETRY_SLOTS = 2;
+    // Sized for a full metrics batch; every other message is well under.
+    static constexpr size_t PAYLOAD_CAPACITY = 1024;
+
+    struct Message
+    {
+        // Must outlive the message; in practice a DeviceContext topic.
+        const char *topic = nullptr;
+        size_t length = 0;
+        bool retained = false;
+        bool logPayload = true;
+        OutboundPriority priority = OutboundPriority::Interactive;
+        char payload[PAYLOAD_CAPACITY] = {};
+    };
+
+    // Claims the next free slot of a priority for the producer to fill, or
+    // nullptr when that priority's ring is full. A priority has one slot
+    // being filled at a time.
+    Message *acquire(OutboundPriority priority);
+    // Queues a filled slot; payload must be NUL terminated at length.
+    void submit(Message &message, const char *topic, size_t length, bool retained, bool logPayload = true);
+    // Hands back a slot that will not be submitted.
+    void release(Message &message);
+    bool canAccept(OutboundPriority priority) const;
+    // Notified with WakeEvent::OUTBOUND_QUEUED after every submit.
+    void setConsumerWake(WakeSignal &wakeSignal);
+
+    // Publishes queued messages until the next one would take the pass over
+    // byteBudget; the first message of a pass always goes. Stops early if
+    // the session is down, leaving the rest queued. Returns bytes sent.
+    size_t drain(MQTTManager &mqttManager, size_t byteBudget);
+
+    bool empty() const;
+    size_t queuedCount() const;
+
+private:
+    // Runs visitor on the ring that carries priority.
+    template <typename Queue, typename Visitor>
+    static auto visitRing(Queue &queue, OutboundPriority priority, Visitor &&visitor);
+
+    SpscRing<Message, INTERACTIVE_SLOTS> interactiveRing;
+    SpscRing<Message, STATE_SLOTS> stateRing;
+    SpscRing<Message, TELEMETRY_SLOTS> telemetryRing;
+    WakeSignal *consumerWake = nullptr;
+};
+
+#endif // SERVICES_OUTBOUND_QUEUE_H
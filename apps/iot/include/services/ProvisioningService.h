@@ -6,13 +6,14 @@
 #include <string_view>
 
 #include "Config.h"
-
-class Stream;
+#include "hal/FileStorage.h"
+#include "hal/SerialPort.h"
+#include "hal/System.h"
 
 class ProvisioningService
 {
 public:
-    explicit ProvisioningService(Stream &serial);
+    ProvisioningService(hal::SerialPort &serial, hal::FileStorage &storage, hal::System &system);
 
     void poll(AppConfig &config);
 
@@ -26,7 +27,9 @@ private:
     void writeConfigResponse(const AppConfig &config, std::optional<std::string_view> requestId) const;
     void restartDevice() const;
 
-    Stream &serial;
+    hal::SerialPort &serial;
+    hal::FileStorage &storage;
+    hal::System &system;
     std::string buffer;
 };
 
@@ -0,0 +1,47 @@
+#ifndef SERVICES_REQUEST_TRACE_H
+#define SERVICES_REQUEST_TRACE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+enum class TraceStage : uint8_t
+{
+    CardDetected,
+    TapPublished,
+    CommandReceived,
+    CommandParsed,
+    FeedbackApplied,
+    AckSent,
+    Count,
+};
+
+// JSON key the stage is carried under, e.g. "cardDetectedUs".
+const char *traceStageKey(TraceStage stage);
+
+// Device-side stage timestamps for one request, in hal::uptimeUs().
+// Only differences between stamps from the same device are meaningful; the
+// backend lines them up with its own clock through the requestId.
+//
+// The stamps travel in a "trace" object: the tap event carries the card and
+// publish stamps, the backend echoes whatever it received (plus its own keys)
+// in the command, and the ack returns that echo with the command stages
+// appended, so the whole round trip arrives in one message.
+class RequestTrace
+{
+public:
+    static constexpr size_t STAGE_COUNT = static_cast<size_t>(TraceStage::Count);
+
+    void mark(TraceStage stage);
+    // For stages stamped on another task and carried over with the request.
+    void markAt(TraceStage stage, uint64_t stampUs);
+    void clear();
+    bool has(TraceStage stage) const;
+    uint64_t at(TraceStage stage) const;
+
+private:
+    std::array<uint64_t, STAGE_COUNT> stampsUs{};
+    uint8_t markedStages = 0;
+};
+
+#endif // SERVICES_REQUEST_TRACE_H
@@ -1,35 +1,41 @@
 #ifndef SERVICES_RUNTIME_STATUS_PUBLISHER_H
 #define SERVICES_RUNTIME_STATUS_PUBLISHER_H
 
+#include <cstdint>
 #include <optional>
 
 #include "app/DeviceContext.h"
 #include "app/RuntimeState.h"
-
-class MQTTManager;
+#include "app/WallClock.h"
+#include "services/OutboundQueue.h"
 
 class RuntimeStatusPublisher
 {
 public:
-    explicit RuntimeStatusPublisher(const DeviceContext &deviceContext);
+    RuntimeStatusPublisher(const DeviceContext &deviceContext, const WallClock &wallClock);
 
-    void publishIfNeeded(MQTTManager &mqttManager,
+    void publishIfNeeded(OutboundQueue &outboundQueue,
                          RuntimeState runtimeState,
                          bool wifiConnected,
                          bool mqttConnected,
                          bool nfcHealthy,
+                         std::optional<uint32_t> nfcHealthyBays,
                          bool force = false);
+    uint64_t nextPublishAt(RuntimeState runtimeState, std::optional<uint32_t> nfcHealthyBays, uint64_t now) const;
 
 private:
     void logPublishedStatus(RuntimeState runtimeState,
-                            unsigned long timestampMs,
+                            uint64_t timestampMs,
                             bool wifiConnected,
                             bool mqttConnected,
                             bool nfcHealthy) const;
 
-    DeviceContext deviceContext;
+    const DeviceContext &deviceContext;
+    const WallClock &wallClock;
     RuntimeState lastPublishedState = RuntimeState::Booting;
-    std::optional<unsigned long> lastPublishedAt;
+    // A bay going down on a station leaves the state alone but is still news.
+    std::optional<uint32_t> lastPublishedBays;
+    std::optional<uint64_t> lastPublishedAt;
 };
 
 #endif // SERVICES_RUNTIME_STATUS_PUBLISHER_H
@@ -1,31 +1,106 @@
 #ifndef SERVICES_TAP_PUBLISHER_H
 #define SERVICES_TAP_PUBLISHER_H
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
-#include <string>
+#include <memory>
+#include <string_view>
 
-#include "CardTapWatcher.h"
+#include "FixedString.h"
+#include "ReaderScanScheduler.h"
+#include "TokenBucket.h"
+#include "app/AppEvents.h"
 #include "app/DeviceContext.h"
+#include "app/WallClock.h"
+#include "services/OutboundQueue.h"
+#include "services/RequestTrace.h"
 
-class MQTTManager;
-class NFCManager;
+// How many taps a bay may publish: a burst of up to burst, then perMinute
+// sustained. A faulty card or a flapping reader otherwise taps every
+// debounce window, each one a rental lookup in the backend.
+struct TapRateLimit
+{
+    uint16_t burst = 6;
+    // 0 publishes every tap.
+    uint16_t perMinute = 12;
+};
 
+// Polls the station's readers and queues a tap event per card, tagged with
+// its bay when there is more than one. Two cards read together go out as
+// one ambiguous tap carrying both UIDs. A reported card leaving the field
+// goes out as a card_removed event with its dwell time, linked to its tap.
+// Taps over a bay's rate limit are held back and counted into one
+// taps_limited event per window. Announces each published tap as
+// TapDetected and every change in a reader's health as ReaderHealthChanged.
+// While MQTT is down, taps within the rate limit are only announced, for
+// the authorization cache to decide, and removals are dropped. Commands keep the readers at their
+// fast rate, as a rider is likely to be at the station.
 class TapPublisher
 {
 public:
-    TapPublisher(NFCManager &nfcManager, const DeviceContext &deviceContext);
+    // "<deviceId>-<boot>-<uptimeMs>-<sequence>"
+    static constexpr size_t MAX_REQUEST_ID_LENGTH = MAX_DEVICE_ID_LENGTH + 48;
+
+    TapPublisher(ReaderScanScheduler &readers,
+                 const DeviceContext &deviceContext,
+                 const WallClock &wallClock,
+                 AppEventBus &events,
+                 const TapRateLimit &rateLimit = TapRateLimit());
+
+    // Announces every reader's state after ReaderScanScheduler::begin().
+    void begin();
+    void subscribe(AppEventBus &events);
 
-    bool pollAndPublish(MQTTManager &mqttManager);
-    const std::string &lastRequestId() const;
+    // Leaves the reader alone while the queue has no room for a tap, so the
+    // card is picked up once it drains instead of being read and lost.
+    bool pollAndPublish(OutboundQueue &outboundQueue);
+    uint64_t nextPollDueAt() const;
+    std::string_view lastRequestId() const;
 
 private:
-    bool publishTap(MQTTManager &mqttManager, const std::string &cardUid);
-    std::string nextRequestId();
+    bool pollOnce(OutboundQueue &outboundQueue);
+    bool pollOffline();
+    bool publishTap(OutboundQueue &outboundQueue, uint8_t bay, const CardTap &tap, RequestTrace &trace);
+    bool publishRemoval(OutboundQueue &outboundQueue, uint8_t bay, const CardRemoval &removal);
+    // Counts the tap into the bay's window instead of publishing it.
+    void holdBack(uint8_t bay, const CardTap &tap, uint64_t now);
+    // The first bay whose window is due a taps_limited event.
+    bool findDueSummary(uint64_t now, uint8_t &bay);
+    bool publishSummary(OutboundQueue &outboundQueue, uint8_t bay, uint64_t now);
+    uint64_t summaryDueAt(size_t bay) const;
+    void updateLimitMetrics(uint64_t now);
+    void advanceRequestId();
+    void reportReaderHealth();
+    void onCommandReceived(const CommandReceived &event);
+    void onConnectivityChanged(const ConnectivityChanged &event);
+    ReaderHealthChanged readerHealth(size_t bay) const;
 
-    CardTapWatcher watcher;
-    DeviceContext deviceContext;
+    ReaderScanScheduler &readers;
+    const DeviceContext &deviceContext;
+    const WallClock &wallClock;
+    AppEventBus &events;
+    std::array<ReaderHealthChanged, ReaderScanScheduler::MAX_BAYS> reportedHealth{};
+    // Per configured bay.
+    struct BayTaps
+    {
+        // The last tap, so its card's removal can name it. requestId is
+        // empty when the tap was held back, and so is its removal.
+        FixedString<MAX_CARD_UID_LENGTH> lastCardUid;
+        FixedString<MAX_REQUEST_ID_LENGTH> lastRequestId;
+        TokenBucket bucket;
+        // Taps held back since firstHeldAt; the window closes once the
+        // bucket has refilled or SUMMARY_WINDOW_MS has passed.
+        uint32_t heldBack = 0;
+        uint64_t firstHeldAt = 0;
+        FixedString<MAX_CARD_UID_LENGTH> heldBackUid;
+    };
+    // Bounds the taps_limited events of a bay that never calms down.
+    static constexpr uint32_t SUMMARY_WINDOW_MS = 60000;
+    std::unique_ptr<BayTaps[]> bayTaps;
+    bool online = false;
     uint32_t requestSequence = 0;
-    std::string lastPublishedRequestId;
+    FixedString<MAX_REQUEST_ID_LENGTH> lastPublishedRequestId;
 };
 
 #endif // SERVICES_TAP_PUBLISHER_H
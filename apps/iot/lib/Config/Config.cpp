@@ -1,134 +1,224 @@
 #include "Config.h"
-#include "FS.h"
-#include "SPIFFS.h"
-#include <ArduinoLog.h>
+#include "MQTTManager.h"
+#include "NFCManager.h"
+#include "app/DeviceContext.h"
+#include "hal/WifiLink.h"
+#include "logging/DeferredLog.h"
+
+#include <cstdlib>
 
 namespace
 {
-constexpr const char *CONFIG_PATH = "/.env";
+constexpr LogModule LOG_MODULE = LogModule::Config;
 
-bool ensureConfigFilesystemMounted()
+constexpr const char *CONFIG_PATH = "/.env";
+constexpr const char *WHITESPACE = " \t\r\n";
+// Below the fast rate is pointless; above it a card held briefly is missed.
+constexpr int MIN_NFC_IDLE_POLL_MS = 80;
+constexpr int MAX_NFC_IDLE_POLL_MS = 1000;
+constexpr int MAX_NFC_ACTIVE_HOLD_MS = 600000;
+// Shorter would be a card still being presented, not one left behind.
+constexpr int MIN_NFC_RETAP_MS = 1000;
+constexpr int MAX_NFC_RETAP_MS = 600000;
+constexpr int MAX_TAP_BURST = 60;
+// One a debounce window is no limit at all.
+constexpr int MAX_TAP_RATE_PER_MIN = 100;
+
+bool ensureConfigFilesystemMounted(hal::FileStorage &storage)
 {
-    if (!SPIFFS.begin(true))
+    if (!storage.mount())
     {
-        Log.error("An error occurred while mounting SPIFFS\n");
+        LOGE("An error occurred while mounting SPIFFS\n");
         return false;
     }
 
     return true;
 }
+
+std::string_view trim(std::string_view text)
+{
+    const size_t first = text.find_first_not_of(WHITESPACE);
+    if (first == std::string_view::npos)
+    {
+        return {};
+    }
+    const size_t last = text.find_last_not_of(WHITESPACE);
+    return text.substr(first, last - first + 1);
 }
 
-AppConfig loadConfig()
+void applyConfigLine(AppConfig &config, std::string_view line)
+{
+    const size_t separatorPos = line.find('=');
+    if (separatorPos == std::string_view::npos)
+    {
+        return;
+    }
+
+    const std::string_view key = line.substr(0, separatorPos);
+    std::string_view value = line.substr(separatorPos + 1);
+
+    if (value.size() >= 2 && value.front() == '"' && value.back() == '"')
+    {
+        value = value.substr(1, value.size() - 2);
+    }
+
+    if (key == "WIFI_SSID")
+    {
+        config.wifiSsid = value;
+    }
+    else if (key == "BIKE_ID")
+    {
+        config.bikeId = value;
+    }
+    else if (key == "WIFI_PASS")
+    {
+        config.wifiPass = value;
+    }
+    else if (key == "MQTT_BROKER_IP")
+    {
+        config.mqttBrokerIP = value;
+    }
+    else if (key == "MQTT_PORT")
+    {
+        config.mqttPort = std::atoi(std::string(value).c_str());
+    }
+    else if (key == "MQTT_USERNAME")
+    {
+        config.mqttUsername = value;
+    }
+    else if (key == "MQTT_PASSWORD")
+    {
+        config.mqttPassword = value;
+    }
+    else if (key == "NTP_SERVER")
+    {
+        config.ntpServer = value;
+    }
+    else if (key == "NFC_BUS")
+    {
+        config.nfcBus = value;
+    }
+    else if (key == "NFC_IDLE_POLL_MS")
+    {
+        config.nfcIdlePollMs = std::atoi(std::string(value).c_str());
+    }
+    else if (key == "NFC_ACTIVE_HOLD_MS")
+    {
+        config.nfcActiveHoldMs = std::atoi(std::string(value).c_str());
+    }
+    else if (key == "NFC_POWER_DOWN")
+    {
+        config.nfcPowerDown = value != "0";
+    }
+    else if (key == "NFC_PROTOCOLS")
+    {
+        config.nfcProtocols = value;
+    }
+    else if (key == "NFC_RETAP_MS")
+    {
+        config.nfcRetapMs = std::atoi(std::string(value).c_str());
+    }
+    else if (key == "TAP_BURST")
+    {
+        config.tapBurst = std::atoi(std::string(value).c_str());
+    }
+    else if (key == "TAP_RATE_PER_MIN")
+    {
+        config.tapRatePerMin = std::atoi(std::string(value).c_str());
+    }
+}
+}
+
+AppConfig loadConfig(hal::FileStorage &storage)
 {
     AppConfig config;
 
-    if (!ensureConfigFilesystemMounted())
+    if (!ensureConfigFilesystemMounted(storage))
     {
         return config;
     }
 
-    File file = SPIFFS.open(CONFIG_PATH);
-    if (!file)
+    std::string contents;
+    if (!storage.readFile(CONFIG_PATH, contents))
     {
-        Log.error("Failed to open .env file for reading\n");
+        LOGE("Failed to open .env file for reading\n");
         return config;
     }
 
-    Log.info("Reading configuration from .env file\n");
+    LOGI("Reading configuration from .env file\n");
 
-    while (file.available())
+    std::string_view remaining = contents;
+    while (!remaining.empty())
     {
-        String line = file.readStringUntil('\n');
-        line.trim();
+        const size_t lineEnd = remaining.find('\n');
+        const std::string_view line = trim(remaining.substr(0, lineEnd));
+        remaining = lineEnd == std::string_view::npos ? std::string_view() : remaining.substr(lineEnd + 1);
 
-        if (line.isEmpty() || line.startsWith("#"))
+        if (line.empty() || line.front() == '#')
         {
             continue;
         }
 
-        int separatorPos = line.indexOf('=');
-        if (separatorPos != -1)
-        {
-            String key = line.substring(0, separatorPos);
-            String value = line.substring(separatorPos + 1);
-
-            if (value.startsWith("\"") && value.endsWith("\""))
-            {
-                value = value.substring(1, value.length() - 1);
-            }
-
-            if (key == "WIFI_SSID")
-            {
-                config.wifiSsid = value.c_str();
-            }
-            else if (key == "BIKE_ID")
-            {
-                config.bikeId = value.c_str();
-            }
-            else if (key == "WIFI_PASS")
-            {
-                config.wifiPass = value.c_str();
-            }
-            else if (key == "MQTT_BROKER_IP")
-            {
-                config.mqttBrokerIP = value.c_str();
-            }
-            else if (key == "MQTT_PORT")
-            {
-                config.mqttPort = value.toInt();
-            }
-            else if (key == "MQTT_USERNAME")
-            {
-                config.mqttUsername = value.c_str();
-            }
-            else if (key == "MQTT_PASSWORD")
-            {
-                config.mqttPassword = value.c_str();
-            }
-        }
+        applyConfigLine(config, line);
     }
-    Log.info("Loaded config from .env file\n");
-    file.close();
+    LOGI("Loaded config from .env file\n");
     return config;
 }
 
-bool saveConfig(const AppConfig &config)
+bool saveConfig(hal::FileStorage &storage, const AppConfig &config)
 {
-    if (!ensureConfigFilesystemMounted())
+    if (!ensureConfigFilesystemMounted(storage))
     {
         return false;
     }
 
-    File file = SPIFFS.open(CONFIG_PATH, FILE_WRITE, true);
-    if (!file)
+    std::string contents;
+    contents.append("BIKE_ID=").append(config.bikeId).append("\r\n");
+    contents.append("WIFI_SSID=").append(config.wifiSsid).append("\r\n");
+    contents.append("WIFI_PASS=").append(config.wifiPass).append("\r\n");
+    contents.append("MQTT_BROKER_IP=").append(config.mqttBrokerIP).append("\r\n");
+    contents.append("MQTT_PORT=").append(std::to_string(config.mqttPort)).append("\r\n");
+    contents.append("MQTT_USERNAME=").append(config.mqttUsername).append("\r\n");
+    contents.append("MQTT_PASSWORD=").append(config.mqttPassword).append("\r\n");
+    contents.append("NTP_SERVER=").append(config.ntpServer).append("\r\n");
+    contents.append("NFC_BUS=").append(config.nfcBus).append("\r\n");
+    contents.append("NFC_IDLE_POLL_MS=").append(std::to_string(config.nfcIdlePollMs)).append("\r\n");
+    contents.append("NFC_ACTIVE_HOLD_MS=").append(std::to_string(config.nfcActiveHoldMs)).append("\r\n");
+    contents.append("NFC_POWER_DOWN=").append(config.nfcPowerDown ? "1" : "0").append("\r\n");
+    contents.append("NFC_PROTOCOLS=").append(config.nfcProtocols).append("\r\n");
+    contents.append("NFC_RETAP_MS=").append(std::to_string(config.nfcRetapMs)).append("\r\n");
+    contents.append("TAP_BURST=").append(std::to_string(config.tapBurst)).append("\r\n");
+    contents.append("TAP_RATE_PER_MIN=").append(std::to_string(config.tapRatePerMin)).append("\r\n");
+
+    if (!storage.writeFile(CONFIG_PATH, contents))
     {
-        Log.error("Failed to open .env file for writing\n");
+        LOGE("Failed to open .env file for writing\n");
         return false;
     }
 
-    file.seek(0, SeekSet);
-    file.print("BIKE_ID=");
-    file.println(config.bikeId.c_str());
-    file.print("WIFI_SSID=");
-    file.println(config.wifiSsid.c_str());
-    file.print("WIFI_PASS=");
-    file.println(config.wifiPass.c_str());
-    file.print("MQTT_BROKER_IP=");
-    file.println(config.mqttBrokerIP.c_str());
-    file.print("MQTT_PORT=");
-    file.println(config.mqttPort);
-    file.print("MQTT_USERNAME=");
-    file.println(config.mqttUsername.c_str());
-    file.print("MQTT_PASSWORD=");
-    file.println(config.mqttPassword.c_str());
-    file.close();
-
-    Log.notice("Saved runtime config to SPIFFS\n");
+    LOGN("Saved runtime config to SPIFFS\n");
     return true;
 }
 
 bool isConfigValid(const AppConfig &config)
 {
-    return !config.bikeId.empty() && !config.wifiSsid.empty() && !config.mqttBrokerIP.empty() && config.mqttPort > 0;
+    return !config.bikeId.empty() && !config.wifiSsid.empty() && !config.mqttBrokerIP.empty() && config.mqttPort > 0 &&
+           config.bikeId.size() <= MAX_DEVICE_ID_LENGTH &&
+           config.wifiSsid.size() <= hal::WifiLink::MAX_SSID_LENGTH &&
+           config.wifiPass.size() <= hal::WifiLink::MAX_PASSWORD_LENGTH &&
+           config.mqttBrokerIP.size() <= MQTTManager::MAX_SETTING_LENGTH &&
+           config.mqttUsername.size() <= MQTTManager::MAX_SETTING_LENGTH &&
+           config.mqttPassword.size() <= MQTTManager::MAX_SETTING_LENGTH &&
+           parseNfcBusMode(config.nfcBus).has_value() && parseCardProtocols(config.nfcProtocols).has_value() &&
+           (config.nfcIdlePollMs == 0 ||
+            (config.nfcIdlePollMs >= MIN_NFC_IDLE_POLL_MS && config.nfcIdlePollMs <= MAX_NFC_IDLE_POLL_MS)) &&
+           config.nfcActiveHoldMs >= 0 && config.nfcActiveHoldMs <= MAX_NFC_ACTIVE_HOLD_MS &&
+           (config.nfcRetapMs == 0 || (config.nfcRetapMs >= MIN_NFC_RETAP_MS && config.nfcRetapMs <= MAX_NFC_RETAP_MS)) &&
+           config.tapBurst >= 1 && config.tapBurst <= MAX_TAP_BURST &&
+           config.tapRatePerMin >= 0 && config.tapRatePerMin <= MAX_TAP_RATE_PER_MIN;
+}
+
+const std::string &ntpServerFor(const AppConfig &config)
+{
+    return config.ntpServer.empty() ? config.mqttBrokerIP : config.ntpServer;
 }
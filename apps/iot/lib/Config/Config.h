@@ -3,6 +3,8 @@
 
 #include <string>
 
+#include "hal/FileStorage.h"
+
 struct AppConfig
 {
     std::string bikeId;
@@ -12,10 +14,31 @@ struct AppConfig
     int mqttPort = 1883;
     std::string mqttUsername;
     std::string mqttPassword;
+    // Empty means the broker host, which on site deployments also serves NTP.
+    std::string ntpServer;
+    // PN532 transport, see parseNfcBusMode(). Empty means adaptive I2C.
+    std::string nfcBus;
+    // Scan interval of a bay nobody has used for nfcActiveHoldMs; 0 scans
+    // every bay at the fast rate all the time.
+    int nfcIdlePollMs = 400;
+    int nfcActiveHoldMs = 10000;
+    // Power idle readers down between scans.
+    bool nfcPowerDown = true;
+    // Card protocols to scan for, see parseCardProtocols(). Empty means
+    // ISO14443A only.
+    std::string nfcProtocols;
+    // A card left on a reader taps again every nfcRetapMs; 0 only after it
+    // has been taken away.
+    int nfcRetapMs = 0;
+    // Per bay: taps published back to back, then tapRatePerMin sustained.
+    // Taps over it are counted into a summary event; 0 publishes them all.
+    int tapBurst = 6;
+    int tapRatePerMin = 12;
 };
 
-AppConfig loadConfig();
-bool saveConfig(const AppConfig &config);
+AppConfig loadConfig(hal::FileStorage &storage);
+bool saveConfig(hal::FileStorage &storage, const AppConfig &config);
 bool isConfigValid(const AppConfig &config);
+const std::string &ntpServerFor(const AppConfig &config);
 
 #endif
@@ -1,27 +1,53 @@
 #include "app/App.h"
 
-#include <Arduino.h>
-#include <ArduinoLog.h>
-#include <Wire.h>
-
 #include "Config.h"
-#include "HardwareConfig.h"
+#include "hal/Clock.h"
+#include "logging/DeferredLog.h"
+
+namespace
+{
+constexpr LogModule LOG_MODULE = LogModule::App;
+}
 
-App::~App() = default;
+App::App(hal::Platform &platform)
+    : platform(platform), wallClock(platform.networkTime), ledController(platform.pwm)
+{
+}
+
+App::~App()
+{
+    // The network task holds references into this object.
+    if (networkTask != nullptr)
+    {
+        networkTask->stop();
+    }
+}
 
 void App::setup()
 {
     initializeLogging();
-    provisioningService = std::make_unique<ProvisioningService>(Serial);
+    wakeSignal.begin(platform, WakeEvent::SERIAL_RX | WakeEvent::NFC_IRQ);
+    provisioningService = std::make_unique<ProvisioningService>(platform.serial, platform.storage, platform.system);
 
     ledController.begin();
+    // Before anything can fail, so the coil is off whatever happens next.
+    if (platform.lockCoil != nullptr)
+    {
+        lockActuator = std::make_unique<LockActuator>(*platform.lockCoil, platform.lockSensor);
+        if (!lockActuator->begin())
+        {
+            lockActuator.reset();
+        }
+    }
     feedbackController = std::make_unique<FeedbackController>();
+    feedbackController->subscribe(events);
+    stateTracker.subscribe(events);
 
     setRuntimeState(RuntimeState::Booting);
 
     if (!loadRuntimeConfig())
     {
-        Log.error("Missing required bike, WiFi, or MQTT configuration\n");
+        LOGE("Missing required bike, WiFi, or MQTT configuration\n");
         setupFailed = true;
         setRuntimeState(RuntimeState::Error);
         return;
@@ -33,102 +59,286 @@ void App::setup()
 
 void App::loop()
 {
-    if (provisioningService != nullptr)
+    runDueServices();
+    scheduleNextDeadlines();
+    sleepUntilNextDeadline();
+}
+
+bool App::servicesAvailable() const
+{
+    return !setupFailed && feedbackController != nullptr && networkTask != nullptr && commandConsumer != nullptr && tapPublisher != nullptr;
+}
+
+void App::applyLinkUpdates()
+{
+    for (const LinkStatus *update = linkUpdates.front(); update != nullptr; update = linkUpdates.front())
+    {
+        events.publish(ConnectivityChanged{update->wifiConnected, update->mqttConnected});
+        linkUpdates.pop();
+    }
+}
+
+void App::runDueServices()
+{
+    const uint64_t now = hal::uptimeMs();
+
+    if (provisioningService != nullptr && scheduler.isDue(ScheduledService::Provisioning, now))
     {
         provisioningService->poll(config);
     }
 
-    RuntimeState nextState = RuntimeState::Offline;
+    // Runs whatever the link or setup state, as it is also the watchdog on
+    // the coil.
+    if (lockActuator != nullptr && scheduler.isDue(ScheduledService::LockActuator, now))
+    {
+        if (const std::optional<LockActuation> actuation = lockActuator->poll())
+        {
+            events.publish(LockActuated{*actuation});
+        }
+    }
 
-    if (setupFailed || feedbackController == nullptr || connectivityService == nullptr || commandConsumer == nullptr || tapPublisher == nullptr)
+    if (!servicesAvailable())
     {
-        nextState = RuntimeState::Error;
+        setRuntimeState(RuntimeState::Error);
     }
     else
     {
-        connectivityService->loop();
+        applyLinkUpdates();
 
-        if (connectivityService->isReady())
+        if (stateTracker.online())
         {
-            nextState = RuntimeState::Ready;
-
-            if (commandConsumer->processPending(connectivityService->mqtt(), *feedbackController))
+            if (commandConsumer->hasPending())
             {
-                nextState = RuntimeState::ExecutingCommand;
+                const LoopProfiler::ScopedTimer timer(loopProfiler, LoopStage::CommandDrain);
+                commandConsumer->processPending(outboundQueue);
             }
+        }
 
-            if (tapPublisher->pollAndPublish(connectivityService->mqtt()))
-            {
-                feedbackController->signalTapPublished();
-                nextState = RuntimeState::ProcessingTap;
-            }
+        // Offline taps are decided from the authorization cache, when there
+        // is one to decide them with.
+        if ((stateTracker.online() || commandConsumer->authorizesOffline()) &&
+            scheduler.isDue(ScheduledService::TapPolling, now))
+        {
+            const LoopProfiler::ScopedTimer timer(loopProfiler, LoopStage::TapPoll);
+            tapPublisher->pollAndPublish(outboundQueue);
+        }
 
-            if (nfcManager != nullptr && !nfcManager->isHealthy() && !nfcManager->isRecovering())
+        // One batch per pass, so the state, status and feedback below see
+        // everything this pass's taps, commands and link changes caused.
+        events.dispatch();
+        setRuntimeState(stateTracker.state());
+
+        if (stateTracker.online())
+        {
+            if (statusPublisher != nullptr && scheduler.isDue(ScheduledService::StatusPublish, hal::uptimeMs()))
             {
-                nextState = RuntimeState::Error;
+                const LoopProfiler::ScopedTimer timer(loopProfiler, LoopStage::StatusPublish);
+                statusPublisher->publishIfNeeded(outboundQueue,
+                                                runtimeState,
+                                                stateTracker.wifiConnected(),
+                                                stateTracker.online(),
+                                                stateTracker.readerHealthy(),
+                                                stateTracker.healthyBays());
             }
 
-            setRuntimeState(nextState);
-            if (statusPublisher != nullptr)
+            if (metricsPublisher != nullptr && scheduler.isDue(ScheduledService::MetricsPublish, hal::uptimeMs()))
             {
-                statusPublisher->publishIfNeeded(connectivityService->mqtt(),
-                                                runtimeState,
-                                                connectivityService->isWifiConnected(),
-                                                connectivityService->isReady(),
-                                                nfcManager != nullptr && nfcManager->isHealthy());
+                metricsPublisher->publishIfDue(outboundQueue);
             }
         }
-        else if (nfcManager != nullptr && !nfcManager->isHealthy())
+        stateTracker.endPass();
+    }
+
+    if (scheduler.isDue(ScheduledService::Feedback, hal::uptimeMs()))
+    {
+        const LoopProfiler::ScopedTimer timer(loopProfiler, LoopStage::Feedback);
+        applyFeedback();
+    }
+}
+
+void App::scheduleNextDeadlines()
+{
+    const uint64_t now = hal::uptimeMs();
+
+    // Serial input is delivered as a wake event, there is nothing to poll for.
+    scheduler.cancel(ScheduledService::Provisioning);
+
+    if (servicesAvailable() && stateTracker.online())
+    {
+        // A producer whose ring is full sleeps until the network task wakes
+        // it with OUTBOUND_SPACE instead of spinning on a stalled socket.
+        const bool interactiveRoom = outboundQueue.canAccept(OutboundPriority::Interactive);
+        const bool stateRoom = outboundQueue.canAccept(OutboundPriority::State);
+
+        if (commandConsumer->hasPending() && interactiveRoom)
+        {
+            scheduler.scheduleAt(ScheduledService::CommandDrain, now);
+        }
+        else
+        {
+            scheduler.cancel(ScheduledService::CommandDrain);
+        }
+
+        if (interactiveRoom)
+        {
+            scheduler.scheduleAt(ScheduledService::TapPolling, tapPublisher->nextPollDueAt());
+        }
+        else
+        {
+            scheduler.cancel(ScheduledService::TapPolling);
+        }
+
+        if (statusPublisher != nullptr && stateRoom)
         {
-            nextState = RuntimeState::Error;
-            setRuntimeState(nextState);
+            scheduler.scheduleAt(ScheduledService::StatusPublish, statusPublisher->nextPublishAt(runtimeState, stateTracker.healthyBays(), now));
         }
         else
         {
-            setRuntimeState(nextState);
+            scheduler.cancel(ScheduledService::StatusPublish);
         }
+
+        if (metricsPublisher != nullptr && outboundQueue.canAccept(OutboundPriority::Telemetry))
+        {
+            scheduler.scheduleAt(ScheduledService::MetricsPublish, metricsPublisher->nextPublishAt());
+        }
+        else
+        {
+            scheduler.cancel(ScheduledService::MetricsPublish);
+        }
+
+        // Tap and command states only last for a single pass, as they did
+        // with the fixed 5 ms loop.
+        if (stateRoom && (runtimeState == RuntimeState::ProcessingTap || runtimeState == RuntimeState::ExecutingCommand))
+        {
+            scheduler.markDue(ScheduledService::StatusPublish);
+        }
+    }
+    else
+    {
+        scheduler.cancel(ScheduledService::CommandDrain);
+        if (servicesAvailable() && commandConsumer->authorizesOffline())
+        {
+            scheduler.scheduleAt(ScheduledService::TapPolling, tapPublisher->nextPollDueAt());
+        }
+        else
+        {
+            scheduler.cancel(ScheduledService::TapPolling);
+        }
+        scheduler.cancel(ScheduledService::StatusPublish);
+        scheduler.cancel(ScheduledService::MetricsPublish);
     }
 
-    applyFeedback();
-    delay(5);
+    if (lockActuator != nullptr && lockActuator->busy())
+    {
+        scheduler.scheduleAt(ScheduledService::LockActuator, lockActuator->nextPollAt());
+    }
+    else
+    {
+        scheduler.cancel(ScheduledService::LockActuator);
+    }
+
+    if (feedbackController != nullptr)
+    {
+        scheduler.scheduleAt(ScheduledService::Feedback, feedbackController->nextUpdateAt(ledController, now));
+    }
+    else
+    {
+        scheduler.scheduleAt(ScheduledService::Feedback, ledController.nextUpdateAt(now));
+    }
+}
+
+void App::sleepUntilNextDeadline()
+{
+    // Commands, link changes and freed outbound slots only need the next
+    // pass to run; scheduleNextDeadlines() picks them up from the rings.
+    const unsigned long sleepMs = scheduler.millisUntilNextDeadline(hal::uptimeMs());
+    const uint32_t events = wakeSignal.wait(sleepMs, -1);
+
+    if ((events & WakeEvent::NFC_IRQ) != 0)
+    {
+        scheduler.markDue(ScheduledService::TapPolling);
+    }
+    if ((events & WakeEvent::SERIAL_RX) != 0)
+    {
+        scheduler.markDue(ScheduledService::Provisioning);
+    }
 }
 
 void App::initializeLogging()
 {
-    Serial.begin(115200);
-    Log.begin(LOG_LEVEL_VERBOSE, &Serial);
+    platform.serial.begin(115200);
+    DeferredLog::begin(platform.serial, LOG_LEVEL_VERBOSE);
 }
 
 bool App::loadRuntimeConfig()
 {
-    config = loadConfig();
+    config = loadConfig(platform.storage);
     return isConfigValid(config);
 }
 
 void App::initializeRuntimeServices()
 {
     deviceContext = makeDeviceContext(config.bikeId);
-    Log.notice("Device adapter booting as bike %s\n", deviceContext.deviceId.c_str());
+    LOGN("Device adapter booting as bike %s\n", deviceContext.deviceId.c_str());
 
-    statusPublisher = std::make_unique<RuntimeStatusPublisher>(deviceContext);
+    // SNTP brings up the network stack itself and waits for a route, so it
+    // can start before WiFi.
+    wallClock.begin(platform.storage, ntpServerFor(config));
 
-    Wire.begin(HardwareConfig::I2C_SDA_PIN, HardwareConfig::I2C_SCL_PIN);
+    statusPublisher = std::make_unique<RuntimeStatusPublisher>(deviceContext, wallClock);
+    metricsPublisher = std::make_unique<MetricsPublisher>(deviceContext, wallClock);
 
-    nfcManager = std::make_unique<NFCManager>();
-    if (!nfcManager->begin())
+    NfcPollPolicy pollPolicy;
+    pollPolicy.idleIntervalMs = static_cast<unsigned long>(config.nfcIdlePollMs);
+    pollPolicy.activeHoldMs = static_cast<unsigned long>(config.nfcActiveHoldMs);
+    pollPolicy.powerDownWhenIdle = config.nfcPowerDown;
+    pollPolicy.protocols = parseCardProtocols(config.nfcProtocols).value_or(pollPolicy.protocols);
+    pollPolicy.retapIntervalMs = static_cast<unsigned long>(config.nfcRetapMs);
+    readers = std::make_unique<ReaderScanScheduler>(platform.nfcBays,
+                                                    platform.nfcBayCount,
+                                                    parseNfcBusMode(config.nfcBus).value_or(NfcBusMode::I2cAdaptive),
+                                                    pollPolicy);
+    if (!readers->begin())
     {
-        Log.warning("PN532 not available at boot; recovery will continue in background\n");
+        LOGW("No PN532 available at boot; recovery will continue in background\n");
     }
 
-    connectivityService = std::make_unique<ConnectivityService>(config, deviceContext);
-    connectivityService->setCommandTopic(deviceContext.topics.commandTopic);
-
-    commandConsumer = std::make_unique<CommandConsumer>(deviceContext);
-    commandConsumer->attach(connectivityService->mqtt());
+    commandConsumer = std::make_unique<CommandConsumer>(deviceContext, wallClock, inboundCommands, events);
+    commandConsumer->setDiagnosticsReporter(*metricsPublisher);
+    commandConsumer->subscribe(events);
+    if (lockActuator != nullptr)
+    {
+        commandConsumer->setLockActuator(*lockActuator);
+    }
+    if (platform.authFlash != nullptr)
+    {
+        authorizationCache = std::make_unique<AuthorizationCache>(*platform.authFlash);
+        if (authorizationCache->begin())
+        {
+            commandConsumer->setAuthorizationCache(*authorizationCache);
+        }
+        else
+        {
+            LOGW("Authorization cache unavailable; offline taps will not unlock\n");
+            authorizationCache.reset();
+        }
+    }
 
-    tapPublisher = std::make_unique<TapPublisher>(*nfcManager, deviceContext);
+    TapRateLimit rateLimit;
+    rateLimit.burst = static_cast<uint16_t>(config.tapBurst);
+    rateLimit.perMinute = static_cast<uint16_t>(config.tapRatePerMin);
+    tapPublisher = std::make_unique<TapPublisher>(*readers, deviceContext, wallClock, events, rateLimit);
+    tapPublisher->begin();
+    tapPublisher->subscribe(events);
 
-    connectivityService->begin();
+    networkTask = std::make_unique<NetworkTask>(config,
+                                                deviceContext,
+                                                platform,
+                                                outboundQueue,
+                                                inboundCommands,
+                                                linkUpdates,
+                                                wakeSignal);
+    networkTask->start();
 }
 
 void App::applyFeedback()
@@ -146,5 +356,10 @@ void App::applyFeedback()
 
 void App::setRuntimeState(RuntimeState state)
 {
+    if (state != runtimeState)
+    {
+        scheduler.markDue(ScheduledService::StatusPublish);
+        scheduler.markDue(ScheduledService::Feedback);
+    }
     runtimeState = state;
 }
@@ -0,0 +1,13 @@
+#include "app/EventBus.h"
+
+#include "metrics/Metrics.h"
+
+namespace
+{
+MetricCounter droppedEvents("events.dropped");
+}
+
+void recordDroppedEvent()
+{
+    droppedEvents.increment();
+}
@@ -0,0 +1,61 @@
+#include "app/LoopProfiler.h"
+
+#include <array>
+
+#include "hal/Clock.h"
+#include "metrics/Metrics.h"
+
+namespace
+{
+MetricHistogram connectivityLatency("loop.connectivity_us");
+MetricHistogram commandDrainLatency("loop.command_drain_us");
+MetricHistogram tapPollLatency("loop.tap_poll_us");
+MetricHistogram statusPublishLatency("loop.status_publish_us");
+MetricHistogram feedbackLatency("loop.feedback_us");
+MetricHistogram outboundDrainLatency("loop.outbound_drain_us");
+
+const std::array<MetricHistogram *, LoopProfiler::STAGE_COUNT> stageHistograms = {
+    &connectivityLatency,
+    &commandDrainLatency,
+    &tapPollLatency,
+    &statusPublishLatency,
+    &feedbackLatency,
+    &outboundDrainLatency,
+};
+}
+
+const char *loopStageName(LoopStage stage)
+{
+    switch (stage)
+    {
+    case LoopStage::Connectivity:
+        return "connectivity";
+    case LoopStage::CommandDrain:
+        return "command_drain";
+    case LoopStage::TapPoll:
+        return "tap_poll";
+    case LoopStage::StatusPublish:
+        return "status_publish";
+    case LoopStage::Feedback:
+        return "feedback";
+    case LoopStage::OutboundDrain:
+        return "outbound_drain";
+    default:
+        return "unknown";
+    }
+}
+
+LoopProfiler::ScopedTimer::ScopedTimer(LoopProfiler &profiler, LoopStage stage)
+    : profiler(profiler), stage(stage), startedAtUs(hal::micros())
+{
+}
+
+LoopProfiler::ScopedTimer::~ScopedTimer()
+{
+    profiler.record(stage, static_cast<uint32_t>(hal::micros() - startedAtUs));
+}
+
+void LoopProfiler::record(LoopStage stage, uint32_t micros)
+{
+    stageHistograms[static_cast<size_t>(stage)]->record(micros);
+}
@@ -0,0 +1,192 @@
+#include "app/NetworkTask.h"
+
+#include <algorithm>
+#include <string_view>
+
+#include "app/Scheduler.h"
+#include "hal/Clock.h"
+#include "hal/Task.h"
+#include "logging/DeferredLog.h"
+#include "metrics/Metrics.h"
+
+namespace
+{
+constexpr LogModule LOG_MODULE = LogModule::Connectivity;
+
+// Core 0 is where the WiFi stack runs; Arduino's loop task is on core 1.
+// Above the log renderer so a burst of log lines cannot hold up an ack.
+constexpr hal::TaskSpec NETWORK_TASK{"network", 8192, 2, 0};
+
+// Bytes handed to the MQTT client per pass. Enough for an ack, a tap and a
+// status together; a metrics batch waits for a pass of its own so the
+// socket is serviced in between.
+constexpr size_t OUTBOUND_BYTES_PER_PASS = 1024;
+
+// Retry delay when the device task has not yet drained its link ring.
+constexpr unsigned long LINK_UPDATE_RETRY_MS = 5;
+
+MetricCounter inboundCommandsDropped("command.inbound_dropped");
+}
+
+NetworkTask::NetworkTask(const AppConfig &config,
+                         const DeviceContext &deviceContext,
+                         hal::Platform &platform,
+                         OutboundQueue &outboundQueue,
+                         InboundCommandRing &inboundCommands,
+                         LinkStatusRing &linkUpdates,
+                         WakeSignal &deviceWake)
+    : platform(platform),
+      deviceContext(deviceContext),
+      outboundQueue(outboundQueue),
+      inboundCommands(inboundCommands),
+      linkUpdates(linkUpdates),
+      deviceWake(deviceWake),
+      connectivityService(config, deviceContext, platform.wifi, platform.mqtt)
+{
+}
+
+bool NetworkTask::start()
+{
+    wakeSignal.begin(platform, WakeEvent::WIFI);
+    outboundQueue.setConsumerWake(wakeSignal);
+    connectivityService.setCommandTopic(deviceContext.topics.commandTopic);
+    connectivityService.mqtt().setCallback([this](char *topic, uint8_t *payload, unsigned int length)
+                                           { onMessage(topic, payload, length); });
+
+    started = hal::startTask(NETWORK_TASK, run, this) != nullptr;
+    if (!started)
+    {
+        LOGE("Failed to start the network task\n");
+    }
+    return started;
+}
+
+void NetworkTask::stop()
+{
+    if (!started)
+    {
+        return;
+    }
+
+    stopRequested.store(true);
+    wakeSignal.notify(0);
+    while (!parked.load())
+    {
+        hal::delayMs(1);
+    }
+}
+
+void NetworkTask::run(void *argument)
+{
+    NetworkTask &task = *static_cast<NetworkTask *>(argument);
+    task.connectivityService.begin();
+    while (!task.stopRequested.load(std::memory_order_relaxed))
+    {
+        task.loopOnce();
+    }
+
+    task.parked.store(true);
+    // Tasks never return.
+    while (true)
+    {
+        hal::waitForNotification(Scheduler::MAX_SLEEP_MS);
+    }
+}
+
+void NetworkTask::loopOnce()
+{
+    if (connectivityDue || deadlineReached(hal::uptimeMs(), nextConnectivityAt))
+    {
+        const LoopProfiler::ScopedTimer timer(loopProfiler, LoopStage::Connectivity);
+        connectivityService.loop();
+        connectivityDue = false;
+    }
+
+    publishLinkStatus();
+
+    if (connectivityService.isReady() && !outboundQueue.empty())
+    {
+        const LoopProfiler::ScopedTimer timer(loopProfiler, LoopStage::OutboundDrain);
+        const size_t queuedBefore = outboundQueue.queuedCount();
+        outboundQueue.drain(connectivityService.mqtt(), OUTBOUND_BYTES_PER_PASS);
+        // Producers that found their ring full are waiting for this.
+        if (outboundQueue.queuedCount() < queuedBefore)
+        {
+            deviceWake.notify(WakeEvent::OUTBOUND_SPACE);
+        }
+    }
+
+    sleepUntilNextDeadline();
+}
+
+void NetworkTask::onMessage(char *topic, uint8_t *payload, unsigned int length)
+{
+    if (topic == nullptr || deviceContext.topics.commandTopic != topic)
+    {
+        return;
+    }
+
+    InboundCommand *command = inboundCommands.reserve();
+    if (command == nullptr)
+    {
+        LOGW("Command ring full, dropping %u byte command\n", length);
+        inboundCommandsDropped.increment();
+        return;
+    }
+
+    command->receivedAtUs = hal::uptimeUs();
+    if (!command->payload.assign(std::string_view(reinterpret_cast<const char *>(payload), length)))
+    {
+        LOGW("Dropping %u byte command payload, limit is %u\n", length, static_cast<unsigned>(InboundCommand::MAX_PAYLOAD_LENGTH));
+    }
+    inboundCommands.commit();
+    deviceWake.notify(WakeEvent::COMMAND_RECEIVED);
+}
+
+void NetworkTask::publishLinkStatus()
+{
+    const LinkStatus current{connectivityService.isWifiConnected(), connectivityService.isReady()};
+    if (current == publishedLink)
+    {
+        linkUpdatePending = false;
+        return;
+    }
+
+    LinkStatus *update = linkUpdates.reserve();
+    if (update == nullptr)
+    {
+        linkUpdatePending = true;
+        return;
+    }
+
+    *update = current;
+    linkUpdates.commit();
+    publishedLink = current;
+    linkUpdatePending = false;
+    deviceWake.notify(WakeEvent::LINK_CHANGED);
+}
+
+void NetworkTask::sleepUntilNextDeadline()
+{
+    const uint64_t now = hal::uptimeMs();
+    nextConnectivityAt = connectivityService.nextServiceAt(now);
+
+    uint64_t wakeAt = nextConnectivityAt;
+    if (connectivityService.isReady() && !outboundQueue.empty())
+    {
+        wakeAt = now;
+    }
+    if (linkUpdatePending)
+    {
+        wakeAt = earlierDeadline(wakeAt, now + LINK_UPDATE_RETRY_MS);
+    }
+
+    const unsigned long sleepMs = deadlineReached(now, wakeAt)
+                                      ? 0
+                                      : static_cast<unsigned long>(std::min<uint64_t>(wakeAt - now, Scheduler::MAX_SLEEP_MS));
+    const uint32_t events = wakeSignal.wait(sleepMs, connectivityService.socketFd());
+    if ((events & (WakeEvent::MQTT_SOCKET | WakeEvent::WIFI)) != 0)
+    {
+        connectivityDue = true;
+    }
+}
@@ -0,0 +1,90 @@
+#include "app/RuntimeStateTracker.h"
+
+void RuntimeStateTracker::subscribe(AppEventBus &events)
+{
+    events.subscribe<TapDetected, &RuntimeStateTracker::onTapDetected>(*this);
+    events.subscribe<CommandReceived, &RuntimeStateTracker::onCommandReceived>(*this);
+    events.subscribe<ConnectivityChanged, &RuntimeStateTracker::onConnectivityChanged>(*this);
+    events.subscribe<ReaderHealthChanged, &RuntimeStateTracker::onReaderHealthChanged>(*this);
+}
+
+RuntimeState RuntimeStateTracker::state() const
+{
+    // Until the readers report they are assumed fine, and a station is only
+    // in error once none of its bays can take a tap.
+    const bool noneReported = reportedBays == 0;
+    if (!link.mqttConnected)
+    {
+        return noneReported || healthyBayMask != 0 ? RuntimeState::Offline : RuntimeState::Error;
+    }
+
+    // A reader that is working its way back keeps the device usable for
+    // commands, so only stuck ones are an error while online.
+    if (!noneReported && (healthyBayMask | recoveringBayMask) == 0)
+    {
+        return RuntimeState::Error;
+    }
+    if (tapThisPass)
+    {
+        return RuntimeState::ProcessingTap;
+    }
+    if (commandThisPass)
+    {
+        return RuntimeState::ExecutingCommand;
+    }
+    return RuntimeState::Ready;
+}
+
+bool RuntimeStateTracker::wifiConnected() const
+{
+    return link.wifiConnected;
+}
+
+bool RuntimeStateTracker::online() const
+{
+    return link.mqttConnected;
+}
+
+bool RuntimeStateTracker::readerHealthy() const
+{
+    return healthyBayMask == reportedBays;
+}
+
+std::optional<uint32_t> RuntimeStateTracker::healthyBays() const
+{
+    // More than one bit set.
+    if ((reportedBays & (reportedBays - 1)) == 0)
+    {
+        return std::nullopt;
+    }
+    return healthyBayMask;
+}
+
+void RuntimeStateTracker::endPass()
+{
+    tapThisPass = false;
+    commandThisPass = false;
+}
+
+void RuntimeStateTracker::onTapDetected(const TapDetected &)
+{
+    tapThisPass = true;
+}
+
+void RuntimeStateTracker::onCommandReceived(const CommandReceived &)
+{
+    commandThisPass = true;
+}
+
+void RuntimeStateTracker::onConnectivityChanged(const ConnectivityChanged &event)
+{
+    link = event;
+}
+
+void RuntimeStateTracker::onReaderHealthChanged(const ReaderHealthChanged &event)
+{
+    const uint32_t bit = 1u << event.bay;
+    reportedBays |= bit;
+    healthyBayMask = event.healthy ? healthyBayMask | bit : healthyBayMask & ~bit;
+    recoveringBayMask = event.recovering ? recoveringBayMask | bit : recoveringBayMask & ~bit;
+}
@@ -0,0 +1,64 @@
+#include "app/Scheduler.h"
+
+void Scheduler::scheduleAt(ScheduledService service, uint64_t deadline)
+{
+    Slot &target = slot(service);
+    target.deadline = deadline;
+    target.armed = true;
+    target.forced = false;
+}
+
+void Scheduler::markDue(ScheduledService service)
+{
+    slot(service).forced = true;
+}
+
+void Scheduler::cancel(ScheduledService service)
+{
+    Slot &target = slot(service);
+    target.armed = false;
+    target.forced = false;
+}
+
+bool Scheduler::isDue(ScheduledService service, uint64_t now) const
+{
+    const Slot &target = slot(service);
+    return target.forced || (target.armed && deadlineReached(now, target.deadline));
+}
+
+unsigned long Scheduler::millisUntilNextDeadline(uint64_t now) const
+{
+    unsigned long sleepMs = MAX_SLEEP_MS;
+    for (const Slot &candidate : slots)
+    {
+        if (candidate.forced)
+        {
+            return 0;
+        }
+        if (!candidate.armed)
+        {
+            continue;
+        }
+        if (deadlineReached(now, candidate.deadline))
+        {
+            return 0;
+        }
+
+        const uint64_t remaining = candidate.deadline - now;
+        if (remaining < sleepMs)
+        {
+            sleepMs = static_cast<unsigned long>(remaining);
+        }
+    }
+    return sleepMs;
+}
+
+Scheduler::Slot &Scheduler::slot(ScheduledService service)
+{
+    return slots[static_cast<size_t>(service)];
+}
+
+const Scheduler::Slot &Scheduler::slot(ScheduledService service) const
+{
+    return slots[static_cast<size_t>(service)];
+}
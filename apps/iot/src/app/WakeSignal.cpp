@@ -0,0 +1,101 @@
+#include "app/WakeSignal.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "hal/Clock.h"
+#include "hal/EventFd.h"
+#include "hal/IsrAttr.h"
+#include "hal/WaitReadable.h"
+#include "logging/DeferredLog.h"
+
+namespace
+{
+constexpr LogModule LOG_MODULE = LogModule::App;
+
+void HAL_ISR_ATTR onNfcIrq(void *argument)
+{
+    static_cast<WakeSignal *>(argument)->notifyFromIsr(WakeEvent::NFC_IRQ);
+}
+}
+
+bool WakeSignal::begin(hal::Platform &platform, uint32_t sources)
+{
+    eventFd = hal::createEventFd();
+    if (eventFd < 0)
+    {
+        LOGE("Failed to create wake eventfd, falling back to %lu ms polling\n", FALLBACK_POLL_INTERVAL_MS);
+        return false;
+    }
+
+    if ((sources & WakeEvent::SERIAL_RX) != 0)
+    {
+        platform.serial.onReceive([this]()
+                                  { notify(WakeEvent::SERIAL_RX); });
+    }
+    if ((sources & WakeEvent::WIFI) != 0)
+    {
+        platform.wifi.onEvent([this]()
+                              { notify(WakeEvent::WIFI); });
+    }
+    if ((sources & WakeEvent::NFC_IRQ) != 0)
+    {
+        for (size_t bay = 0; bay < platform.nfcBayCount; ++bay)
+        {
+            platform.nfcBays[bay].reader.onIrq(onNfcIrq, this);
+        }
+    }
+    return true;
+}
+
+uint32_t WakeSignal::wait(unsigned long timeoutMs, int socketFd)
+{
+    if (eventFd < 0)
+    {
+        if (timeoutMs > 0)
+        {
+            hal::delayMs(std::min(timeoutMs, FALLBACK_POLL_INTERVAL_MS));
+        }
+        return pendingEvents.exchange(0) | (socketFd >= 0 ? WakeEvent::MQTT_SOCKET : 0);
+    }
+
+    const int fds[] = {eventFd, socketFd};
+    bool readable[] = {false, false};
+    uint32_t observed = 0;
+    if (hal::waitReadable(fds, readable, 2, timeoutMs) > 0)
+    {
+        if (readable[0])
+        {
+            uint64_t counter = 0;
+            read(eventFd, &counter, sizeof(counter));
+        }
+        if (readable[1])
+        {
+            observed |= WakeEvent::MQTT_SOCKET;
+        }
+    }
+
+    return observed | pendingEvents.exchange(0);
+}
+
+void WakeSignal::notify(uint32_t events)
+{
+    pendingEvents.fetch_or(events);
+    if (eventFd >= 0)
+    {
+        const uint64_t increment = 1;
+        write(eventFd, &increment, sizeof(increment));
+    }
+}
+
+void HAL_ISR_ATTR WakeSignal::notifyFromIsr(uint32_t events)
+{
+    // eventfds created with EFD_SUPPORT_ISR accept writes from interrupt context.
+    pendingEvents.fetch_or(events);
+    if (eventFd >= 0)
+    {
+        const uint64_t increment = 1;
+        write(eventFd, &increment, sizeof(increment));
+    }
+}
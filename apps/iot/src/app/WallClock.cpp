@@ -0,0 +1,81 @@
+#include "app/WallClock.h"
+
+#include <cstdlib>
+
+#include "hal/Clock.h"
+#include "logging/DeferredLog.h"
+
+namespace
+{
+constexpr LogModule LOG_MODULE = LogModule::App;
+
+constexpr const char *BOOT_COUNT_PATH = "/boot_count";
+
+uint32_t advanceBootCount(hal::FileStorage &storage)
+{
+    std::string contents;
+    const uint32_t previous = storage.readFile(BOOT_COUNT_PATH, contents)
+                                  ? static_cast<uint32_t>(std::strtoul(contents.c_str(), nullptr, 10))
+                                  : 0;
+    const uint32_t current = previous + 1;
+    if (!storage.writeFile(BOOT_COUNT_PATH, std::to_string(current)))
+    {
+        LOGW("Failed to persist boot count\n");
+    }
+    return current;
+}
+}
+
+const char *timeSyncQualityName(TimeSyncQuality quality)
+{
+    switch (quality)
+    {
+    case TimeSyncQuality::None:
+        return "none";
+    case TimeSyncQuality::Synced:
+        return "synced";
+    case TimeSyncQuality::Stale:
+        return "stale";
+    default:
+        return "unknown";
+    }
+}
+
+WallClock::WallClock(hal::NetworkTime &networkTime)
+    : networkTime(networkTime)
+{
+}
+
+void WallClock::begin(hal::FileStorage &storage, const std::string &server)
+{
+    boot = advanceBootCount(storage);
+    networkTime.begin(server.c_str());
+    LOGI("Boot %lu, syncing time from %s\n", static_cast<unsigned long>(boot), server.c_str());
+}
+
+WallTime WallClock::now() const
+{
+    return at(hal::uptimeUs());
+}
+
+WallTime WallClock::at(uint64_t uptimeUs) const
+{
+    hal::NetworkTime::Sample sample;
+    if (!networkTime.lastSync(sample))
+    {
+        return WallTime{};
+    }
+
+    const int64_t epochUs = sample.epochUs + (static_cast<int64_t>(uptimeUs) - static_cast<int64_t>(sample.uptimeUs));
+    const uint64_t syncAgeMs = uptimeUs > sample.uptimeUs ? (uptimeUs - sample.uptimeUs) / 1000 : 0;
+
+    WallTime time;
+    time.epochMs = epochUs > 0 ? static_cast<uint64_t>(epochUs / 1000) : 0;
+    time.quality = syncAgeMs <= FRESH_SYNC_WINDOW_MS ? TimeSyncQuality::Synced : TimeSyncQuality::Stale;
+    return time;
+}
+
+uint32_t WallClock::bootCount() const
+{
+    return boot;
+}
@@ -3,23 +3,30 @@
 #include <cmath>
 
 #include "HardwareConfig.h"
+#include "hal/Clock.h"
 
 namespace
 {
 constexpr unsigned long SLOW_BLINK_INTERVAL_MS = 500;
 constexpr unsigned long FAST_BLINK_INTERVAL_MS = 180;
 constexpr unsigned long FLASH_INTERVAL_MS = 120;
+constexpr float PI_F = 3.14159265F;
+}
+
+LedController::LedController(hal::PwmOutput &pwm)
+    : pwm(pwm)
+{
 }
 
 void LedController::begin()
 {
-    ledcSetup(HardwareConfig::LED_RED_CHANNEL, HardwareConfig::LED_PWM_FREQ, HardwareConfig::LED_PWM_RESOLUTION);
-    ledcSetup(HardwareConfig::LED_YELLOW_CHANNEL, HardwareConfig::LED_PWM_FREQ, HardwareConfig::LED_PWM_RESOLUTION);
-    ledcSetup(HardwareConfig::LED_GREEN_CHANNEL, HardwareConfig::LED_PWM_FREQ, HardwareConfig::LED_PWM_RESOLUTION);
+    pwm.setupChannel(HardwareConfig::LED_RED_CHANNEL, HardwareConfig::LED_PWM_FREQ, HardwareConfig::LED_PWM_RESOLUTION);
+    pwm.setupChannel(HardwareConfig::LED_YELLOW_CHANNEL, HardwareConfig::LED_PWM_FREQ, HardwareConfig::LED_PWM_RESOLUTION);
+    pwm.setupChannel(HardwareConfig::LED_GREEN_CHANNEL, HardwareConfig::LED_PWM_FREQ, HardwareConfig::LED_PWM_RESOLUTION);
 
-    ledcAttachPin(HardwareConfig::LED_RED_PIN, HardwareConfig::LED_RED_CHANNEL);
-    ledcAttachPin(HardwareConfig::LED_YELLOW_PIN, HardwareConfig::LED_YELLOW_CHANNEL);
-    ledcAttachPin(HardwareConfig::LED_GREEN_PIN, HardwareConfig::LED_GREEN_CHANNEL);
+    pwm.attachPin(HardwareConfig::LED_RED_PIN, HardwareConfig::LED_RED_CHANNEL);
+    pwm.attachPin(HardwareConfig::LED_YELLOW_PIN, HardwareConfig::LED_YELLOW_CHANNEL);
+    pwm.attachPin(HardwareConfig::LED_GREEN_PIN, HardwareConfig::LED_GREEN_CHANNEL);
 
     turnOffAll();
 }
@@ -32,13 +39,13 @@ void LedController::setMode(LedMode mode)
     }
 
     currentMode = mode;
-    lastUpdateAt = millis();
+    lastUpdateAt = hal::uptimeMs();
     blinkOn = false;
 }
 
 void LedController::update()
 {
-    const unsigned long now = millis();
+    const uint64_t now = hal::uptimeMs();
 
     switch (currentMode)
     {
@@ -79,7 +86,7 @@ void LedController::update()
     {
         const float phase = static_cast<float>(now % HardwareConfig::LED_SLOW_PULSE_PERIOD) /
                             static_cast<float>(HardwareConfig::LED_SLOW_PULSE_PERIOD);
-        const float intensity = (std::sin(phase * 2.0F * PI - PI / 2.0F) + 1.0F) / 2.0F;
+        const float intensity = (std::sin(phase * 2.0F * PI_F - PI_F / 2.0F) + 1.0F) / 2.0F;
         const uint8_t brightness = static_cast<uint8_t>(
             HardwareConfig::LED_PULSE_MIN_BRIGHTNESS +
             intensity * (HardwareConfig::LED_PULSE_MAX_BRIGHTNESS - HardwareConfig::LED_PULSE_MIN_BRIGHTNESS));
@@ -105,27 +112,49 @@ void LedController::update()
     }
 }
 
+uint64_t LedController::nextUpdateAt(uint64_t now) const
+{
+    switch (currentMode)
+    {
+    case LedMode::BlinkAmberSlow:
+        return lastUpdateAt + SLOW_BLINK_INTERVAL_MS;
+    case LedMode::BlinkAmberFast:
+    case LedMode::BlinkRed:
+        return lastUpdateAt + FAST_BLINK_INTERVAL_MS;
+    case LedMode::FlashGreen:
+    case LedMode::FlashRed:
+        return lastUpdateAt + FLASH_INTERVAL_MS;
+    case LedMode::PulseAmber:
+        return now + HardwareConfig::LED_PULSE_FRAME_INTERVAL;
+    case LedMode::Off:
+    case LedMode::SolidGreen:
+    case LedMode::SolidAmber:
+    default:
+        return now + HardwareConfig::LED_SOLID_UPDATE_INTERVAL;
+    }
+}
+
 void LedController::turnOffAll()
 {
-    ledcWrite(HardwareConfig::LED_RED_CHANNEL, HardwareConfig::LED_OFF);
-    ledcWrite(HardwareConfig::LED_YELLOW_CHANNEL, HardwareConfig::LED_OFF);
-    ledcWrite(HardwareConfig::LED_GREEN_CHANNEL, HardwareConfig::LED_FULL_BRIGHTNESS);
+    pwm.write(HardwareConfig::LED_RED_CHANNEL, HardwareConfig::LED_OFF);
+    pwm.write(HardwareConfig::LED_YELLOW_CHANNEL, HardwareConfig::LED_OFF);
+    pwm.write(HardwareConfig::LED_GREEN_CHANNEL, HardwareConfig::LED_FULL_BRIGHTNESS);
 }
 
 void LedController::setRed(uint8_t brightness)
 {
     turnOffAll();
-    ledcWrite(HardwareConfig::LED_RED_CHANNEL, brightness);
+    pwm.write(HardwareConfig::LED_RED_CHANNEL, brightness);
 }
 
 void LedController::setYellow(uint8_t brightness)
 {
     turnOffAll();
-    ledcWrite(HardwareConfig::LED_YELLOW_CHANNEL, brightness);
+    pwm.write(HardwareConfig::LED_YELLOW_CHANNEL, brightness);
 }
 
 void LedController::setGreen(uint8_t brightness)
 {
     turnOffAll();
-    ledcWrite(HardwareConfig::LED_GREEN_CHANNEL, HardwareConfig::LED_FULL_BRIGHTNESS - brightness);
+    pwm.write(HardwareConfig::LED_GREEN_CHANNEL, HardwareConfig::LED_FULL_BRIGHTNESS - brightness);
 }
@@ -0,0 +1,185 @@
+#include "drivers/LockActuator.h"
+
+#include <algorithm>
+#include <limits>
+
+#include "HardwareConfig.h"
+#include "hal/Clock.h"
+#include "logging/DeferredLog.h"
+#include "metrics/Metrics.h"
+
+namespace
+{
+constexpr LogModule LOG_MODULE = LogModule::Lock;
+
+MetricCounter lockActuations("lock.actuations");
+MetricCounter lockJams("lock.jams");
+MetricCounter lockWatchdogTrips("lock.watchdog_trips");
+MetricHistogram lockActuationTime("lock.actuation_ms");
+}
+
+const char *lockOutcomeName(LockOutcome outcome)
+{
+    switch (outcome)
+    {
+    case LockOutcome::Released:
+        return "released";
+    case LockOutcome::Pulsed:
+        return "pulsed";
+    case LockOutcome::Jammed:
+        return "jammed";
+    case LockOutcome::WatchdogTripped:
+        return "watchdog";
+    }
+    return "unknown";
+}
+
+LockActuator::LockActuator(hal::PulseOutput &coil, hal::DigitalInput *sensor)
+    : coil(coil), sensor(sensor)
+{
+}
+
+bool LockActuator::begin()
+{
+    if (!coil.begin())
+    {
+        LOGE("Lock coil output unavailable\n");
+        return false;
+    }
+    coil.forceRelease();
+
+    if (sensor != nullptr && !sensor->begin())
+    {
+        LOGW("Lock bolt switch unavailable, unlocks will not be confirmed\n");
+        sensor = nullptr;
+    }
+    if (sensor != nullptr && boltOpen())
+    {
+        LOGW("Lock bolt reads open at boot\n");
+    }
+    return true;
+}
+
+bool LockActuator::unlock(uint32_t durationMs)
+{
+    if (pulsing)
+    {
+        return false;
+    }
+
+    const uint32_t pulseMs = std::min(durationMs == 0 ? HardwareConfig::LOCK_DEFAULT_PULSE_MS : durationMs,
+                                      HardwareConfig::LOCK_MAX_PULSE_MS);
+    startedAtUs = hal::uptimeUs();
+    if (!coil.start(pulseMs * 1000))
+    {
+        LOGE("Lock coil pulse did not start\n");
+        return false;
+    }
+    pulsing = true;
+    ++pulseCount;
+    pulseUs = pulseMs * 1000;
+    openedAtUs = 0;
+    lockActuations.increment();
+    return true;
+}
+
+bool LockActuator::busy() const
+{
+    return pulsing;
+}
+
+uint32_t LockActuator::lastPulse() const
+{
+    return pulseCount;
+}
+
+std::optional<LockActuation> LockActuator::poll()
+{
+    if (!pulsing)
+    {
+        return std::nullopt;
+    }
+
+    // Read before checking the coil, so a bolt that opened in the pulse's
+    // last moments still counts.
+    const uint64_t now = hal::uptimeUs();
+    if (sensor != nullptr && openedAtUs == 0 && boltOpen())
+    {
+        openedAtUs = now;
+    }
+
+    if (!coil.active())
+    {
+        if (sensor == nullptr)
+        {
+            return finish(LockOutcome::Pulsed, coil.releasedAtUs());
+        }
+        return finish(openedAtUs != 0 ? LockOutcome::Released : LockOutcome::Jammed, coil.releasedAtUs());
+    }
+
+    if (now >= startedAtUs + pulseUs + HardwareConfig::LOCK_WATCHDOG_MARGIN_MS * 1000ULL)
+    {
+        coil.forceRelease();
+        lockWatchdogTrips.increment();
+        LOGE("Lock coil still energized %lu ms after its pulse, forced off\n",
+             static_cast<unsigned long>((now - startedAtUs - pulseUs) / 1000));
+        return finish(LockOutcome::WatchdogTripped, now);
+    }
+    return std::nullopt;
+}
+
+uint64_t LockActuator::nextPollAt() const
+{
+    if (!pulsing)
+    {
+        return std::numeric_limits<uint64_t>::max();
+    }
+
+    const uint64_t now = hal::uptimeMs();
+    const uint64_t endsAt = (startedAtUs + pulseUs + 999) / 1000;
+    if (now < endsAt)
+    {
+        // The switch is sampled until it opens.
+        return sensor != nullptr && openedAtUs == 0 ? std::min(now + HardwareConfig::LOCK_SENSOR_POLL_MS, endsAt) : endsAt;
+    }
+    // The timer is late; keep looking until the watchdog cuts the pulse.
+    return std::min(now + HardwareConfig::LOCK_SENSOR_POLL_MS, endsAt + HardwareConfig::LOCK_WATCHDOG_MARGIN_MS);
+}
+
+bool LockActuator::boltOpen()
+{
+    return sensor->read() != HardwareConfig::LOCK_SENSOR_LOCKED_LEVEL;
+}
+
+LockActuation LockActuator::finish(LockOutcome outcome, uint64_t releasedAtUs)
+{
+    pulsing = false;
+
+    LockActuation actuation;
+    actuation.pulse = pulseCount;
+    actuation.outcome = outcome;
+    actuation.pulseMs = static_cast<uint32_t>((releasedAtUs - startedAtUs) / 1000);
+    if (outcome == LockOutcome::Released)
+    {
+        actuation.actuationMs = static_cast<uint32_t>((openedAtUs - startedAtUs) / 1000);
+    }
+    else if (outcome == LockOutcome::Pulsed)
+    {
+        actuation.actuationMs = actuation.pulseMs;
+    }
+
+    if (outcome == LockOutcome::Released || outcome == LockOutcome::Pulsed)
+    {
+        lockActuationTime.record(actuation.actuationMs);
+        LOGI("Lock %s after %lu ms, coil on for %lu ms\n",
+             lockOutcomeName(outcome),
+             static_cast<unsigned long>(actuation.actuationMs),
+             static_cast<unsigned long>(actuation.pulseMs));
+    }
+    else if (outcome == LockOutcome::Jammed)
+    {
+        lockJams.increment();
+        LOGE("Lock bolt did not open during a %lu ms pulse\n", static_cast<unsigned long>(actuation.pulseMs));
+    }
+    return actuation;
+}
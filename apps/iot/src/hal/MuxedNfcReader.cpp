@@ -0,0 +1,51 @@
+#include "hal/MuxedNfcReader.h"
+
+namespace hal
+{
+MuxedNfcReader::MuxedNfcReader(NfcReader &reader, I2CMux &mux, uint8_t channel)
+    : reader(reader), mux(mux), channel(channel)
+{
+}
+
+void MuxedNfcReader::begin()
+{
+    if (mux.select(channel))
+    {
+        reader.begin();
+    }
+}
+
+uint32_t MuxedNfcReader::firmwareVersion()
+{
+    return mux.select(channel) ? reader.firmwareVersion() : 0;
+}
+
+bool MuxedNfcReader::configureSam()
+{
+    return mux.select(channel) && reader.configureSam();
+}
+
+uint8_t MuxedNfcReader::listPassiveTargets(CardProtocol protocol,
+                                           PassiveTarget *targets,
+                                           uint8_t maxTargets,
+                                           uint16_t timeoutMs)
+{
+    return mux.select(channel) ? reader.listPassiveTargets(protocol, targets, maxTargets, timeoutMs) : 0;
+}
+
+bool MuxedNfcReader::powerDown()
+{
+    return mux.select(channel) && reader.powerDown();
+}
+
+bool MuxedNfcReader::wakeUp()
+{
+    return mux.select(channel) && reader.wakeUp();
+}
+
+void MuxedNfcReader::onIrq(IrqCallback callback, void *argument)
+{
+    // The IRQ line is wired per reader, not through the mux.
+    reader.onIrq(callback, argument);
+}
+} // namespace hal
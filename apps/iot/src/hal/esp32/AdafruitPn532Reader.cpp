@@ -0,0 +1,365 @@
+#include "hal/esp32/AdafruitPn532Reader.h"
+
+#include <algorithm>
+
+namespace hal
+{
+namespace
+{
+constexpr uint8_t PN532_COMMAND_POWER_DOWN = 0x16;
+constexpr uint8_t PN532_COMMAND_IN_LIST_PASSIVE_TARGET = 0x4A;
+// InListPassiveTarget BrTy values.
+constexpr uint8_t BRTY_ISO14443A_106 = 0x00;
+constexpr uint8_t BRTY_FELICA_212 = 0x01;
+constexpr uint8_t BRTY_ISO14443B_106 = 0x03;
+constexpr uint8_t PN532_PN532_TO_HOST = 0xD5;
+constexpr uint8_t PN532_STATUS_READY = 0x01;
+constexpr uint8_t PN532_SPI_STATUS_READ = 0x02;
+constexpr uint8_t PN532_SPI_DATA_READ = 0x03;
+constexpr uint32_t PN532_SPI_CLOCK_HZ = 1000000;
+// Preamble, start code, LEN, LCS, TFI and command code come before the
+// data; DCS and the postamble after it.
+constexpr size_t FRAME_HEADER_LENGTH = 7;
+// Two targets with 10-byte UIDs and ATS, with room to spare.
+constexpr size_t RESPONSE_FRAME_LENGTH = 96;
+// SEL_RES bit for cards that speak ISO14443-4; their entry carries an ATS.
+constexpr uint8_t SEL_RES_ISO14443_4 = 0x20;
+// FeliCa POLLING for any system code, without a request code, in one time
+// slot.
+constexpr uint8_t FELICA_POLLING[] = {0x00, 0xFF, 0xFF, 0x00, 0x00};
+constexpr uint8_t FELICA_IDM_LENGTH = 8;
+// Type B REQB for every application family (AFI 0).
+constexpr uint8_t ISO14443B_AFI_ANY = 0x00;
+// ATQB: 0x50, the 4-byte PUPI, application data (4) and protocol info (3).
+constexpr size_t ATQB_LENGTH = 12;
+constexpr uint8_t PUPI_LENGTH = 4;
+// WakeUpEnable bits, PN532 user manual 7.2.11.
+constexpr uint8_t WAKE_ON_RF = 0x08;
+constexpr uint8_t WAKE_ON_SPI = 0x20;
+constexpr uint8_t WAKE_ON_I2C = 0x80;
+constexpr uint8_t GENERATE_IRQ = 0x01;
+// The chip restarts its oscillator before it takes a command.
+constexpr unsigned long WAKE_UP_DELAY_MS = 2;
+// The PowerDown reply is sent before the chip goes to sleep and carries
+// only a status byte, 0 when the command was accepted.
+constexpr uint16_t POWER_DOWN_REPLY_TIMEOUT_MS = 10;
+constexpr size_t POWER_DOWN_REPLY_LENGTH = FRAME_HEADER_LENGTH + 1 + 2;
+// The low six bits of a status byte are the error code.
+constexpr uint8_t STATUS_ERROR_MASK = 0x3F;
+
+// InListPassiveTarget data starts with NbTg; each target entry then starts
+// with its Tg. A target that runs past the end is dropped.
+
+// Type A entries: SENS_RES (2), SEL_RES, NFCIDLength, NFCID and, for
+// ISO14443-4 cards, the ATS.
+uint8_t parseTypeATargets(const uint8_t *data, size_t length, PassiveTarget *targets, uint8_t maxTargets)
+{
+    const uint8_t reported = data[0];
+    size_t offset = 1;
+    uint8_t parsed = 0;
+    while (parsed < reported && parsed < maxTargets && offset + 5 <= length)
+    {
+        const uint8_t selRes = data[offset + 3];
+        const uint8_t uidLength = data[offset + 4];
+        offset += 5;
+        if (uidLength > PassiveTarget::MAX_UID_LENGTH || offset + uidLength > length)
+        {
+            break;
+        }
+        std::copy_n(data + offset, uidLength, targets[parsed].uid);
+        targets[parsed].uidLength = uidLength;
+        targets[parsed].protocol = CardProtocol::Iso14443A;
+        offset += uidLength;
+        if ((selRes & SEL_RES_ISO14443_4) != 0)
+        {
+            if (offset >= length || data[offset] == 0)
+            {
+                break;
+            }
+            // The ATS length byte counts itself.
+            offset += data[offset];
+        }
+        ++parsed;
+    }
+    return parsed;
+}
+
+// Type B entries: ATQB, then the ATTRIB_RES with its length byte first.
+uint8_t parseTypeBTargets(const uint8_t *data, size_t length, PassiveTarget *targets, uint8_t maxTargets)
+{
+    const uint8_t reported = data[0];
+    size_t offset = 1;
+    uint8_t parsed = 0;
+    while (parsed < reported && parsed < maxTargets && offset + 1 + ATQB_LENGTH + 1 <= length)
+    {
+        // Past Tg and the ATQB's leading 0x50.
+        std::copy_n(data + offset + 2, PUPI_LENGTH, targets[parsed].uid);
+        targets[parsed].uidLength = PUPI_LENGTH;
+        targets[parsed].protocol = CardProtocol::Iso14443B;
+        offset += 1 + ATQB_LENGTH;
+        offset += 1 + data[offset];
+        if (offset > length)
+        {
+            break;
+        }
+        ++parsed;
+    }
+    return parsed;
+}
+
+// FeliCa entries: the POLLING response, whose length byte counts itself,
+// then response code 0x01, the IDm, PMm (8) and the system code if asked.
+uint8_t parseFeliCaTargets(const uint8_t *data, size_t length, PassiveTarget *targets, uint8_t maxTargets)
+{
+    const uint8_t reported = data[0];
+    size_t offset = 1;
+    uint8_t parsed = 0;
+    while (parsed < reported && parsed < maxTargets && offset + 2 <= length)
+    {
+        const uint8_t responseLength = data[offset + 1];
+        if (responseLength < 2 + FELICA_IDM_LENGTH || offset + 1 + responseLength > length)
+        {
+            break;
+        }
+        std::copy_n(data + offset + 3, FELICA_IDM_LENGTH, targets[parsed].uid);
+        targets[parsed].uidLength = FELICA_IDM_LENGTH;
+        targets[parsed].protocol = CardProtocol::FeliCa;
+        offset += 1 + responseLength;
+        ++parsed;
+    }
+    return parsed;
+}
+
+uint8_t parseTargets(CardProtocol protocol,
+                     const uint8_t *data,
+                     size_t length,
+                     PassiveTarget *targets,
+                     uint8_t maxTargets)
+{
+    if (length == 0)
+    {
+        return 0;
+    }
+    switch (protocol)
+    {
+    case CardProtocol::Iso14443A:
+        return parseTypeATargets(data, length, targets, maxTargets);
+    case CardProtocol::Iso14443B:
+        return parseTypeBTargets(data, length, targets, maxTargets);
+    case CardProtocol::FeliCa:
+        return parseFeliCaTargets(data, length, targets, maxTargets);
+    }
+    return 0;
+}
+
+// Checks the normal information frame and returns where its data starts,
+// or 0 when the frame is not a valid reply to command.
+size_t replyData(const uint8_t *frame, size_t frameLength, uint8_t command, size_t &dataLength)
+{
+    if (frameLength < FRAME_HEADER_LENGTH + 2 || frame[0] != 0x00 || frame[1] != 0x00 || frame[2] != 0xFF)
+    {
+        return 0;
+    }
+    // LEN counts TFI, the command code and the data; LCS makes it sum to 0.
+    const size_t length = frame[3];
+    if (static_cast<uint8_t>(frame[3] + frame[4]) != 0 || length < 2 || 5 + length + 1 > frameLength)
+    {
+        return 0;
+    }
+    if (frame[5] != PN532_PN532_TO_HOST || frame[6] != command + 1)
+    {
+        return 0;
+    }
+    uint8_t checksum = 0;
+    // TFI through DCS sums to 0.
+    for (size_t index = 5; index < 5 + length + 1; ++index)
+    {
+        checksum += frame[index];
+    }
+    if (checksum != 0)
+    {
+        return 0;
+    }
+    dataLength = length - 2;
+    return FRAME_HEADER_LENGTH;
+}
+}
+
+AdafruitPn532Reader::AdafruitPn532Reader(uint8_t irqPin, uint8_t resetPin, TwoWire &wire)
+    : nfc(irqPin, resetPin, &wire), irqPin(irqPin), wire(&wire)
+{
+}
+
+AdafruitPn532Reader::AdafruitPn532Reader(SPIClass &spi, const SpiPins &pins)
+    : nfc(pins.ss, &spi), irqPin(NO_PIN), spi(&spi), spiPins(pins)
+{
+}
+
+void AdafruitPn532Reader::begin()
+{
+    // The library starts the bus on its default pins; an SPIClass that is
+    // already running keeps the ones given here.
+    if (spi != nullptr)
+    {
+        spi->begin(spiPins.sck, spiPins.miso, spiPins.mosi, spiPins.ss);
+    }
+    nfc.begin();
+}
+
+uint32_t AdafruitPn532Reader::firmwareVersion()
+{
+    return nfc.getFirmwareVersion();
+}
+
+bool AdafruitPn532Reader::configureSam()
+{
+    return nfc.SAMConfig();
+}
+
+uint8_t AdafruitPn532Reader::listPassiveTargets(CardProtocol protocol,
+                                                PassiveTarget *targets,
+                                                uint8_t maxTargets,
+                                                uint16_t timeoutMs)
+{
+    uint8_t command[3 + sizeof(FELICA_POLLING)] = {PN532_COMMAND_IN_LIST_PASSIVE_TARGET, maxTargets};
+    size_t commandLength = 3;
+    switch (protocol)
+    {
+    case CardProtocol::Iso14443A:
+        command[2] = BRTY_ISO14443A_106;
+        break;
+    case CardProtocol::Iso14443B:
+        command[2] = BRTY_ISO14443B_106;
+        command[commandLength++] = ISO14443B_AFI_ANY;
+        break;
+    case CardProtocol::FeliCa:
+        command[2] = BRTY_FELICA_212;
+        std::copy_n(FELICA_POLLING, sizeof(FELICA_POLLING), command + commandLength);
+        commandLength += sizeof(FELICA_POLLING);
+        break;
+    }
+    if (!nfc.sendCommandCheckAck(command, static_cast<uint8_t>(commandLength)) || !waitForResponse(timeoutMs))
+    {
+        return 0;
+    }
+
+    uint8_t frame[RESPONSE_FRAME_LENGTH];
+    readResponse(frame, sizeof(frame));
+    size_t dataLength = 0;
+    const size_t dataStart = replyData(frame, sizeof(frame), PN532_COMMAND_IN_LIST_PASSIVE_TARGET, dataLength);
+    if (dataStart == 0)
+    {
+        return 0;
+    }
+    return parseTargets(protocol, frame + dataStart, dataLength, targets, maxTargets);
+}
+
+bool AdafruitPn532Reader::powerDown()
+{
+    uint8_t command[] = {PN532_COMMAND_POWER_DOWN,
+                         static_cast<uint8_t>(WAKE_ON_RF | (spi != nullptr ? WAKE_ON_SPI : WAKE_ON_I2C)),
+                         GENERATE_IRQ};
+    if (!nfc.sendCommandCheckAck(command, sizeof(command)) || !waitForResponse(POWER_DOWN_REPLY_TIMEOUT_MS))
+    {
+        return false;
+    }
+
+    // Left unread, the reply would be taken for the answer to the first
+    // command after wake-up.
+    uint8_t frame[POWER_DOWN_REPLY_LENGTH];
+    readResponse(frame, sizeof(frame));
+    size_t dataLength = 0;
+    const size_t dataStart = replyData(frame, sizeof(frame), PN532_COMMAND_POWER_DOWN, dataLength);
+    return dataStart != 0 && dataLength >= 1 && (frame[dataStart] & STATUS_ERROR_MASK) == 0;
+}
+
+bool AdafruitPn532Reader::wakeUp()
+{
+    if (spi != nullptr)
+    {
+        digitalWrite(spiPins.ss, LOW);
+        delay(WAKE_UP_DELAY_MS);
+        digitalWrite(spiPins.ss, HIGH);
+    }
+    else
+    {
+        // Any frame addressed to the chip wakes it.
+        wire->beginTransmission(PN532_I2C_ADDRESS);
+        wire->endTransmission();
+        delay(WAKE_UP_DELAY_MS);
+    }
+
+    return nfc.getFirmwareVersion() != 0;
+}
+
+bool AdafruitPn532Reader::responseReady()
+{
+    if (spi != nullptr)
+    {
+        spi->beginTransaction(SPISettings(PN532_SPI_CLOCK_HZ, SPI_LSBFIRST, SPI_MODE0));
+        digitalWrite(spiPins.ss, LOW);
+        spi->transfer(PN532_SPI_STATUS_READ);
+        const uint8_t status = spi->transfer(0);
+        digitalWrite(spiPins.ss, HIGH);
+        spi->endTransaction();
+        return (status & PN532_STATUS_READY) != 0;
+    }
+    if (irqPin != NO_PIN)
+    {
+        return digitalRead(irqPin) == LOW;
+    }
+    // Every I2C read starts with the status byte.
+    return wire->requestFrom(static_cast<uint8_t>(PN532_I2C_ADDRESS), static_cast<uint8_t>(1)) == 1 &&
+           (wire->read() & PN532_STATUS_READY) != 0;
+}
+
+bool AdafruitPn532Reader::waitForResponse(uint16_t timeoutMs)
+{
+    // Polled every millisecond, as the library does.
+    for (uint16_t waitedMs = 0; !responseReady(); ++waitedMs)
+    {
+        if (waitedMs >= timeoutMs)
+        {
+            return false;
+        }
+        delay(1);
+    }
+    return true;
+}
+
+void AdafruitPn532Reader::readResponse(uint8_t *frame, size_t length)
+{
+    std::fill_n(frame, length, 0);
+    if (spi != nullptr)
+    {
+        spi->beginTransaction(SPISettings(PN532_SPI_CLOCK_HZ, SPI_LSBFIRST, SPI_MODE0));
+        digitalWrite(spiPins.ss, LOW);
+        spi->transfer(PN532_SPI_DATA_READ);
+        for (size_t index = 0; index < length; ++index)
+        {
+            frame[index] = spi->transfer(0);
+        }
+        digitalWrite(spiPins.ss, HIGH);
+        spi->endTransaction();
+        return;
+    }
+
+    wire->requestFrom(static_cast<uint8_t>(PN532_I2C_ADDRESS), static_cast<uint8_t>(length + 1));
+    // Status byte.
+    wire->read();
+    for (size_t index = 0; index < length && wire->available() > 0; ++index)
+    {
+        frame[index] = static_cast<uint8_t>(wire->read());
+    }
+}
+
+void AdafruitPn532Reader::onIrq(IrqCallback callback, void *argument)
+{
+    if (irqPin == NO_PIN)
+    {
+        return;
+    }
+    pinMode(irqPin, INPUT_PULLUP);
+    attachInterruptArg(digitalPinToInterrupt(irqPin), callback, argument, FALLING);
+}
+} // namespace hal
@@ -0,0 +1,32 @@
+#include "hal/Clock.h"
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+namespace hal
+{
+unsigned long millis()
+{
+    return ::millis();
+}
+
+unsigned long micros()
+{
+    return ::micros();
+}
+
+void delayMs(unsigned long durationMs)
+{
+    ::delay(durationMs);
+}
+
+uint64_t uptimeMs()
+{
+    return uptimeUs() / 1000;
+}
+
+uint64_t uptimeUs()
+{
+    return static_cast<uint64_t>(esp_timer_get_time());
+}
+} // namespace hal
@@ -0,0 +1,22 @@
+#include "hal/esp32/Esp32DigitalInput.h"
+
+#include <Arduino.h>
+
+namespace hal
+{
+Esp32DigitalInput::Esp32DigitalInput(uint8_t pin)
+    : pin(pin)
+{
+}
+
+bool Esp32DigitalInput::begin()
+{
+    pinMode(pin, INPUT_PULLUP);
+    return true;
+}
+
+bool Esp32DigitalInput::read()
+{
+    return digitalRead(pin) == HIGH;
+}
+} // namespace hal
@@ -0,0 +1,42 @@
+#include "hal/esp32/Esp32I2CBus.h"
+
+namespace hal
+{
+Esp32I2CBus::Esp32I2CBus(TwoWire &wire, uint8_t sdaPin, uint8_t sclPin)
+    : wire(wire), sdaPin(sdaPin), sclPin(sclPin)
+{
+}
+
+bool Esp32I2CBus::begin()
+{
+    // Wire forgets both across end(); 0 picks its 100 kHz default.
+    const bool started = wire.begin(sdaPin, sclPin, frequencyHz);
+    if (timeoutMs != 0)
+    {
+        wire.setTimeout(timeoutMs);
+    }
+    return started;
+}
+
+void Esp32I2CBus::end()
+{
+    wire.end();
+}
+
+void Esp32I2CBus::setClock(uint32_t frequency)
+{
+    frequencyHz = frequency;
+    wire.setClock(frequency);
+}
+
+void Esp32I2CBus::setTimeout(uint16_t timeout)
+{
+    timeoutMs = timeout;
+    wire.setTimeout(timeout);
+}
+
+uint32_t Esp32I2CBus::clockHz() const
+{
+    return frequencyHz;
+}
+} // namespace hal
@@ -0,0 +1,39 @@
+#include "hal/esp32/Esp32SerialPort.h"
+
+namespace hal
+{
+Esp32SerialPort::Esp32SerialPort(HardwareSerial &serial)
+    : serial(serial)
+{
+}
+
+void Esp32SerialPort::begin(unsigned long baudRate)
+{
+    serial.begin(baudRate);
+}
+
+int Esp32SerialPort::available()
+{
+    return serial.available();
+}
+
+int Esp32SerialPort::read()
+{
+    return serial.read();
+}
+
+size_t Esp32SerialPort::write(const uint8_t *data, size_t length)
+{
+    return serial.write(data, length);
+}
+
+void Esp32SerialPort::flush()
+{
+    serial.flush();
+}
+
+void Esp32SerialPort::onReceive(std::function<void()> callback)
+{
+    serial.onReceive(std::move(callback));
+}
+} // namespace hal
@@ -0,0 +1,16 @@
+#include "hal/esp32/Esp32System.h"
+
+#include <Arduino.h>
+
+namespace hal
+{
+void Esp32System::restart()
+{
+    ESP.restart();
+}
+
+uint32_t Esp32System::freeHeapBytes() const
+{
+    return ESP.getFreeHeap();
+}
+} // namespace hal
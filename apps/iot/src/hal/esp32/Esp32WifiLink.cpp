@@ -0,0 +1,41 @@
+#include "hal/esp32/Esp32WifiLink.h"
+
+#include <WiFi.h>
+
+namespace hal
+{
+void Esp32WifiLink::startStation()
+{
+    WiFi.mode(WIFI_STA);
+}
+
+void Esp32WifiLink::begin(const char *ssid, const char *password)
+{
+    WiFi.begin(ssid, password);
+}
+
+void Esp32WifiLink::reconnect()
+{
+    WiFi.reconnect();
+}
+
+bool Esp32WifiLink::isConnected() const
+{
+    return WiFi.status() == WL_CONNECTED;
+}
+
+int32_t Esp32WifiLink::rssi() const
+{
+    return WiFi.RSSI();
+}
+
+void Esp32WifiLink::macAddress(uint8_t mac[6]) const
+{
+    WiFi.macAddress(mac);
+}
+
+void Esp32WifiLink::onEvent(std::function<void()> callback)
+{
+    WiFi.onEvent([callback](arduino_event_id_t) { callback(); });
+}
+} // namespace hal
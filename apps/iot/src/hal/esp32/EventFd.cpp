@@ -0,0 +1,22 @@
+#include "hal/EventFd.h"
+
+#include <esp_vfs_eventfd.h>
+
+namespace hal
+{
+int createEventFd()
+{
+    static bool registered = false;
+    if (!registered)
+    {
+        esp_vfs_eventfd_config_t config = ESP_VFS_EVENTD_CONFIG_DEFAULT();
+        if (esp_vfs_eventfd_register(&config) != ESP_OK)
+        {
+            return -1;
+        }
+        registered = true;
+    }
+
+    return eventfd(0, EFD_SUPPORT_ISR);
+}
+} // namespace hal
@@ -0,0 +1,21 @@
+#include "hal/esp32/LedcPwmOutput.h"
+
+#include <Arduino.h>
+
+namespace hal
+{
+void LedcPwmOutput::setupChannel(uint8_t channel, uint32_t frequencyHz, uint8_t resolutionBits)
+{
+    ledcSetup(channel, frequencyHz, resolutionBits);
+}
+
+void LedcPwmOutput::attachPin(uint8_t pin, uint8_t channel)
+{
+    ledcAttachPin(pin, channel);
+}
+
+void LedcPwmOutput::write(uint8_t channel, uint32_t duty)
+{
+    ledcWrite(channel, duty);
+}
+} // namespace hal
@@ -0,0 +1,53 @@
+#include "hal/esp32/PartitionFlashRegion.h"
+
+namespace hal
+{
+PartitionFlashRegion::PartitionFlashRegion(const char *label)
+    : label(label)
+{
+}
+
+bool PartitionFlashRegion::begin()
+{
+    if (mapped != nullptr)
+    {
+        return true;
+    }
+
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (partition == nullptr)
+    {
+        return false;
+    }
+
+    const void *view = nullptr;
+    if (esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &view, &mapHandle) != ESP_OK)
+    {
+        partition = nullptr;
+        return false;
+    }
+    mapped = static_cast<const uint8_t *>(view);
+    return true;
+}
+
+size_t PartitionFlashRegion::size() const
+{
+    return partition != nullptr ? partition->size : 0;
+}
+
+const uint8_t *PartitionFlashRegion::data() const
+{
+    return mapped;
+}
+
+bool PartitionFlashRegion::eraseSector(size_t offset)
+{
+    // The IDF invalidates the cached pages of the range it erases or writes.
+    return partition != nullptr && esp_partition_erase_range(partition, offset, SECTOR_SIZE) == ESP_OK;
+}
+
+bool PartitionFlashRegion::write(size_t offset, const void *bytes, size_t length)
+{
+    return partition != nullptr && esp_partition_write(partition, offset, bytes, length) == ESP_OK;
+}
+} // namespace hal
@@ -0,0 +1,68 @@
+#include "hal/esp32/PubSubMqttTransport.h"
+
+namespace hal
+{
+PubSubMqttTransport::PubSubMqttTransport()
+    : client(wifiClient)
+{
+}
+
+void PubSubMqttTransport::setServer(const char *host, uint16_t port)
+{
+    client.setServer(host, port);
+}
+
+void PubSubMqttTransport::setBufferSize(uint16_t size)
+{
+    client.setBufferSize(size);
+}
+
+void PubSubMqttTransport::setCallback(MessageCallback callback)
+{
+    client.setCallback(std::move(callback));
+}
+
+bool PubSubMqttTransport::connect(const char *clientId, const char *username, const char *password)
+{
+    if (username == nullptr)
+    {
+        return client.connect(clientId);
+    }
+    return client.connect(clientId, username, password);
+}
+
+bool PubSubMqttTransport::connected()
+{
+    return client.connected();
+}
+
+int PubSubMqttTransport::state()
+{
+    return client.state();
+}
+
+bool PubSubMqttTransport::publish(const char *topic, const uint8_t *payload, size_t length, bool retained)
+{
+    return client.publish(topic, payload, static_cast<unsigned int>(length), retained);
+}
+
+bool PubSubMqttTransport::subscribe(const char *topic)
+{
+    return client.subscribe(topic);
+}
+
+bool PubSubMqttTransport::loop()
+{
+    return client.loop();
+}
+
+int PubSubMqttTransport::socketFd() const
+{
+    return wifiClient.fd();
+}
+
+int PubSubMqttTransport::bytesBuffered()
+{
+    return wifiClient.available();
+}
+} // namespace hal
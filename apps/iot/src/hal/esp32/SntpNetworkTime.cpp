@@ -0,0 +1,51 @@
+#include "hal/esp32/SntpNetworkTime.h"
+
+#include <Arduino.h>
+#include <esp_sntp.h>
+#include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+
+namespace
+{
+constexpr uint32_t SYNC_INTERVAL_MS = 60UL * 60UL * 1000UL;
+
+// Written from the lwIP task when a sync lands.
+portMUX_TYPE sampleLock = portMUX_INITIALIZER_UNLOCKED;
+hal::NetworkTime::Sample latestSample;
+bool hasSample = false;
+
+void onTimeSynced(struct timeval *tv)
+{
+    const uint64_t uptimeUs = static_cast<uint64_t>(esp_timer_get_time());
+    const int64_t epochUs = static_cast<int64_t>(tv->tv_sec) * 1000000 + tv->tv_usec;
+
+    portENTER_CRITICAL(&sampleLock);
+    latestSample.epochUs = epochUs;
+    latestSample.uptimeUs = uptimeUs;
+    hasSample = true;
+    portEXIT_CRITICAL(&sampleLock);
+}
+}
+
+namespace hal
+{
+void SntpNetworkTime::begin(const char *server)
+{
+    serverName = server;
+    sntp_set_sync_interval(SYNC_INTERVAL_MS);
+    sntp_set_time_sync_notification_cb(onTimeSynced);
+    // configTime() brings up esp_netif (and with it the lwIP thread) before
+    // it touches SNTP, so this is safe ahead of WiFi.begin(). It restarts a
+    // running client, and leaves TZ at UTC, which is what the samples are in.
+    configTime(0, 0, serverName.c_str());
+}
+
+bool SntpNetworkTime::lastSync(Sample &sample) const
+{
+    portENTER_CRITICAL(&sampleLock);
+    const bool synced = hasSample;
+    sample = latestSample;
+    portEXIT_CRITICAL(&sampleLock);
+    return synced;
+}
+} // namespace hal
@@ -0,0 +1,39 @@
+#include "hal/esp32/SpiffsFileStorage.h"
+
+#include <SPIFFS.h>
+
+namespace hal
+{
+bool SpiffsFileStorage::mount()
+{
+    return SPIFFS.begin(true);
+}
+
+bool SpiffsFileStorage::readFile(const char *path, std::string &contents)
+{
+    File file = SPIFFS.open(path);
+    if (!file)
+    {
+        return false;
+    }
+
+    contents.resize(file.size());
+    const size_t bytesRead = file.read(reinterpret_cast<uint8_t *>(contents.data()), contents.size());
+    contents.resize(bytesRead);
+    file.close();
+    return true;
+}
+
+bool SpiffsFileStorage::writeFile(const char *path, std::string_view contents)
+{
+    File file = SPIFFS.open(path, FILE_WRITE, true);
+    if (!file)
+    {
+        return false;
+    }
+
+    const size_t written = file.write(reinterpret_cast<const uint8_t *>(contents.data()), contents.size());
+    file.close();
+    return written == contents.size();
+}
+} // namespace hal
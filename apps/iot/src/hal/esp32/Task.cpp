@@ -0,0 +1,28 @@
+#include "hal/Task.h"
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+namespace hal
+{
+TaskHandle *startTask(const TaskSpec &spec, TaskEntry entry, void *argument)
+{
+    TaskHandle_t handle = nullptr;
+    const BaseType_t core = spec.core < 0 ? tskNO_AFFINITY : spec.core;
+    if (xTaskCreatePinnedToCore(entry, spec.name, spec.stackBytes, argument, spec.priority, &handle, core) != pdPASS)
+    {
+        return nullptr;
+    }
+    return reinterpret_cast<TaskHandle *>(handle);
+}
+
+void notifyTask(TaskHandle *task)
+{
+    xTaskNotifyGive(reinterpret_cast<TaskHandle_t>(task));
+}
+
+bool waitForNotification(unsigned long timeoutMs)
+{
+    return ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeoutMs)) > 0;
+}
+} // namespace hal
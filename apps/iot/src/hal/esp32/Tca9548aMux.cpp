@@ -0,0 +1,23 @@
+#include "hal/esp32/Tca9548aMux.h"
+
+namespace hal
+{
+Tca9548aMux::Tca9548aMux(TwoWire &wire, uint8_t address)
+    : wire(wire), address(address)
+{
+}
+
+bool Tca9548aMux::select(uint8_t channel)
+{
+    if (channel >= CHANNEL_COUNT)
+    {
+        return false;
+    }
+
+    // Not cached: a switch that browned out would otherwise leave a bay
+    // reading its neighbour's cards. It is one byte against a 75 ms scan.
+    wire.beginTransmission(address);
+    wire.write(static_cast<uint8_t>(1u << channel));
+    return wire.endTransmission() == 0;
+}
+} // namespace hal
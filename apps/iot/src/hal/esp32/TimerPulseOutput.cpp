@@ -0,0 +1,130 @@
+#include "hal/esp32/TimerPulseOutput.h"
+
+#include <esp_intr_alloc.h>
+#include <esp_timer.h>
+#include <soc/gpio_struct.h>
+
+namespace hal
+{
+namespace
+{
+// 80 MHz APB clock divided down to one tick per microsecond.
+constexpr uint16_t TIMER_DIVIDER = 80;
+constexpr uint8_t MAX_REGISTER_PIN = 31;
+}
+
+TimerPulseOutput *TimerPulseOutput::instance = nullptr;
+
+TimerPulseOutput::TimerPulseOutput(uint8_t pin, bool activeHigh, uint8_t timerNumber)
+    : pin(pin), pinMask(pin <= MAX_REGISTER_PIN ? 1UL << pin : 0), activeHigh(activeHigh), timerNumber(timerNumber)
+{
+}
+
+bool TimerPulseOutput::begin()
+{
+    if (pinMask == 0 || (instance != nullptr && instance != this))
+    {
+        return false;
+    }
+
+    // Released before the pin becomes an output, so it never glitches active.
+    if (activeHigh)
+    {
+        GPIO.out_w1tc = pinMask;
+    }
+    else
+    {
+        GPIO.out_w1ts = pinMask;
+    }
+    pinMode(pin, OUTPUT);
+
+    if (timer == nullptr)
+    {
+        timer = timerBegin(timerNumber, TIMER_DIVIDER, true);
+        if (timer == nullptr)
+        {
+            return false;
+        }
+        instance = this;
+        // IRAM-allocated, so the alarm is still serviced while a flash write
+        // has the cache off. The ESP32 timers only raise level interrupts.
+        timerAttachInterruptFlag(timer, &TimerPulseOutput::onAlarm, false, ESP_INTR_FLAG_IRAM);
+    }
+    return true;
+}
+
+bool TimerPulseOutput::start(uint32_t durationUs)
+{
+    if (timer == nullptr || running.load(std::memory_order_acquire))
+    {
+        return false;
+    }
+
+    releasedAt = 0;
+    running.store(true, std::memory_order_release);
+    timerWrite(timer, 0);
+    timerAlarmWrite(timer, durationUs, false);
+    if (activeHigh)
+    {
+        GPIO.out_w1ts = pinMask;
+    }
+    else
+    {
+        GPIO.out_w1tc = pinMask;
+    }
+    timerAlarmEnable(timer);
+    return true;
+}
+
+bool TimerPulseOutput::active()
+{
+    return running.load(std::memory_order_acquire);
+}
+
+uint64_t TimerPulseOutput::releasedAtUs()
+{
+    return running.load(std::memory_order_acquire) ? 0 : releasedAt;
+}
+
+void TimerPulseOutput::forceRelease()
+{
+    if (timer != nullptr)
+    {
+        timerAlarmDisable(timer);
+    }
+    if (activeHigh)
+    {
+        GPIO.out_w1tc = pinMask;
+    }
+    else
+    {
+        GPIO.out_w1ts = pinMask;
+    }
+    if (running.load(std::memory_order_acquire))
+    {
+        releasedAt = static_cast<uint64_t>(esp_timer_get_time());
+        running.store(false, std::memory_order_release);
+    }
+}
+
+void HAL_ISR_ATTR TimerPulseOutput::onAlarm()
+{
+    TimerPulseOutput *output = instance;
+    if (output == nullptr || !output->running.load(std::memory_order_acquire))
+    {
+        return;
+    }
+
+    // One-shot: the alarm disarms itself once it has fired.
+    if (output->activeHigh)
+    {
+        GPIO.out_w1tc = output->pinMask;
+    }
+    else
+    {
+        GPIO.out_w1ts = output->pinMask;
+    }
+    output->releasedAt = static_cast<uint64_t>(esp_timer_get_time());
+    output->running.store(false, std::memory_order_release);
+}
+} // namespace hal
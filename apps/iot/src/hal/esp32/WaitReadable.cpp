@@ -0,0 +1,37 @@
+#include "hal/WaitReadable.h"
+
+#include <sys/select.h>
+
+namespace hal
+{
+int waitReadable(const int *fds, bool *readable, size_t count, unsigned long timeoutMs)
+{
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    int highestFd = -1;
+    for (size_t index = 0; index < count; ++index)
+    {
+        readable[index] = false;
+        if (fds[index] >= 0)
+        {
+            FD_SET(fds[index], &readSet);
+            highestFd = fds[index] > highestFd ? fds[index] : highestFd;
+        }
+    }
+
+    timeval timeout{};
+    timeout.tv_sec = static_cast<long>(timeoutMs / 1000);
+    timeout.tv_usec = static_cast<long>((timeoutMs % 1000) * 1000);
+
+    const int ready = select(highestFd + 1, &readSet, nullptr, nullptr, &timeout);
+    if (ready <= 0)
+    {
+        return ready;
+    }
+    for (size_t index = 0; index < count; ++index)
+    {
+        readable[index] = fds[index] >= 0 && FD_ISSET(fds[index], &readSet);
+    }
+    return ready;
+}
+} // namespace hal
@@ -0,0 +1,85 @@
+#include "hal/Clock.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "hal/native/VirtualClock.h"
+
+namespace
+{
+const std::chrono::steady_clock::time_point processStart = std::chrono::steady_clock::now();
+
+std::atomic<bool> virtualTime{false};
+std::atomic<uint64_t> virtualNowUs{0};
+
+uint64_t wallClockUs()
+{
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - processStart).count());
+}
+}
+
+namespace hal
+{
+unsigned long millis()
+{
+    return static_cast<unsigned long>(VirtualClock::nowUs() / 1000);
+}
+
+unsigned long micros()
+{
+    return static_cast<unsigned long>(VirtualClock::nowUs());
+}
+
+uint64_t uptimeMs()
+{
+    return VirtualClock::nowUs() / 1000;
+}
+
+uint64_t uptimeUs()
+{
+    return VirtualClock::nowUs();
+}
+
+void delayMs(unsigned long durationMs)
+{
+    if (virtualTime.load(std::memory_order_relaxed))
+    {
+        VirtualClock::advanceMs(durationMs);
+        return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(durationMs));
+}
+
+void VirtualClock::enable(uint64_t startUs)
+{
+    virtualNowUs.store(startUs, std::memory_order_relaxed);
+    virtualTime.store(true, std::memory_order_release);
+}
+
+void VirtualClock::disable()
+{
+    virtualTime.store(false, std::memory_order_release);
+}
+
+bool VirtualClock::isEnabled()
+{
+    return virtualTime.load(std::memory_order_acquire);
+}
+
+void VirtualClock::advanceMs(unsigned long durationMs)
+{
+    advanceUs(static_cast<uint64_t>(durationMs) * 1000);
+}
+
+void VirtualClock::advanceUs(uint64_t durationUs)
+{
+    virtualNowUs.fetch_add(durationUs, std::memory_order_relaxed);
+}
+
+uint64_t VirtualClock::nowUs()
+{
+    return virtualTime.load(std::memory_order_acquire) ? virtualNowUs.load(std::memory_order_relaxed) : wallClockUs();
+}
+} // namespace hal
@@ -0,0 +1,11 @@
+#include "hal/EventFd.h"
+
+#include <sys/eventfd.h>
+
+namespace hal
+{
+int createEventFd()
+{
+    return eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+} // namespace hal
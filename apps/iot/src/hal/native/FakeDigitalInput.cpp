@@ -0,0 +1,45 @@
+#include "hal/native/FakeDigitalInput.h"
+
+#include "hal/Clock.h"
+
+namespace hal
+{
+bool FakeDigitalInput::begin()
+{
+    return true;
+}
+
+bool FakeDigitalInput::read()
+{
+    if (coil == nullptr || jammed)
+    {
+        return level;
+    }
+
+    const uint64_t now = uptimeUs();
+    const uint64_t releasedAt = coil->releasedAtUs();
+    const bool opened = coil->pulses > 0 && now >= coil->startedAtUs() + travelUs &&
+                        (releasedAt == 0 || now < releasedAt + travelUs) &&
+                        (releasedAt == 0 || releasedAt >= coil->startedAtUs() + travelUs);
+    level = opened ? !lockedLevel : lockedLevel;
+    return level;
+}
+
+void FakeDigitalInput::setLevel(bool high)
+{
+    level = high;
+}
+
+void FakeDigitalInput::followBolt(FakePulseOutput &pulseOutput, uint32_t boltTravelUs, bool boltLockedLevel)
+{
+    coil = &pulseOutput;
+    travelUs = boltTravelUs;
+    lockedLevel = boltLockedLevel;
+    level = boltLockedLevel;
+}
+
+void FakeDigitalInput::setJammed(bool stuck)
+{
+    jammed = stuck;
+}
+} // namespace hal
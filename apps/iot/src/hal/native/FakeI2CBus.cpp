@@ -0,0 +1,49 @@
+#include "hal/native/FakeI2CBus.h"
+
+namespace hal
+{
+bool FakeI2CBus::begin()
+{
+    if (!running)
+    {
+        ++restarts;
+    }
+    running = true;
+    return true;
+}
+
+void FakeI2CBus::end()
+{
+    running = false;
+}
+
+void FakeI2CBus::setClock(uint32_t frequency)
+{
+    frequencyHz = frequency;
+}
+
+void FakeI2CBus::setTimeout(uint16_t timeoutMs)
+{
+    timeout = timeoutMs;
+}
+
+bool FakeI2CBus::isRunning() const
+{
+    return running;
+}
+
+uint32_t FakeI2CBus::restartCount() const
+{
+    return restarts;
+}
+
+uint32_t FakeI2CBus::clockHz() const
+{
+    return frequencyHz;
+}
+
+uint16_t FakeI2CBus::timeoutMs() const
+{
+    return timeout;
+}
+} // namespace hal
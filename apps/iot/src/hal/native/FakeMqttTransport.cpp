@@ -0,0 +1,176 @@
+#include "hal/native/FakeMqttTransport.h"
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <cstring>
+
+namespace hal
+{
+namespace
+{
+// PubSubClient state codes.
+constexpr int MQTT_CONNECTION_TIMEOUT = -4;
+constexpr int MQTT_DISCONNECTED = -1;
+constexpr int MQTT_CONNECTED = 0;
+// Fixed header, topic length prefix and a 4 byte remaining length.
+constexpr size_t PUBLISH_OVERHEAD = 7;
+}
+
+FakeMqttTransport::FakeMqttTransport()
+    : readyFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+{
+}
+
+FakeMqttTransport::~FakeMqttTransport()
+{
+    if (readyFd >= 0)
+    {
+        close(readyFd);
+    }
+}
+
+void FakeMqttTransport::setServer(const char *host, uint16_t port)
+{
+}
+
+void FakeMqttTransport::setBufferSize(uint16_t size)
+{
+    bufferSize = size;
+}
+
+void FakeMqttTransport::setCallback(MessageCallback messageCallback)
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    callback = std::move(messageCallback);
+}
+
+bool FakeMqttTransport::connect(const char *clientId, const char *username, const char *password)
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    sessionUp = brokerReachable;
+    subscriptions.clear();
+    return sessionUp;
+}
+
+bool FakeMqttTransport::connected()
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    return sessionUp;
+}
+
+int FakeMqttTransport::state()
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    if (sessionUp)
+    {
+        return MQTT_CONNECTED;
+    }
+    return brokerReachable ? MQTT_DISCONNECTED : MQTT_CONNECTION_TIMEOUT;
+}
+
+bool FakeMqttTransport::publish(const char *topic, const uint8_t *payload, size_t length, bool retained)
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    if (!sessionUp || PUBLISH_OVERHEAD + strlen(topic) + length > bufferSize)
+    {
+        return false;
+    }
+    published.push_back(Message{topic, std::string(reinterpret_cast<const char *>(payload), length), retained});
+    return true;
+}
+
+bool FakeMqttTransport::subscribe(const char *topic)
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    if (!sessionUp)
+    {
+        return false;
+    }
+    subscriptions.insert(topic);
+    return true;
+}
+
+bool FakeMqttTransport::loop()
+{
+    Message message;
+    MessageCallback messageCallback;
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        if (!sessionUp)
+        {
+            return false;
+        }
+        if (inbound.empty())
+        {
+            return true;
+        }
+        message = std::move(inbound.front());
+        inbound.pop_front();
+        updateReadiness();
+        if (subscriptions.count(message.topic) == 0 || !callback)
+        {
+            return true;
+        }
+        messageCallback = callback;
+    }
+
+    messageCallback(message.topic.data(),
+                    reinterpret_cast<uint8_t *>(message.payload.data()),
+                    static_cast<unsigned int>(message.payload.size()));
+    return true;
+}
+
+int FakeMqttTransport::socketFd() const
+{
+    return readyFd;
+}
+
+int FakeMqttTransport::bytesBuffered()
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    return inbound.empty() ? 0 : static_cast<int>(inbound.front().payload.size());
+}
+
+void FakeMqttTransport::setBrokerReachable(bool reachable)
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    brokerReachable = reachable;
+    if (!reachable)
+    {
+        sessionUp = false;
+    }
+}
+
+void FakeMqttTransport::deliver(std::string_view topic, std::string_view payload)
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    inbound.push_back(Message{std::string(topic), std::string(payload), false});
+    updateReadiness();
+}
+
+std::vector<FakeMqttTransport::Message> FakeMqttTransport::takePublished()
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Message> taken;
+    taken.swap(published);
+    return taken;
+}
+
+// Level triggered like a socket: readable exactly while a message waits.
+void FakeMqttTransport::updateReadiness()
+{
+    if (readyFd < 0)
+    {
+        return;
+    }
+
+    uint64_t counter = 0;
+    (void)read(readyFd, &counter, sizeof(counter));
+    if (!inbound.empty())
+    {
+        counter = 1;
+        (void)write(readyFd, &counter, sizeof(counter));
+    }
+}
+} // namespace hal
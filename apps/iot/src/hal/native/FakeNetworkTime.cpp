@@ -0,0 +1,33 @@
+#include "hal/native/FakeNetworkTime.h"
+
+#include "hal/Clock.h"
+
+namespace hal
+{
+void FakeNetworkTime::begin(const char *server)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    serverName = server;
+}
+
+bool FakeNetworkTime::lastSync(Sample &sample) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    sample = latestSample;
+    return hasSample;
+}
+
+void FakeNetworkTime::completeSync(int64_t epochMs)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    latestSample.epochUs = epochMs * 1000;
+    latestSample.uptimeUs = uptimeUs();
+    hasSample = true;
+}
+
+std::string FakeNetworkTime::server() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return serverName;
+}
+} // namespace hal
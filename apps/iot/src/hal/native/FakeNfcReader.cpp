@@ -0,0 +1,295 @@
+#include "hal/native/FakeNfcReader.h"
+
+#include <algorithm>
+
+#include "hal/Clock.h"
+#include "hal/native/FakeI2CBus.h"
+
+namespace hal
+{
+namespace
+{
+// Used for BusHang when no bus is attached; matches NFCManager's setting.
+constexpr unsigned long DEFAULT_BUS_TIMEOUT_MS = 50;
+constexpr uint32_t SLOW_BUS_MAX_CLOCK_HZ = 100000;
+// Transactions a MarginalFastBus chip answers after each bus restart.
+constexpr uint32_t MARGINAL_TRANSACTIONS_PER_RESTART = 16;
+}
+
+void FakeNfcReader::begin()
+{
+    // Adafruit_PN532::begin() only wakes the chip; the result is not checked.
+    transact();
+}
+
+uint32_t FakeNfcReader::firmwareVersion()
+{
+    return transact() ? PN532_FIRMWARE_VERSION : 0;
+}
+
+bool FakeNfcReader::configureSam()
+{
+    return transact();
+}
+
+uint8_t FakeNfcReader::listPassiveTargets(CardProtocol protocol,
+                                          PassiveTarget *targets,
+                                          uint8_t maxTargets,
+                                          uint16_t timeoutMs)
+{
+    const bool answered = transact();
+
+    unsigned long scanCostMs = 0;
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        ++scans;
+        if (!answered)
+        {
+            return 0;
+        }
+        const bool answering = std::any_of(cards.begin(), cards.end(), [protocol](const Card &card)
+                                           { return card.protocol == protocol; });
+        scanCostMs = answering ? scanWithCardMs : std::min<unsigned long>(scanEmptyFieldMs, timeoutMs);
+    }
+    // The field is sampled after the scan time has passed so a card
+    // presented mid-scan is seen, like the reader polling the RF field.
+    if (scanCostMs > 0)
+    {
+        delayMs(scanCostMs);
+    }
+
+    const std::lock_guard<std::mutex> lock(mutex);
+    uint8_t count = 0;
+    for (const Card &card : cards)
+    {
+        if (count == maxTargets)
+        {
+            break;
+        }
+        if (card.protocol != protocol)
+        {
+            continue;
+        }
+        const size_t length = std::min<size_t>(card.uid.size(), PassiveTarget::MAX_UID_LENGTH);
+        std::copy_n(card.uid.begin(), length, targets[count].uid);
+        targets[count].uidLength = static_cast<uint8_t>(length);
+        targets[count].protocol = protocol;
+        ++count;
+    }
+    return count;
+}
+
+bool FakeNfcReader::powerDown()
+{
+    if (!transact())
+    {
+        return false;
+    }
+    const std::lock_guard<std::mutex> lock(mutex);
+    poweredDown = true;
+    poweredDownSince = millis();
+    return true;
+}
+
+bool FakeNfcReader::wakeUp()
+{
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        leavePowerDownLocked();
+    }
+    return transact();
+}
+
+void FakeNfcReader::onIrq(IrqCallback callback, void *argument)
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    irqCallback = callback;
+    irqArgument = argument;
+}
+
+void FakeNfcReader::attachBus(const FakeI2CBus &i2cBus)
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    bus = &i2cBus;
+}
+
+void FakeNfcReader::presentCard(const std::vector<uint8_t> &uid, CardProtocol protocol)
+{
+    IrqCallback callback;
+    void *argument;
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        cards.assign(1, Card{uid, protocol});
+        callback = irqCallback;
+        argument = irqArgument;
+    }
+    if (callback != nullptr)
+    {
+        callback(argument);
+    }
+}
+
+void FakeNfcReader::addCard(const std::vector<uint8_t> &uid, CardProtocol protocol)
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    cards.push_back(Card{uid, protocol});
+}
+
+void FakeNfcReader::removeCard()
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    cards.clear();
+}
+
+void FakeNfcReader::injectFault(Fault newFault)
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    fault = newFault;
+    marginalAtRestart = bus != nullptr ? bus->restartCount() : 0;
+    marginalAnswered = 0;
+}
+
+void FakeNfcReader::clearFault()
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    fault = Fault::None;
+    wedged = false;
+}
+
+void FakeNfcReader::failEveryNthTransaction(uint32_t n)
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    failEvery = n;
+}
+
+void FakeNfcReader::setScanTiming(unsigned long withCardMs, unsigned long emptyFieldMs)
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    scanWithCardMs = withCardMs;
+    scanEmptyFieldMs = emptyFieldMs;
+}
+
+bool FakeNfcReader::isAnswering() const
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    return answeringLocked();
+}
+
+uint32_t FakeNfcReader::scanCount() const
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    return scans;
+}
+
+uint32_t FakeNfcReader::transactionCount() const
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    return transactions;
+}
+
+uint32_t FakeNfcReader::stoppedBusTransactionCount() const
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    return stoppedBusTransactions;
+}
+
+unsigned long FakeNfcReader::stalledMs() const
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    return stalled;
+}
+
+bool FakeNfcReader::isPoweredDown() const
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    return poweredDown;
+}
+
+unsigned long FakeNfcReader::poweredDownMs() const
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    return poweredDownTotal + (poweredDown ? millis() - poweredDownSince : 0);
+}
+
+void FakeNfcReader::leavePowerDownLocked()
+{
+    if (poweredDown)
+    {
+        poweredDownTotal += millis() - poweredDownSince;
+        poweredDown = false;
+    }
+}
+
+// Decides the outcome of one I2C exchange with the chip. A hung bus blocks
+// the caller for the bus timeout, outside the lock so the harness can keep
+// scripting meanwhile.
+bool FakeNfcReader::transact()
+{
+    unsigned long stallMs = 0;
+    bool answered = false;
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        ++transactions;
+        if (bus != nullptr && !bus->isRunning())
+        {
+            ++stoppedBusTransactions;
+        }
+        if (poweredDown)
+        {
+            leavePowerDownLocked();
+            return false;
+        }
+        if (wedged && bus != nullptr && bus->restartCount() != wedgedAtRestart)
+        {
+            wedged = false;
+        }
+
+        if (fault == Fault::DropMidTransaction)
+        {
+            fault = Fault::None;
+            wedged = true;
+            wedgedAtRestart = bus != nullptr ? bus->restartCount() : 0;
+        }
+        else if (fault == Fault::BusHang)
+        {
+            stallMs = bus != nullptr ? bus->timeoutMs() : DEFAULT_BUS_TIMEOUT_MS;
+            stalled += stallMs;
+        }
+        else if (fault == Fault::MarginalFastBus && bus != nullptr && bus->clockHz() > SLOW_BUS_MAX_CLOCK_HZ)
+        {
+            if (bus->restartCount() != marginalAtRestart)
+            {
+                marginalAtRestart = bus->restartCount();
+                marginalAnswered = 0;
+            }
+            answered = bus->isRunning() && !wedged && marginalAnswered < MARGINAL_TRANSACTIONS_PER_RESTART;
+            marginalAnswered += answered ? 1 : 0;
+        }
+        else
+        {
+            const bool transientFailure = failEvery != 0 && transactions % failEvery == 0;
+            answered = answeringLocked() && !transientFailure;
+        }
+    }
+
+    if (stallMs > 0)
+    {
+        delayMs(stallMs);
+    }
+    return answered;
+}
+
+bool FakeNfcReader::answeringLocked() const
+{
+    if (bus != nullptr && !bus->isRunning())
+    {
+        return false;
+    }
+    const bool stillWedged = wedged && (bus == nullptr || bus->restartCount() == wedgedAtRestart);
+    if (fault == Fault::SlowBusOnly || fault == Fault::MarginalFastBus)
+    {
+        return !stillWedged && (bus == nullptr || bus->clockHz() <= SLOW_BUS_MAX_CLOCK_HZ);
+    }
+    return fault == Fault::None && !stillWedged;
+}
+} // namespace hal
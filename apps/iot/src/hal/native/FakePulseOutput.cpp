@@ -0,0 +1,68 @@
+#include "hal/native/FakePulseOutput.h"
+
+#include "hal/Clock.h"
+
+namespace hal
+{
+bool FakePulseOutput::begin()
+{
+    running = false;
+    return true;
+}
+
+bool FakePulseOutput::start(uint32_t durationUs)
+{
+    if (active())
+    {
+        return false;
+    }
+    startedAt = uptimeUs();
+    deadline = startedAt + durationUs;
+    releasedAt = 0;
+    running = true;
+    ++pulses;
+    return true;
+}
+
+bool FakePulseOutput::active()
+{
+    fireIfDue();
+    return running;
+}
+
+uint64_t FakePulseOutput::releasedAtUs()
+{
+    fireIfDue();
+    return running ? 0 : releasedAt;
+}
+
+void FakePulseOutput::forceRelease()
+{
+    fireIfDue();
+    if (running)
+    {
+        running = false;
+        releasedAt = uptimeUs();
+    }
+    ++forcedReleases;
+}
+
+void FakePulseOutput::setTimerStuck(bool stuck)
+{
+    timerStuck = stuck;
+}
+
+uint64_t FakePulseOutput::startedAtUs() const
+{
+    return startedAt;
+}
+
+void FakePulseOutput::fireIfDue()
+{
+    if (running && !timerStuck && uptimeUs() >= deadline)
+    {
+        running = false;
+        releasedAt = deadline;
+    }
+}
+} // namespace hal
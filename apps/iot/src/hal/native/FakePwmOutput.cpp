@@ -0,0 +1,25 @@
+#include "hal/native/FakePwmOutput.h"
+
+namespace hal
+{
+void FakePwmOutput::setupChannel(uint8_t channel, uint32_t frequencyHz, uint8_t resolutionBits)
+{
+}
+
+void FakePwmOutput::attachPin(uint8_t pin, uint8_t channel)
+{
+}
+
+void FakePwmOutput::write(uint8_t channel, uint32_t duty)
+{
+    if (channel < CHANNEL_COUNT)
+    {
+        duties[channel] = duty;
+    }
+}
+
+uint32_t FakePwmOutput::duty(uint8_t channel) const
+{
+    return channel < CHANNEL_COUNT ? duties[channel] : 0;
+}
+} // namespace hal
@@ -0,0 +1,80 @@
+#include "hal/native/FakeSerialPort.h"
+
+#include <cstdio>
+
+namespace hal
+{
+FakeSerialPort::FakeSerialPort(bool echo)
+    : echo(echo)
+{
+}
+
+void FakeSerialPort::begin(unsigned long baudRate)
+{
+}
+
+int FakeSerialPort::available()
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    return static_cast<int>(input.size());
+}
+
+int FakeSerialPort::read()
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    if (input.empty())
+    {
+        return -1;
+    }
+    const uint8_t next = input.front();
+    input.pop_front();
+    return next;
+}
+
+size_t FakeSerialPort::write(const uint8_t *data, size_t length)
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    output.append(reinterpret_cast<const char *>(data), length);
+    if (echo)
+    {
+        fwrite(data, 1, length, stdout);
+    }
+    return length;
+}
+
+void FakeSerialPort::flush()
+{
+    if (echo)
+    {
+        fflush(stdout);
+    }
+}
+
+void FakeSerialPort::onReceive(std::function<void()> callback)
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    receiveCallback = std::move(callback);
+}
+
+void FakeSerialPort::injectInput(std::string_view text)
+{
+    std::function<void()> callback;
+    {
+        const std::lock_guard<std::mutex> lock(mutex);
+        input.insert(input.end(), text.begin(), text.end());
+        callback = receiveCallback;
+    }
+    if (callback)
+    {
+        callback();
+    }
+}
+
+std::string FakeSerialPort::takeOutput()
+{
+    const std::lock_guard<std::mutex> lock(mutex);
+    std::string taken;
+    taken.swap(output);
+    return taken;
+}
+} // namespace hal
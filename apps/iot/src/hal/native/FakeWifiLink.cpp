@@ -0,0 +1,58 @@
+#include "hal/native/FakeWifiLink.h"
+
+#include <algorithm>
+
+namespace hal
+{
+void FakeWifiLink::startStation()
+{
+}
+
+void FakeWifiLink::begin(const char *ssid, const char *password)
+{
+    reconnect();
+}
+
+void FakeWifiLink::reconnect()
+{
+    associated = networkAvailable.load();
+}
+
+bool FakeWifiLink::isConnected() const
+{
+    return associated;
+}
+
+int32_t FakeWifiLink::rssi() const
+{
+    return associated ? -55 : 0;
+}
+
+void FakeWifiLink::macAddress(uint8_t out[6]) const
+{
+    std::copy_n(mac, 6, out);
+}
+
+void FakeWifiLink::onEvent(std::function<void()> callback)
+{
+    eventCallback = std::move(callback);
+}
+
+void FakeWifiLink::setNetworkAvailable(bool available)
+{
+    networkAvailable = available;
+    if (!available)
+    {
+        associated = false;
+    }
+    if (eventCallback)
+    {
+        eventCallback();
+    }
+}
+
+void FakeWifiLink::setMacAddress(const uint8_t address[6])
+{
+    std::copy_n(address, 6, mac);
+}
+} // namespace hal
@@ -0,0 +1,26 @@
+#include "hal/native/MemoryFileStorage.h"
+
+namespace hal
+{
+bool MemoryFileStorage::mount()
+{
+    return !mountFails;
+}
+
+bool MemoryFileStorage::readFile(const char *path, std::string &contents)
+{
+    const auto file = files.find(path);
+    if (file == files.end())
+    {
+        return false;
+    }
+    contents = file->second;
+    return true;
+}
+
+bool MemoryFileStorage::writeFile(const char *path, std::string_view contents)
+{
+    files[path] = std::string(contents);
+    return true;
+}
+} // namespace hal
@@ -0,0 +1,57 @@
+#include "hal/native/MemoryFlashRegion.h"
+
+#include <algorithm>
+
+namespace hal
+{
+MemoryFlashRegion::MemoryFlashRegion(size_t size)
+    : regionSize(size / SECTOR_SIZE * SECTOR_SIZE)
+{
+}
+
+bool MemoryFlashRegion::begin()
+{
+    if (bytes.empty())
+    {
+        bytes.assign(regionSize, 0xFF);
+    }
+    return true;
+}
+
+size_t MemoryFlashRegion::size() const
+{
+    return bytes.size();
+}
+
+const uint8_t *MemoryFlashRegion::data() const
+{
+    return bytes.empty() ? nullptr : bytes.data();
+}
+
+bool MemoryFlashRegion::eraseSector(size_t offset)
+{
+    if (offset % SECTOR_SIZE != 0 || offset + SECTOR_SIZE > bytes.size())
+    {
+        return false;
+    }
+    std::fill(bytes.begin() + static_cast<std::ptrdiff_t>(offset),
+              bytes.begin() + static_cast<std::ptrdiff_t>(offset + SECTOR_SIZE),
+              0xFF);
+    ++sectorErases;
+    return true;
+}
+
+bool MemoryFlashRegion::write(size_t offset, const void *source, size_t length)
+{
+    if (offset + length > bytes.size())
+    {
+        return false;
+    }
+    const uint8_t *input = static_cast<const uint8_t *>(source);
+    for (size_t index = 0; index < length; ++index)
+    {
+        bytes[offset + index] &= input[index];
+    }
+    return true;
+}
+} // namespace hal
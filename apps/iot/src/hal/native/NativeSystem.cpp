@@ -0,0 +1,20 @@
+#include "hal/native/NativeSystem.h"
+
+namespace hal
+{
+void NativeSystem::restart()
+{
+    restarts.fetch_add(1);
+}
+
+uint32_t NativeSystem::freeHeapBytes() const
+{
+    // No meaningful equivalent on the host.
+    return 0;
+}
+
+uint32_t NativeSystem::restartCount() const
+{
+    return restarts.load();
+}
+} // namespace hal
@@ -0,0 +1,513 @@
+#include "hal/native/PosixMqttTransport.h"
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include "hal/Clock.h"
+
+namespace hal
+{
+namespace
+{
+// PubSubClient state codes.
+constexpr int MQTT_CONNECTION_TIMEOUT = -4;
+constexpr int MQTT_CONNECTION_LOST = -3;
+constexpr int MQTT_CONNECT_FAILED = -2;
+constexpr int MQTT_DISCONNECTED = -1;
+constexpr int MQTT_CONNECTED = 0;
+
+constexpr uint8_t CONNECT = 0x10;
+constexpr uint8_t CONNACK = 0x20;
+constexpr uint8_t PUBLISH = 0x30;
+constexpr uint8_t SUBSCRIBE = 0x82;
+constexpr uint8_t PINGREQ = 0xC0;
+constexpr uint8_t PINGRESP = 0xD0;
+constexpr uint8_t PACKET_TYPE_MASK = 0xF0;
+constexpr uint8_t PUBLISH_RETAIN = 0x01;
+constexpr uint8_t PUBLISH_QOS_MASK = 0x06;
+
+constexpr uint8_t CONNECT_CLEAN_SESSION = 0x02;
+constexpr uint8_t CONNECT_PASSWORD = 0x40;
+constexpr uint8_t CONNECT_USERNAME = 0x80;
+constexpr uint8_t PROTOCOL_LEVEL_311 = 4;
+
+// Packets are assembled after this many reserved bytes so the fixed header
+// can be written in front without moving the body.
+constexpr size_t MAX_HEADER_SIZE = 5;
+constexpr size_t MAX_REMAINING_LENGTH = 268435455;
+}
+
+PosixMqttTransport::~PosixMqttTransport()
+{
+    closeSocket(MQTT_DISCONNECTED);
+}
+
+void PosixMqttTransport::setServer(const char *serverHost, uint16_t serverPort)
+{
+    host = serverHost;
+    port = serverPort;
+}
+
+void PosixMqttTransport::setBufferSize(uint16_t size)
+{
+    buffer.assign(size, 0);
+}
+
+void PosixMqttTransport::setCallback(MessageCallback messageCallback)
+{
+    callback = std::move(messageCallback);
+}
+
+bool PosixMqttTransport::connect(const char *clientId, const char *username, const char *password)
+{
+    if (connected())
+    {
+        return true;
+    }
+    if (!openSocket())
+    {
+        lastState = MQTT_CONNECT_FAILED;
+        return false;
+    }
+
+    size_t offset = MAX_HEADER_SIZE;
+    writeString(buffer, offset, "MQTT");
+    uint8_t flags = CONNECT_CLEAN_SESSION;
+    if (username != nullptr)
+    {
+        flags |= CONNECT_USERNAME;
+        if (password != nullptr)
+        {
+            flags |= CONNECT_PASSWORD;
+        }
+    }
+    const uint8_t variableHeader[] = {PROTOCOL_LEVEL_311, flags, KEEPALIVE_SECONDS >> 8, KEEPALIVE_SECONDS & 0xFF};
+    if (offset + sizeof(variableHeader) > buffer.size())
+    {
+        closeSocket(MQTT_CONNECT_FAILED);
+        return false;
+    }
+    std::memcpy(buffer.data() + offset, variableHeader, sizeof(variableHeader));
+    offset += sizeof(variableHeader);
+
+    writeString(buffer, offset, clientId);
+    if (username != nullptr)
+    {
+        writeString(buffer, offset, username);
+        if (password != nullptr)
+        {
+            writeString(buffer, offset, password);
+        }
+    }
+    if (offset > buffer.size())
+    {
+        closeSocket(MQTT_CONNECT_FAILED);
+        return false;
+    }
+
+    const size_t headerLength = writeHeader(CONNECT, offset - MAX_HEADER_SIZE);
+    if (!sendAll(buffer.data() + MAX_HEADER_SIZE - headerLength, offset - MAX_HEADER_SIZE + headerLength))
+    {
+        closeSocket(MQTT_CONNECT_FAILED);
+        return false;
+    }
+
+    uint8_t header = 0;
+    size_t length = 0;
+    if (!readPacket(header, length))
+    {
+        closeSocket(MQTT_CONNECTION_TIMEOUT);
+        return false;
+    }
+    if ((header & PACKET_TYPE_MASK) != CONNACK || length < 2)
+    {
+        closeSocket(MQTT_CONNECT_FAILED);
+        return false;
+    }
+    const uint8_t returnCode = buffer[1];
+    if (returnCode != 0)
+    {
+        closeSocket(returnCode);
+        return false;
+    }
+
+    lastInboundAt = lastOutboundAt = millis();
+    pingOutstanding = false;
+    lastState = MQTT_CONNECTED;
+    return true;
+}
+
+bool PosixMqttTransport::connected()
+{
+    return fd.load() >= 0 && lastState == MQTT_CONNECTED;
+}
+
+int PosixMqttTransport::state()
+{
+    return lastState;
+}
+
+bool PosixMqttTransport::publish(const char *topic, const uint8_t *payload, size_t length, bool retained)
+{
+    if (!connected())
+    {
+        return false;
+    }
+
+    size_t offset = MAX_HEADER_SIZE;
+    writeString(buffer, offset, topic);
+    if (offset + length > buffer.size())
+    {
+        return false;
+    }
+    std::memcpy(buffer.data() + offset, payload, length);
+    offset += length;
+
+    const uint8_t header = PUBLISH | (retained ? PUBLISH_RETAIN : 0);
+    const size_t headerLength = writeHeader(header, offset - MAX_HEADER_SIZE);
+    if (!sendAll(buffer.data() + MAX_HEADER_SIZE - headerLength, offset - MAX_HEADER_SIZE + headerLength))
+    {
+        closeSocket(MQTT_CONNECTION_LOST);
+        return false;
+    }
+    return true;
+}
+
+bool PosixMqttTransport::subscribe(const char *topic)
+{
+    if (!connected())
+    {
+        return false;
+    }
+
+    size_t offset = MAX_HEADER_SIZE;
+    buffer[offset++] = static_cast<uint8_t>(nextPacketId >> 8);
+    buffer[offset++] = static_cast<uint8_t>(nextPacketId & 0xFF);
+    nextPacketId = nextPacketId == 0xFFFF ? 1 : nextPacketId + 1;
+    writeString(buffer, offset, topic);
+    if (offset + 1 > buffer.size())
+    {
+        return false;
+    }
+    buffer[offset++] = 0; // QoS 0
+
+    const size_t headerLength = writeHeader(SUBSCRIBE, offset - MAX_HEADER_SIZE);
+    if (!sendAll(buffer.data() + MAX_HEADER_SIZE - headerLength, offset - MAX_HEADER_SIZE + headerLength))
+    {
+        closeSocket(MQTT_CONNECTION_LOST);
+        return false;
+    }
+    return true;
+}
+
+bool PosixMqttTransport::loop()
+{
+    if (!connected())
+    {
+        return false;
+    }
+
+    const unsigned long now = millis();
+    const unsigned long keepaliveMs = KEEPALIVE_SECONDS * 1000UL;
+    if (now - lastInboundAt > keepaliveMs || now - lastOutboundAt > keepaliveMs)
+    {
+        if (pingOutstanding)
+        {
+            closeSocket(MQTT_CONNECTION_TIMEOUT);
+            return false;
+        }
+        const uint8_t ping[] = {PINGREQ, 0};
+        if (!sendAll(ping, sizeof(ping)))
+        {
+            closeSocket(MQTT_CONNECTION_LOST);
+            return false;
+        }
+        lastInboundAt = now;
+        pingOutstanding = true;
+    }
+
+    pollfd readable{fd.load(), POLLIN, 0};
+    if (poll(&readable, 1, 0) <= 0)
+    {
+        return true;
+    }
+
+    uint8_t header = 0;
+    size_t length = 0;
+    if (!readPacket(header, length))
+    {
+        closeSocket(MQTT_CONNECTION_LOST);
+        return false;
+    }
+    lastInboundAt = millis();
+
+    switch (header & PACKET_TYPE_MASK)
+    {
+    case PUBLISH:
+    {
+        // readPacket() leaves oversized packets with length 0; PubSubClient
+        // drops them the same way.
+        if (length < 2 || !callback)
+        {
+            break;
+        }
+        const size_t topicLength = (static_cast<size_t>(buffer[0]) << 8) | buffer[1];
+        const size_t packetIdLength = (header & PUBLISH_QOS_MASK) != 0 ? 2 : 0;
+        if (2 + topicLength + packetIdLength > length)
+        {
+            break;
+        }
+        // Shift the topic down over its length prefix to make room for the
+        // terminator callbacks expect.
+        std::memmove(buffer.data(), buffer.data() + 2, topicLength);
+        buffer[topicLength] = '\0';
+        uint8_t *payload = buffer.data() + 2 + topicLength + packetIdLength;
+        callback(reinterpret_cast<char *>(buffer.data()),
+                 payload,
+                 static_cast<unsigned int>(length - 2 - topicLength - packetIdLength));
+        break;
+    }
+    case PINGREQ:
+    {
+        const uint8_t pong[] = {PINGRESP, 0};
+        if (!sendAll(pong, sizeof(pong)))
+        {
+            closeSocket(MQTT_CONNECTION_LOST);
+            return false;
+        }
+        break;
+    }
+    case PINGRESP:
+        pingOutstanding = false;
+        break;
+    default:
+        break;
+    }
+    return true;
+}
+
+int PosixMqttTransport::socketFd() const
+{
+    return fd.load();
+}
+
+int PosixMqttTransport::bytesBuffered()
+{
+    const int socket = fd.load();
+    int available = 0;
+    if (socket < 0 || ioctl(socket, FIONREAD, &available) != 0)
+    {
+        return 0;
+    }
+    return available;
+}
+
+void PosixMqttTransport::severConnection()
+{
+    const int socket = fd.load();
+    if (socket >= 0)
+    {
+        shutdown(socket, SHUT_RDWR);
+    }
+}
+
+bool PosixMqttTransport::openSocket()
+{
+    closeSocket(MQTT_DISCONNECTED);
+
+    addrinfo hints{};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo *addresses = nullptr;
+    const std::string service = std::to_string(port);
+    if (getaddrinfo(host.c_str(), service.c_str(), &hints, &addresses) != 0)
+    {
+        return false;
+    }
+
+    int socket = -1;
+    for (addrinfo *address = addresses; address != nullptr && socket < 0; address = address->ai_next)
+    {
+        socket = ::socket(address->ai_family, address->ai_socktype | SOCK_CLOEXEC | SOCK_NONBLOCK, address->ai_protocol);
+        if (socket < 0)
+        {
+            continue;
+        }
+
+        bool established = ::connect(socket, address->ai_addr, address->ai_addrlen) == 0;
+        if (!established && errno == EINPROGRESS)
+        {
+            pollfd writable{socket, POLLOUT, 0};
+            int error = 0;
+            socklen_t errorLength = sizeof(error);
+            established = poll(&writable, 1, static_cast<int>(SOCKET_TIMEOUT_MS)) == 1 &&
+                          getsockopt(socket, SOL_SOCKET, SO_ERROR, &error, &errorLength) == 0 &&
+                          error == 0;
+        }
+        if (!established)
+        {
+            ::close(socket);
+            socket = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+
+    if (socket < 0)
+    {
+        return false;
+    }
+
+    // Blocking from here on, like WiFiClient; reads are bounded by poll().
+    fcntl(socket, F_SETFL, fcntl(socket, F_GETFL) & ~O_NONBLOCK);
+    fd.store(socket);
+    return true;
+}
+
+void PosixMqttTransport::closeSocket(int newState)
+{
+    const int socket = fd.exchange(-1);
+    if (socket >= 0)
+    {
+        ::close(socket);
+    }
+    lastState = newState;
+    pingOutstanding = false;
+}
+
+bool PosixMqttTransport::sendAll(const uint8_t *data, size_t length)
+{
+    const int socket = fd.load();
+    while (length > 0)
+    {
+        const ssize_t sent = ::send(socket, data, length, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (sent <= 0)
+        {
+            return false;
+        }
+        data += sent;
+        length -= static_cast<size_t>(sent);
+    }
+    lastOutboundAt = millis();
+    return true;
+}
+
+bool PosixMqttTransport::readExactly(uint8_t *data, size_t length)
+{
+    const int socket = fd.load();
+    while (length > 0)
+    {
+        pollfd readable{socket, POLLIN, 0};
+        if (poll(&readable, 1, static_cast<int>(SOCKET_TIMEOUT_MS)) != 1)
+        {
+            return false;
+        }
+        const ssize_t received = ::recv(socket, data, length, 0);
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (received <= 0)
+        {
+            return false;
+        }
+        data += received;
+        length -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+// Reads one packet body into buffer. Bodies that do not fit are consumed
+// and reported with length 0.
+bool PosixMqttTransport::readPacket(uint8_t &header, size_t &length)
+{
+    if (!readExactly(&header, 1))
+    {
+        return false;
+    }
+
+    size_t remaining = 0;
+    size_t multiplier = 1;
+    uint8_t digit = 0;
+    do
+    {
+        if (multiplier > 128 * 128 * 128 || !readExactly(&digit, 1))
+        {
+            return false;
+        }
+        remaining += (digit & 0x7F) * multiplier;
+        multiplier *= 128;
+    } while ((digit & 0x80) != 0);
+
+    if (remaining <= buffer.size())
+    {
+        length = remaining;
+        return readExactly(buffer.data(), remaining);
+    }
+
+    length = 0;
+    uint8_t discard[64];
+    while (remaining > 0)
+    {
+        const size_t chunk = remaining < sizeof(discard) ? remaining : sizeof(discard);
+        if (!readExactly(discard, chunk))
+        {
+            return false;
+        }
+        remaining -= chunk;
+    }
+    return true;
+}
+
+// Writes the fixed header so that it ends at MAX_HEADER_SIZE and returns its
+// length.
+size_t PosixMqttTransport::writeHeader(uint8_t header, size_t remainingLength)
+{
+    uint8_t encoded[MAX_HEADER_SIZE - 1];
+    size_t encodedLength = 0;
+    if (remainingLength > MAX_REMAINING_LENGTH)
+    {
+        remainingLength = MAX_REMAINING_LENGTH;
+    }
+    do
+    {
+        uint8_t digit = remainingLength % 128;
+        remainingLength /= 128;
+        if (remainingLength > 0)
+        {
+            digit |= 0x80;
+        }
+        encoded[encodedLength++] = digit;
+    } while (remainingLength > 0);
+
+    const size_t headerLength = 1 + encodedLength;
+    uint8_t *start = buffer.data() + MAX_HEADER_SIZE - headerLength;
+    start[0] = header;
+    std::memcpy(start + 1, encoded, encodedLength);
+    return headerLength;
+}
+
+// Appends a length prefixed string. Running past the buffer only advances
+// offset, so callers check offset against the buffer size once at the end.
+void PosixMqttTransport::writeString(std::vector<uint8_t> &packet, size_t &offset, const char *text)
+{
+    const size_t length = std::strlen(text);
+    if (offset + 2 + length <= packet.size())
+    {
+        packet[offset] = static_cast<uint8_t>(length >> 8);
+        packet[offset + 1] = static_cast<uint8_t>(length & 0xFF);
+        std::memcpy(packet.data() + offset + 2, text, length);
+    }
+    offset += 2 + length;
+}
+} // namespace hal
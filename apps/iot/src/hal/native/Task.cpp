@@ -0,0 +1,66 @@
+#include "hal/Task.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace hal
+{
+struct TaskHandle
+{
+    std::mutex mutex;
+    std::condition_variable notified;
+    bool pending = false;
+};
+
+namespace
+{
+// Threads that were not started through startTask() get a handle on first
+// wait, so the main thread can block on notifications too.
+thread_local TaskHandle *currentTask = nullptr;
+
+TaskHandle &currentTaskHandle()
+{
+    if (currentTask == nullptr)
+    {
+        static thread_local TaskHandle ownHandle;
+        currentTask = &ownHandle;
+    }
+    return *currentTask;
+}
+}
+
+TaskHandle *startTask(const TaskSpec &spec, TaskEntry entry, void *argument)
+{
+    // Priority, stack size and core pinning have no host equivalent.
+    auto *handle = new TaskHandle();
+    std::thread([handle, entry, argument]()
+                {
+                    currentTask = handle;
+                    entry(argument);
+                })
+        .detach();
+    return handle;
+}
+
+void notifyTask(TaskHandle *task)
+{
+    {
+        const std::lock_guard<std::mutex> lock(task->mutex);
+        task->pending = true;
+    }
+    task->notified.notify_one();
+}
+
+bool waitForNotification(unsigned long timeoutMs)
+{
+    TaskHandle &task = currentTaskHandle();
+    std::unique_lock<std::mutex> lock(task.mutex);
+    task.notified.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&task]()
+                           { return task.pending; });
+    const bool wasNotified = task.pending;
+    task.pending = false;
+    return wasNotified;
+}
+} // namespace hal
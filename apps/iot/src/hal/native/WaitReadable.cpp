@@ -0,0 +1,44 @@
+#include "hal/WaitReadable.h"
+
+#include <poll.h>
+
+#include <array>
+#include <climits>
+
+namespace
+{
+// Each task waits on its eventfd and at most the MQTT socket.
+constexpr size_t MAX_WAIT_FDS = 4;
+}
+
+namespace hal
+{
+int waitReadable(const int *fds, bool *readable, size_t count, unsigned long timeoutMs)
+{
+    // On the stack: both tasks call this on every pass.
+    std::array<pollfd, MAX_WAIT_FDS> entries{};
+    if (count > entries.size())
+    {
+        return -1;
+    }
+    for (size_t index = 0; index < count; ++index)
+    {
+        // poll() ignores negative descriptors.
+        entries[index] = pollfd{fds[index], POLLIN, 0};
+        readable[index] = false;
+    }
+
+    const int timeout = timeoutMs > static_cast<unsigned long>(INT_MAX) ? INT_MAX : static_cast<int>(timeoutMs);
+    const int ready = poll(entries.data(), count, timeout);
+    if (ready <= 0)
+    {
+        return ready;
+    }
+    for (size_t index = 0; index < count; ++index)
+    {
+        // Hang-ups count as readable, as select() reports them.
+        readable[index] = (entries[index].revents & (POLLIN | POLLHUP | POLLERR)) != 0;
+    }
+    return ready;
+}
+} // namespace hal
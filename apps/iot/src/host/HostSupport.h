@@ -0,0 +1,118 @@
+#ifndef HOST_HOST_SUPPORT_H
+#define HOST_HOST_SUPPORT_H
+
+// Helpers shared by the host programs under src/host: driving an App on
+// the fakes, checking results and summarising samples. Header-only, since
+// each program's env builds its own directory and none of the others.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "hal/Clock.h"
+#include "logging/DeferredLog.h"
+
+namespace host
+{
+// Prints a FAIL line when condition does not hold, and returns it.
+inline bool expect(bool condition, const char *what)
+{
+    if (!condition)
+    {
+        std::fprintf(stderr, "FAIL: %s\n", what);
+    }
+    return condition;
+}
+
+inline bool contains(const std::string &text, const char *needle)
+{
+    return text.find(needle) != std::string::npos;
+}
+
+// Loops app for durationMs of hal::millis().
+template <typename Runnable>
+void runFor(Runnable &app, unsigned long durationMs)
+{
+    const unsigned long startedAt = hal::millis();
+    while (hal::millis() - startedAt < durationMs)
+    {
+        app.loop();
+    }
+}
+
+// Same, discarding what mqtt records so it does not pile up.
+template <typename Runnable, typename Transport>
+void runFor(Runnable &app, Transport &mqtt, unsigned long durationMs)
+{
+    const unsigned long startedAt = hal::millis();
+    while (hal::millis() - startedAt < durationMs)
+    {
+        app.loop();
+        mqtt.takePublished();
+    }
+}
+
+// Loops app until mqtt records a publish on topic that matches, or until
+// timeoutMs has passed. elapsedMs, when given, gets how long it took.
+template <typename Runnable, typename Transport>
+bool runUntilPublished(Runnable &app,
+                       Transport &mqtt,
+                       std::string_view topic,
+                       const std::function<bool(const std::string &)> &matches,
+                       unsigned long timeoutMs,
+                       unsigned long *elapsedMs = nullptr)
+{
+    const unsigned long startedAt = hal::millis();
+    while (hal::millis() - startedAt < timeoutMs)
+    {
+        app.loop();
+        for (const auto &message : mqtt.takePublished())
+        {
+            if (message.topic == topic && matches(message.payload))
+            {
+                if (elapsedMs != nullptr)
+                {
+                    *elapsedMs = hal::millis() - startedAt;
+                }
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+// Nearest rank; 0 when there are no values.
+inline unsigned long percentile(std::vector<unsigned long> values, unsigned rank)
+{
+    if (values.empty())
+    {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    const size_t index = (values.size() * rank + 99) / 100;
+    return values[index == 0 ? 0 : index - 1];
+}
+
+// Flushes the deferred log; return it from main.
+inline int finish(int exitCode)
+{
+    DeferredLog::flush();
+    return exitCode;
+}
+
+// For programs whose App threads never return: flushes everything and
+// leaves without running static destructors underneath them.
+[[noreturn]] inline void quickExit(int exitCode)
+{
+    DeferredLog::flush();
+    std::fflush(stdout);
+    std::fflush(stderr);
+    std::_Exit(exitCode);
+}
+} // namespace host
+
+#endif // HOST_HOST_SUPPORT_H
@@ -0,0 +1,240 @@
+// Fills a partition-sized authorization cache through the same batches the
+// backend sends, then times lookups against it and checks what survives a
+// reboot, an interrupted sync and a damaged slot.
+//
+//   pio run -e native_auth_bench
+//   .pio/build/native_auth_bench/program [--lookups n] [--flash-kb n]
+//
+// Exits non-zero on the first wrong answer. Lookup times are for the host;
+// on the ESP32 the keys are read through the flash cache, so expect the
+// first probes of a lookup to cost a cache miss each.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "hal/native/MemoryFlashRegion.h"
+#include "host/HostSupport.h"
+#include "services/AuthorizationCache.h"
+#include "services/CommandConsumer.h"
+
+namespace
+{
+constexpr unsigned long DEFAULT_LOOKUPS = 1000000;
+constexpr size_t DEFAULT_FLASH_KB = 512;
+constexpr uint32_t NOW_EPOCH_S = 1790000000;
+// One card in this many has already expired.
+constexpr size_t EXPIRED_EVERY = 10;
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point since)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+}
+
+// Sorted, distinct keys with gaps between them for misses to land in.
+std::vector<AuthorizationCache::Entry> makeEntries(size_t count, std::mt19937_64 &random)
+{
+    std::vector<AuthorizationCache::Entry> entries(count);
+    uint64_t key = 1000;
+    for (size_t index = 0; index < count; ++index)
+    {
+        key += 2 + random() % 1000000;
+        entries[index].cardKey = key;
+        entries[index].expiresAt = index % EXPIRED_EVERY == 0 ? NOW_EPOCH_S - 60 : NOW_EPOCH_S + 86400;
+    }
+    return entries;
+}
+
+// Sends entries from offset on in wire-sized batches, stopping after limit.
+AuthorizationCache::SyncResult sendBatches(AuthorizationCache &cache,
+                                           uint32_t generation,
+                                           const std::vector<AuthorizationCache::Entry> &entries,
+                                           size_t offset,
+                                           size_t limit,
+                                           unsigned long &batches)
+{
+    const size_t end = std::min(entries.size(), offset + limit);
+    while (offset < end)
+    {
+        const size_t count = std::min(CommandConsumer::MAX_AUTH_BATCH_ENTRIES, end - offset);
+        const AuthorizationCache::SyncResult result =
+            cache.appendEntries(generation, static_cast<uint32_t>(offset), entries.data() + offset, count);
+        if (result != AuthorizationCache::SyncResult::Ok)
+        {
+            return result;
+        }
+        offset += count;
+        ++batches;
+    }
+    return AuthorizationCache::SyncResult::Ok;
+}
+
+bool syncAll(AuthorizationCache &cache, hal::MemoryFlashRegion &flash, uint32_t generation, const std::vector<AuthorizationCache::Entry> &entries)
+{
+    const unsigned long erasesBefore = flash.sectorErases;
+    unsigned long batches = 0;
+    const Clock::time_point started = Clock::now();
+    if (!host::expect(cache.beginSync(generation, static_cast<uint32_t>(entries.size())) == AuthorizationCache::SyncResult::Ok, "beginSync") ||
+        !host::expect(sendBatches(cache, generation, entries, 0, entries.size(), batches) == AuthorizationCache::SyncResult::Ok, "batches") ||
+        !host::expect(cache.commitSync(generation) == AuthorizationCache::SyncResult::Ok, "commitSync"))
+    {
+        return false;
+    }
+    std::printf("sync %lu: %zu cards in %lu batches, %lu sector erases, %.1f ms on the host\n",
+                static_cast<unsigned long>(generation),
+                entries.size(),
+                batches,
+                flash.sectorErases - erasesBefore,
+                elapsedMs(started));
+    return true;
+}
+
+bool verifyAll(const AuthorizationCache &cache, const std::vector<AuthorizationCache::Entry> &entries)
+{
+    for (size_t index = 0; index < entries.size(); ++index)
+    {
+        const AuthorizationCache::Verdict expected =
+            index % EXPIRED_EVERY == 0 ? AuthorizationCache::Verdict::Expired : AuthorizationCache::Verdict::Granted;
+        if (cache.check(entries[index].cardKey, NOW_EPOCH_S) != expected ||
+            cache.check(entries[index].cardKey + 1, NOW_EPOCH_S) != AuthorizationCache::Verdict::NotCached)
+        {
+            std::fprintf(stderr, "FAIL: wrong verdict for card %zu\n", index);
+            return false;
+        }
+    }
+    return host::expect(cache.check(0, NOW_EPOCH_S) == AuthorizationCache::Verdict::NotCached, "key below the first") &&
+           host::expect(cache.check(UINT64_MAX, NOW_EPOCH_S) == AuthorizationCache::Verdict::NotCached, "key above the last");
+}
+
+void timeLookups(const AuthorizationCache &cache,
+                 const std::vector<AuthorizationCache::Entry> &entries,
+                 unsigned long lookups,
+                 std::mt19937_64 &random)
+{
+    std::vector<uint64_t> probes(lookups);
+    for (uint64_t &probe : probes)
+    {
+        const uint64_t key = entries[random() % entries.size()].cardKey;
+        probe = random() % 2 == 0 ? key : key + 1;
+    }
+
+    unsigned long granted = 0;
+    const Clock::time_point started = Clock::now();
+    for (const uint64_t probe : probes)
+    {
+        granted += cache.check(probe, NOW_EPOCH_S) == AuthorizationCache::Verdict::Granted ? 1 : 0;
+    }
+    const double totalMs = elapsedMs(started);
+    std::printf("%lu lookups over %lu cards (half misses): %.0f ns each, %lu granted\n",
+                lookups,
+                static_cast<unsigned long>(cache.entryCount()),
+                totalMs * 1e6 / static_cast<double>(lookups),
+                granted);
+}
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long lookups = DEFAULT_LOOKUPS;
+    size_t flashKb = DEFAULT_FLASH_KB;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--lookups") == 0 && i + 1 < argc)
+        {
+            lookups = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--flash-kb") == 0 && i + 1 < argc)
+        {
+            flashKb = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--lookups n] [--flash-kb n]\n", argv[0]);
+            return 2;
+        }
+    }
+    lookups = std::max(lookups, 1UL);
+
+    std::mt19937_64 random(49);
+    hal::MemoryFlashRegion flash(flashKb * 1024);
+    AuthorizationCache cache(flash);
+    if (!host::expect(cache.begin(), "begin") || !host::expect(!cache.hasSnapshot(), "blank flash has no snapshot"))
+    {
+        return 1;
+    }
+    std::printf("%zu KB region, %lu cards per slot\n", flashKb, static_cast<unsigned long>(cache.capacity()));
+
+    const std::vector<AuthorizationCache::Entry> first = makeEntries(cache.capacity(), random);
+    if (!host::expect(cache.beginSync(1, cache.capacity() + 1) == AuthorizationCache::SyncResult::TooLarge, "oversized snapshot") ||
+        !syncAll(cache, flash, 1, first) || !verifyAll(cache, first))
+    {
+        return 1;
+    }
+    timeLookups(cache, first, lookups, random);
+
+    // A resent batch is acked without writing; a gap or a step back in the
+    // keys is refused.
+    const std::vector<AuthorizationCache::Entry> second = makeEntries(cache.capacity() / 2, random);
+    unsigned long batches = 0;
+    AuthorizationCache::Entry unsorted[] = {{second[0].cardKey, NOW_EPOCH_S}};
+    if (!host::expect(cache.beginSync(2, static_cast<uint32_t>(second.size())) == AuthorizationCache::SyncResult::Ok, "beginSync 2") ||
+        !host::expect(sendBatches(cache, 2, second, 0, 64, batches) == AuthorizationCache::SyncResult::Ok, "first batches of 2") ||
+        !host::expect(sendBatches(cache, 2, second, 48, 16, batches) == AuthorizationCache::SyncResult::Ok, "resent batch") ||
+        !host::expect(cache.syncedCount() == 64, "resent batch written once") ||
+        !host::expect(sendBatches(cache, 2, second, 80, 16, batches) == AuthorizationCache::SyncResult::OutOfOrder, "gap") ||
+        !host::expect(cache.commitSync(2) == AuthorizationCache::SyncResult::Incomplete, "early commit") ||
+        !host::expect(cache.generation() == 1, "snapshot 1 answers during sync 2"))
+    {
+        return 1;
+    }
+
+    // Power lost mid-sync: the previous snapshot comes back.
+    {
+        AuthorizationCache rebooted(flash);
+        if (!host::expect(rebooted.begin(), "begin after interrupted sync") || !host::expect(rebooted.generation() == 1, "interrupted sync ignored") ||
+            !verifyAll(rebooted, first))
+        {
+            return 1;
+        }
+    }
+
+    if (!host::expect(cache.appendEntries(2, 64, unsorted, 1) == AuthorizationCache::SyncResult::Unsorted, "unsorted keys") ||
+        !host::expect(cache.appendEntries(2, 64, second.data() + 64, 16) == AuthorizationCache::SyncResult::Unavailable, "abandoned sync") ||
+        !syncAll(cache, flash, 2, second) || !verifyAll(cache, second))
+    {
+        return 1;
+    }
+
+    {
+        AuthorizationCache rebooted(flash);
+        if (!host::expect(rebooted.begin(), "begin after sync 2") || !host::expect(rebooted.generation() == 2, "newest snapshot wins") ||
+            !verifyAll(rebooted, second))
+        {
+            return 1;
+        }
+    }
+
+    // Flip bits in the middle of the active slot's keys: it fails its
+    // checksum and snapshot 1 in the other slot takes over.
+    const size_t activeSlot = std::min<size_t>(flash.size() / 2, 64 * hal::FlashRegion::SECTOR_SIZE);
+    const uint8_t zeros[8] = {};
+    flash.write(activeSlot + 32 + 8 * (second.size() / 2), zeros, sizeof(zeros));
+    {
+        AuthorizationCache rebooted(flash);
+        if (!host::expect(rebooted.begin(), "begin after damage") || !host::expect(rebooted.generation() == 1, "damaged slot skipped") ||
+            !verifyAll(rebooted, first))
+        {
+            return 1;
+        }
+    }
+
+    std::printf("ok\n");
+    return 0;
+}
@@ -0,0 +1,751 @@
+// Fleet load generator. Runs many copies of the firmware App, each with its
+// own device and network threads, DeviceContext and simulated hardware, all
+// against one MQTT broker, plus a stand-in for the iot-service that answers
+// every tap with an unlock command. The fleet grows in stages; each stage
+// reports:
+//
+//   boot      time for the newly added devices to get an MQTT session
+//   traffic   device->broker publishes and bytes per second, commands/s
+//   latency   unlock command sent to ack received, and card presented to
+//             ack received, both as seen from the service side
+//   storm     every session is cut at once; time for the fleet to
+//             reconnect, connect attempts made and the peak attempts/s
+//
+//   pio run -e native_fleet
+//   .pio/build/native_fleet/program [--broker host[:port]] [--devices 100,250,500]
+//       [--window s] [--tap-interval s] [--seed n] [--csv out.csv] [-v]
+//
+// Metrics registries are process-wide, so every device's metrics publish
+// carries fleet totals. The sizes and rates on the wire are still those of
+// a real device.
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "app/App.h"
+#include "app/Scheduler.h"
+#include "hal/Clock.h"
+#include "hal/Task.h"
+#include "hal/WaitReadable.h"
+#include "hal/native/FakeI2CBus.h"
+#include "hal/native/FakeNetworkTime.h"
+#include "hal/native/FakeNfcReader.h"
+#include "hal/native/FakePwmOutput.h"
+#include "hal/native/FakeSerialPort.h"
+#include "hal/native/FakeWifiLink.h"
+#include "hal/native/MemoryFileStorage.h"
+#include "hal/native/NativeSystem.h"
+#include "hal/native/PosixMqttTransport.h"
+#include "host/HostSupport.h"
+#include "logging/DeferredLog.h"
+
+namespace
+{
+constexpr unsigned long BOOT_TIMEOUT_MS = 120000;
+constexpr unsigned long STORM_TIMEOUT_MS = 120000;
+// Taps still unanswered this long after the window closes count as lost.
+constexpr unsigned long DRAIN_GRACE_MS = 5000;
+constexpr unsigned long CARD_DWELL_MS = 400;
+constexpr unsigned long MAX_WAIT_MS = 10;
+// Upper bound on packets handled per pump so a flood cannot starve taps.
+constexpr int MAX_PACKETS_PER_PUMP = 2000;
+constexpr uint16_t SERVICE_BUFFER_SIZE = 1152;
+
+const hal::TaskSpec DEVICE_TASK{"device", 16384, 1, -1};
+
+std::atomic<uint64_t> publishesOut{0};
+std::atomic<uint64_t> bytesOut{0};
+std::atomic<uint64_t> connectAttempts{0};
+
+// Device transport that counts what the fleet puts on the wire.
+class FleetTransport : public hal::PosixMqttTransport
+{
+public:
+    bool connect(const char *clientId, const char *username, const char *password) override
+    {
+        connectAttempts.fetch_add(1, std::memory_order_relaxed);
+        if (!PosixMqttTransport::connect(clientId, username, password))
+        {
+            return false;
+        }
+        lastConnectedAtMs.store(hal::millis());
+        sessions.fetch_add(1);
+        return true;
+    }
+
+    bool publish(const char *topic, const uint8_t *payload, size_t length, bool retained) override
+    {
+        if (!PosixMqttTransport::publish(topic, payload, length, retained))
+        {
+            return false;
+        }
+        publishesOut.fetch_add(1, std::memory_order_relaxed);
+        bytesOut.fetch_add(std::strlen(topic) + length, std::memory_order_relaxed);
+        return true;
+    }
+
+    std::atomic<uint32_t> sessions{0};
+    std::atomic<unsigned long> lastConnectedAtMs{0};
+};
+
+struct FleetDevice
+{
+    FleetDevice(std::string deviceId, const std::string &config)
+        : id(std::move(deviceId)), context(makeDeviceContext(id))
+    {
+        nfc.attachBus(i2c);
+        storage.files["/.env"] = "BIKE_ID=" + id + "\n" + config;
+    }
+
+    FleetDevice(const FleetDevice &) = delete;
+    FleetDevice &operator=(const FleetDevice &) = delete;
+
+    std::string id;
+    DeviceContext context;
+    hal::FakeSerialPort serial;
+    hal::MemoryFileStorage storage;
+    hal::FakePwmOutput pwm;
+    hal::FakeI2CBus i2c;
+    hal::FakeNfcReader nfc;
+    hal::NfcBay bay{nfc, i2c};
+    hal::FakeWifiLink wifi;
+    FleetTransport mqtt;
+    hal::NativeSystem system;
+    hal::FakeNetworkTime networkTime;
+    hal::Platform platform{serial, storage, pwm, &bay, 1, wifi, mqtt, system, networkTime};
+    App app{platform};
+
+    uint32_t tapSequence = 0;
+    unsigned long presentedAtUs = 0;
+};
+
+[[noreturn]] void runDevice(void *argument)
+{
+    App &app = static_cast<FleetDevice *>(argument)->app;
+    while (true)
+    {
+        app.loop();
+    }
+}
+
+struct Percentiles
+{
+    std::vector<unsigned long> values;
+
+    void add(unsigned long value)
+    {
+        values.push_back(value);
+    }
+
+    unsigned long at(unsigned rank) const
+    {
+        return host::percentile(values, rank);
+    }
+};
+
+// The iot-service side: answers each tap with an unlock and times the ack.
+class Service
+{
+public:
+    explicit Service(const std::vector<std::unique_ptr<FleetDevice>> &devices)
+        : devices(devices)
+    {
+    }
+
+    bool connect(const std::string &host, uint16_t port, const std::string &clientId)
+    {
+        client.setServer(host.c_str(), port);
+        client.setBufferSize(SERVICE_BUFFER_SIZE);
+        client.setCallback([this](char *topic, uint8_t *payload, unsigned int length)
+                           {
+                               // The payload lives in the client's buffer, which the
+                               // reply publish reuses, so copy before answering.
+                               inbox.push_back({topic, std::string(reinterpret_cast<char *>(payload), length)});
+                           });
+        return client.connect(clientId.c_str(), nullptr, nullptr) &&
+               client.subscribe("device/+/events/tap") &&
+               client.subscribe("device/+/acks");
+    }
+
+    void registerDevice(const std::string &deviceId, size_t index)
+    {
+        indexById[deviceId] = index;
+    }
+
+    // Handles everything already readable, up to a bound.
+    void pump()
+    {
+        for (int packets = 0; packets < MAX_PACKETS_PER_PUMP && client.bytesBuffered() > 0; ++packets)
+        {
+            client.loop();
+        }
+        client.loop(); // keepalive
+        for (const Inbound &message : inbox)
+        {
+            handle(message);
+        }
+        inbox.clear();
+    }
+
+    int socketFd() const
+    {
+        return client.socketFd();
+    }
+
+    void resetStage()
+    {
+        unlockUs = Percentiles();
+        tapToAckUs = Percentiles();
+        tapsIn = 0;
+        commandsOut = 0;
+        acksIn = 0;
+    }
+
+    size_t outstanding() const
+    {
+        return pending.size();
+    }
+
+    void forgetOutstanding()
+    {
+        pending.clear();
+    }
+
+    Percentiles unlockUs;
+    Percentiles tapToAckUs;
+    uint64_t tapsIn = 0;
+    uint64_t commandsOut = 0;
+    uint64_t acksIn = 0;
+
+private:
+    struct Inbound
+    {
+        std::string topic;
+        std::string payload;
+    };
+
+    struct Pending
+    {
+        unsigned long presentedAtUs;
+        unsigned long sentAtUs;
+    };
+
+    static std::string deviceIdOf(const std::string &topic)
+    {
+        const size_t start = topic.find('/') + 1;
+        const size_t end = topic.find('/', start);
+        return start == 0 || end == std::string::npos ? std::string() : topic.substr(start, end - start);
+    }
+
+    static std::string requestIdOf(const std::string &payload)
+    {
+        static const std::string key = "\"requestId\":\"";
+        const size_t start = payload.find(key);
+        if (start == std::string::npos)
+        {
+            return std::string();
+        }
+        const size_t valueStart = start + key.size();
+        const size_t end = payload.find('"', valueStart);
+        return end == std::string::npos ? std::string() : payload.substr(valueStart, end - valueStart);
+    }
+
+    void handle(const Inbound &message)
+    {
+        const auto device = indexById.find(deviceIdOf(message.topic));
+        if (device == indexById.end())
+        {
+            return;
+        }
+        const FleetDevice &target = *devices[device->second];
+
+        if (message.topic == target.context.topics.tapEventTopic)
+        {
+            ++tapsIn;
+            const std::string requestId = "svc-" + std::to_string(nextCommandId++);
+            const std::string command = "{\"action\":\"unlock\",\"requestId\":\"" + requestId + "\"}";
+            if (client.publish(target.context.topics.commandTopic.c_str(),
+                               reinterpret_cast<const uint8_t *>(command.data()),
+                               command.size(),
+                               false))
+            {
+                ++commandsOut;
+                pending[requestId] = Pending{target.presentedAtUs, hal::micros()};
+            }
+            return;
+        }
+
+        if (message.topic == target.context.topics.ackTopic)
+        {
+            const auto request = pending.find(requestIdOf(message.payload));
+            if (request == pending.end())
+            {
+                return;
+            }
+            ++acksIn;
+            const unsigned long now = hal::micros();
+            unlockUs.add(now - request->second.sentAtUs);
+            tapToAckUs.add(now - request->second.presentedAtUs);
+            pending.erase(request);
+        }
+    }
+
+    const std::vector<std::unique_ptr<FleetDevice>> &devices;
+    hal::PosixMqttTransport client;
+    std::unordered_map<std::string, size_t> indexById;
+    std::unordered_map<std::string, Pending> pending;
+    std::vector<Inbound> inbox;
+    uint64_t nextCommandId = 1;
+};
+
+struct CardEvent
+{
+    unsigned long atMs;
+    size_t device;
+    bool present;
+
+    bool operator>(const CardEvent &other) const
+    {
+        return static_cast<long>(atMs - other.atMs) > 0;
+    }
+};
+
+using CardSchedule = std::priority_queue<CardEvent, std::vector<CardEvent>, std::greater<CardEvent>>;
+
+struct StageResult
+{
+    size_t devices = 0;
+    unsigned long bootP50Ms = 0;
+    unsigned long bootP95Ms = 0;
+    unsigned long bootMaxMs = 0;
+    size_t bootStragglers = 0;
+    double publishesPerSecond = 0;
+    double kilobytesPerSecond = 0;
+    double commandsPerSecond = 0;
+    uint64_t taps = 0;
+    uint64_t lost = 0;
+    unsigned long unlockP50Us = 0;
+    unsigned long unlockP99Us = 0;
+    unsigned long tapToAckP50Us = 0;
+    unsigned long tapToAckP99Us = 0;
+    unsigned long stormP50Ms = 0;
+    unsigned long stormP95Ms = 0;
+    unsigned long stormMaxMs = 0;
+    size_t stormStragglers = 0;
+    uint64_t stormAttempts = 0;
+    uint64_t stormPeakAttemptsPerSecond = 0;
+};
+
+class Fleet
+{
+public:
+    Fleet(std::string brokerHost, uint16_t brokerPort, unsigned seed)
+        : host(std::move(brokerHost)), port(brokerPort), random(seed), service(devices)
+    {
+        prefix = "fleet" + std::to_string(getpid()) + "-";
+        config = "WIFI_SSID=fleet\nWIFI_PASS=fleet\nMQTT_BROKER_IP=" + host + "\nMQTT_PORT=" + std::to_string(port) + "\n";
+    }
+
+    bool connectService()
+    {
+        return service.connect(host, port, prefix + "service");
+    }
+
+    // Boots devices until the fleet has count of them and waits for their
+    // sessions. Returns each new device's time to connect.
+    Percentiles grow(size_t count, size_t &stragglers)
+    {
+        const size_t firstNew = devices.size();
+        const unsigned long startedAt = hal::millis();
+        for (size_t index = firstNew; index < count; ++index)
+        {
+            devices.push_back(std::make_unique<FleetDevice>(deviceIdFor(index), config));
+            service.registerDevice(devices.back()->id, index);
+            devices.back()->app.setup();
+            hal::startTask(DEVICE_TASK, runDevice, devices.back().get());
+        }
+
+        Percentiles bootMs;
+        std::vector<bool> online(count, false);
+        size_t remaining = count - firstNew;
+        while (remaining > 0 && hal::millis() - startedAt < BOOT_TIMEOUT_MS)
+        {
+            for (size_t index = firstNew; index < count; ++index)
+            {
+                if (!online[index] && devices[index]->mqtt.sessions.load() > 0)
+                {
+                    online[index] = true;
+                    bootMs.add(devices[index]->mqtt.lastConnectedAtMs.load() - startedAt);
+                    --remaining;
+                }
+            }
+            idle(MAX_WAIT_MS * 10);
+        }
+        stragglers = remaining;
+        return bootMs;
+    }
+
+    // Runs taps for windowMs and fills in traffic and latency figures.
+    void measureTraffic(unsigned long windowMs, double tapIntervalMs, StageResult &result)
+    {
+        std::exponential_distribution<double> tapGapMs(1.0 / tapIntervalMs);
+        CardSchedule schedule;
+        const unsigned long startedAt = hal::millis();
+        for (size_t index = 0; index < devices.size(); ++index)
+        {
+            schedule.push(CardEvent{startedAt + static_cast<unsigned long>(tapGapMs(random)), index, true});
+        }
+
+        service.resetStage();
+        service.forgetOutstanding();
+        const uint64_t publishesBefore = publishesOut.load();
+        const uint64_t bytesBefore = bytesOut.load();
+        uint64_t presented = 0;
+
+        while (hal::millis() - startedAt < windowMs)
+        {
+            const unsigned long now = hal::millis();
+            while (!schedule.empty() && deadlineReached(now, schedule.top().atMs))
+            {
+                const CardEvent event = schedule.top();
+                schedule.pop();
+                FleetDevice &device = *devices[event.device];
+                if (event.present)
+                {
+                    ++device.tapSequence;
+                    device.presentedAtUs = hal::micros();
+                    device.nfc.presentCard({0x04,
+                                            static_cast<uint8_t>(event.device >> 8),
+                                            static_cast<uint8_t>(event.device),
+                                            static_cast<uint8_t>(device.tapSequence >> 8),
+                                            static_cast<uint8_t>(device.tapSequence),
+                                            0xF1,
+                                            0xEE});
+                    ++presented;
+                    schedule.push(CardEvent{now + CARD_DWELL_MS, event.device, false});
+                    schedule.push(CardEvent{now + CARD_DWELL_MS + static_cast<unsigned long>(tapGapMs(random)), event.device, true});
+                }
+                else
+                {
+                    device.nfc.removeCard();
+                }
+            }
+
+            const unsigned long untilNext = schedule.empty() ? MAX_WAIT_MS : schedule.top().atMs - now;
+            waitForService(std::min(untilNext, MAX_WAIT_MS));
+        }
+        const double windowSeconds = static_cast<double>(hal::millis() - startedAt) / 1000.0;
+        const uint64_t publishes = publishesOut.load() - publishesBefore;
+        const uint64_t bytes = bytesOut.load() - bytesBefore;
+        for (const auto &device : devices)
+        {
+            device->nfc.removeCard();
+        }
+
+        idle(DRAIN_GRACE_MS);
+
+        result.publishesPerSecond = static_cast<double>(publishes) / windowSeconds;
+        result.kilobytesPerSecond = static_cast<double>(bytes) / 1024.0 / windowSeconds;
+        result.commandsPerSecond = static_cast<double>(service.commandsOut) / windowSeconds;
+        result.taps = presented;
+        result.lost = presented - service.acksIn;
+        result.unlockP50Us = service.unlockUs.at(50);
+        result.unlockP99Us = service.unlockUs.at(99);
+        result.tapToAckP50Us = service.tapToAckUs.at(50);
+        result.tapToAckP99Us = service.tapToAckUs.at(99);
+    }
+
+    // Cuts every session at once, as a broker restart would, and times the
+    // fleet coming back.
+    void measureStorm(StageResult &result)
+    {
+        std::vector<uint32_t> sessionsBefore(devices.size());
+        for (size_t index = 0; index < devices.size(); ++index)
+        {
+            sessionsBefore[index] = devices[index]->mqtt.sessions.load();
+        }
+
+        const uint64_t attemptsBefore = connectAttempts.load();
+        const unsigned long startedAt = hal::millis();
+        for (const auto &device : devices)
+        {
+            device->mqtt.severConnection();
+        }
+
+        Percentiles reconnectMs;
+        std::vector<bool> back(devices.size(), false);
+        size_t remaining = devices.size();
+        uint64_t attemptsAtSecond = attemptsBefore;
+        unsigned long secondStartedAt = startedAt;
+        uint64_t peakPerSecond = 0;
+        while (remaining > 0 && hal::millis() - startedAt < STORM_TIMEOUT_MS)
+        {
+            for (size_t index = 0; index < devices.size(); ++index)
+            {
+                if (!back[index] && devices[index]->mqtt.sessions.load() > sessionsBefore[index])
+                {
+                    back[index] = true;
+                    reconnectMs.add(devices[index]->mqtt.lastConnectedAtMs.load() - startedAt);
+                    --remaining;
+                }
+            }
+            if (hal::millis() - secondStartedAt >= 1000)
+            {
+                const uint64_t attempts = connectAttempts.load();
+                peakPerSecond = std::max(peakPerSecond, attempts - attemptsAtSecond);
+                attemptsAtSecond = attempts;
+                secondStartedAt = hal::millis();
+            }
+            idle(MAX_WAIT_MS * 10);
+        }
+        peakPerSecond = std::max(peakPerSecond, connectAttempts.load() - attemptsAtSecond);
+
+        result.stormStragglers = remaining;
+        result.stormAttempts = connectAttempts.load() - attemptsBefore;
+        result.stormPeakAttemptsPerSecond = peakPerSecond;
+        result.stormP50Ms = reconnectMs.at(50);
+        result.stormP95Ms = reconnectMs.at(95);
+        result.stormMaxMs = reconnectMs.at(100);
+    }
+
+    size_t size() const
+    {
+        return devices.size();
+    }
+
+private:
+    void waitForService(unsigned long timeoutMs)
+    {
+        const int fds[] = {service.socketFd()};
+        bool readable[] = {false};
+        hal::waitReadable(fds, readable, 1, timeoutMs);
+        service.pump();
+    }
+
+    // Shaped like the backend's Bike.id, and unique to this run so fleets
+    // sharing a broker keep apart.
+    static std::string deviceIdFor(size_t index)
+    {
+        char id[48];
+        std::snprintf(id, sizeof(id), "%08lx-0000-7000-8000-%012llx",
+                      static_cast<unsigned long>(getpid()) & 0xFFFFFFFFUL,
+                      static_cast<unsigned long long>(index) & 0xFFFFFFFFFFFFULL);
+        return id;
+    }
+
+    void idle(unsigned long durationMs)
+    {
+        const unsigned long startedAt = hal::millis();
+        for (unsigned long elapsedMs = 0; elapsedMs < durationMs; elapsedMs = hal::millis() - startedAt)
+        {
+            waitForService(std::min(MAX_WAIT_MS, durationMs - elapsedMs));
+        }
+    }
+
+    std::string host;
+    uint16_t port;
+    std::string prefix;
+    std::string config;
+    std::mt19937 random;
+    std::vector<std::unique_ptr<FleetDevice>> devices;
+    Service service;
+};
+
+double toMs(unsigned long micros)
+{
+    return static_cast<double>(micros) / 1000.0;
+}
+
+double toSeconds(unsigned long millis)
+{
+    return static_cast<double>(millis) / 1000.0;
+}
+
+// Every device holds a socket and an eventfd.
+void raiseDescriptorLimit()
+{
+    rlimit limit{};
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+    {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+void usage(const char *program)
+{
+    std::fprintf(stderr,
+                 "usage: %s [--broker host[:port]] [--devices n,n,...] [--window s] [--tap-interval s] "
+                 "[--seed n] [--csv path] [-v]\n",
+                 program);
+}
+}
+
+int main(int argc, char **argv)
+{
+    std::string brokerHost = "127.0.0.1";
+    uint16_t brokerPort = 1883;
+    std::vector<size_t> stages = {100, 250, 500};
+    unsigned long windowMs = 30000;
+    double tapIntervalMs = 20000;
+    unsigned seed = 1;
+    const char *csvPath = nullptr;
+    bool verbose = false;
+
+    for (int index = 1; index < argc; ++index)
+    {
+        const std::string argument = argv[index];
+        const bool hasValue = index + 1 < argc;
+        if (argument == "--broker" && hasValue)
+        {
+            brokerHost = argv[++index];
+            const size_t colon = brokerHost.rfind(':');
+            if (colon != std::string::npos)
+            {
+                brokerPort = static_cast<uint16_t>(std::strtoul(brokerHost.c_str() + colon + 1, nullptr, 10));
+                brokerHost.resize(colon);
+            }
+        }
+        else if (argument == "--devices" && hasValue)
+        {
+            stages.clear();
+            for (const char *cursor = argv[++index]; *cursor != '\0';)
+            {
+                char *end = nullptr;
+                stages.push_back(std::strtoul(cursor, &end, 10));
+                cursor = *end == ',' ? end + 1 : end;
+            }
+            std::sort(stages.begin(), stages.end());
+        }
+        else if (argument == "--window" && hasValue)
+        {
+            windowMs = std::strtoul(argv[++index], nullptr, 10) * 1000;
+        }
+        else if (argument == "--tap-interval" && hasValue)
+        {
+            tapIntervalMs = std::strtod(argv[++index], nullptr) * 1000.0;
+        }
+        else if (argument == "--seed" && hasValue)
+        {
+            seed = static_cast<unsigned>(std::strtoul(argv[++index], nullptr, 10));
+        }
+        else if (argument == "--csv" && hasValue)
+        {
+            csvPath = argv[++index];
+        }
+        else if (argument == "-v")
+        {
+            verbose = true;
+        }
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (stages.empty() || stages.front() == 0 || windowMs == 0 || tapIntervalMs <= 0)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    raiseDescriptorLimit();
+
+    // Claim the log renderer before any App does, so device logs go to one
+    // console instead of piling up in the first device's serial buffer.
+    hal::FakeSerialPort console(verbose);
+    const uint8_t logLevel = verbose ? LOG_LEVEL_NOTICE : LOG_LEVEL_SILENT;
+    DeferredLog::begin(console, logLevel);
+
+    Fleet fleet(brokerHost, brokerPort, seed);
+    if (!fleet.connectService())
+    {
+        std::fprintf(stderr, "cannot reach an MQTT broker at %s:%u\n", brokerHost.c_str(), brokerPort);
+        return 1;
+    }
+
+    FILE *csv = csvPath != nullptr ? std::fopen(csvPath, "w") : nullptr;
+    if (csvPath != nullptr && csv == nullptr)
+    {
+        std::fprintf(stderr, "cannot write %s\n", csvPath);
+        return 1;
+    }
+    if (csv != nullptr)
+    {
+        std::fprintf(csv, "devices,boot_p50_ms,boot_p95_ms,boot_max_ms,boot_stragglers,publishes_per_s,kib_per_s,"
+                          "commands_per_s,taps,lost,unlock_p50_us,unlock_p99_us,tap_to_ack_p50_us,tap_to_ack_p99_us,"
+                          "storm_p50_ms,storm_p95_ms,storm_max_ms,storm_stragglers,storm_attempts,storm_peak_attempts_per_s\n");
+    }
+
+    std::printf("broker %s:%u, %lu s window, one tap per device every %.1f s on average, seed %u\n",
+                brokerHost.c_str(), brokerPort, windowMs / 1000, tapIntervalMs / 1000.0, seed);
+    std::printf("%7s | %-20s | %-21s | %-15s | %-15s | %5s | %-20s %8s %7s\n",
+                "", "boot s p50/p95/max", "pub/s  KiB/s  cmd/s", "unlock ms 50/99", "tap>ack ms 50/99",
+                "lost", "storm s p50/p95/max", "attempts", "peak/s");
+
+    bool degraded = false;
+    for (const size_t count : stages)
+    {
+        StageResult result;
+        result.devices = count;
+
+        Percentiles boot = fleet.grow(count, result.bootStragglers);
+        DeferredLog::setLevel(logLevel); // App::setup() raises it again
+        result.bootP50Ms = boot.at(50);
+        result.bootP95Ms = boot.at(95);
+        result.bootMaxMs = boot.at(100);
+
+        fleet.measureTraffic(windowMs, tapIntervalMs, result);
+        fleet.measureStorm(result);
+        degraded = degraded || result.bootStragglers > 0 || result.stormStragglers > 0 || result.lost > 0;
+
+        std::printf("%7zu | %6.1f %6.1f %6.1f | %6.0f %6.1f %7.1f | %7.1f %7.1f | %7.1f %7.1f | %5llu | %6.1f %6.1f %6.1f %8llu %7llu\n",
+                    result.devices,
+                    toSeconds(result.bootP50Ms), toSeconds(result.bootP95Ms), toSeconds(result.bootMaxMs),
+                    result.publishesPerSecond, result.kilobytesPerSecond, result.commandsPerSecond,
+                    toMs(result.unlockP50Us), toMs(result.unlockP99Us),
+                    toMs(result.tapToAckP50Us), toMs(result.tapToAckP99Us),
+                    static_cast<unsigned long long>(result.lost),
+                    toSeconds(result.stormP50Ms), toSeconds(result.stormP95Ms), toSeconds(result.stormMaxMs),
+                    static_cast<unsigned long long>(result.stormAttempts),
+                    static_cast<unsigned long long>(result.stormPeakAttemptsPerSecond));
+        if (result.bootStragglers > 0 || result.stormStragglers > 0)
+        {
+            std::printf("        %zu devices never booted, %zu never reconnected after the storm\n",
+                        result.bootStragglers, result.stormStragglers);
+        }
+        std::fflush(stdout);
+
+        if (csv != nullptr)
+        {
+            std::fprintf(csv, "%zu,%lu,%lu,%lu,%zu,%.1f,%.2f,%.2f,%llu,%llu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%zu,%llu,%llu\n",
+                         result.devices, result.bootP50Ms, result.bootP95Ms, result.bootMaxMs, result.bootStragglers,
+                         result.publishesPerSecond, result.kilobytesPerSecond, result.commandsPerSecond,
+                         static_cast<unsigned long long>(result.taps), static_cast<unsigned long long>(result.lost),
+                         result.unlockP50Us, result.unlockP99Us, result.tapToAckP50Us, result.tapToAckP99Us,
+                         result.stormP50Ms, result.stormP95Ms, result.stormMaxMs, result.stormStragglers,
+                         static_cast<unsigned long long>(result.stormAttempts),
+                         static_cast<unsigned long long>(result.stormPeakAttemptsPerSecond));
+            std::fflush(csv);
+        }
+    }
+
+    if (csv != nullptr)
+    {
+        std::fclose(csv);
+    }
+    host::quickExit(degraded ? 3 : 0);
+}
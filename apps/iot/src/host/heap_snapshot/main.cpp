@@ -0,0 +1,440 @@
+// Heap snapshot of the firmware App on the host build. Global operator
+// new/delete are replaced with counting versions, then the App is booted
+// against the fakes and driven through tap and unlock round trips. Heap
+// use is reported at each stage: device identity, boot, first MQTT
+// session, and per round trip once warm. Allocations made by the fakes
+// to record traffic for the harness are left out, so the numbers are what
+// the firmware itself asks of the allocator.
+//
+//   pio run -e native_heap_snapshot
+//   .pio/build/native_heap_snapshot/program [--cycles n] [--csv out.csv] [-v]
+//
+// Exits non-zero if a round trip fails or live heap keeps growing across
+// warm round trips. Boot and round-trip counts include ArduinoJson, so they
+// are only the firmware's when pio builds this against the real library;
+// a stand-in that allocates per document inflates both.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "app/App.h"
+#include "hal/native/FakePlatform.h"
+#include "host/HostSupport.h"
+#include "logging/DeferredLog.h"
+
+namespace
+{
+constexpr unsigned long STEP_TIMEOUT_MS = 8000;
+// Three missed 80 ms polls before the watcher forgets the last card.
+constexpr unsigned long CARD_RELEASE_MS = 400;
+constexpr unsigned DEFAULT_CYCLES = 20;
+constexpr const char *DEVICE_ID = "heap-bike";
+
+const char *const CONFIG_FILE =
+    "BIKE_ID=heap-bike\n"
+    "WIFI_SSID=bench\n"
+    "WIFI_PASS=bench\n"
+    "MQTT_BROKER_IP=127.0.0.1\n"
+    "MQTT_PORT=1883\n"
+    // Cycles tap back to back, far over any real bay's rate.
+    "TAP_RATE_PER_MIN=0\n";
+
+// Every block carries its size and whether it was counted, so frees match
+// the allocation even when they happen outside the scope that made it.
+struct alignas(std::max_align_t) BlockHeader
+{
+    size_t size;
+    bool counted;
+};
+
+std::atomic<long long> liveBytes{0};
+std::atomic<long long> liveBlocks{0};
+std::atomic<long long> peakLiveBytes{0};
+std::atomic<unsigned long long> totalAllocations{0};
+std::atomic<unsigned long long> totalAllocatedBytes{0};
+thread_local int uncountedDepth = 0;
+
+void *allocate(size_t size, bool throwOnFailure)
+{
+    void *raw = std::malloc(sizeof(BlockHeader) + size);
+    if (raw == nullptr)
+    {
+        if (throwOnFailure)
+        {
+            throw std::bad_alloc();
+        }
+        return nullptr;
+    }
+
+    BlockHeader *header = static_cast<BlockHeader *>(raw);
+    header->size = size;
+    header->counted = uncountedDepth == 0;
+    if (header->counted)
+    {
+        const long long live = liveBytes.fetch_add(static_cast<long long>(size)) + static_cast<long long>(size);
+        liveBlocks.fetch_add(1);
+        totalAllocations.fetch_add(1);
+        totalAllocatedBytes.fetch_add(size);
+        long long peak = peakLiveBytes.load();
+        while (live > peak && !peakLiveBytes.compare_exchange_weak(peak, live))
+        {
+        }
+    }
+    return header + 1;
+}
+
+void release(void *pointer)
+{
+    if (pointer == nullptr)
+    {
+        return;
+    }
+
+    BlockHeader *header = static_cast<BlockHeader *>(pointer) - 1;
+    if (header->counted)
+    {
+        liveBytes.fetch_sub(static_cast<long long>(header->size));
+        liveBlocks.fetch_sub(1);
+    }
+    std::free(header);
+}
+
+// Allocations made while one of these is alive are not counted.
+class Uncounted
+{
+public:
+    Uncounted() { ++uncountedDepth; }
+    ~Uncounted() { --uncountedDepth; }
+    Uncounted(const Uncounted &) = delete;
+    Uncounted &operator=(const Uncounted &) = delete;
+};
+
+// Counting resumes for firmware code called back from inside an
+// uncounted fake.
+class Counted
+{
+public:
+    Counted() : savedDepth(uncountedDepth) { uncountedDepth = 0; }
+    ~Counted() { uncountedDepth = savedDepth; }
+    Counted(const Counted &) = delete;
+    Counted &operator=(const Counted &) = delete;
+
+private:
+    int savedDepth;
+};
+
+struct Snapshot
+{
+    long long liveBytes = 0;
+    long long liveBlocks = 0;
+    unsigned long long allocations = 0;
+    unsigned long long allocatedBytes = 0;
+};
+
+Snapshot takeSnapshot()
+{
+    return Snapshot{liveBytes.load(), liveBlocks.load(), totalAllocations.load(), totalAllocatedBytes.load()};
+}
+
+// Keeps the serial log for the harness only.
+class HarnessSerialPort : public hal::FakeSerialPort
+{
+public:
+    using FakeSerialPort::FakeSerialPort;
+
+    size_t write(const uint8_t *data, size_t length) override
+    {
+        const Uncounted uncounted;
+        return FakeSerialPort::write(data, length);
+    }
+};
+
+// PubSubClient writes straight into its fixed packet buffer; the fake's
+// recorded copies and subscription set belong to the harness.
+class HarnessMqttTransport : public hal::FakeMqttTransport
+{
+public:
+    void setCallback(MessageCallback callback) override
+    {
+        FakeMqttTransport::setCallback([callback](char *topic, uint8_t *payload, unsigned int length)
+                                       {
+                                           const Counted counted;
+                                           callback(topic, payload, length);
+                                       });
+    }
+
+    bool publish(const char *topic, const uint8_t *payload, size_t length, bool retained) override
+    {
+        const Uncounted uncounted;
+        return FakeMqttTransport::publish(topic, payload, length, retained);
+    }
+
+    bool subscribe(const char *topic) override
+    {
+        const Uncounted uncounted;
+        return FakeMqttTransport::subscribe(topic);
+    }
+
+    bool loop() override
+    {
+        const Uncounted uncounted;
+        return FakeMqttTransport::loop();
+    }
+
+    // Hides the fake's own, so the copies the harness drains stay
+    // uncounted too.
+    std::vector<Message> takePublished()
+    {
+        const Uncounted uncounted;
+        return FakeMqttTransport::takePublished();
+    }
+};
+
+struct Stage
+{
+    const char *name;
+    Snapshot delta;
+    Snapshot after;
+};
+
+Snapshot difference(const Snapshot &after, const Snapshot &before)
+{
+    return Snapshot{after.liveBytes - before.liveBytes,
+                    after.liveBlocks - before.liveBlocks,
+                    after.allocations - before.allocations,
+                    after.allocatedBytes - before.allocatedBytes};
+}
+
+void printStage(const Stage &stage)
+{
+    std::printf("%-12s %+9lld B %+6lld blk   %8llu allocs %10llu B   live %8lld B %6lld blk\n",
+                stage.name,
+                stage.delta.liveBytes,
+                stage.delta.liveBlocks,
+                stage.delta.allocations,
+                stage.delta.allocatedBytes,
+                stage.after.liveBytes,
+                stage.after.liveBlocks);
+}
+
+bool writeCsv(const char *path, const std::vector<Stage> &stages)
+{
+    FILE *file = std::fopen(path, "w");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    std::fprintf(file, "stage,live_bytes_delta,live_blocks_delta,allocations,allocated_bytes,live_bytes,live_blocks\n");
+    for (const Stage &stage : stages)
+    {
+        std::fprintf(file, "%s,%lld,%lld,%llu,%llu,%lld,%lld\n",
+                     stage.name,
+                     stage.delta.liveBytes,
+                     stage.delta.liveBlocks,
+                     stage.delta.allocations,
+                     stage.delta.allocatedBytes,
+                     stage.after.liveBytes,
+                     stage.after.liveBlocks);
+    }
+    std::fclose(file);
+    return true;
+}
+}
+
+void *operator new(size_t size)
+{
+    return allocate(size, true);
+}
+
+void *operator new[](size_t size)
+{
+    return allocate(size, true);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size, false);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return allocate(size, false);
+}
+
+void operator delete(void *pointer) noexcept
+{
+    release(pointer);
+}
+
+void operator delete[](void *pointer) noexcept
+{
+    release(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept
+{
+    release(pointer);
+}
+
+void operator delete[](void *pointer, size_t) noexcept
+{
+    release(pointer);
+}
+
+void operator delete(void *pointer, const std::nothrow_t &) noexcept
+{
+    release(pointer);
+}
+
+void operator delete[](void *pointer, const std::nothrow_t &) noexcept
+{
+    release(pointer);
+}
+
+int main(int argc, char **argv)
+{
+    bool verbose = false;
+    unsigned cycles = DEFAULT_CYCLES;
+    const char *csvPath = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "-v") == 0)
+        {
+            verbose = true;
+        }
+        else if (std::strcmp(argv[i], "--cycles") == 0 && i + 1 < argc)
+        {
+            cycles = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if (std::strcmp(argv[i], "--csv") == 0 && i + 1 < argc)
+        {
+            csvPath = argv[++i];
+        }
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--cycles n] [--csv out.csv] [-v]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (cycles < 2)
+    {
+        cycles = 2;
+    }
+
+    std::vector<Stage> stages;
+    stages.reserve(8);
+
+    hal::FakePlatform fake(verbose);
+    HarnessSerialPort serial(verbose);
+    HarnessMqttTransport mqtt;
+    fake.storage.files["/.env"] = CONFIG_FILE;
+    hal::Platform platform{serial, fake.storage, fake.pwm, &fake.bay, 1, fake.wifi, mqtt, fake.system, fake.networkTime};
+
+    Snapshot before = takeSnapshot();
+    const DeviceContext context = makeDeviceContext(DEVICE_ID);
+    Snapshot after = takeSnapshot();
+    stages.push_back(Stage{"identity", difference(after, before), after});
+
+    before = after;
+    App app(platform);
+    app.setup();
+    after = takeSnapshot();
+    stages.push_back(Stage{"boot", difference(after, before), after});
+
+    before = after;
+    if (!host::runUntilPublished(app, mqtt, context.topics.statusTopic, [](const std::string &payload)
+                                 { return host::contains(payload, "\"mqttConnected\":true"); },
+                                 STEP_TIMEOUT_MS))
+    {
+        std::fprintf(stderr, "FAIL: device never reported an MQTT session\n");
+        return host::finish(1);
+    }
+    after = takeSnapshot();
+    stages.push_back(Stage{"online", difference(after, before), after});
+
+    Snapshot warm;
+    for (unsigned cycle = 0; cycle < cycles; ++cycle)
+    {
+        if (cycle == 1)
+        {
+            warm = takeSnapshot();
+        }
+
+        {
+            const Uncounted uncounted;
+            fake.nfc.presentCard({0x04, 0xA2, 0x3B, static_cast<uint8_t>(cycle)});
+        }
+        if (!host::runUntilPublished(app, mqtt, context.topics.tapEventTopic, [](const std::string &payload)
+                                     { return host::contains(payload, "\"cardUid\""); },
+                                     STEP_TIMEOUT_MS))
+        {
+            std::fprintf(stderr, "FAIL: tap %u was not published\n", cycle + 1);
+            return host::finish(1);
+        }
+        fake.nfc.removeCard();
+
+        char command[96];
+        std::snprintf(command, sizeof(command), R"({"action":"unlock","requestId":"heap-%u"})", cycle + 1);
+        char expectedAck[48];
+        std::snprintf(expectedAck, sizeof(expectedAck), "\"requestId\":\"heap-%u\"", cycle + 1);
+        {
+            const Uncounted uncounted;
+            mqtt.deliver(context.topics.commandTopic, command);
+        }
+        if (!host::runUntilPublished(app, mqtt, context.topics.ackTopic, [&expectedAck](const std::string &payload)
+                                     { return host::contains(payload, expectedAck) && host::contains(payload, "\"status\":\"done\""); },
+                                     STEP_TIMEOUT_MS))
+        {
+            std::fprintf(stderr, "FAIL: unlock %u was not acknowledged\n", cycle + 1);
+            return host::finish(1);
+        }
+
+        host::runFor(app, mqtt, CARD_RELEASE_MS);
+
+        if (cycle == 0)
+        {
+            after = takeSnapshot();
+            stages.push_back(Stage{"first-cycle", difference(after, before), after});
+            before = after;
+        }
+    }
+
+    after = takeSnapshot();
+    const Snapshot warmDelta = difference(after, warm);
+    const unsigned warmCycles = cycles - 1;
+    stages.push_back(Stage{"warm-cycles", warmDelta, after});
+    Snapshot perCycle{warmDelta.liveBytes / warmCycles,
+                      warmDelta.liveBlocks / warmCycles,
+                      warmDelta.allocations / warmCycles,
+                      warmDelta.allocatedBytes / warmCycles};
+    stages.push_back(Stage{"per-cycle", perCycle, after});
+
+    DeferredLog::flush();
+    std::printf("%-12s %11s %10s   %15s %12s   %s\n", "stage", "live", "blocks", "allocations", "bytes", "after stage");
+    for (const Stage &stage : stages)
+    {
+        printStage(stage);
+    }
+    std::printf("peak live heap %lld B, %u round trips\n", peakLiveBytes.load(), cycles);
+
+    if (csvPath != nullptr && !writeCsv(csvPath, stages))
+    {
+        std::fprintf(stderr, "FAIL: could not write %s\n", csvPath);
+        return host::finish(1);
+    }
+
+    if (warmDelta.liveBytes > 0)
+    {
+        std::fprintf(stderr, "FAIL: live heap grew by %lld B over %u warm round trips\n", warmDelta.liveBytes, warmCycles);
+        return host::finish(1);
+    }
+
+    std::printf("OK\n");
+    return host::finish(0);
+}
@@ -0,0 +1,480 @@
+// Compares the schema serializers in services/OutboundMessages with the
+// ArduinoJson documents they replaced. Every message is first built both
+// ways over a spread of inputs (escapes, optional fields, echoed traces) and
+// the bytes must match; then each path is timed and run once on a painted
+// stack to measure how deep it goes.
+//
+//   pio run -e native_json_bench
+//   .pio/build/native_json_bench/program [--iterations n] [--csv out.csv]
+//
+// Exits non-zero on the first mismatch. Cycle counts use the TSC and are
+// only printed on x86 hosts; stack depth is for the host ABI, so read it as
+// a ratio rather than as ESP32 bytes. The byte comparison and the document
+// column only say something about ArduinoJson when pio builds this against
+// ArduinoJson 6 itself. Built against a stand-in header the bench says so,
+// and the document column then reflects the stand-in, not the library.
+
+#include <ucontext.h>
+
+#include <ArduinoJson.h>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define JSON_BENCH_HAS_TSC 1
+#endif
+
+#include "services/OutboundMessages.h"
+#include "services/RequestTrace.h"
+
+namespace
+{
+constexpr unsigned long DEFAULT_ITERATIONS = 200000;
+constexpr size_t PAYLOAD_CAPACITY = 512;
+constexpr size_t PROBE_STACK_SIZE = 64 * 1024;
+constexpr unsigned char STACK_PAINT = 0xA5;
+
+// Reference builders: the document code the publishers ran before the
+// schemas, kept verbatim apart from reading from the message structs.
+void stampDocument(JsonDocument &doc, const std::optional<uint64_t> &epochMs, const char *timeSync, uint32_t boot)
+{
+    if (epochMs.has_value())
+    {
+        doc["epochMs"] = *epochMs;
+    }
+    doc["timeSync"] = timeSync;
+    doc["boot"] = boot;
+}
+
+void writeStages(JsonObject trace, const RequestTrace &stages)
+{
+    for (size_t index = 0; index < RequestTrace::STAGE_COUNT; ++index)
+    {
+        const TraceStage stage = static_cast<TraceStage>(index);
+        if (stages.has(stage))
+        {
+            trace[traceStageKey(stage)] = stages.at(stage);
+        }
+    }
+}
+
+size_t documentTapEvent(const TapEventMessage &message, char *payload, size_t capacity)
+{
+    StaticJsonDocument<256> doc;
+    doc["requestId"] = message.requestId;
+    doc["deviceId"] = message.deviceId;
+    doc["cardUid"] = message.cardUid;
+    if (message.cardType.has_value())
+    {
+        doc["cardType"] = *message.cardType;
+    }
+    if (message.ambiguous.has_value())
+    {
+        doc["ambiguous"] = *message.ambiguous;
+    }
+    if (message.otherCardUid.has_value())
+    {
+        doc["otherCardUid"] = *message.otherCardUid;
+    }
+    if (message.bay.has_value())
+    {
+        doc["bay"] = *message.bay;
+    }
+    doc["timestampMs"] = message.timestampMs;
+    stampDocument(doc, message.epochMs, message.timeSync, message.boot);
+    writeStages(doc.createNestedObject("trace"), *message.trace.stages);
+
+    const size_t length = serializeJson(doc, payload, capacity);
+    return length >= capacity ? 0 : length;
+}
+
+size_t documentRuntimeStatus(const RuntimeStatusMessage &message, char *payload, size_t capacity)
+{
+    StaticJsonDocument<256> doc;
+    doc["deviceId"] = message.deviceId;
+    doc["runtimeState"] = message.runtimeState;
+    doc["wifiConnected"] = message.wifiConnected;
+    doc["mqttConnected"] = message.mqttConnected;
+    doc["nfcHealthy"] = message.nfcHealthy;
+    if (message.nfcHealthyBays.has_value())
+    {
+        doc["nfcHealthyBays"] = *message.nfcHealthyBays;
+    }
+    doc["timestampMs"] = message.timestampMs;
+    stampDocument(doc, message.epochMs, message.timeSync, message.boot);
+
+    const size_t length = serializeJson(doc, payload, capacity);
+    return length >= capacity ? 0 : length;
+}
+
+size_t documentCommandAck(const CommandAckMessage &message, char *payload, size_t capacity)
+{
+    StaticJsonDocument<512> doc;
+    doc["deviceId"] = message.deviceId;
+    doc["requestId"] = message.requestId;
+    doc["action"] = message.action;
+    doc["status"] = message.status;
+    stampDocument(doc, message.epochMs, message.timeSync, message.boot);
+    if (message.detail.has_value())
+    {
+        doc["detail"] = *message.detail;
+    }
+    if (message.actuationMs.has_value())
+    {
+        doc["actuationMs"] = *message.actuationMs;
+    }
+
+    JsonObject trace = doc.createNestedObject("trace");
+    if (message.trace.echoed != nullptr && !message.trace.echoed->isNull())
+    {
+        trace.set(message.trace.echoed->as<JsonObjectConst>());
+    }
+    writeStages(trace, *message.trace.stages);
+
+    const size_t length = serializeJson(doc, payload, capacity);
+    return length >= capacity ? 0 : length;
+}
+
+struct Inputs
+{
+    RequestTrace tapStages;
+    RequestTrace commandStages;
+    StaticJsonDocument<256> echoed;
+    TapEventMessage tap;
+    RuntimeStatusMessage status;
+    CommandAckMessage ack;
+};
+
+void markAll(RequestTrace &trace, std::initializer_list<TraceStage> stages)
+{
+    for (TraceStage stage : stages)
+    {
+        trace.mark(stage);
+    }
+}
+
+// Fills every message from one case number, cycling the optional parts and
+// string contents independently.
+void buildInputs(Inputs &inputs, unsigned variant)
+{
+    static const char *const REQUEST_IDS[] = {"bike-17-3-120044-9", "plain", "quote\"and\\slash/", "tab\there\nnewline"};
+    static const char *const DEVICE_IDS[] = {"bike-17", "", "b\b\f\r"};
+    static const char *const CARD_UIDS[] = {"04A23B11", "04A23B11C2D3E4", "\x01raw-control"};
+    static const char *const ECHOES[] = {"", "{}", R"({"serviceSentUs":42})",
+                                         R"({"serviceSentUs":18446744073709551615,"hop":"edge-1","path":["a","b"],"nested":{"k":true,"n":null}})"};
+    static const char *const DETAILS[] = {"unlock_simulated", "denied", "reason with \"quotes\""};
+
+    inputs.tapStages.clear();
+    inputs.commandStages.clear();
+    markAll(inputs.tapStages, {TraceStage::CardDetected, TraceStage::TapPublished});
+    if (variant % 2 == 0)
+    {
+        markAll(inputs.commandStages, {TraceStage::CommandReceived, TraceStage::CommandParsed});
+    }
+    if (variant % 3 != 1)
+    {
+        markAll(inputs.commandStages, {TraceStage::FeedbackApplied, TraceStage::AckSent});
+    }
+
+    inputs.echoed.clear();
+    const char *echo = ECHOES[variant % 4];
+    if (echo[0] != '\0')
+    {
+        deserializeJson(inputs.echoed, echo);
+    }
+
+    const std::optional<uint64_t> epochMs = variant % 2 == 0 ? std::optional<uint64_t>(1700000000000ULL + variant) : std::nullopt;
+    const char *timeSync = variant % 2 == 0 ? "synced" : "none";
+    const uint32_t boot = variant == 0 ? UINT32_MAX : variant;
+    const uint64_t timestampMs = variant == 1 ? 0 : 86400000ULL * variant + 7;
+
+    inputs.tap = TapEventMessage{};
+    inputs.tap.requestId = REQUEST_IDS[variant % 4];
+    inputs.tap.deviceId = DEVICE_IDS[variant % 3];
+    inputs.tap.cardUid = CARD_UIDS[variant % 3];
+    if (variant % 3 == 1)
+    {
+        inputs.tap.bay = variant % 8;
+    }
+    if (variant % 5 == 3)
+    {
+        inputs.tap.cardType = variant % 2 == 0 ? "felica" : "iso14443b";
+    }
+    if (variant % 4 == 2)
+    {
+        inputs.tap.ambiguous = true;
+        inputs.tap.otherCardUid = CARD_UIDS[(variant + 1) % 3];
+    }
+    inputs.tap.timestampMs = timestampMs;
+    inputs.tap.epochMs = epochMs;
+    inputs.tap.timeSync = timeSync;
+    inputs.tap.boot = boot;
+    inputs.tap.trace.stages = &inputs.tapStages;
+
+    inputs.status = RuntimeStatusMessage{};
+    inputs.status.deviceId = DEVICE_IDS[variant % 3];
+    inputs.status.runtimeState = variant % 2 == 0 ? "ready" : "offline";
+    inputs.status.wifiConnected = (variant & 1) != 0;
+    inputs.status.mqttConnected = (variant & 2) != 0;
+    inputs.status.nfcHealthy = (variant & 4) != 0;
+    if (variant % 3 == 2)
+    {
+        inputs.status.nfcHealthyBays = variant % 2 == 0 ? 0xFFu : 0x5Au;
+    }
+    inputs.status.timestampMs = timestampMs;
+    inputs.status.epochMs = epochMs;
+    inputs.status.timeSync = timeSync;
+    inputs.status.boot = boot;
+
+    inputs.ack = CommandAckMessage{};
+    inputs.ack.deviceId = DEVICE_IDS[variant % 3];
+    inputs.ack.requestId = REQUEST_IDS[(variant + 1) % 4];
+    inputs.ack.action = variant % 5 == 0 ? "" : "unlock";
+    inputs.ack.status = "done";
+    inputs.ack.epochMs = epochMs;
+    inputs.ack.timeSync = timeSync;
+    inputs.ack.boot = boot;
+    if (variant % 3 != 2)
+    {
+        inputs.ack.detail = DETAILS[variant % 3];
+    }
+    if (variant % 2 == 0)
+    {
+        inputs.ack.actuationMs = 40 + variant;
+    }
+    inputs.ack.trace.stages = &inputs.commandStages;
+    inputs.ack.trace.echoed = &inputs.echoed;
+}
+
+struct Path
+{
+    const char *message;
+    const char *serializer;
+    std::function<size_t(const Inputs &, char *, size_t)> run;
+};
+
+std::vector<Path> paths()
+{
+    return {
+        {"tap", "document", [](const Inputs &in, char *out, size_t cap) { return documentTapEvent(in.tap, out, cap); }},
+        {"tap", "schema", [](const Inputs &in, char *out, size_t cap) { return serializeTapEvent(in.tap, out, cap); }},
+        {"status", "document", [](const Inputs &in, char *out, size_t cap) { return documentRuntimeStatus(in.status, out, cap); }},
+        {"status", "schema", [](const Inputs &in, char *out, size_t cap) { return serializeRuntimeStatus(in.status, out, cap); }},
+        {"ack", "document", [](const Inputs &in, char *out, size_t cap) { return documentCommandAck(in.ack, out, cap); }},
+        {"ack", "schema", [](const Inputs &in, char *out, size_t cap) { return serializeCommandAck(in.ack, out, cap); }},
+    };
+}
+
+bool verify(const std::vector<Path> &all)
+{
+    constexpr unsigned VARIANTS = 60;
+    Inputs inputs;
+    for (unsigned variant = 0; variant < VARIANTS; ++variant)
+    {
+        buildInputs(inputs, variant);
+        for (size_t index = 0; index + 1 < all.size(); index += 2)
+        {
+            char expected[PAYLOAD_CAPACITY];
+            char actual[PAYLOAD_CAPACITY];
+            const size_t expectedLength = all[index].run(inputs, expected, sizeof(expected));
+            const size_t actualLength = all[index + 1].run(inputs, actual, sizeof(actual));
+            if (expectedLength == 0 || expectedLength != actualLength || std::memcmp(expected, actual, expectedLength) != 0)
+            {
+                std::fprintf(stderr, "FAIL: %s variant %u differs\n  document: %s\n  schema:   %s\n",
+                             all[index].message, variant, expected, actual);
+                return false;
+            }
+
+            // Every shorter buffer must be refused rather than cut.
+            for (size_t capacity = 0; capacity <= expectedLength; ++capacity)
+            {
+                if (all[index + 1].run(inputs, actual, capacity) != 0)
+                {
+                    std::fprintf(stderr, "FAIL: %s variant %u fit %zu bytes into %zu\n",
+                                 all[index].message, variant, expectedLength, capacity);
+                    return false;
+                }
+            }
+        }
+    }
+#ifdef ARDUINOJSON_VERSION
+    std::printf("%u inputs per message serialize identically to ArduinoJson %s\n", VARIANTS, ARDUINOJSON_VERSION);
+#else
+    std::printf("%u inputs per message match the ArduinoJson stand-in this was built with; "
+                "not a check against the library\n",
+                VARIANTS);
+#endif
+    return true;
+}
+
+struct StackProbe
+{
+    const Path *path = nullptr;
+    const Inputs *inputs = nullptr;
+    ucontext_t caller;
+};
+
+StackProbe *activeProbe = nullptr;
+
+void runProbe()
+{
+    char payload[PAYLOAD_CAPACITY];
+    activeProbe->path->run(*activeProbe->inputs, payload, sizeof(payload));
+}
+
+// Deepest point the path reaches on a fresh stack, payload buffer included.
+size_t measureStack(const Path &path, const Inputs &inputs)
+{
+    std::vector<unsigned char> stack(PROBE_STACK_SIZE, STACK_PAINT);
+    StackProbe probe;
+    probe.path = &path;
+    probe.inputs = &inputs;
+    activeProbe = &probe;
+
+    ucontext_t context;
+    getcontext(&context);
+    context.uc_stack.ss_sp = stack.data();
+    context.uc_stack.ss_size = stack.size();
+    context.uc_link = &probe.caller;
+    makecontext(&context, runProbe, 0);
+    swapcontext(&probe.caller, &context);
+    activeProbe = nullptr;
+
+    size_t untouched = 0;
+    while (untouched < stack.size() && stack[untouched] == STACK_PAINT)
+    {
+        ++untouched;
+    }
+    return stack.size() - untouched;
+}
+
+struct Result
+{
+    const Path *path;
+    double nsPerOp = 0;
+    double cyclesPerOp = 0;
+    size_t stackBytes = 0;
+    size_t payloadBytes = 0;
+};
+
+Result measure(const Path &path, const Inputs &inputs, unsigned long iterations)
+{
+    Result result;
+    result.path = &path;
+    char payload[PAYLOAD_CAPACITY];
+    result.payloadBytes = path.run(inputs, payload, sizeof(payload));
+
+    size_t sink = 0;
+    const auto startedAt = std::chrono::steady_clock::now();
+#ifdef JSON_BENCH_HAS_TSC
+    const uint64_t startedCycles = __rdtsc();
+#endif
+    for (unsigned long iteration = 0; iteration < iterations; ++iteration)
+    {
+        sink += path.run(inputs, payload, sizeof(payload));
+    }
+#ifdef JSON_BENCH_HAS_TSC
+    result.cyclesPerOp = static_cast<double>(__rdtsc() - startedCycles) / iterations;
+#endif
+    const auto elapsed = std::chrono::steady_clock::now() - startedAt;
+    result.nsPerOp = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+    if (sink != result.payloadBytes * iterations)
+    {
+        std::fprintf(stderr, "warning: %s/%s output changed between runs\n", path.message, path.serializer);
+    }
+
+    result.stackBytes = measureStack(path, inputs);
+    return result;
+}
+
+bool writeCsv(const char *path, const std::vector<Result> &results)
+{
+    FILE *file = std::fopen(path, "w");
+    if (file == nullptr)
+    {
+        return false;
+    }
+    std::fprintf(file, "message,serializer,payload_bytes,ns_per_op,cycles_per_op,stack_bytes\n");
+    for (const Result &result : results)
+    {
+        std::fprintf(file, "%s,%s,%zu,%.1f,%.0f,%zu\n",
+                     result.path->message,
+                     result.path->serializer,
+                     result.payloadBytes,
+                     result.nsPerOp,
+                     result.cyclesPerOp,
+                     result.stackBytes);
+    }
+    std::fclose(file);
+    return true;
+}
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long iterations = DEFAULT_ITERATIONS;
+    const char *csvPath = nullptr;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+        {
+            iterations = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (std::strcmp(argv[i], "--csv") == 0 && i + 1 < argc)
+        {
+            csvPath = argv[++i];
+        }
+        else
+        {
+            std::fprintf(stderr, "usage: %s [--iterations n] [--csv out.csv]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (iterations == 0)
+    {
+        iterations = 1;
+    }
+
+    const std::vector<Path> all = paths();
+    if (!verify(all))
+    {
+        return 1;
+    }
+
+    // Benchmark the shape the device sends most: synced clock, echoed trace,
+    // all stages marked.
+    Inputs inputs;
+    buildInputs(inputs, 2);
+
+    std::vector<Result> results;
+    for (const Path &path : all)
+    {
+        results.push_back(measure(path, inputs, iterations));
+    }
+
+    std::printf("%-8s %-9s %8s %10s %12s %10s\n", "message", "path", "bytes", "ns/op", "cycles/op", "stack");
+    for (const Result &result : results)
+    {
+        std::printf("%-8s %-9s %8zu %10.1f %12.0f %8zu B\n",
+                    result.path->message,
+                    result.path->serializer,
+                    result.payloadBytes,
+                    result.nsPerOp,
+                    result.cyclesPerOp,
+                    result.stackBytes);
+    }
+
+    if (csvPath != nullptr && !writeCsv(csvPath, results))
+    {
+        std::fprintf(stderr, "FAIL: could not write %s\n", csvPath);
+        return 1;
+    }
+    return 0;
+}
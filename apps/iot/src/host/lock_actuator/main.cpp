@@ -0,0 +1,166 @@
+// Drives LockActuator on virtual time against a fake coil and bolt switch:
+// a lock without a switch, one that opens, one that jams and one whose
+// pulse timer never fires. Polls at nextPollAt() the way App does, so the
+// measured times include the sampling the device would do.
+//
+//   pio run -e native_lock_actuator
+//   .pio/build/native_lock_actuator/program
+//
+// Exits non-zero on the first unexpected result.
+
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+
+#include "HardwareConfig.h"
+#include "drivers/LockActuator.h"
+#include "hal/Clock.h"
+#include "hal/native/FakeDigitalInput.h"
+#include "hal/native/FakePulseOutput.h"
+#include "hal/native/VirtualClock.h"
+#include "host/HostSupport.h"
+
+namespace
+{
+constexpr uint32_t BOLT_TRAVEL_US = 37 * 1000;
+// Longer than any pulse plus the watchdog margin.
+constexpr uint64_t GIVE_UP_MS = 10000;
+
+// Sleeps until each nextPollAt() and polls, as App's loop would.
+std::optional<LockActuation> runPulse(LockActuator &lock, unsigned long &polls)
+{
+    const uint64_t giveUpAt = hal::uptimeMs() + GIVE_UP_MS;
+    polls = 0;
+    while (hal::uptimeMs() < giveUpAt)
+    {
+        const uint64_t now = hal::uptimeMs();
+        const uint64_t due = lock.nextPollAt();
+        if (due > now)
+        {
+            hal::VirtualClock::advanceMs(static_cast<unsigned long>(due - now));
+        }
+        ++polls;
+        if (const std::optional<LockActuation> actuation = lock.poll())
+        {
+            return actuation;
+        }
+    }
+    return std::nullopt;
+}
+
+void report(const char *scenario, const LockActuation &actuation, unsigned long polls)
+{
+    std::printf("%-10s %-9s actuation %4lu ms  pulse %4lu ms  %3lu polls\n",
+                scenario,
+                lockOutcomeName(actuation.outcome),
+                static_cast<unsigned long>(actuation.actuationMs),
+                static_cast<unsigned long>(actuation.pulseMs),
+                polls);
+}
+
+bool noSensor()
+{
+    hal::FakePulseOutput coil;
+    LockActuator lock(coil, nullptr);
+    unsigned long polls = 0;
+    if (!host::expect(lock.begin(), "begin") || !host::expect(lock.unlock(0), "unlock"))
+    {
+        return false;
+    }
+    const std::optional<LockActuation> actuation = runPulse(lock, polls);
+    if (!host::expect(actuation.has_value(), "pulse without a switch never finished"))
+    {
+        return false;
+    }
+    report("no-sensor", *actuation, polls);
+    return host::expect(actuation->outcome == LockOutcome::Pulsed, "outcome without a switch") &&
+           host::expect(actuation->pulseMs == HardwareConfig::LOCK_DEFAULT_PULSE_MS, "default pulse length") &&
+           host::expect(actuation->actuationMs == actuation->pulseMs, "actuation is the pulse without a switch") &&
+           host::expect(polls <= 2, "polled more than needed without a switch");
+}
+
+bool released()
+{
+    hal::FakePulseOutput coil;
+    hal::FakeDigitalInput sensor;
+    sensor.followBolt(coil, BOLT_TRAVEL_US, HardwareConfig::LOCK_SENSOR_LOCKED_LEVEL);
+    LockActuator lock(coil, &sensor);
+    unsigned long polls = 0;
+    if (!host::expect(lock.begin(), "begin") || !host::expect(lock.unlock(800), "unlock") ||
+        !host::expect(!lock.unlock(800), "second unlock while pulsing") || !host::expect(lock.busy(), "busy while pulsing"))
+    {
+        return false;
+    }
+    const std::optional<LockActuation> actuation = runPulse(lock, polls);
+    if (!host::expect(actuation.has_value(), "pulse never finished"))
+    {
+        return false;
+    }
+    report("released", *actuation, polls);
+    const uint32_t travelMs = BOLT_TRAVEL_US / 1000;
+    return host::expect(actuation->outcome == LockOutcome::Released, "outcome") &&
+           host::expect(actuation->pulseMs == 800, "requested pulse length") &&
+           host::expect(actuation->actuationMs >= travelMs && actuation->actuationMs <= travelMs + HardwareConfig::LOCK_SENSOR_POLL_MS,
+                        "actuation time within one sample of the bolt travel") &&
+           host::expect(!lock.busy() && !coil.active(), "coil off after the pulse");
+}
+
+bool jammed()
+{
+    hal::FakePulseOutput coil;
+    hal::FakeDigitalInput sensor;
+    sensor.followBolt(coil, BOLT_TRAVEL_US, HardwareConfig::LOCK_SENSOR_LOCKED_LEVEL);
+    sensor.setJammed(true);
+    LockActuator lock(coil, &sensor);
+    unsigned long polls = 0;
+    if (!host::expect(lock.begin(), "begin") || !host::expect(lock.unlock(60000), "unlock"))
+    {
+        return false;
+    }
+    const std::optional<LockActuation> actuation = runPulse(lock, polls);
+    if (!host::expect(actuation.has_value(), "jammed pulse never finished"))
+    {
+        return false;
+    }
+    report("jammed", *actuation, polls);
+    return host::expect(actuation->outcome == LockOutcome::Jammed, "outcome") &&
+           host::expect(actuation->pulseMs == HardwareConfig::LOCK_MAX_PULSE_MS, "long pulse clamped") &&
+           host::expect(actuation->actuationMs == 0, "no actuation time for a jam");
+}
+
+bool watchdog()
+{
+    hal::FakePulseOutput coil;
+    coil.setTimerStuck(true);
+    LockActuator lock(coil, nullptr);
+    unsigned long polls = 0;
+    if (!host::expect(lock.begin(), "begin") || !host::expect(lock.unlock(200), "unlock"))
+    {
+        return false;
+    }
+    const std::optional<LockActuation> actuation = runPulse(lock, polls);
+    if (!host::expect(actuation.has_value(), "watchdog never tripped"))
+    {
+        return false;
+    }
+    report("watchdog", *actuation, polls);
+    return host::expect(actuation->outcome == LockOutcome::WatchdogTripped, "outcome") &&
+           host::expect(!coil.active(), "coil forced off") &&
+           host::expect(actuation->pulseMs >= 200 + HardwareConfig::LOCK_WATCHDOG_MARGIN_MS &&
+                            actuation->pulseMs <= 200 + HardwareConfig::LOCK_WATCHDOG_MARGIN_MS + HardwareConfig::LOCK_SENSOR_POLL_MS,
+                        "cut off at the watchdog margin") &&
+           host::expect(lock.unlock(200), "usable again after the watchdog");
+}
+}
+
+int main()
+{
+    hal::VirtualClock::enable(1000 * 1000);
+    const bool passed = noSensor() && released() && jammed() && watchdog();
+    if (!passed)
+    {
+        return host::finish(1);
+    }
+    std::printf("OK\n");
+    return host::finish(0);
+}
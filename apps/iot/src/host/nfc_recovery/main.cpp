@@ -0,0 +1,434 @@
+// Deterministic recovery timing for NFCManager. Runs CardTapWatcher and
+// NFCManager on virtual time against the fake PN532, injects one fault per
+// trial at a randomised phase and measures how long detection and recovery
+// take and how much scanning capacity is lost on the way. Nothing sleeps,
+// so a full sweep takes well under a second and repeats exactly for a seed.
+//
+//   pio run -e native_nfc_recovery
+//   .pio/build/native_nfc_recovery/program [--trials n] [--pattern name]...
+//       [--seed n] [--csv out.csv] [-v]
+//
+// Columns, in ms unless noted, averaged over trials:
+//   detect    fault onset until the manager reports the reader unhealthy
+//   recover   fault cleared (onset for a wedge) until healthy again; mean
+//             and p90 of this are the MTTR figures to tune against
+//   outage    fault onset until healthy again
+//   blind     time the chip would have answered but was not being scanned
+//   lost      poll slots lost during blind time, blind / poll interval
+//   stalled   time the loop spent blocked on a hung bus
+//   restarts  I2C bus restarts, one per recovery attempt
+//   flaps     healthy to unhealthy transitions
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "CardTapWatcher.h"
+#include "NFCManager.h"
+#include "app/Scheduler.h"
+#include "hal/Clock.h"
+#include "hal/native/FakeI2CBus.h"
+#include "hal/native/FakeNfcReader.h"
+#include "hal/native/FakeSerialPort.h"
+#include "hal/native/VirtualClock.h"
+#include "host/HostSupport.h"
+#include "logging/DeferredLog.h"
+
+namespace
+{
+using Fault = hal::FakeNfcReader::Fault;
+
+constexpr unsigned long WARMUP_MS = 3000;
+// Onsets are spread over this window so results are not phase locked to
+// the 1 s health check or the 80 ms poll.
+constexpr unsigned long ONSET_JITTER_MS = 1000;
+// A trial that has not recovered this long after the fault cleared counts
+// as unrecovered.
+constexpr unsigned long RECOVERY_LIMIT_MS = 120000;
+// Stand-in for the rest of the App loop, so a poll that leaves its deadline
+// in the past still moves time forward.
+constexpr unsigned long MIN_LOOP_STEP_MS = 1;
+// CardTapWatcher's default poll interval.
+constexpr unsigned long POLL_INTERVAL_MS = 80;
+
+struct Pattern
+{
+    const char *name;
+    const char *description;
+    Fault fault;
+    uint32_t failEvery;
+    // How long the fault lasts; 0 for faults that only recovery clears.
+    unsigned long durationMs;
+};
+
+const std::vector<Pattern> &patterns()
+{
+    static const std::vector<Pattern> all = {
+        {"silent-500ms", "chip stops answering for 0.5 s", Fault::Silent, 0, 500},
+        {"silent-3s", "chip stops answering for 3 s", Fault::Silent, 0, 3000},
+        {"silent-20s", "chip stops answering for 20 s", Fault::Silent, 0, 20000},
+        {"hang-500ms", "bus hangs for 0.5 s, each transfer waits out the timeout", Fault::BusHang, 0, 500},
+        {"hang-3s", "bus hangs for 3 s, each transfer waits out the timeout", Fault::BusHang, 0, 3000},
+        {"hang-20s", "bus hangs for 20 s, each transfer waits out the timeout", Fault::BusHang, 0, 20000},
+        {"drop-mid-xfer", "a transfer is cut mid-frame, chip is wedged until a bus restart", Fault::DropMidTransaction, 0, 0},
+        {"flaky-1in10", "every 10th transfer fails for 10 s", Fault::None, 10, 10000},
+        {"flaky-1in3", "every 3rd transfer fails for 10 s", Fault::None, 3, 10000},
+        {"slow-bus", "chip stops answering at 400 kHz, recovery has to step down to 100 kHz", Fault::SlowBusOnly, 0, 0},
+        {"marginal-bus", "chip fails soon after every restart at 400 kHz, repeated recoveries have to step down", Fault::MarginalFastBus, 0, 0},
+    };
+    return all;
+}
+
+struct TrialResult
+{
+    bool detected = false;
+    bool recovered = false;
+    unsigned long detectMs = 0;
+    unsigned long recoverMs = 0;
+    unsigned long outageMs = 0;
+    unsigned long blindMs = 0;
+    unsigned long stalledMs = 0;
+    uint32_t restarts = 0;
+    uint32_t flaps = 0;
+};
+
+// Integrates "chip answers but the manager is not scanning" over virtual
+// time. Sampled around every poll, so time spent inside a blocking call is
+// attributed to the state the call started in.
+class BlindTimeMeter
+{
+public:
+    explicit BlindTimeMeter(unsigned long startMs)
+        : lastSampleAt(startMs)
+    {
+    }
+
+    void sample(unsigned long now, bool blindNow)
+    {
+        if (blind)
+        {
+            total += now - lastSampleAt;
+        }
+        lastSampleAt = now;
+        blind = blindNow;
+    }
+
+    unsigned long totalMs() const
+    {
+        return total;
+    }
+
+private:
+    unsigned long lastSampleAt;
+    unsigned long total = 0;
+    bool blind = false;
+};
+
+TrialResult runTrial(const Pattern &pattern, unsigned long onsetJitterMs)
+{
+    hal::VirtualClock::enable();
+
+    hal::FakeI2CBus bus;
+    hal::FakeNfcReader reader;
+    reader.attachBus(bus);
+    bus.begin();
+    NFCManager manager(reader, bus, 0, NfcBusMode::I2cAdaptive);
+    manager.begin();
+    CardTapWatcher watcher(manager);
+
+    const unsigned long onsetAt = WARMUP_MS + onsetJitterMs;
+    const unsigned long clearAt = onsetAt + pattern.durationMs;
+    const bool clearsByItself = pattern.durationMs > 0;
+    // Recovery is timed from when the chip could answer again: the scripted
+    // clear, or the onset for faults only a bus restart clears.
+    const unsigned long recoveryBase = clearsByItself ? clearAt : onsetAt;
+    const uint32_t restartsBefore = bus.restartCount();
+
+    TrialResult result;
+    BlindTimeMeter blindTime(onsetAt);
+    bool faultInjected = false;
+    bool faultCleared = false;
+    bool wasHealthy = manager.isHealthy();
+    CardTap tap;
+
+    while (true)
+    {
+        unsigned long now = hal::millis();
+        if (!faultInjected && deadlineReached(now, onsetAt))
+        {
+            reader.injectFault(pattern.fault);
+            reader.failEveryNthTransaction(pattern.failEvery);
+            faultInjected = true;
+        }
+        if (faultInjected && clearsByItself && !faultCleared && deadlineReached(now, clearAt))
+        {
+            reader.clearFault();
+            reader.failEveryNthTransaction(0);
+            faultCleared = true;
+        }
+
+        if (faultInjected)
+        {
+            blindTime.sample(now, reader.isAnswering() && !manager.isHealthy());
+        }
+
+        watcher.poll(tap);
+
+        now = hal::millis();
+        const bool healthy = manager.isHealthy();
+        if (faultInjected)
+        {
+            blindTime.sample(now, reader.isAnswering() && !healthy);
+            if (wasHealthy && !healthy)
+            {
+                ++result.flaps;
+                if (!result.detected)
+                {
+                    result.detected = true;
+                    result.detectMs = now - onsetAt;
+                }
+            }
+        }
+        wasHealthy = healthy;
+
+        // A transient fault that never tripped the health check counts as
+        // recovered the moment it stops.
+        const bool faultOver = clearsByItself ? faultCleared : result.detected;
+        if (faultOver && healthy && reader.isAnswering())
+        {
+            result.recovered = true;
+            break;
+        }
+        if (faultInjected && deadlineReached(now, recoveryBase + RECOVERY_LIMIT_MS))
+        {
+            break;
+        }
+
+        unsigned long wakeAt = watcher.nextPollDueAt();
+        if (deadlineReached(now, wakeAt))
+        {
+            wakeAt = now + MIN_LOOP_STEP_MS;
+        }
+        if (!faultInjected)
+        {
+            wakeAt = earlierDeadline(wakeAt, onsetAt);
+        }
+        else if (clearsByItself && !faultCleared)
+        {
+            wakeAt = earlierDeadline(wakeAt, clearAt);
+        }
+        if (!deadlineReached(now, wakeAt))
+        {
+            hal::VirtualClock::advanceMs(wakeAt - now);
+        }
+    }
+
+    const unsigned long endedAt = hal::millis();
+    result.recoverMs = result.recovered ? endedAt - recoveryBase : 0;
+    result.outageMs = result.recovered && result.detected ? endedAt - onsetAt : 0;
+    result.blindMs = blindTime.totalMs();
+    result.stalledMs = reader.stalledMs();
+    result.restarts = bus.restartCount() - restartsBefore;
+    return result;
+}
+
+struct Column
+{
+    std::vector<unsigned long> values;
+
+    void add(unsigned long value)
+    {
+        values.push_back(value);
+    }
+
+    double mean() const
+    {
+        if (values.empty())
+        {
+            return 0;
+        }
+        double total = 0;
+        for (const unsigned long value : values)
+        {
+            total += static_cast<double>(value);
+        }
+        return total / static_cast<double>(values.size());
+    }
+
+    unsigned long percentile(unsigned rank) const
+    {
+        return host::percentile(values, rank);
+    }
+
+    unsigned long max() const
+    {
+        return values.empty() ? 0 : *std::max_element(values.begin(), values.end());
+    }
+};
+
+struct PatternSummary
+{
+    unsigned trials = 0;
+    unsigned unrecovered = 0;
+    Column detect;
+    Column recover;
+    Column outage;
+    Column blind;
+    Column stalled;
+    Column restarts;
+    Column flaps;
+};
+
+PatternSummary runPattern(const Pattern &pattern, unsigned trials, std::mt19937 &random)
+{
+    std::uniform_int_distribution<unsigned long> jitterMs(0, ONSET_JITTER_MS - 1);
+    PatternSummary summary;
+    for (unsigned trial = 0; trial < trials; ++trial)
+    {
+        const TrialResult result = runTrial(pattern, jitterMs(random));
+        ++summary.trials;
+        if (!result.recovered)
+        {
+            ++summary.unrecovered;
+        }
+        if (result.detected)
+        {
+            summary.detect.add(result.detectMs);
+            summary.outage.add(result.outageMs);
+        }
+        if (result.recovered)
+        {
+            summary.recover.add(result.recoverMs);
+        }
+        summary.blind.add(result.blindMs);
+        summary.stalled.add(result.stalledMs);
+        summary.restarts.add(result.restarts);
+        summary.flaps.add(result.flaps);
+    }
+    return summary;
+}
+
+void usage(const char *program)
+{
+    std::fprintf(stderr, "usage: %s [--trials n] [--pattern name]... [--seed n] [--csv path] [-v]\n", program);
+    std::fprintf(stderr, "patterns:\n");
+    for (const Pattern &pattern : patterns())
+    {
+        std::fprintf(stderr, "  %-14s %s\n", pattern.name, pattern.description);
+    }
+}
+}
+
+int main(int argc, char **argv)
+{
+    unsigned trials = 50;
+    unsigned seed = 1;
+    const char *csvPath = nullptr;
+    bool verbose = false;
+    std::vector<const Pattern *> selected;
+
+    for (int index = 1; index < argc; ++index)
+    {
+        const std::string argument = argv[index];
+        const bool hasValue = index + 1 < argc;
+        if (argument == "--trials" && hasValue)
+        {
+            trials = static_cast<unsigned>(std::strtoul(argv[++index], nullptr, 10));
+        }
+        else if (argument == "--seed" && hasValue)
+        {
+            seed = static_cast<unsigned>(std::strtoul(argv[++index], nullptr, 10));
+        }
+        else if (argument == "--csv" && hasValue)
+        {
+            csvPath = argv[++index];
+        }
+        else if (argument == "--pattern" && hasValue)
+        {
+            const std::string name = argv[++index];
+            const auto &all = patterns();
+            const auto found = std::find_if(all.begin(), all.end(), [&name](const Pattern &pattern)
+                                            { return name == pattern.name; });
+            if (found == all.end())
+            {
+                usage(argv[0]);
+                return 2;
+            }
+            selected.push_back(&*found);
+        }
+        else if (argument == "-v")
+        {
+            verbose = true;
+        }
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (selected.empty())
+    {
+        for (const Pattern &pattern : patterns())
+        {
+            selected.push_back(&pattern);
+        }
+    }
+
+    hal::FakeSerialPort console(true);
+    if (verbose)
+    {
+        DeferredLog::begin(console, LOG_LEVEL_VERBOSE);
+    }
+    else
+    {
+        DeferredLog::setLevel(LOG_LEVEL_SILENT);
+    }
+
+    FILE *csv = csvPath != nullptr ? std::fopen(csvPath, "w") : nullptr;
+    if (csvPath != nullptr && csv == nullptr)
+    {
+        std::fprintf(stderr, "cannot write %s\n", csvPath);
+        return 1;
+    }
+    if (csv != nullptr)
+    {
+        std::fprintf(csv, "pattern,trials,unrecovered,detect_mean_ms,recover_mean_ms,recover_p90_ms,recover_max_ms,"
+                          "outage_mean_ms,blind_mean_ms,lost_scans_mean,stalled_mean_ms,restarts_mean,flaps_mean\n");
+    }
+
+    std::printf("%u trials per pattern, seed %u, times in ms (virtual)\n", trials, seed);
+    std::printf("%-14s %6s %8s %9s %8s %8s %8s %8s %7s %8s %8s %6s\n",
+                "pattern", "unrec", "detect", "recover", "p90", "max", "outage", "blind", "lost", "stalled", "restarts", "flaps");
+
+    std::mt19937 random(seed);
+    bool anyUnrecovered = false;
+    for (const Pattern *pattern : selected)
+    {
+        const PatternSummary summary = runPattern(*pattern, trials, random);
+        const double lostScans = summary.blind.mean() / POLL_INTERVAL_MS;
+        anyUnrecovered = anyUnrecovered || summary.unrecovered > 0;
+
+        std::printf("%-14s %6u %8.0f %9.0f %8lu %8lu %8.0f %8.0f %7.1f %8.0f %8.1f %6.1f\n",
+                    pattern->name, summary.unrecovered, summary.detect.mean(), summary.recover.mean(),
+                    summary.recover.percentile(90), summary.recover.max(), summary.outage.mean(),
+                    summary.blind.mean(), lostScans, summary.stalled.mean(), summary.restarts.mean(),
+                    summary.flaps.mean());
+        if (csv != nullptr)
+        {
+            std::fprintf(csv, "%s,%u,%u,%.1f,%.1f,%lu,%lu,%.1f,%.1f,%.2f,%.1f,%.2f,%.2f\n",
+                         pattern->name, summary.trials, summary.unrecovered, summary.detect.mean(),
+                         summary.recover.mean(), summary.recover.percentile(90), summary.recover.max(),
+                         summary.outage.mean(), summary.blind.mean(), lostScans, summary.stalled.mean(),
+                         summary.restarts.mean(), summary.flaps.mean());
+        }
+    }
+
+    if (csv != nullptr)
+    {
+        std::fclose(csv);
+    }
+    return host::finish(anyUnrecovered ? 3 : 0);
+}
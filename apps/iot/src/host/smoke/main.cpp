@@ -0,0 +1,139 @@
+// Boots the firmware App against in-process fakes and walks it through one
+// tap, one unlock command and two taps decided offline from the
+// authorization cache, the second with another card in the field. Exits
+// non-zero if any round trip fails.
+//
+//   pio run -e native && .pio/build/native/program [-v]
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "app/App.h"
+#include "hal/native/FakePlatform.h"
+#include "host/HostSupport.h"
+
+namespace
+{
+constexpr unsigned long STEP_TIMEOUT_MS = 8000;
+// Shaped like the backend's Bike.id, so the id limits see a real length.
+constexpr const char *DEVICE_ID = "0192f3a4-5b6c-7d8e-9f01-23456789abcd";
+constexpr int64_t SYNCED_EPOCH_MS = 1700000000000;
+
+const char *const CONFIG_FILE =
+    "BIKE_ID=0192f3a4-5b6c-7d8e-9f01-23456789abcd\n"
+    "WIFI_SSID=bench\n"
+    "WIFI_PASS=bench\n"
+    "MQTT_BROKER_IP=127.0.0.1\n"
+    "MQTT_PORT=1883\n";
+}
+
+int main(int argc, char **argv)
+{
+    const bool verbose = argc > 1 && std::strcmp(argv[1], "-v") == 0;
+
+    hal::FakePlatform fake(verbose);
+    fake.storage.files["/.env"] = CONFIG_FILE;
+    hal::Platform platform = fake.view();
+    const DeviceContext context = makeDeviceContext(DEVICE_ID);
+
+    App app(platform);
+    app.setup();
+
+    unsigned long elapsedMs = 0;
+    if (!host::runUntilPublished(app, fake.mqtt, context.topics.statusTopic, [](const std::string &payload)
+                                 { return host::contains(payload, "\"mqttConnected\":true"); },
+                                 STEP_TIMEOUT_MS, &elapsedMs))
+    {
+        std::fprintf(stderr, "FAIL: device never reported an MQTT session\n");
+        return host::finish(1);
+    }
+    std::printf("online after %lu ms\n", elapsedMs);
+
+    if (fake.networkTime.server() != "127.0.0.1")
+    {
+        std::fprintf(stderr, "FAIL: time sync did not default to the broker host\n");
+        return host::finish(1);
+    }
+    fake.networkTime.completeSync(SYNCED_EPOCH_MS);
+
+    fake.nfc.presentCard({0x04, 0xA2, 0x3B, 0x11});
+    if (!host::runUntilPublished(app, fake.mqtt, context.topics.tapEventTopic, [](const std::string &payload)
+                                 { return host::contains(payload, "\"cardUid\"") && host::contains(payload, "\"cardDetectedUs\"") &&
+                                 host::contains(payload, "\"epochMs\":17000000") && host::contains(payload, "\"timeSync\":\"synced\""); },
+                                 STEP_TIMEOUT_MS, &elapsedMs))
+    {
+        std::fprintf(stderr, "FAIL: tap was not published\n");
+        return host::finish(1);
+    }
+    fake.nfc.removeCard();
+    std::printf("tap published after %lu ms\n", elapsedMs);
+
+    fake.mqtt.deliver(context.topics.commandTopic, R"({"action":"unlock","requestId":"smoke-1","trace":{"serviceSentUs":42}})");
+    if (!host::runUntilPublished(app, fake.mqtt, context.topics.ackTopic, [](const std::string &payload)
+                                 { return host::contains(payload, "\"requestId\":\"smoke-1\"") && host::contains(payload, "\"status\":\"done\"") &&
+                                 host::contains(payload, "\"detail\":\"released\"") && host::contains(payload, "\"actuationMs\"") &&
+                                 host::contains(payload, "\"serviceSentUs\":42") && host::contains(payload, "\"ackSentUs\""); },
+                                 STEP_TIMEOUT_MS, &elapsedMs))
+    {
+        std::fprintf(stderr, "FAIL: unlock command was not acknowledged\n");
+        return host::finish(1);
+    }
+    std::printf("unlock acked after %lu ms\n", elapsedMs);
+
+    // 04A23B11 is card 77740817; it stays allowed until 2038.
+    fake.mqtt.deliver(context.topics.commandTopic, R"({"action":"auth_begin","requestId":"smoke-2","generation":7,"count":1})");
+    fake.mqtt.deliver(context.topics.commandTopic, R"({"action":"auth_batch","requestId":"smoke-3","generation":7,"offset":0,"entries":"0000000004a23b117fffffff"})");
+    fake.mqtt.deliver(context.topics.commandTopic, R"({"action":"auth_commit","requestId":"smoke-4","generation":7})");
+    if (!host::runUntilPublished(app, fake.mqtt, context.topics.ackTopic, [](const std::string &payload)
+                                 { return host::contains(payload, "\"requestId\":\"smoke-4\"") && host::contains(payload, "\"status\":\"done\""); },
+                                 STEP_TIMEOUT_MS, &elapsedMs))
+    {
+        std::fprintf(stderr, "FAIL: authorization snapshot was not committed\n");
+        return host::finish(1);
+    }
+    std::printf("authorization snapshot committed after %lu ms\n", elapsedMs);
+
+    fake.mqtt.setBrokerReachable(false);
+    host::runFor(app, 2000);
+    fake.nfc.presentCard({0x04, 0xA2, 0x3B, 0x11});
+    host::runFor(app, 500);
+    fake.nfc.removeCard();
+    fake.mqtt.setBrokerReachable(true);
+    if (!host::runUntilPublished(app, fake.mqtt, context.topics.cardEventTopic, [](const std::string &payload)
+                                 { return host::contains(payload, "\"event\":\"offline_decision\"") && host::contains(payload, "\"cardUid\":\"77740817\"") &&
+                                 host::contains(payload, "\"decision\":\"granted\"") && host::contains(payload, "\"cacheGeneration\":7"); },
+                                 STEP_TIMEOUT_MS, &elapsedMs))
+    {
+        std::fprintf(stderr, "FAIL: offline unlock was not reported\n");
+        return host::finish(1);
+    }
+    std::printf("offline unlock reported %lu ms after reconnecting\n", elapsedMs);
+
+    // The cached card with a second one next to it must not unlock.
+    const unsigned long pulsesBefore = fake.lockCoil.pulses;
+    fake.mqtt.setBrokerReachable(false);
+    host::runFor(app, 2000);
+    fake.nfc.presentCard({0x04, 0xA2, 0x3B, 0x11});
+    fake.nfc.addCard({0x04, 0x5C, 0x19, 0x7E});
+    host::runFor(app, 500);
+    fake.nfc.removeCard();
+    fake.mqtt.setBrokerReachable(true);
+    if (!host::runUntilPublished(app, fake.mqtt, context.topics.cardEventTopic, [](const std::string &payload)
+                                 { return host::contains(payload, "\"event\":\"offline_decision\"") && host::contains(payload, "\"decision\":\"denied\"") &&
+                                 host::contains(payload, "\"reason\":\"ambiguous\""); },
+                                 STEP_TIMEOUT_MS, &elapsedMs))
+    {
+        std::fprintf(stderr, "FAIL: ambiguous offline tap was not denied\n");
+        return host::finish(1);
+    }
+    if (fake.lockCoil.pulses != pulsesBefore)
+    {
+        std::fprintf(stderr, "FAIL: ambiguous offline tap drove the lock\n");
+        return host::finish(1);
+    }
+    std::printf("ambiguous offline tap denied %lu ms after reconnecting\n", elapsedMs);
+
+    std::printf("OK\n");
+    return host::finish(0);
+}
@@ -0,0 +1,389 @@
+// Scan fairness across a docking station's readers. Runs ReaderScanScheduler
+// on virtual time over several fake PN532s sharing one bus, as behind the
+// station's I2C mux, so a bay restarting the bus stalls the others. Faults
+// bay 0 for the whole run, presents cards on the other bays at random and
+// measures how long each takes to be read. Nothing sleeps, so a run repeats
+// exactly for a seed. Comparing --idle-poll 0 with the default shows what
+// the idle rate costs in latency and saves in scans, --no-power-down what
+// parking idle readers saves in RF time.
+//
+//   pio run -e native_station
+//   .pio/build/native_station/program [--bays n] [--taps n]
+//       [--scenario name]... [--idle-poll ms] [--no-power-down] [--seed n] [-v]
+//
+// Columns, in ms of virtual time:
+//   p50 p90 max  card presented until the scheduler reported it
+//   gap          longest interval between two scans of a healthy bay
+//   missed       cards taken away again before they were read
+//   ambig        wallet taps reported as ambiguous; any wallet tap read as a
+//                single card fails the run
+//   rm-p90       card taken away until its removal was reported; a reported
+//                card whose removal never is fails the run
+//
+// Any transfer tried while a recovering bay has the bus stopped fails the
+// run.
+//   scans/s      scans per second across all bays
+//   rf-off       share of the time the readers spent powered down
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ReaderScanScheduler.h"
+#include "app/Scheduler.h"
+#include "hal/Clock.h"
+#include "hal/Platform.h"
+#include "hal/native/FakeI2CBus.h"
+#include "hal/native/FakeNfcReader.h"
+#include "hal/native/FakeSerialPort.h"
+#include "hal/native/VirtualClock.h"
+#include "host/HostSupport.h"
+#include "logging/DeferredLog.h"
+
+namespace
+{
+using Fault = hal::FakeNfcReader::Fault;
+
+constexpr unsigned long WARMUP_MS = 3000;
+// Roughly what an Adafruit PN532 on I2C takes for InListPassiveTarget; an
+// empty field costs the whole scan timeout.
+constexpr unsigned long PN532_SCAN_WITH_CARD_MS = 18;
+// How long a rider holds the card against the reader.
+constexpr unsigned long CARD_HOLD_MS = 1500;
+// Stand-in for the rest of the App loop.
+constexpr unsigned long MIN_LOOP_STEP_MS = 1;
+
+struct Scenario
+{
+    const char *name;
+    const char *description;
+    Fault fault;
+    uint32_t failEvery;
+    unsigned long minTapSpacingMs;
+    unsigned long maxTapSpacingMs;
+    // Every nth tap holds two cards to the reader; 0 for never.
+    unsigned walletEvery;
+    // Taps cycle through ISO14443A, ISO14443B and FeliCa cards, with every
+    // protocol enabled; a wallet pairs cards of different protocols.
+    bool mixedProtocols;
+};
+
+const std::vector<Scenario> &scenarios()
+{
+    static const std::vector<Scenario> all = {
+        {"clean", "every bay answers", Fault::None, 0, 200, 1000, 0, false},
+        {"silent", "bay 0 never answers", Fault::Silent, 0, 200, 1000, 0, false},
+        {"hang", "bay 0's channel hangs, each transfer waits out the timeout", Fault::BusHang, 0, 200, 1000, 0, false},
+        {"flaky", "every 3rd transfer on bay 0 fails", Fault::None, 3, 200, 1000, 0, false},
+        {"off-peak", "every bay answers, a tap every 20-90 s", Fault::None, 0, 20000, 90000, 0, false},
+        {"wallet", "every 4th tap holds two cards to the reader", Fault::None, 0, 200, 1000, 4, false},
+        {"transit", "type A, type B and FeliCa cards in turn, every 4th with a second card", Fault::None, 0, 200, 1000, 4, true},
+    };
+    return all;
+}
+
+struct Station
+{
+    explicit Station(size_t count)
+    {
+        for (size_t index = 0; index < count; ++index)
+        {
+            readers.push_back(std::make_unique<hal::FakeNfcReader>());
+            readers.back()->attachBus(bus);
+            readers.back()->setScanTiming(PN532_SCAN_WITH_CARD_MS, UINT16_MAX);
+            bays.push_back(hal::NfcBay{*readers.back(), bus});
+        }
+    }
+
+    hal::FakeI2CBus bus;
+    std::vector<std::unique_ptr<hal::FakeNfcReader>> readers;
+    std::vector<hal::NfcBay> bays;
+};
+
+struct ScenarioResult
+{
+    std::vector<unsigned long> latencies;
+    unsigned long maxScanGapMs = 0;
+    unsigned missed = 0;
+    unsigned ambiguous = 0;
+    unsigned misread = 0;
+    std::vector<unsigned long> removalLatencies;
+    unsigned removalsMissing = 0;
+    uint32_t stoppedBusTransactions = 0;
+    double scansPerSecond = 0;
+    double poweredDownShare = 0;
+};
+
+ScenarioResult runScenario(const Scenario &scenario, size_t bayCount, unsigned taps, const NfcPollPolicy &policy, std::mt19937 &random)
+{
+    hal::VirtualClock::enable();
+
+    NfcPollPolicy scenarioPolicy = policy;
+    if (scenario.mixedProtocols)
+    {
+        scenarioPolicy.protocols = hal::cardProtocolBit(hal::CardProtocol::Iso14443A) |
+                                   hal::cardProtocolBit(hal::CardProtocol::Iso14443B) |
+                                   hal::cardProtocolBit(hal::CardProtocol::FeliCa);
+    }
+
+    Station station(bayCount);
+    ReaderScanScheduler scheduler(station.bays.data(), station.bays.size(), NfcBusMode::I2cAdaptive, scenarioPolicy);
+    scheduler.begin();
+    station.readers[0]->injectFault(scenario.fault);
+    station.readers[0]->failEveryNthTransaction(scenario.failEvery);
+
+    std::uniform_int_distribution<size_t> pickBay(1, bayCount - 1);
+    std::uniform_int_distribution<unsigned long> spacingMs(scenario.minTapSpacingMs, scenario.maxTapSpacingMs);
+
+    ScenarioResult result;
+    std::vector<uint32_t> scansSeen(bayCount, 0);
+    std::vector<unsigned long> lastScanAt(bayCount, WARMUP_MS);
+    uint32_t scansAtWarmup = 0;
+    bool warmedUp = false;
+    unsigned presented = 0;
+    size_t tapBay = 0;
+    bool cardPresent = false;
+    bool walletTap = false;
+    unsigned long presentedAt = 0;
+    unsigned long nextTapAt = WARMUP_MS + spacingMs(random);
+    // Reported cards taken away and when, until their removal is reported.
+    std::vector<std::pair<std::string, unsigned long>> takenAway;
+
+    while (presented < taps || cardPresent || (!takenAway.empty() && hal::millis() - takenAway.back().second < CARD_HOLD_MS))
+    {
+        unsigned long now = hal::millis();
+        if (!cardPresent && presented < taps && deadlineReached(now, nextTapAt))
+        {
+            tapBay = pickBay(random);
+            const auto protocol = scenario.mixedProtocols ? static_cast<hal::CardProtocol>(presented % hal::CARD_PROTOCOL_COUNT)
+                                                          : hal::CardProtocol::Iso14443A;
+            station.readers[tapBay]->presentCard({0x04, static_cast<uint8_t>(presented >> 8), static_cast<uint8_t>(presented), static_cast<uint8_t>(tapBay)},
+                                                 protocol);
+            walletTap = scenario.walletEvery > 0 && presented % scenario.walletEvery == 0;
+            if (walletTap)
+            {
+                const auto otherProtocol = scenario.mixedProtocols && protocol == hal::CardProtocol::Iso14443A
+                                               ? hal::CardProtocol::FeliCa
+                                               : hal::CardProtocol::Iso14443A;
+                station.readers[tapBay]->addCard({0x08, static_cast<uint8_t>(presented >> 8), static_cast<uint8_t>(presented), static_cast<uint8_t>(tapBay)},
+                                                 otherProtocol);
+            }
+            cardPresent = true;
+            presentedAt = now;
+            ++presented;
+        }
+
+        uint8_t bay = 0;
+        CardRemoval removal;
+        while (scheduler.takeRemoval(bay, removal))
+        {
+            const auto card = std::find_if(takenAway.begin(), takenAway.end(), [&removal](const auto &entry)
+                                           { return entry.first == removal.cardUid; });
+            if (card != takenAway.end())
+            {
+                result.removalLatencies.push_back(now - card->second);
+                takenAway.erase(card);
+            }
+        }
+
+        CardTap tap;
+        const bool read = scheduler.poll(bay, tap);
+        now = hal::millis();
+        if (!warmedUp && deadlineReached(now, WARMUP_MS))
+        {
+            for (size_t index = 0; index < bayCount; ++index)
+            {
+                scansAtWarmup += station.readers[index]->scanCount();
+            }
+            warmedUp = true;
+        }
+
+        for (size_t index = 1; index < bayCount; ++index)
+        {
+            const uint32_t scans = station.readers[index]->scanCount();
+            if (scans != scansSeen[index])
+            {
+                if (deadlineReached(now, WARMUP_MS))
+                {
+                    result.maxScanGapMs = std::max(result.maxScanGapMs, now - lastScanAt[index]);
+                }
+                scansSeen[index] = scans;
+                lastScanAt[index] = now;
+            }
+        }
+
+        const bool tapRead = read && cardPresent && bay == tapBay;
+        const bool tapMissed = !tapRead && cardPresent && deadlineReached(now, presentedAt + CARD_HOLD_MS);
+        if (tapRead || tapMissed)
+        {
+            if (tapRead)
+            {
+                result.latencies.push_back(now - presentedAt);
+                result.ambiguous += tap.ambiguous() ? 1 : 0;
+                result.misread += walletTap != tap.ambiguous() ? 1 : 0;
+                takenAway.emplace_back(tap.cardUid, now);
+                if (tap.ambiguous())
+                {
+                    takenAway.emplace_back(tap.otherCardUid, now);
+                }
+            }
+            else
+            {
+                ++result.missed;
+            }
+            station.readers[tapBay]->removeCard();
+            cardPresent = false;
+            nextTapAt = now + spacingMs(random);
+        }
+
+        unsigned long wakeAt = static_cast<unsigned long>(scheduler.nextPollDueAt());
+        if (deadlineReached(now, wakeAt))
+        {
+            wakeAt = now + MIN_LOOP_STEP_MS;
+        }
+        if (cardPresent || presented < taps)
+        {
+            wakeAt = earlierDeadline(wakeAt, cardPresent ? presentedAt + CARD_HOLD_MS : nextTapAt);
+        }
+        if (!deadlineReached(now, wakeAt))
+        {
+            hal::VirtualClock::advanceMs(wakeAt - now);
+        }
+    }
+
+    result.removalsMissing = static_cast<unsigned>(takenAway.size());
+
+    uint32_t scans = 0;
+    unsigned long poweredDownMs = 0;
+    for (size_t index = 0; index < bayCount; ++index)
+    {
+        scans += station.readers[index]->scanCount();
+        poweredDownMs += station.readers[index]->poweredDownMs();
+        result.stoppedBusTransactions += station.readers[index]->stoppedBusTransactionCount();
+    }
+    const unsigned long elapsedMs = hal::millis() - WARMUP_MS;
+    result.scansPerSecond = elapsedMs > 0 ? (scans - scansAtWarmup) * 1000.0 / static_cast<double>(elapsedMs) : 0;
+    // Over the whole run; readers rarely park during the warm-up.
+    result.poweredDownShare = static_cast<double>(poweredDownMs) / static_cast<double>(hal::millis() * bayCount);
+    return result;
+}
+
+void usage(const char *program)
+{
+    std::fprintf(stderr, "usage: %s [--bays n] [--taps n] [--scenario name]... [--idle-poll ms] [--no-power-down] [--seed n] [-v]\n", program);
+    std::fprintf(stderr, "scenarios:\n");
+    for (const Scenario &scenario : scenarios())
+    {
+        std::fprintf(stderr, "  %-8s %s\n", scenario.name, scenario.description);
+    }
+}
+}
+
+int main(int argc, char **argv)
+{
+    size_t bays = 4;
+    unsigned taps = 200;
+    unsigned seed = 1;
+    bool verbose = false;
+    NfcPollPolicy policy;
+    std::vector<const Scenario *> selected;
+
+    for (int index = 1; index < argc; ++index)
+    {
+        const std::string argument = argv[index];
+        const bool hasValue = index + 1 < argc;
+        if (argument == "--bays" && hasValue)
+        {
+            bays = std::strtoul(argv[++index], nullptr, 10);
+        }
+        else if (argument == "--taps" && hasValue)
+        {
+            taps = static_cast<unsigned>(std::strtoul(argv[++index], nullptr, 10));
+        }
+        else if (argument == "--idle-poll" && hasValue)
+        {
+            policy.idleIntervalMs = std::strtoul(argv[++index], nullptr, 10);
+        }
+        else if (argument == "--no-power-down")
+        {
+            policy.powerDownWhenIdle = false;
+        }
+        else if (argument == "--seed" && hasValue)
+        {
+            seed = static_cast<unsigned>(std::strtoul(argv[++index], nullptr, 10));
+        }
+        else if (argument == "--scenario" && hasValue)
+        {
+            const std::string name = argv[++index];
+            const auto &all = scenarios();
+            const auto found = std::find_if(all.begin(), all.end(), [&name](const Scenario &scenario)
+                                            { return name == scenario.name; });
+            if (found == all.end())
+            {
+                usage(argv[0]);
+                return 2;
+            }
+            selected.push_back(&*found);
+        }
+        else if (argument == "-v")
+        {
+            verbose = true;
+        }
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (bays < 2 || bays > ReaderScanScheduler::MAX_BAYS)
+    {
+        std::fprintf(stderr, "--bays must be 2 to %u\n", static_cast<unsigned>(ReaderScanScheduler::MAX_BAYS));
+        return 2;
+    }
+    if (selected.empty())
+    {
+        for (const Scenario &scenario : scenarios())
+        {
+            selected.push_back(&scenario);
+        }
+    }
+
+    hal::FakeSerialPort console(true);
+    if (verbose)
+    {
+        DeferredLog::begin(console, LOG_LEVEL_VERBOSE);
+    }
+    else
+    {
+        DeferredLog::setLevel(LOG_LEVEL_SILENT);
+    }
+
+    std::printf("%u bays, %u taps per scenario on bays 1-%u, idle poll %lu ms, seed %u, times in ms (virtual)\n",
+                static_cast<unsigned>(bays), taps, static_cast<unsigned>(bays - 1), policy.idleIntervalMs, seed);
+    std::printf("%-8s %6s %6s %6s %6s %7s %6s %6s %8s %7s\n", "scenario", "p50", "p90", "max", "gap", "missed", "ambig", "rm-p90", "scans/s", "rf-off");
+
+    std::mt19937 random(seed);
+    bool anyFailed = false;
+    for (const Scenario *scenario : selected)
+    {
+        const ScenarioResult result = runScenario(*scenario, bays, taps, policy, random);
+        anyFailed = anyFailed || result.missed > 0 || result.misread > 0 || result.removalsMissing > 0 || result.stoppedBusTransactions > 0;
+        std::printf("%-8s %6lu %6lu %6lu %6lu %7u %6u %6lu %8.1f %6.0f%%\n",
+                    scenario->name, host::percentile(result.latencies, 50), host::percentile(result.latencies, 90),
+                    host::percentile(result.latencies, 100), result.maxScanGapMs, result.missed, result.ambiguous,
+                    host::percentile(result.removalLatencies, 90), result.scansPerSecond, result.poweredDownShare * 100.0);
+        if (result.stoppedBusTransactions > 0)
+        {
+            std::fprintf(stderr, "FAIL: %s: %lu transfers while the bus was stopped\n", scenario->name,
+                         static_cast<unsigned long>(result.stoppedBusTransactions));
+        }
+    }
+
+    return host::finish(anyFailed ? 3 : 0);
+}
@@ -0,0 +1,567 @@
+// Latency benchmark for the two paths a rider waits on: card presented to
+// tap PUBLISH written to the broker socket, and unlock command published to
+// ack PUBLISH written back. The firmware App runs unmodified on its own
+// thread with a simulated PN532 and a real MQTT session against a local
+// broker, so both measurements include the scheduler, NFC polling, JSON
+// and socket work. Each scenario repeats the round trips with a fault
+// injected and reports percentiles.
+//
+//   mosquitto -p 1883 &
+//   pio run -e native_tap_bench
+//   .pio/build/native_tap_bench/program [--broker host[:port]] [--iterations n]
+//       [--scenario name]... [--seed n] [--csv out.csv] [--baseline old.csv] [-v]
+//
+// --csv writes one row per scenario and path; passing a file from another
+// commit as --baseline prints p50/p99 deltas next to each row.
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "app/App.h"
+#include "hal/Clock.h"
+#include "hal/Task.h"
+#include "hal/native/FakePlatform.h"
+#include "hal/native/PosixMqttTransport.h"
+#include "host/HostSupport.h"
+#include "logging/DeferredLog.h"
+
+namespace
+{
+constexpr unsigned long ONLINE_TIMEOUT_MS = 20000;
+constexpr unsigned long ROUND_TRIP_TIMEOUT_MS = 15000;
+// Gaps between round trips are randomised so taps do not stay phase locked
+// to the 80 ms NFC poll.
+constexpr unsigned long MIN_GAP_MS = 150;
+constexpr unsigned long MAX_GAP_MS = 400;
+// Roughly what an Adafruit PN532 on I2C takes for InListPassiveTarget.
+constexpr unsigned long PN532_SCAN_WITH_CARD_MS = 18;
+constexpr unsigned long READER_STALL_MS = 1500;
+constexpr unsigned long WIFI_OUTAGE_MS = 250;
+
+const hal::TaskSpec APP_TASK{"app", 8192, 1, 1};
+
+// Device-side transport that timestamps every PUBLISH once send() has
+// handed the whole packet to the kernel.
+class WireRecorder : public hal::PosixMqttTransport
+{
+public:
+    struct Publish
+    {
+        std::string topic;
+        std::string payload;
+        unsigned long atUs = 0;
+    };
+
+    bool publish(const char *topic, const uint8_t *payload, size_t length, bool retained) override
+    {
+        if (!PosixMqttTransport::publish(topic, payload, length, retained))
+        {
+            return false;
+        }
+        const unsigned long atUs = hal::micros();
+        {
+            const std::lock_guard<std::mutex> lock(mutex);
+            publishes.push_back(Publish{topic, std::string(reinterpret_cast<const char *>(payload), length), atUs});
+        }
+        published.notify_all();
+        return true;
+    }
+
+    // Consumes publishes until one matches; false once timeoutMs passes.
+    bool waitFor(std::string_view topic, const std::string &needle, unsigned long timeoutMs, Publish &match)
+    {
+        const unsigned long startedAt = hal::millis();
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true)
+        {
+            while (!publishes.empty())
+            {
+                Publish next = std::move(publishes.front());
+                publishes.pop_front();
+                if (next.topic == topic && next.payload.find(needle) != std::string::npos)
+                {
+                    match = std::move(next);
+                    return true;
+                }
+            }
+            const unsigned long elapsedMs = hal::millis() - startedAt;
+            if (elapsedMs >= timeoutMs)
+            {
+                return false;
+            }
+            published.wait_for(lock, std::chrono::milliseconds(timeoutMs - elapsedMs));
+        }
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable published;
+    std::deque<Publish> publishes;
+};
+
+struct Bench
+{
+    hal::FakePlatform &fake;
+    WireRecorder &device;
+    hal::PosixMqttTransport &observer;
+    DeviceContext context;
+};
+
+struct Scenario
+{
+    const char *name;
+    const char *description;
+    // Runs with the card about to be presented / the command about to be
+    // sent; returns the action that ends the fault, run right after.
+    std::function<std::function<void()>(Bench &)> beforeTap;
+    std::function<std::function<void()>(Bench &)> beforeUnlock;
+};
+
+struct Samples
+{
+    std::vector<unsigned long> latenciesUs;
+    unsigned timeouts = 0;
+};
+
+struct Summary
+{
+    size_t count = 0;
+    unsigned timeouts = 0;
+    unsigned long minUs = 0;
+    unsigned long p50Us = 0;
+    unsigned long p90Us = 0;
+    unsigned long p99Us = 0;
+    unsigned long maxUs = 0;
+    unsigned long meanUs = 0;
+};
+
+using BaselineKey = std::pair<std::string, std::string>;
+
+std::function<void()> noFault(Bench &)
+{
+    return {};
+}
+
+// Long enough for the watcher to notice and start recovery.
+std::function<void()> stallReader(Bench &bench)
+{
+    bench.fake.nfc.injectFault(hal::FakeNfcReader::Fault::Silent);
+    hal::delayMs(READER_STALL_MS);
+    return [&bench]()
+    { bench.fake.nfc.clearFault(); };
+}
+
+const std::vector<Scenario> &scenarios()
+{
+    static const std::vector<Scenario> all = {
+        {"clean", "instant reader, steady session", noFault, noFault},
+        {"pn532-timing", "scans cost 18 ms with a card and the full 75 ms timeout without",
+         [](Bench &bench) -> std::function<void()>
+         {
+             bench.fake.nfc.setScanTiming(PN532_SCAN_WITH_CARD_MS, UINT16_MAX);
+             return {};
+         },
+         noFault},
+        {"reader-stall", "PN532 stops answering for 1.5 s and comes back as the card or command arrives",
+         stallReader, stallReader},
+        {"broker-drop", "broker connection is cut just before the tap",
+         [](Bench &bench) -> std::function<void()>
+         {
+             bench.device.severConnection();
+             return {};
+         },
+         noFault},
+        {"wifi-flap", "network disappears for 250 ms around the tap",
+         [](Bench &bench) -> std::function<void()>
+         {
+             bench.fake.wifi.setNetworkAvailable(false);
+             return [&bench]()
+             {
+                 hal::delayMs(WIFI_OUTAGE_MS);
+                 bench.fake.wifi.setNetworkAvailable(true);
+             };
+         },
+         noFault},
+    };
+    return all;
+}
+
+[[noreturn]] void runApp(void *argument)
+{
+    App &app = *static_cast<App *>(argument);
+    while (true)
+    {
+        app.loop();
+    }
+}
+
+// The observer only publishes commands, but it still has to answer
+// keepalives while the bench sleeps.
+void idle(hal::PosixMqttTransport &observer, unsigned long durationMs)
+{
+    const unsigned long startedAt = hal::millis();
+    for (unsigned long elapsedMs = 0; elapsedMs < durationMs; elapsedMs = hal::millis() - startedAt)
+    {
+        observer.loop();
+        hal::delayMs(std::min<unsigned long>(10, durationMs - elapsedMs));
+    }
+}
+
+std::string uidToDecimal(const std::vector<uint8_t> &uid)
+{
+    uint64_t value = 0;
+    for (const uint8_t byte : uid)
+    {
+        value = (value << 8) | byte;
+    }
+    return std::to_string(value);
+}
+
+bool measureTap(Bench &bench, const Scenario &scenario, uint32_t iteration, unsigned long &latencyUs)
+{
+    const std::vector<uint8_t> uid = {0x04,
+                                      static_cast<uint8_t>(iteration >> 16),
+                                      static_cast<uint8_t>(iteration >> 8),
+                                      static_cast<uint8_t>(iteration),
+                                      0x5A,
+                                      0xC3,
+                                      0x80};
+    const std::string needle = "\"cardUid\":\"" + uidToDecimal(uid) + "\"";
+
+    const std::function<void()> endFault = scenario.beforeTap(bench);
+    const unsigned long presentedAt = hal::micros();
+    bench.fake.nfc.presentCard(uid);
+    if (endFault)
+    {
+        endFault();
+    }
+
+    WireRecorder::Publish publish;
+    const bool published = bench.device.waitFor(bench.context.topics.tapEventTopic, needle, ROUND_TRIP_TIMEOUT_MS, publish);
+    bench.fake.nfc.removeCard();
+    latencyUs = publish.atUs - presentedAt;
+    return published;
+}
+
+bool measureUnlock(Bench &bench, const Scenario &scenario, uint32_t iteration, unsigned long &latencyUs)
+{
+    const std::string requestId = "bench-" + std::to_string(iteration);
+    const std::string command = "{\"action\":\"unlock\",\"requestId\":\"" + requestId + "\"}";
+
+    const std::function<void()> endFault = scenario.beforeUnlock(bench);
+    const unsigned long sentAt = hal::micros();
+    if (!bench.observer.publish(bench.context.topics.commandTopic.c_str(),
+                                reinterpret_cast<const uint8_t *>(command.data()),
+                                command.size(),
+                                false))
+    {
+        return false;
+    }
+    if (endFault)
+    {
+        endFault();
+    }
+
+    WireRecorder::Publish publish;
+    const bool acked = bench.device.waitFor(bench.context.topics.ackTopic,
+                                            "\"requestId\":\"" + requestId + "\"",
+                                            ROUND_TRIP_TIMEOUT_MS,
+                                            publish);
+    latencyUs = publish.atUs - sentAt;
+    return acked;
+}
+
+Summary summarize(Samples samples)
+{
+    Summary summary;
+    summary.timeouts = samples.timeouts;
+    summary.count = samples.latenciesUs.size();
+    if (samples.latenciesUs.empty())
+    {
+        return summary;
+    }
+
+    std::vector<unsigned long> &sorted = samples.latenciesUs;
+    std::sort(sorted.begin(), sorted.end());
+    unsigned long long total = 0;
+    for (const unsigned long latency : sorted)
+    {
+        total += latency;
+    }
+    summary.minUs = sorted.front();
+    summary.p50Us = host::percentile(sorted, 50);
+    summary.p90Us = host::percentile(sorted, 90);
+    summary.p99Us = host::percentile(sorted, 99);
+    summary.maxUs = sorted.back();
+    summary.meanUs = static_cast<unsigned long>(total / sorted.size());
+    return summary;
+}
+
+double toMs(unsigned long micros)
+{
+    return static_cast<double>(micros) / 1000.0;
+}
+
+std::map<BaselineKey, Summary> loadBaseline(const char *fileName)
+{
+    std::map<BaselineKey, Summary> baseline;
+    FILE *file = std::fopen(fileName, "r");
+    if (file == nullptr)
+    {
+        std::fprintf(stderr, "cannot read baseline %s\n", fileName);
+        return baseline;
+    }
+
+    char line[256];
+    while (std::fgets(line, sizeof(line), file) != nullptr)
+    {
+        char scenario[64];
+        char path[32];
+        Summary row;
+        unsigned long count = 0;
+        if (std::sscanf(line, "%63[^,],%31[^,],%lu,%u,%lu,%lu,%lu,%lu,%lu,%lu",
+                        scenario, path, &count, &row.timeouts,
+                        &row.minUs, &row.p50Us, &row.p90Us, &row.p99Us, &row.maxUs, &row.meanUs) == 10)
+        {
+            row.count = count;
+            baseline[{scenario, path}] = row;
+        }
+    }
+    std::fclose(file);
+    return baseline;
+}
+
+void printRow(const char *scenario, const char *path, const Summary &summary, const std::map<BaselineKey, Summary> &baseline)
+{
+    std::printf("%-14s %-7s %5zu %4u %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f",
+                scenario, path, summary.count, summary.timeouts,
+                toMs(summary.minUs), toMs(summary.p50Us), toMs(summary.p90Us),
+                toMs(summary.p99Us), toMs(summary.maxUs), toMs(summary.meanUs));
+
+    const auto previous = baseline.find({scenario, path});
+    if (previous != baseline.end() && summary.count > 0 && previous->second.count > 0)
+    {
+        std::printf("   p50 %+8.2f  p99 %+8.2f",
+                    toMs(summary.p50Us) - toMs(previous->second.p50Us),
+                    toMs(summary.p99Us) - toMs(previous->second.p99Us));
+    }
+    std::printf("\n");
+}
+
+void writeRow(FILE *csv, const char *scenario, const char *path, const Summary &summary)
+{
+    std::fprintf(csv, "%s,%s,%zu,%u,%lu,%lu,%lu,%lu,%lu,%lu\n",
+                 scenario, path, summary.count, summary.timeouts,
+                 summary.minUs, summary.p50Us, summary.p90Us, summary.p99Us, summary.maxUs, summary.meanUs);
+}
+
+void usage(const char *program)
+{
+    std::fprintf(stderr,
+                 "usage: %s [--broker host[:port]] [--iterations n] [--scenario name]... "
+                 "[--seed n] [--csv path] [--baseline path] [-v]\n",
+                 program);
+    std::fprintf(stderr, "scenarios:\n");
+    for (const Scenario &scenario : scenarios())
+    {
+        std::fprintf(stderr, "  %-14s %s\n", scenario.name, scenario.description);
+    }
+}
+}
+
+int main(int argc, char **argv)
+{
+    std::string brokerHost = "127.0.0.1";
+    uint16_t brokerPort = 1883;
+    unsigned iterations = 100;
+    unsigned seed = 1;
+    const char *csvPath = nullptr;
+    const char *baselinePath = nullptr;
+    bool verbose = false;
+    std::vector<const Scenario *> selected;
+
+    for (int index = 1; index < argc; ++index)
+    {
+        const std::string argument = argv[index];
+        const bool hasValue = index + 1 < argc;
+        if (argument == "--broker" && hasValue)
+        {
+            brokerHost = argv[++index];
+            const size_t colon = brokerHost.rfind(':');
+            if (colon != std::string::npos)
+            {
+                brokerPort = static_cast<uint16_t>(std::strtoul(brokerHost.c_str() + colon + 1, nullptr, 10));
+                brokerHost.resize(colon);
+            }
+        }
+        else if (argument == "--iterations" && hasValue)
+        {
+            iterations = static_cast<unsigned>(std::strtoul(argv[++index], nullptr, 10));
+        }
+        else if (argument == "--seed" && hasValue)
+        {
+            seed = static_cast<unsigned>(std::strtoul(argv[++index], nullptr, 10));
+        }
+        else if (argument == "--csv" && hasValue)
+        {
+            csvPath = argv[++index];
+        }
+        else if (argument == "--baseline" && hasValue)
+        {
+            baselinePath = argv[++index];
+        }
+        else if (argument == "--scenario" && hasValue)
+        {
+            const std::string name = argv[++index];
+            const auto &all = scenarios();
+            const auto found = std::find_if(all.begin(), all.end(), [&name](const Scenario &scenario)
+                                            { return name == scenario.name; });
+            if (found == all.end())
+            {
+                usage(argv[0]);
+                return 2;
+            }
+            selected.push_back(&*found);
+        }
+        else if (argument == "-v")
+        {
+            verbose = true;
+        }
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (selected.empty())
+    {
+        for (const Scenario &scenario : scenarios())
+        {
+            selected.push_back(&scenario);
+        }
+    }
+
+    const std::string deviceId = "bench-" + std::to_string(getpid());
+    hal::FakePlatform fake(verbose);
+    fake.storage.files["/.env"] = "BIKE_ID=" + deviceId + "\n" +
+                                  "WIFI_SSID=bench\n" +
+                                  "WIFI_PASS=bench\n" +
+                                  "MQTT_BROKER_IP=" + brokerHost + "\n" +
+                                  "MQTT_PORT=" + std::to_string(brokerPort) + "\n" +
+                                  // A tap a second is the point of the bench, not a fault.
+                                  "TAP_RATE_PER_MIN=0\n";
+    WireRecorder device;
+    hal::Platform platform{fake.serial, fake.storage, fake.pwm, &fake.bay, 1, fake.wifi, device, fake.system, fake.networkTime};
+
+    hal::PosixMqttTransport observer;
+    observer.setServer(brokerHost.c_str(), brokerPort);
+    if (!observer.connect((deviceId + "-observer").c_str(), nullptr, nullptr))
+    {
+        std::fprintf(stderr, "cannot reach an MQTT broker at %s:%u (state %d)\n",
+                     brokerHost.c_str(), brokerPort, observer.state());
+        return 1;
+    }
+
+    Bench bench{fake, device, observer, makeDeviceContext(deviceId)};
+    App app(platform);
+    app.setup();
+    hal::startTask(APP_TASK, runApp, &app);
+
+    WireRecorder::Publish online;
+    if (!device.waitFor(bench.context.topics.statusTopic, "\"mqttConnected\":true", ONLINE_TIMEOUT_MS, online))
+    {
+        std::fprintf(stderr, "device never came online\n");
+        host::quickExit(1);
+    }
+
+    const std::map<BaselineKey, Summary> baseline =
+        baselinePath != nullptr ? loadBaseline(baselinePath) : std::map<BaselineKey, Summary>();
+    FILE *csv = csvPath != nullptr ? std::fopen(csvPath, "w") : nullptr;
+    if (csvPath != nullptr && csv == nullptr)
+    {
+        std::fprintf(stderr, "cannot write %s\n", csvPath);
+        host::quickExit(1);
+    }
+    if (csv != nullptr)
+    {
+        std::fprintf(csv, "scenario,path,count,timeouts,min_us,p50_us,p90_us,p99_us,max_us,mean_us\n");
+    }
+
+    std::printf("%u iterations per scenario against %s:%u, seed %u, latencies in ms\n",
+                iterations, brokerHost.c_str(), brokerPort, seed);
+    std::printf("%-14s %-7s %5s %4s %9s %9s %9s %9s %9s %9s\n",
+                "scenario", "path", "n", "lost", "min", "p50", "p90", "p99", "max", "mean");
+
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<unsigned long> gapMs(MIN_GAP_MS, MAX_GAP_MS);
+    uint32_t sequence = 0;
+    bool anyLost = false;
+    for (const Scenario *scenario : selected)
+    {
+        Samples taps;
+        Samples unlocks;
+        for (unsigned iteration = 0; iteration < iterations; ++iteration)
+        {
+            unsigned long latencyUs = 0;
+            ++sequence;
+
+            idle(observer, gapMs(random));
+            if (measureTap(bench, *scenario, sequence, latencyUs))
+            {
+                taps.latenciesUs.push_back(latencyUs);
+            }
+            else
+            {
+                ++taps.timeouts;
+            }
+
+            idle(observer, gapMs(random));
+            if (!observer.connected())
+            {
+                observer.connect((deviceId + "-observer").c_str(), nullptr, nullptr);
+            }
+            if (measureUnlock(bench, *scenario, sequence, latencyUs))
+            {
+                unlocks.latenciesUs.push_back(latencyUs);
+            }
+            else
+            {
+                ++unlocks.timeouts;
+            }
+        }
+        fake.nfc.setScanTiming(0, 0);
+
+        const Summary tapSummary = summarize(std::move(taps));
+        const Summary unlockSummary = summarize(std::move(unlocks));
+        anyLost = anyLost || tapSummary.timeouts > 0 || unlockSummary.timeouts > 0;
+        printRow(scenario->name, "tap", tapSummary, baseline);
+        printRow(scenario->name, "unlock", unlockSummary, baseline);
+        std::fflush(stdout);
+        if (csv != nullptr)
+        {
+            writeRow(csv, scenario->name, "tap", tapSummary);
+            writeRow(csv, scenario->name, "unlock", unlockSummary);
+            std::fflush(csv);
+        }
+    }
+
+    if (csv != nullptr)
+    {
+        std::fclose(csv);
+    }
+    host::quickExit(anyLost ? 3 : 0);
+}
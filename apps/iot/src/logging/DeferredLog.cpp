@@ -0,0 +1,573 @@
+#include "logging/DeferredLog.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <mutex>
+
+#include "hal/Clock.h"
+#include "hal/SerialPort.h"
+#include "hal/Task.h"
+#include "metrics/Metrics.h"
+
+std::atomic<uint8_t> DeferredLog::moduleLevels[static_cast<size_t>(LogModule::Count)] = {
+    {LOG_LEVEL_VERBOSE},
+    {LOG_LEVEL_VERBOSE},
+    {LOG_LEVEL_VERBOSE},
+    {LOG_LEVEL_VERBOSE},
+    {LOG_LEVEL_VERBOSE},
+    {LOG_LEVEL_VERBOSE},
+    {LOG_LEVEL_VERBOSE},
+    {LOG_LEVEL_VERBOSE},
+    {LOG_LEVEL_VERBOSE},
+    {LOG_LEVEL_VERBOSE},
+    {LOG_LEVEL_VERBOSE},
+    {LOG_LEVEL_VERBOSE},
+};
+static_assert(static_cast<size_t>(LogModule::Count) == 12, "update DeferredLog::moduleLevels initialiser");
+
+namespace
+{
+constexpr const char *MODULE_NAMES[] = {
+    "app",
+    "nfc",
+    "tap",
+    "command",
+    "connectivity",
+    "mqtt",
+    "status",
+    "metrics",
+    "provisioning",
+    "config",
+    "auth",
+    "lock",
+};
+static_assert(sizeof(MODULE_NAMES) / sizeof(MODULE_NAMES[0]) == static_cast<size_t>(LogModule::Count), "missing log module name");
+
+constexpr char SEVERITY_LETTERS[] = {'F', 'E', 'W', 'N', 'I', 'T', 'V'};
+
+// Core 0 runs the WiFi stack and otherwise idles; the application loop lives
+// on core 1, so rendering there never competes with tap handling.
+constexpr hal::TaskSpec RENDERER_TASK{"log", 4096, 1, 0};
+constexpr uint32_t RENDERER_IDLE_WAIT_MS = 500;
+constexpr size_t LINE_CAPACITY = 320;
+
+// Positions are free-running counters; the capacity must divide 2^32 so they
+// stay consistent across the wrap.
+static_assert((DeferredLog::RING_CAPACITY & (DeferredLog::RING_CAPACITY - 1)) == 0, "ring capacity must be a power of two");
+uint8_t ring[DeferredLog::RING_CAPACITY];
+std::atomic<uint32_t> ringHead{0}; // Advanced by producers under ringLock.
+std::atomic<uint32_t> ringTail{0}; // Advanced by whoever holds renderLock.
+// Held only for the copy into the ring, never across UART writes.
+std::mutex ringLock;
+std::mutex renderLock;
+
+std::atomic<uint32_t> droppedSinceReport{0};
+MetricCounter droppedRecords("log.dropped_records");
+
+hal::SerialPort *output = nullptr;
+hal::TaskHandle *rendererTask = nullptr;
+
+void copyIn(uint32_t position, const uint8_t *data, size_t length)
+{
+    const size_t offset = position % DeferredLog::RING_CAPACITY;
+    const size_t firstPart = std::min(length, DeferredLog::RING_CAPACITY - offset);
+    std::memcpy(ring + offset, data, firstPart);
+    std::memcpy(ring, data + firstPart, length - firstPart);
+}
+
+void copyOut(uint32_t position, uint8_t *data, size_t length)
+{
+    const size_t offset = position % DeferredLog::RING_CAPACITY;
+    const size_t firstPart = std::min(length, DeferredLog::RING_CAPACITY - offset);
+    std::memcpy(data, ring + offset, firstPart);
+    std::memcpy(data + firstPart, ring, length - firstPart);
+}
+
+struct DecodedArg
+{
+    DeferredLog::ArgType type;
+    int64_t signedValue = 0;
+    uint64_t unsignedValue = 0;
+    double floatValue = 0;
+    char text[DeferredLog::MAX_STRING_ARG_LENGTH + 1];
+};
+
+class ArgReader
+{
+public:
+    ArgReader(const uint8_t *data, size_t length)
+        : data(data), length(length)
+    {
+    }
+
+    bool next(DecodedArg &arg)
+    {
+        if (position >= length)
+        {
+            return false;
+        }
+
+        arg.type = static_cast<DeferredLog::ArgType>(data[position++]);
+        switch (arg.type)
+        {
+        case DeferredLog::ArgType::Int32:
+        {
+            int32_t value;
+            if (!read(&value, sizeof(value)))
+            {
+                return false;
+            }
+            setSigned(arg, value);
+            return true;
+        }
+        case DeferredLog::ArgType::Int64:
+        {
+            int64_t value;
+            if (!read(&value, sizeof(value)))
+            {
+                return false;
+            }
+            setSigned(arg, value);
+            return true;
+        }
+        case DeferredLog::ArgType::UInt32:
+        {
+            uint32_t value;
+            if (!read(&value, sizeof(value)))
+            {
+                return false;
+            }
+            setUnsigned(arg, value);
+            return true;
+        }
+        case DeferredLog::ArgType::UInt64:
+        {
+            uint64_t value;
+            if (!read(&value, sizeof(value)))
+            {
+                return false;
+            }
+            setUnsigned(arg, value);
+            return true;
+        }
+        case DeferredLog::ArgType::Pointer:
+        {
+            uintptr_t value;
+            if (!read(&value, sizeof(value)))
+            {
+                return false;
+            }
+            setUnsigned(arg, value);
+            return true;
+        }
+        case DeferredLog::ArgType::Double:
+        {
+            double value;
+            if (!read(&value, sizeof(value)))
+            {
+                return false;
+            }
+            arg.floatValue = value;
+            arg.signedValue = static_cast<int64_t>(value);
+            arg.unsignedValue = static_cast<uint64_t>(arg.signedValue);
+            return true;
+        }
+        case DeferredLog::ArgType::Char:
+        case DeferredLog::ArgType::Bool:
+        {
+            uint8_t value;
+            if (!read(&value, sizeof(value)))
+            {
+                return false;
+            }
+            setUnsigned(arg, value);
+            return true;
+        }
+        case DeferredLog::ArgType::String:
+        {
+            uint8_t textLength;
+            if (!read(&textLength, sizeof(textLength)) || !read(arg.text, textLength))
+            {
+                return false;
+            }
+            arg.text[textLength] = '\0';
+            return true;
+        }
+        }
+        return false;
+    }
+
+private:
+    bool read(void *target, size_t size)
+    {
+        if (position + size > length)
+        {
+            position = length;
+            return false;
+        }
+        std::memcpy(target, data + position, size);
+        position += size;
+        return true;
+    }
+
+    static void setSigned(DecodedArg &arg, int64_t value)
+    {
+        arg.signedValue = value;
+        arg.unsignedValue = static_cast<uint64_t>(value);
+        arg.floatValue = static_cast<double>(value);
+    }
+
+    static void setUnsigned(DecodedArg &arg, uint64_t value)
+    {
+        arg.signedValue = static_cast<int64_t>(value);
+        arg.unsignedValue = value;
+        arg.floatValue = static_cast<double>(value);
+    }
+
+    const uint8_t *data;
+    size_t length;
+    size_t position = 0;
+};
+
+class LineBuilder
+{
+public:
+    void append(char character)
+    {
+        if (length + 1 < LINE_CAPACITY)
+        {
+            line[length++] = character;
+            line[length] = '\0';
+        }
+    }
+
+    void append(const char *text)
+    {
+        while (*text != '\0')
+        {
+            append(*text++);
+        }
+    }
+
+    template <typename... Args>
+    void appendFormatted(const char *format, Args... args)
+    {
+        const int written = snprintf(line + length, LINE_CAPACITY - length, format, args...);
+        if (written > 0)
+        {
+            length = std::min(length + static_cast<size_t>(written), LINE_CAPACITY - 1);
+        }
+    }
+
+    void terminateLine()
+    {
+        if (length == 0 || line[length - 1] != '\n')
+        {
+            if (length + 1 >= LINE_CAPACITY)
+            {
+                --length;
+            }
+            line[length++] = '\n';
+            line[length] = '\0';
+        }
+    }
+
+    const char *data() const
+    {
+        return line;
+    }
+
+    size_t size() const
+    {
+        return length;
+    }
+
+private:
+    char line[LINE_CAPACITY] = {};
+    size_t length = 0;
+};
+
+// printf conversions are re-expanded from the stored argument type, so
+// length modifiers in the source format (l, ll, z, ...) are ignored and a
+// mismatched specifier prints a sane value instead of reading garbage.
+// ArduinoLog's %T/%t boolean conversions are kept for old call sites.
+void renderArg(LineBuilder &builder, const char *flags, char conversion, const DecodedArg &arg)
+{
+    char spec[24];
+    switch (conversion)
+    {
+    case 's':
+        if (arg.type == DeferredLog::ArgType::String)
+        {
+            snprintf(spec, sizeof(spec), "%%%ss", flags);
+            builder.appendFormatted(spec, arg.text);
+        }
+        else
+        {
+            snprintf(spec, sizeof(spec), "%%%s" PRId64, flags);
+            builder.appendFormatted(spec, arg.signedValue);
+        }
+        return;
+    case 'd':
+    case 'i':
+        snprintf(spec, sizeof(spec), "%%%s" PRId64, flags);
+        builder.appendFormatted(spec, arg.signedValue);
+        return;
+    case 'u':
+        snprintf(spec, sizeof(spec), "%%%s" PRIu64, flags);
+        builder.appendFormatted(spec, arg.unsignedValue);
+        return;
+    case 'x':
+        snprintf(spec, sizeof(spec), "%%%s" PRIx64, flags);
+        builder.appendFormatted(spec, arg.unsignedValue);
+        return;
+    case 'X':
+        snprintf(spec, sizeof(spec), "%%%s" PRIX64, flags);
+        builder.appendFormatted(spec, arg.unsignedValue);
+        return;
+    case 'o':
+        snprintf(spec, sizeof(spec), "%%%s" PRIo64, flags);
+        builder.appendFormatted(spec, arg.unsignedValue);
+        return;
+    case 'p':
+        builder.appendFormatted("0x%08" PRIx64, arg.unsignedValue);
+        return;
+    case 'c':
+        builder.append(static_cast<char>(arg.unsignedValue));
+        return;
+    case 'f':
+    case 'F':
+    case 'e':
+    case 'E':
+    case 'g':
+    case 'G':
+        snprintf(spec, sizeof(spec), "%%%s%c", flags, conversion);
+        builder.appendFormatted(spec, arg.floatValue);
+        return;
+    case 'T':
+        builder.append(arg.unsignedValue != 0 ? "true" : "false");
+        return;
+    case 't':
+        builder.append(arg.unsignedValue != 0 ? 'T' : 'F');
+        return;
+    default:
+        builder.append('%');
+        builder.append(conversion);
+        return;
+    }
+}
+
+void renderMessage(LineBuilder &builder, const char *format, const uint8_t *args, size_t argsLength)
+{
+    ArgReader reader(args, argsLength);
+    DecodedArg arg;
+
+    for (const char *cursor = format; *cursor != '\0'; ++cursor)
+    {
+        if (*cursor != '%')
+        {
+            builder.append(*cursor);
+            continue;
+        }
+
+        ++cursor;
+        if (*cursor == '%')
+        {
+            builder.append('%');
+            continue;
+        }
+
+        char flags[12];
+        size_t flagsLength = 0;
+        while (*cursor != '\0' && std::strchr("-+ #0123456789.", *cursor) != nullptr)
+        {
+            if (flagsLength + 1 < sizeof(flags))
+            {
+                flags[flagsLength++] = *cursor;
+            }
+            ++cursor;
+        }
+        flags[flagsLength] = '\0';
+
+        while (*cursor != '\0' && std::strchr("hlLqjz", *cursor) != nullptr)
+        {
+            ++cursor;
+        }
+        if (*cursor == '\0')
+        {
+            break;
+        }
+
+        if (!reader.next(arg))
+        {
+            builder.append("<?>");
+            continue;
+        }
+        renderArg(builder, flags, *cursor, arg);
+    }
+}
+
+void renderRecord(const uint8_t *record, size_t length)
+{
+    const uint8_t severity = record[2];
+    const uint8_t module = record[3];
+    uint32_t timestampMs;
+    std::memcpy(&timestampMs, record + 4, sizeof(timestampMs));
+    const char *format;
+    std::memcpy(&format, record + 8, sizeof(format));
+    const size_t argsOffset = 9 + sizeof(format);
+
+    LineBuilder builder;
+    builder.appendFormatted("%" PRIu32 " %c %s: ",
+                            timestampMs,
+                            severity < sizeof(SEVERITY_LETTERS) ? SEVERITY_LETTERS[severity] : '?',
+                            logModuleName(static_cast<LogModule>(module)));
+    renderMessage(builder, format, record + argsOffset, length - argsOffset);
+    builder.terminateLine();
+
+    // One write per line keeps lines whole when something else also prints.
+    output->write(reinterpret_cast<const uint8_t *>(builder.data()), builder.size());
+}
+
+void renderPending()
+{
+    uint8_t record[DeferredLog::MAX_RECORD_SIZE];
+
+    while (true)
+    {
+        const uint32_t tail = ringTail.load(std::memory_order_relaxed);
+        const uint32_t head = ringHead.load(std::memory_order_acquire);
+        if (head == tail)
+        {
+            break;
+        }
+
+        uint16_t length;
+        copyOut(tail, reinterpret_cast<uint8_t *>(&length), sizeof(length));
+        copyOut(tail, record, length);
+        ringTail.store(tail + length, std::memory_order_release);
+        renderRecord(record, length);
+    }
+
+    const uint32_t dropped = droppedSinceReport.exchange(0, std::memory_order_relaxed);
+    if (dropped > 0)
+    {
+        LineBuilder builder;
+        builder.appendFormatted("%lu W log: dropped %" PRIu32 " records, ring full\n", hal::millis(), dropped);
+        output->write(reinterpret_cast<const uint8_t *>(builder.data()), builder.size());
+    }
+}
+
+void renderLocked()
+{
+    if (output == nullptr)
+    {
+        return;
+    }
+    const std::lock_guard<std::mutex> lock(renderLock);
+    renderPending();
+}
+
+void rendererLoop(void *)
+{
+    while (true)
+    {
+        hal::waitForNotification(RENDERER_IDLE_WAIT_MS);
+        renderLocked();
+    }
+}
+} // namespace
+
+const char *logModuleName(LogModule module)
+{
+    const size_t index = static_cast<size_t>(module);
+    return index < static_cast<size_t>(LogModule::Count) ? MODULE_NAMES[index] : "?";
+}
+
+bool parseLogModule(std::string_view name, LogModule &module)
+{
+    for (size_t index = 0; index < static_cast<size_t>(LogModule::Count); ++index)
+    {
+        if (name == MODULE_NAMES[index])
+        {
+            module = static_cast<LogModule>(index);
+            return true;
+        }
+    }
+    return false;
+}
+
+void DeferredLog::begin(hal::SerialPort &target, uint8_t level)
+{
+    setLevel(level);
+    if (rendererTask != nullptr)
+    {
+        return;
+    }
+
+    output = &target;
+    rendererTask = hal::startTask(RENDERER_TASK, rendererLoop, nullptr);
+}
+
+void DeferredLog::setLevel(uint8_t level)
+{
+    for (auto &moduleLevel : moduleLevels)
+    {
+        moduleLevel.store(level, std::memory_order_relaxed);
+    }
+}
+
+void DeferredLog::setModuleLevel(LogModule module, uint8_t level)
+{
+    moduleLevels[static_cast<size_t>(module)].store(level, std::memory_order_relaxed);
+}
+
+uint8_t DeferredLog::moduleLevel(LogModule module)
+{
+    return moduleLevels[static_cast<size_t>(module)].load(std::memory_order_relaxed);
+}
+
+void DeferredLog::flush()
+{
+    renderLocked();
+}
+
+void DeferredLog::commit(uint8_t *record, size_t length, LogSeverity severity, LogModule module, const char *format, uint8_t argCount)
+{
+    const uint16_t recordLength = static_cast<uint16_t>(length);
+    const uint32_t timestampMs = hal::millis();
+    std::memcpy(record, &recordLength, sizeof(recordLength));
+    record[2] = static_cast<uint8_t>(severity);
+    record[3] = static_cast<uint8_t>(module);
+    std::memcpy(record + 4, &timestampMs, sizeof(timestampMs));
+    std::memcpy(record + 8, &format, sizeof(format));
+    record[8 + sizeof(format)] = argCount;
+
+    bool wasEmpty = false;
+    bool stored = false;
+    {
+        const std::lock_guard<std::mutex> lock(ringLock);
+        const uint32_t head = ringHead.load(std::memory_order_relaxed);
+        const uint32_t tail = ringTail.load(std::memory_order_acquire);
+        if (RING_CAPACITY - (head - tail) >= length)
+        {
+            copyIn(head, record, length);
+            ringHead.store(head + length, std::memory_order_release);
+            wasEmpty = head == tail;
+            stored = true;
+        }
+    }
+
+    if (!stored)
+    {
+        droppedRecords.increment();
+        droppedSinceReport.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    if (wasEmpty && rendererTask != nullptr)
+    {
+        hal::notifyTask(rendererTask);
+    }
+}
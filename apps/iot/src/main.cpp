@@ -1,10 +1,105 @@
 #include <Arduino.h>
+#include <SPI.h>
+#include <Wire.h>
 
+#include <array>
+#include <utility>
+
+#include "HardwareConfig.h"
 #include "app/App.h"
+#include "hal/MuxedNfcReader.h"
+#include "hal/esp32/AdafruitPn532Reader.h"
+#include "hal/esp32/Esp32DigitalInput.h"
+#include "hal/esp32/Esp32I2CBus.h"
+#include "hal/esp32/Esp32SerialPort.h"
+#include "hal/esp32/Esp32System.h"
+#include "hal/esp32/Esp32WifiLink.h"
+#include "hal/esp32/LedcPwmOutput.h"
+#include "hal/esp32/PartitionFlashRegion.h"
+#include "hal/esp32/PubSubMqttTransport.h"
+#include "hal/esp32/SntpNetworkTime.h"
+#include "hal/esp32/SpiffsFileStorage.h"
+#include "hal/esp32/Tca9548aMux.h"
+#include "hal/esp32/TimerPulseOutput.h"
 
 namespace
 {
-App app;
+hal::Esp32SerialPort serialPort(Serial);
+hal::SpiffsFileStorage fileStorage;
+hal::LedcPwmOutput pwmOutput;
+hal::Esp32I2CBus i2cBus(Wire, HardwareConfig::I2C_SDA_PIN, HardwareConfig::I2C_SCL_PIN);
+
+#if NFC_BAY_COUNT > 1
+hal::Tca9548aMux i2cMux(Wire, HardwareConfig::I2C_MUX_ADDRESS);
+
+// The station board wires neither IRQ nor reset to the bays, so the readers
+// are polled over I2C.
+struct StationReader
+{
+    explicit StationReader(uint8_t channel)
+        : pn532(hal::AdafruitPn532Reader::NO_PIN, hal::AdafruitPn532Reader::NO_PIN, Wire),
+          reader(pn532, i2cMux, channel)
+    {
+    }
+    StationReader(const StationReader &) = delete;
+
+    hal::AdafruitPn532Reader pn532;
+    hal::MuxedNfcReader reader;
+};
+
+template <size_t... Bay>
+std::array<StationReader, sizeof...(Bay)> makeStationReaders(std::index_sequence<Bay...>)
+{
+    return {StationReader(Bay)...};
+}
+
+template <size_t... Bay>
+std::array<hal::NfcBay, sizeof...(Bay)> makeNfcBays(std::array<StationReader, sizeof...(Bay)> &readers, std::index_sequence<Bay...>)
+{
+    return {hal::NfcBay{readers[Bay].reader, i2cBus}...};
+}
+
+std::array<StationReader, HardwareConfig::NFC_BAYS> stationReaders =
+    makeStationReaders(std::make_index_sequence<HardwareConfig::NFC_BAYS>{});
+std::array<hal::NfcBay, HardwareConfig::NFC_BAYS> nfcBays =
+    makeNfcBays(stationReaders, std::make_index_sequence<HardwareConfig::NFC_BAYS>{});
+#else
+hal::AdafruitPn532Reader nfcReader(HardwareConfig::PN532_IRQ_PIN, HardwareConfig::PN532_RESET_PIN);
+SPIClass nfcSpi(HSPI);
+hal::AdafruitPn532Reader nfcSpiReader(nfcSpi,
+                                      {HardwareConfig::PN532_SPI_SCK_PIN,
+                                       HardwareConfig::PN532_SPI_MISO_PIN,
+                                       HardwareConfig::PN532_SPI_MOSI_PIN,
+                                       HardwareConfig::PN532_SPI_SS_PIN});
+std::array<hal::NfcBay, 1> nfcBays{{{nfcReader, i2cBus, &nfcSpiReader}}};
+#endif
+
+hal::Esp32WifiLink wifiLink;
+hal::PubSubMqttTransport mqttTransport;
+hal::Esp32System esp32System;
+hal::SntpNetworkTime networkTime;
+hal::PartitionFlashRegion authFlash("authcache");
+hal::TimerPulseOutput lockCoil(HardwareConfig::LOCK_COIL_PIN,
+                               HardwareConfig::LOCK_COIL_ACTIVE_HIGH,
+                               HardwareConfig::LOCK_PULSE_TIMER);
+hal::Esp32DigitalInput lockSensor(HardwareConfig::LOCK_SENSOR_PIN);
+
+hal::Platform platform{
+    serialPort,
+    fileStorage,
+    pwmOutput,
+    nfcBays.data(),
+    nfcBays.size(),
+    wifiLink,
+    mqttTransport,
+    esp32System,
+    networkTime,
+    &authFlash,
+    &lockCoil,
+    HardwareConfig::LOCK_SENSOR ? &lockSensor : nullptr,
+};
+
+App app(platform);
 }
 
 void setup()
@@ -1,9 +1,20 @@
 #include "CardTapWatcher.h"
 
-#include <ArduinoLog.h>
 #include <cstdio>
 #include <algorithm>
-#include <cctype>
+
+#include "app/Scheduler.h"
+#include "hal/Clock.h"
+#include "logging/DeferredLog.h"
+#include "metrics/Metrics.h"
+
+namespace {
+constexpr LogModule LOG_MODULE = LogModule::Nfc;
+MetricGauge consecutiveFailedScansGauge("nfc.consecutive_failed_scans");
+MetricCounter cardsDetected("nfc.cards_detected");
+MetricCounter ambiguousTaps("nfc.ambiguous_taps");
+MetricCounter cardsRemoved("nfc.cards_removed");
+}
 
 CardTapWatcher::CardTapWatcher(
     NFCManager& manager,
@@ -15,8 +26,8 @@ CardTapWatcher::CardTapWatcher(
   , debounceInterval(debounceMs)
   , scanTimeout(scanTimeoutMs) {}
 
-bool CardTapWatcher::poll(std::string& cardUidOut) {
-  const unsigned long now = millis();
+bool CardTapWatcher::poll(CardTap& tapOut) {
+  const uint64_t now = hal::uptimeMs();
 
   if (!nfcManager.isHealthy() || nfcManager.isRecovering()) {
     if (now - lastRecoverTick >= RECOVER_TICK_INTERVAL_MS) {
@@ -26,83 +37,252 @@ bool CardTapWatcher::poll(std::string& cardUidOut) {
     return false;
   }
 
-  if (now - lastPollTime < pollInterval) {
+  // A pending card's confirming scans run back to back.
+  if (pendingScansLeft == 0 && now - lastPollTime < pollInterval) {
     return false;
   }
   lastPollTime = now;
 
-  uint8_t uid[7] = {0};
-  uint8_t uidLength = 0;
-
-  const bool success = nfcManager.scanForCard(uid, &uidLength, scanTimeout);
-  if (!success) {
+  // MaxTg=2 costs the same single InListPassiveTarget as one card.
+  const hal::CardProtocol protocol = takeNextProtocol();
+  // Type B and FeliCa cards answer a single REQB or POLLING within a few
+  // ms; only type A anticollision needs the full timeout.
+  const uint16_t timeout = protocol == hal::CardProtocol::Iso14443A ? scanTimeout
+                                                                     : std::min(scanTimeout, SHORT_SCAN_TIMEOUT_MS);
+  hal::PassiveTarget targets[MAX_TARGETS];
+  const uint8_t targetCount = nfcManager.scanForCards(protocol, targets, MAX_TARGETS, timeout);
+  if (targetCount == 0) {
     consecutiveFailedScans = std::min<uint16_t>(consecutiveFailedScans + 1, UINT16_MAX);
+    consecutiveFailedScansGauge.set(consecutiveFailedScans);
     const bool healthCheckDue = (now - lastHealthCheckAt) >= HEALTH_CHECK_INTERVAL_MS ||
                                 consecutiveFailedScans >= FAILED_SCAN_THRESHOLD_FOR_HEALTH_CHECK;
 
     if (healthCheckDue) {
       lastHealthCheckAt = now;
       if (!nfcManager.healthCheck()) {
-        Log.error("PN532 became unresponsive, scheduling recovery\n");
+        LOGE("PN532 became unresponsive, scheduling recovery\n");
         nfcManager.recoverTick();
         lastRecoverTick = now;
-        cardPresent = false;
-        consecutiveMisses = 0;
+        clearPresent();
         consecutiveFailedScans = 0;
+        consecutiveFailedScansGauge.set(0);
         return false;
       }
       consecutiveFailedScans = 0;
+      consecutiveFailedScansGauge.set(0);
     }
 
-    if (cardPresent) {
-      consecutiveMisses = std::min<uint8_t>(consecutiveMisses + 1, MAX_MISSES_BEFORE_RESET);
-      if (consecutiveMisses >= MAX_MISSES_BEFORE_RESET) {
-        cardPresent = false;
-        consecutiveMisses = 0;
-      }
+    ageSessions(protocol, nullptr, 0);
+    if (releasePending(tapOut, now)) {
+      return true;
+    }
+    if (parkBetweenPolls && presentCount == 0) {
+      nfcManager.park();
     }
     return false;
   }
 
   consecutiveFailedScans = 0;
+  consecutiveFailedScansGauge.set(0);
   lastHealthCheckAt = now;
-  consecutiveMisses = 0;
-  std::string decimalUid = convertUidToDecimal(uid, uidLength);
 
-  auto stringsEqualIgnoreCase = [](const std::string& lhs, const std::string& rhs) {
-    if (lhs.size() != rhs.size()) {
-      return false;
-    }
-    for (size_t i = 0; i < lhs.size(); ++i) {
-      if (std::tolower(static_cast<unsigned char>(lhs[i])) !=
-          std::tolower(static_cast<unsigned char>(rhs[i]))) {
-        return false;
-      }
-    }
-    return true;
-  };
+  std::string uids[MAX_TARGETS];
+  bool anyNew = false;
+  for (uint8_t i = 0; i < targetCount; ++i) {
+    uids[i] = convertUidToDecimal(targets[i].uid, targets[i].uidLength);
+    anyNew = markPresent(uids[i], protocol, now) || anyNew;
+  }
+  // A card swapped for another never leaves the field empty, so sessions
+  // end on their own misses rather than on an empty scan.
+  ageSessions(protocol, uids, targetCount);
+  // Whatever answers another protocol's scan while a card is pending was in
+  // the field with it, whether or not it was seen before.
+  if (pendingScansLeft > 0 && protocol != pendingCard.protocol) {
+    pendingScansLeft = 0;
+    markReported(pendingCard.uid, now);
+    markReported(uids[0], now);
+    return reportAmbiguous(pendingCard.uid, pendingCard.protocol, uids[0], tapOut);
+  }
+  if (!anyNew) {
+    return releasePending(tapOut, now);
+  }
+  if (targetCount > 1) {
+    markReported(uids[0], now);
+    markReported(uids[1], now);
+    return reportAmbiguous(uids[0], protocol, uids[1], tapOut);
+  }
 
-  const bool sameUidAsLast = stringsEqualIgnoreCase(decimalUid, lastPublishedUid);
-  const bool withinDebounce = (now - lastPublishTime) < debounceInterval;
-  const bool isDuplicate = cardPresent && sameUidAsLast && withinDebounce;
+  // A card of another protocol next to this one only shows up in that
+  // protocol's scan, so the tap waits until each has had one.
+  if (enabledProtocols > 1) {
+    pendingCard = PresentCard{uids[0], protocol};
+    pendingScansLeft = static_cast<uint8_t>(enabledProtocols - 1);
+    return false;
+  }
+  return reportCard(uids[0], protocol, now, tapOut);
+}
 
-  if (isDuplicate) {
+bool CardTapWatcher::releasePending(CardTap& tapOut, uint64_t now) {
+  if (pendingScansLeft == 0 || --pendingScansLeft > 0) {
     return false;
   }
+  return reportCard(pendingCard.uid, pendingCard.protocol, now, tapOut);
+}
 
-  if (cardPresent && sameUidAsLast && !withinDebounce) {
+bool CardTapWatcher::reportAmbiguous(const std::string& uid,
+                                     hal::CardProtocol protocol,
+                                     const std::string& otherUid,
+                                     CardTap& tapOut) {
+  tapOut.cardUid = uid;
+  tapOut.protocol = protocol;
+  tapOut.otherCardUid = otherUid;
+  ambiguousTaps.increment();
+  LOGW("Two NFC cards in the field: %s and %s\n", uid.c_str(), otherUid.c_str());
+  return true;
+}
+
+bool CardTapWatcher::reportCard(const std::string& uid, hal::CardProtocol protocol, uint64_t now, CardTap& tapOut) {
+  // The same card back within the debounce window bounced at the edge of
+  // the field rather than being tapped again.
+  if (uid == lastPublishedUid && (now - lastPublishTime) < debounceInterval) {
     return false;
   }
 
-  cardPresent = true;
-  lastPublishedUid = decimalUid;
+  markReported(uid, now);
+  lastPublishedUid = uid;
   lastPublishTime = now;
-  cardUidOut = decimalUid;
-  Serial.print("NFC card detected: ");
-  Serial.println(decimalUid.c_str());
+  tapOut.cardUid = uid;
+  tapOut.protocol = protocol;
+  tapOut.otherCardUid.clear();
+  cardsDetected.increment();
+  LOGN("NFC card detected: %s (%s)\n", uid.c_str(), cardProtocolName(protocol));
   return true;
 }
 
+uint64_t CardTapWatcher::nextPollDueAt() const {
+  if (!nfcManager.isHealthy() || nfcManager.isRecovering()) {
+    // Recovery ticks are rate limited locally, but there is no point waking
+    // before the manager's own backoff or restart delay has elapsed.
+    return laterDeadline(lastRecoverTick + RECOVER_TICK_INTERVAL_MS, nfcManager.nextRecoveryActionAt());
+  }
+  return pendingScansLeft > 0 ? lastPollTime : lastPollTime + pollInterval;
+}
+
+bool CardTapWatcher::hasRemoval() const {
+  return removalCount > 0;
+}
+
+bool CardTapWatcher::takeRemoval(CardRemoval& removalOut) {
+  if (removalCount == 0) {
+    return false;
+  }
+  removalOut = std::move(removals[0]);
+  std::move(removals.begin() + 1, removals.begin() + removalCount, removals.begin());
+  --removalCount;
+  return true;
+}
+
+void CardTapWatcher::setPollInterval(unsigned long pollIntervalMs) {
+  pollInterval = pollIntervalMs;
+}
+
+unsigned long CardTapWatcher::currentPollInterval() const {
+  return pollInterval;
+}
+
+bool CardTapWatcher::cardInField() const {
+  return presentCount > 0;
+}
+
+bool CardTapWatcher::confirmingCard() const {
+  return pendingScansLeft > 0;
+}
+
+void CardTapWatcher::setParkBetweenPolls(bool park) {
+  parkBetweenPolls = park;
+}
+
+void CardTapWatcher::setRetapInterval(unsigned long retapMs) {
+  retapInterval = retapMs;
+}
+
+void CardTapWatcher::setProtocols(hal::CardProtocolMask enabled) {
+  protocols = enabled != 0 ? enabled : hal::cardProtocolBit(hal::CardProtocol::Iso14443A);
+  enabledProtocols = 0;
+  for (uint8_t index = 0; index < hal::CARD_PROTOCOL_COUNT; ++index) {
+    enabledProtocols += (protocols >> index) & 1u;
+  }
+}
+
+hal::CardProtocol CardTapWatcher::takeNextProtocol() {
+  for (uint8_t step = 0; step < hal::CARD_PROTOCOL_COUNT; ++step) {
+    const auto candidate = static_cast<hal::CardProtocol>((nextProtocol + step) % hal::CARD_PROTOCOL_COUNT);
+    if ((protocols & hal::cardProtocolBit(candidate)) != 0) {
+      nextProtocol = static_cast<uint8_t>((static_cast<uint8_t>(candidate) + 1) % hal::CARD_PROTOCOL_COUNT);
+      return candidate;
+    }
+  }
+  return hal::CardProtocol::Iso14443A;
+}
+
+bool CardTapWatcher::markPresent(const std::string& uid, hal::CardProtocol protocol, uint64_t now) {
+  for (size_t i = 0; i < presentCount; ++i) {
+    PresentCard& card = presentCards[i];
+    if (card.uid == uid) {
+      card.lastSeenAt = now;
+      card.misses = 0;
+      return retapInterval > 0 && card.reported && now - card.reportedAt >= retapInterval;
+    }
+  }
+  // A full list drops the oldest card; it only fills up when cards are
+  // swapped without the field ever going empty.
+  if (presentCount == MAX_PRESENT_CARDS) {
+    std::rotate(presentCards.begin(), presentCards.begin() + 1, presentCards.end());
+    --presentCount;
+  }
+  presentCards[presentCount++] = PresentCard{uid, protocol, now, now, 0, 0, false};
+  return true;
+}
+
+void CardTapWatcher::markReported(const std::string& uid, uint64_t now) {
+  for (size_t i = 0; i < presentCount; ++i) {
+    if (presentCards[i].uid == uid) {
+      presentCards[i].reported = true;
+      presentCards[i].reportedAt = now;
+      return;
+    }
+  }
+}
+
+void CardTapWatcher::clearPresent() {
+  presentCount = 0;
+  pendingScansLeft = 0;
+}
+
+void CardTapWatcher::ageSessions(hal::CardProtocol protocol, const std::string* seenUids, uint8_t seenCount) {
+  size_t kept = 0;
+  for (size_t i = 0; i < presentCount; ++i) {
+    PresentCard& card = presentCards[i];
+    const bool seen = std::find(seenUids, seenUids + seenCount, card.uid) != seenUids + seenCount;
+    if (card.protocol != protocol || seen || ++card.misses < MAX_MISSES_BEFORE_RESET) {
+      if (kept != i) {
+        presentCards[kept] = std::move(card);
+      }
+      ++kept;
+      continue;
+    }
+    // The queue holds a full field; past that a removal is dropped.
+    if (card.reported && removalCount < removals.size()) {
+      const uint64_t dwell = card.lastSeenAt - card.firstSeenAt;
+      removals[removalCount++] = CardRemoval{std::move(card.uid), protocol,
+                                             static_cast<uint32_t>(std::min<uint64_t>(dwell, UINT32_MAX))};
+      cardsRemoved.increment();
+      LOGI("NFC card removed after %lu ms\n", static_cast<unsigned long>(dwell));
+    }
+  }
+  presentCount = kept;
+}
+
 std::string CardTapWatcher::convertUidToDecimal(const uint8_t* uidBytes, uint8_t length) {
   uint64_t uidValue = 0;
   for (uint8_t i = 0; i < length; i++) {
@@ -1,20 +1,40 @@
 #include "MQTTManager.h"
-#include <ArduinoLog.h>
 
-MQTTManager::MQTTManager(WiFiClient &wifiClient,
+#include <cstring>
+#include <utility>
+
+#include "logging/DeferredLog.h"
+#include "metrics/Metrics.h"
+
+namespace
+{
+constexpr LogModule LOG_MODULE = LogModule::Mqtt;
+
+// PubSubClient defaults to 256 bytes for the whole packet, which is too
+// small for a metrics batch once the topic is included.
+constexpr uint16_t MQTT_PACKET_BUFFER_SIZE = 1152;
+
+MetricCounter connectsTotal("mqtt.connects");
+MetricCounter connectFailures("mqtt.connect_failures");
+MetricCounter publishesTotal("mqtt.publishes");
+MetricCounter publishFailures("mqtt.publish_failures");
+}
+
+MQTTManager::MQTTManager(hal::MqttTransport &transport,
                          std::string_view clientId,
                          std::string_view brokerIP,
                          int port,
                          std::string_view username,
                          std::string_view password)
-    : _client(wifiClient),
-      _clientId(clientId),
-      _brokerIP(brokerIP),
-      _port(port),
-      _username(username),
-      _password(password)
+    : _client(transport),
+      _port(port)
 {
-    _client.setServer(_brokerIP.c_str(), _port);
+    _clientId.assign(clientId);
+    _brokerIP.assign(brokerIP);
+    _username.assign(username);
+    _password.assign(password);
+    _client.setServer(_brokerIP.c_str(), static_cast<uint16_t>(_port));
+    _client.setBufferSize(MQTT_PACKET_BUFFER_SIZE);
 }
 
 bool MQTTManager::connect()
@@ -22,7 +42,7 @@ bool MQTTManager::connect()
     bool connected = false;
     if (_username.empty())
     {
-        connected = _client.connect(_clientId.c_str());
+        connected = _client.connect(_clientId.c_str(), nullptr, nullptr);
     }
     else
     {
@@ -31,12 +51,14 @@ bool MQTTManager::connect()
 
     if (connected)
     {
-        Log.info("Connected to MQTT broker as %s\n", _clientId.c_str());
+        connectsTotal.increment();
+        LOGI("Connected to MQTT broker as %s\n", _clientId.c_str());
         return true;
     }
     else
     {
-        Log.error("MQTT connection failed, state: %d\n", _client.state());
+        connectFailures.increment();
+        LOGE("MQTT connection failed, state: %d\n", _client.state());
         return false;
     }
 }
@@ -48,17 +70,19 @@ void MQTTManager::loop()
 
 bool MQTTManager::publish(const char *topic, const char *message, bool retained, bool logMessage)
 {
-    if (_client.publish(topic, message, retained))
+    if (_client.publish(topic, reinterpret_cast<const uint8_t *>(message), strlen(message), retained))
     {
+        publishesTotal.increment();
         if (logMessage)
         {
-            Log.info("Published to %s: %s\n", topic, message);
+            LOGI("Published to %s: %s\n", topic, message);
         }
         return true;
     }
     else
     {
-        Log.error("Failed to publish to %s\n", topic);
+        publishFailures.increment();
+        LOGE("Failed to publish to %s\n", topic);
         return false;
     }
 }
@@ -74,12 +98,12 @@ bool MQTTManager::subscribe(const char *topic)
 {
     if (_client.subscribe(topic))
     {
-        Log.info("Subscribed to %s\n", topic);
+        LOGI("Subscribed to %s\n", topic);
         return true;
     }
     else
     {
-        Log.error("Failed to subscribe to %s\n", topic);
+        LOGE("Failed to subscribe to %s\n", topic);
         return false;
     }
 }
@@ -90,9 +114,9 @@ bool MQTTManager::subscribe(std::string_view topic)
     return subscribe(topicBuffer.c_str());
 }
 
-void MQTTManager::setCallback(void (*callback)(char *, byte *, unsigned int))
+void MQTTManager::setCallback(hal::MqttTransport::MessageCallback callback)
 {
-    _client.setCallback(callback);
+    _client.setCallback(std::move(callback));
 }
 
 bool MQTTManager::isConnected()
@@ -1,53 +1,185 @@
 #include "NFCManager.h"
 
-#include <ArduinoLog.h>
-#include <Wire.h>
 #include <algorithm>
 
-#include "HardwareConfig.h"
+#include "app/Scheduler.h"
+#include "hal/Clock.h"
+#include "logging/DeferredLog.h"
+#include "metrics/Metrics.h"
 
-NFCManager::NFCManager()
-    : nfc(HardwareConfig::PN532_IRQ_PIN, HardwareConfig::PN532_RESET_PIN) {}
+namespace
+{
+constexpr LogModule LOG_MODULE = LogModule::Nfc;
+
+MetricCounter recoveryAttemptsTotal("nfc.recovery_attempts");
+MetricCounter recoveriesTotal("nfc.recoveries");
+MetricCounter healthCheckFailures("nfc.health_check_failures");
+// Number of healthy readers; 0 or 1 on a single-reader device.
+MetricGauge readersHealthy("nfc.healthy");
+int32_t healthyReaderCount = 0;
+// Transport clock of the reader brought up or stepped down last.
+MetricGauge busClockKhz("nfc.bus_khz");
+MetricCounter clockStepDowns("nfc.clock_step_downs");
+MetricCounter powerDowns("nfc.power_downs");
+MetricCounter wakeFailures("nfc.wake_failures");
+
+NfcBusMode effectiveBusMode(NfcBusMode requested, const hal::NfcReader *spiReader)
+{
+    return requested == NfcBusMode::Spi && spiReader == nullptr ? NfcBusMode::I2cAdaptive : requested;
+}
+}
+
+std::optional<NfcBusMode> parseNfcBusMode(std::string_view name)
+{
+    if (name.empty() || name == "i2c")
+    {
+        return NfcBusMode::I2cAdaptive;
+    }
+    if (name == "i2c-100k")
+    {
+        return NfcBusMode::I2cStandard;
+    }
+    if (name == "spi")
+    {
+        return NfcBusMode::Spi;
+    }
+    return std::nullopt;
+}
+
+std::optional<hal::CardProtocolMask> parseCardProtocols(std::string_view names)
+{
+    if (names.empty())
+    {
+        return hal::cardProtocolBit(hal::CardProtocol::Iso14443A);
+    }
+    hal::CardProtocolMask mask = 0;
+    while (true)
+    {
+        const size_t comma = names.find(',');
+        const std::string_view name = names.substr(0, comma);
+        bool known = false;
+        for (uint8_t index = 0; index < hal::CARD_PROTOCOL_COUNT; ++index)
+        {
+            const hal::CardProtocol protocol = static_cast<hal::CardProtocol>(index);
+            if (name == cardProtocolName(protocol))
+            {
+                mask |= hal::cardProtocolBit(protocol);
+                known = true;
+            }
+        }
+        if (!known)
+        {
+            return std::nullopt;
+        }
+        if (comma == std::string_view::npos)
+        {
+            return mask;
+        }
+        names.remove_prefix(comma + 1);
+    }
+}
+
+const char *cardProtocolName(hal::CardProtocol protocol)
+{
+    switch (protocol)
+    {
+    case hal::CardProtocol::Iso14443A:
+        return "iso14443a";
+    case hal::CardProtocol::Iso14443B:
+        return "iso14443b";
+    case hal::CardProtocol::FeliCa:
+        return "felica";
+    }
+    return "unknown";
+}
+
+NFCManager::NFCManager(hal::NfcReader &reader,
+                       hal::I2CBus &i2c,
+                       uint8_t bay,
+                       NfcBusMode busMode,
+                       hal::NfcReader *spiReader)
+    : busMode(effectiveBusMode(busMode, spiReader)),
+      nfc(this->busMode == NfcBusMode::Spi ? *spiReader : reader),
+      i2c(i2c),
+      bay(bay)
+{
+    if (this->busMode != busMode)
+    {
+        LOGW("Bay %u: no SPI reader wired, using I2C\n", bay);
+    }
+}
+
+NFCManager::~NFCManager()
+{
+    setHealthState(HealthState::Unhealthy);
+}
 
 bool NFCManager::begin()
 {
-    Wire.setTimeout(50);
-    Wire.setClock(100000);
+    if (usesI2c())
+    {
+        i2c.setTimeout(I2C_TIMEOUT_MS);
+        // Bays sharing a bus keep the clock an earlier bay settled on.
+        if (busMode == NfcBusMode::I2cStandard || i2c.clockHz() == 0)
+        {
+            i2c.setClock(busMode == NfcBusMode::I2cAdaptive ? I2C_FAST_CLOCK_HZ : I2C_STANDARD_CLOCK_HZ);
+        }
+    }
 
-    nfc.begin();
-    uint32_t versiondata = nfc.getFirmwareVersion();
+    uint32_t versiondata = wakeChip();
+    busClockKhz.set(static_cast<int32_t>((usesI2c() ? i2c.clockHz() : SPI_CLOCK_HZ) / 1000));
     if (!versiondata)
     {
-        Serial.print("Didn't find PN53x board");
-        Serial.print("Check your wiring and the DIP switches!");
-        healthState = HealthState::Unhealthy;
-        lastRecoveryAttemptAt = millis() - recoveryBackoffMs;
+        LOGE("Bay %u: didn't find PN53x board, check your wiring and the DIP switches\n", bay);
+        setHealthState(HealthState::Unhealthy);
+        nextRecoveryAttemptAt = hal::uptimeMs();
         return false;
     }
-    Serial.println("Found PN532 Board!");
-    Serial.print("Firmware ver. ");
-    Serial.print((versiondata >> 16) & 0xFF, DEC);
-    Serial.print('.');
-    Serial.println((versiondata >> 8) & 0xFF, DEC);
-    nfc.SAMConfig();
-    Serial.println("\nWaiting for an NFC Card...");
-    healthState = HealthState::Healthy;
+    LOGN("Bay %u: found PN532 board, firmware ver. %lu.%lu\n",
+         bay,
+         static_cast<unsigned long>((versiondata >> 16) & 0xFF),
+         static_cast<unsigned long>((versiondata >> 8) & 0xFF));
+    nfc.configureSam();
+    LOGI("Bay %u: waiting for an NFC card\n", bay);
+    setHealthState(HealthState::Healthy);
     recoveryBackoffMs = RECOVERY_BACKOFF_INITIAL_MS;
-    lastRecoveryAttemptAt = 0;
+    nextRecoveryAttemptAt = 0;
     recoveryStep = 0;
     nextActionAt = 0;
     return true;
 }
 
-bool NFCManager::scanForCard(uint8_t *uid, uint8_t *uidLength, uint16_t timeoutMs)
+uint8_t NFCManager::scanForCards(hal::CardProtocol protocol,
+                                 hal::PassiveTarget *targets,
+                                 uint8_t maxTargets,
+                                 uint16_t timeoutMs)
 //scan
 {
-    return nfc.readPassiveTargetID(PN532_MIFARE_ISO14443A, uid, uidLength, timeoutMs);
+    return wakeIfParked() ? nfc.listPassiveTargets(protocol, targets, maxTargets, timeoutMs) : 0;
+}
+
+bool NFCManager::park()
+{
+    if (healthState != HealthState::Healthy || parked)
+    {
+        return parked;
+    }
+    parked = nfc.powerDown();
+    if (parked)
+    {
+        powerDowns.increment();
+    }
+    return parked;
+}
+
+bool NFCManager::isParked() const
+{
+    return parked;
 }
 
 void NFCManager::recoverTick()
 {
-    const unsigned long now = millis();
+    const uint64_t now = hal::uptimeMs();
 
     if (healthState == HealthState::Healthy)
     {
@@ -56,12 +188,12 @@ void NFCManager::recoverTick()
 
     if (healthState == HealthState::Unhealthy)
     {
-        if ((now - lastRecoveryAttemptAt) < recoveryBackoffMs)
+        if (!deadlineReached(now, nextRecoveryAttemptAt))
         {
             return;
         }
         startRecovery();
-        healthState = HealthState::Recovering;
+        setHealthState(HealthState::Recovering);
         recoveryStep = 0;
         nextActionAt = now;
         return;
@@ -72,7 +204,7 @@ void NFCManager::recoverTick()
         return;
     }
 
-    if (now < nextActionAt)
+    if (!deadlineReached(now, nextActionAt))
     {
         return;
     }
@@ -80,41 +212,48 @@ void NFCManager::recoverTick()
     switch (recoveryStep)
     {
     case 0:
-        Log.warning("PN532 recovery: restarting I2C bus\n");
-        Wire.end();
+        if (!usesI2c())
+        {
+            // Reinitializing resets the chip; there is no bus to restart.
+            nextActionAt = now;
+            recoveryStep = 2;
+            break;
+        }
+        LOGW("Bay %u: PN532 recovery, restarting I2C bus\n", bay);
+        i2c.end();
         nextActionAt = now + I2C_RESTART_DELAY_MS;
         recoveryStep = 1;
         break;
     case 1:
-        Wire.begin(HardwareConfig::I2C_SDA_PIN, HardwareConfig::I2C_SCL_PIN);
-        Wire.setTimeout(50);
-        Wire.setClock(100000);
+        // Comes back with the clock and timeout it had.
+        i2c.begin();
         nextActionAt = now + I2C_RESTART_DELAY_MS;
         recoveryStep = 2;
         break;
     case 2:
         if (performReinitialization())
         {
-            const unsigned long duration = now - recoveryStartedAt;
-            Log.info("PN532 recovery successful after %lu ms (attempt %lu)\n", duration, static_cast<unsigned long>(recoveryAttempts));
-            healthState = HealthState::Healthy;
+            const unsigned long duration = static_cast<unsigned long>(now - recoveryStartedAt);
+            LOGI("Bay %u: PN532 recovery successful after %lu ms (attempt %lu)\n", bay, duration, static_cast<unsigned long>(recoveryAttempts));
+            setHealthState(HealthState::Healthy);
+            recoveriesTotal.increment();
             recoveryBackoffMs = RECOVERY_BACKOFF_INITIAL_MS;
             recoveryStep = 0;
-            lastRecoveryAttemptAt = 0;
+            nextRecoveryAttemptAt = 0;
             recoveryAttempts = 0;
             recoveryStartedAt = 0;
         }
         else
         {
-            Log.error("PN532 recovery failed (attempt %lu)\n", static_cast<unsigned long>(recoveryAttempts));
-            healthState = HealthState::Unhealthy;
-            lastRecoveryAttemptAt = now;
+            LOGE("Bay %u: PN532 recovery failed (attempt %lu)\n", bay, static_cast<unsigned long>(recoveryAttempts));
+            setHealthState(HealthState::Unhealthy);
             recoveryBackoffMs = std::min<unsigned long>(recoveryBackoffMs * 2, RECOVERY_BACKOFF_MAX_MS);
+            nextRecoveryAttemptAt = now + recoveryBackoffMs;
             recoveryStep = 0;
         }
         break;
     default:
-        healthState = HealthState::Unhealthy;
+        setHealthState(HealthState::Unhealthy);
         recoveryStep = 0;
         break;
     }
@@ -126,13 +265,21 @@ void NFCManager::markUnhealthy()
     {
         return;
     }
-    healthState = HealthState::Unhealthy;
+    const uint64_t now = hal::uptimeMs();
+    if (healthState == HealthState::Healthy && busMode == NfcBusMode::I2cAdaptive && i2c.clockHz() > I2C_STANDARD_CLOCK_HZ)
+    {
+        const bool soonAfterRecovery = now - healthySince < FAST_CLOCK_STABLE_MS;
+        fastClockFailures = soonAfterRecovery ? fastClockFailures + 1 : 1;
+    }
+    setHealthState(HealthState::Unhealthy);
+    // Reinitialising wakes the chip.
+    parked = false;
     recoveryStep = 0;
     nextActionAt = 0;
     recoveryAttempts = 0;
     recoveryStartedAt = 0;
-    Log.warning("PN532 marked unhealthy, scheduling recovery\n");
-    lastRecoveryAttemptAt = millis() - recoveryBackoffMs;
+    LOGW("Bay %u: PN532 marked unhealthy, scheduling recovery\n", bay);
+    nextRecoveryAttemptAt = now;
 }
 
 bool NFCManager::isHealthy() const
@@ -145,6 +292,25 @@ bool NFCManager::isRecovering() const
     return healthState == HealthState::Recovering;
 }
 
+bool NFCManager::busStopped() const
+{
+    return healthState == HealthState::Recovering && recoveryStep == 1;
+}
+
+uint64_t NFCManager::nextRecoveryActionAt() const
+{
+    switch (healthState)
+    {
+    case HealthState::Unhealthy:
+        return nextRecoveryAttemptAt;
+    case HealthState::Recovering:
+        return nextActionAt;
+    case HealthState::Healthy:
+    default:
+        return hal::uptimeMs();
+    }
+}
+
 bool NFCManager::healthCheck()
 {
     if (healthState != HealthState::Healthy)
@@ -152,36 +318,122 @@ bool NFCManager::healthCheck()
         return false;
     }
 
-    uint32_t versiondata = nfc.getFirmwareVersion();
-    if (!versiondata)
+    // Waking a parked chip already asks it for its version.
+    const bool answered = parked ? wakeIfParked() : nfc.firmwareVersion() != 0;
+    if (!answered)
     {
-        Log.warning("PN532 health check failed\n");
+        LOGW("Bay %u: PN532 health check failed\n", bay);
+        healthCheckFailures.increment();
         markUnhealthy();
         return false;
     }
     return true;
 }
 
+void NFCManager::setHealthState(HealthState next)
+{
+    const bool wasHealthy = healthState == HealthState::Healthy;
+    const bool healthy = next == HealthState::Healthy;
+    healthState = next;
+    if (healthy && !wasHealthy)
+    {
+        healthySince = hal::uptimeMs();
+    }
+    if (wasHealthy != healthy)
+    {
+        healthyReaderCount += healthy ? 1 : -1;
+        readersHealthy.set(healthyReaderCount);
+    }
+}
+
 void NFCManager::startRecovery()
 {
-    const unsigned long now = millis();
-    lastRecoveryAttemptAt = now;
+    const uint64_t now = hal::uptimeMs();
     recoveryStartedAt = now;
     recoveryAttempts += 1;
-    Log.warning("PN532 recovery attempt %lu starting\n", static_cast<unsigned long>(recoveryAttempts));
+    recoveryAttemptsTotal.increment();
+    LOGW("Bay %u: PN532 recovery attempt %lu starting\n", bay, static_cast<unsigned long>(recoveryAttempts));
     recoveryStep = 0;
     nextActionAt = now;
 }
 
 bool NFCManager::performReinitialization()
 {
-    nfc.begin();
-    uint32_t versiondata = nfc.getFirmwareVersion();
+    // Another bay on the bus may have stepped it down already.
+    if (fastClockFailures >= FAST_CLOCK_FAILURES_BEFORE_STEP_DOWN && i2c.clockHz() > I2C_STANDARD_CLOCK_HZ)
+    {
+        LOGW("Bay %u: PN532 failed %u times soon after recovering at %lu kHz, staying at %lu kHz\n",
+             bay,
+             static_cast<unsigned>(fastClockFailures),
+             static_cast<unsigned long>(i2c.clockHz() / 1000),
+             static_cast<unsigned long>(I2C_STANDARD_CLOCK_HZ / 1000));
+        stepDownClock();
+    }
+    uint32_t versiondata = wakeChip();
     if (!versiondata)
     {
         return false;
     }
-    nfc.SAMConfig();
-    Serial.println("PN532 reinitialized");
+    nfc.configureSam();
+    LOGI("Bay %u: PN532 reinitialized\n", bay);
     return true;
 }
+
+bool NFCManager::wakeIfParked()
+{
+    if (!parked)
+    {
+        return true;
+    }
+    parked = false;
+    if (!nfc.wakeUp())
+    {
+        LOGW("Bay %u: PN532 did not wake from power-down\n", bay);
+        wakeFailures.increment();
+        return false;
+    }
+    return true;
+}
+
+bool NFCManager::usesI2c() const
+{
+    return busMode != NfcBusMode::Spi;
+}
+
+uint32_t NFCManager::wakeChip()
+{
+    const uint64_t startedAt = hal::uptimeMs();
+    nfc.begin();
+    const uint32_t version = nfc.firmwareVersion();
+
+    // A hung bus times out at any clock, so only a quick failure at the fast
+    // clock is worth a retry.
+    const uint32_t clockHz = i2c.clockHz();
+    const bool quickFailure = hal::uptimeMs() - startedAt < I2C_TIMEOUT_MS;
+    if (version != 0 || busMode != NfcBusMode::I2cAdaptive || clockHz <= I2C_STANDARD_CLOCK_HZ || !quickFailure)
+    {
+        return version;
+    }
+
+    i2c.setClock(I2C_STANDARD_CLOCK_HZ);
+    nfc.begin();
+    const uint32_t slowVersion = nfc.firmwareVersion();
+    if (slowVersion == 0)
+    {
+        // Not the clock; the chip is just not answering.
+        i2c.setClock(clockHz);
+        return 0;
+    }
+
+    LOGW("Bay %u: PN532 only answers at %lu kHz, staying there\n", bay, static_cast<unsigned long>(I2C_STANDARD_CLOCK_HZ / 1000));
+    stepDownClock();
+    return slowVersion;
+}
+
+void NFCManager::stepDownClock()
+{
+    i2c.setClock(I2C_STANDARD_CLOCK_HZ);
+    clockStepDowns.increment();
+    busClockKhz.set(static_cast<int32_t>(I2C_STANDARD_CLOCK_HZ / 1000));
+    fastClockFailures = 0;
+}
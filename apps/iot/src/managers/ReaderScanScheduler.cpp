@@ -0,0 +1,196 @@
+#include "ReaderScanScheduler.h"
+
+#include <algorithm>
+
+#include "app/Scheduler.h"
+#include "hal/Clock.h"
+#include "logging/DeferredLog.h"
+#include "metrics/Metrics.h"
+
+namespace
+{
+constexpr LogModule LOG_MODULE = LogModule::Nfc;
+// The station's fastest bay; the idle rate once every bay is idle.
+MetricGauge pollIntervalGauge("nfc.poll_interval_ms");
+MetricGauge activeBaysGauge("nfc.active_bays");
+}
+
+ReaderScanScheduler::Bay::Bay(const hal::NfcBay &bay,
+                              uint8_t index,
+                              NfcBusMode busMode,
+                              const NfcPollPolicy &policy)
+    : manager(bay.reader, bay.bus, index, busMode, bay.spiReader), watcher(manager), bus(bay.bus)
+{
+    watcher.setProtocols(policy.protocols);
+    watcher.setRetapInterval(policy.retapIntervalMs);
+}
+
+ReaderScanScheduler::ReaderScanScheduler(const hal::NfcBay *nfcBays,
+                                         size_t nfcBayCount,
+                                         NfcBusMode busMode,
+                                         const NfcPollPolicy &pollPolicy)
+    : count(std::min(nfcBayCount, MAX_BAYS)), policy(pollPolicy)
+{
+    for (size_t index = 0; index < count; ++index)
+    {
+        bays[index] = std::make_unique<Bay>(nfcBays[index], static_cast<uint8_t>(index), busMode, policy);
+    }
+    // Bay 0 is served first.
+    lastServed = count > 0 ? count - 1 : 0;
+}
+
+bool ReaderScanScheduler::begin()
+{
+    if (count == 0)
+    {
+        LOGE("No NFC readers configured\n");
+        return false;
+    }
+
+    bool anyHealthy = false;
+    for (size_t index = 0; index < count; ++index)
+    {
+        Bay &bay = *bays[index];
+        // Bays behind a mux share their bus; it only needs starting once.
+        bool busStarted = false;
+        for (size_t earlier = 0; earlier < index; ++earlier)
+        {
+            busStarted = busStarted || &bays[earlier]->bus == &bay.bus;
+        }
+        if (!busStarted)
+        {
+            bay.bus.begin();
+        }
+        anyHealthy = bay.manager.begin() || anyHealthy;
+    }
+    updatePollRates(hal::uptimeMs());
+    return anyHealthy;
+}
+
+bool ReaderScanScheduler::poll(uint8_t &bay, CardTap &tap)
+{
+    const uint64_t now = hal::uptimeMs();
+    updatePollRates(now);
+    // A bay confirming a card keeps the turn until it reports, which takes
+    // one scan per other protocol.
+    const size_t first = count > 0 && bays[lastServed]->watcher.confirmingCard() ? 0 : 1;
+    for (size_t offset = first; offset < first + count; ++offset)
+    {
+        const size_t index = (lastServed + offset) % count;
+        Bay &served = *bays[index];
+        if (!deadlineReached(now, served.watcher.nextPollDueAt()) || busHolder(index) != nullptr)
+        {
+            continue;
+        }
+
+        lastServed = index;
+        const bool read = served.watcher.poll(tap);
+        if (read || served.watcher.cardInField())
+        {
+            served.activeUntil = hal::uptimeMs() + policy.activeHoldMs;
+        }
+        if (!read)
+        {
+            return false;
+        }
+        bay = static_cast<uint8_t>(index);
+        return true;
+    }
+    return false;
+}
+
+bool ReaderScanScheduler::takeRemoval(uint8_t &bay, CardRemoval &removal)
+{
+    for (size_t index = 0; index < count; ++index)
+    {
+        if (bays[index]->watcher.takeRemoval(removal))
+        {
+            bay = static_cast<uint8_t>(index);
+            return true;
+        }
+    }
+    return false;
+}
+
+uint64_t ReaderScanScheduler::nextPollDueAt() const
+{
+    if (count == 0)
+    {
+        return hal::uptimeMs() + Scheduler::MAX_SLEEP_MS;
+    }
+
+    uint64_t dueAt = hal::uptimeMs() + Scheduler::MAX_SLEEP_MS;
+    for (size_t index = 0; index < count; ++index)
+    {
+        // A queued removal is due now.
+        if (bays[index]->watcher.hasRemoval())
+        {
+            return hal::uptimeMs();
+        }
+        uint64_t bayDueAt = bays[index]->watcher.nextPollDueAt();
+        if (const Bay *holder = busHolder(index))
+        {
+            bayDueAt = laterDeadline(bayDueAt, holder->manager.nextRecoveryActionAt());
+        }
+        dueAt = earlierDeadline(dueAt, bayDueAt);
+    }
+    return dueAt;
+}
+
+void ReaderScanScheduler::noteActivity()
+{
+    const uint64_t activeUntil = hal::uptimeMs() + policy.activeHoldMs;
+    for (size_t index = 0; index < count; ++index)
+    {
+        bays[index]->activeUntil = laterDeadline(bays[index]->activeUntil, activeUntil);
+    }
+    updatePollRates(hal::uptimeMs());
+}
+
+size_t ReaderScanScheduler::bayCount() const
+{
+    return count;
+}
+
+const NFCManager &ReaderScanScheduler::reader(size_t bay) const
+{
+    return bays[bay]->manager;
+}
+
+void ReaderScanScheduler::updatePollRates(uint64_t now)
+{
+    size_t active = 0;
+    for (size_t index = 0; index < count; ++index)
+    {
+        Bay &bay = *bays[index];
+        const bool idle = policy.idleIntervalMs > 0 && deadlineReached(now, bay.activeUntil);
+        bay.watcher.setPollInterval(idle ? policy.idleIntervalMs : policy.activeIntervalMs);
+        bay.watcher.setParkBetweenPolls(idle && policy.powerDownWhenIdle);
+        active += idle ? 0 : 1;
+    }
+    if (active == activeBays)
+    {
+        return;
+    }
+
+    if (activeBays != SIZE_MAX)
+    {
+        LOGV("%u of %u bays polling fast\n", static_cast<unsigned>(active), static_cast<unsigned>(count));
+    }
+    activeBays = active;
+    activeBaysGauge.set(static_cast<int32_t>(active));
+    const bool allIdle = active == 0 && policy.idleIntervalMs > 0;
+    pollIntervalGauge.set(static_cast<int32_t>(allIdle ? policy.idleIntervalMs : policy.activeIntervalMs));
+}
+
+const ReaderScanScheduler::Bay *ReaderScanScheduler::busHolder(size_t index) const
+{
+    for (size_t other = 0; other < count; ++other)
+    {
+        if (other != index && &bays[other]->bus == &bays[index]->bus && bays[other]->manager.busStopped())
+        {
+            return bays[other].get();
+        }
+    }
+    return nullptr;
+}
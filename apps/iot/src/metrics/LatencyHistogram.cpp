@@ -0,0 +1,95 @@
+#include "metrics/LatencyHistogram.h"
+
+#include <algorithm>
+#include <limits>
+
+void LatencyHistogram::record(uint32_t micros)
+{
+    buckets[bucketIndexFor(micros)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+
+    uint32_t observedMax = maxValue.load(std::memory_order_relaxed);
+    while (micros > observedMax &&
+           !maxValue.compare_exchange_weak(observedMax, micros, std::memory_order_relaxed))
+    {
+    }
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::snapshot() const
+{
+    Snapshot result;
+    for (size_t index = 0; index < BUCKET_COUNT; ++index)
+    {
+        result.buckets[index] = buckets[index].load(std::memory_order_relaxed);
+    }
+    result.count = total.load(std::memory_order_relaxed);
+    result.maxMicros = maxValue.load(std::memory_order_relaxed);
+    return result;
+}
+
+LatencyHistogram::Snapshot LatencyHistogram::takeSnapshot()
+{
+    Snapshot result;
+    for (size_t index = 0; index < BUCKET_COUNT; ++index)
+    {
+        result.buckets[index] = buckets[index].exchange(0, std::memory_order_relaxed);
+    }
+    result.count = total.exchange(0, std::memory_order_relaxed);
+    result.maxMicros = maxValue.exchange(0, std::memory_order_relaxed);
+    return result;
+}
+
+uint32_t LatencyHistogram::Snapshot::percentileMicros(uint8_t percentile) const
+{
+    uint64_t sampleCount = 0;
+    for (const uint32_t bucket : buckets)
+    {
+        sampleCount += bucket;
+    }
+    if (sampleCount == 0)
+    {
+        return 0;
+    }
+
+    const uint64_t rank = (sampleCount * std::min<uint8_t>(percentile, 100) + 99) / 100;
+    uint64_t seen = 0;
+    for (size_t index = 0; index < BUCKET_COUNT; ++index)
+    {
+        seen += buckets[index];
+        if (seen >= rank && seen > 0)
+        {
+            return std::min(bucketUpperBoundMicros(index), maxMicros);
+        }
+    }
+    return maxMicros;
+}
+
+size_t LatencyHistogram::Snapshot::usedBucketCount() const
+{
+    size_t used = BUCKET_COUNT;
+    while (used > 0 && buckets[used - 1] == 0)
+    {
+        --used;
+    }
+    return used;
+}
+
+size_t LatencyHistogram::bucketIndexFor(uint32_t micros)
+{
+    if (micros == 0)
+    {
+        return 0;
+    }
+
+    const size_t index = static_cast<size_t>(32 - __builtin_clz(micros));
+    return std::min(index, BUCKET_COUNT - 1);
+}
+
+uint32_t LatencyHistogram::bucketUpperBoundMicros(size_t index)
+{
+    if (index >= BUCKET_COUNT - 1)
+    {
+        return std::numeric_limits<uint32_t>::max();
+    }
+    return 1UL << index;
+}
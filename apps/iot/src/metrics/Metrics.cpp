@@ -0,0 +1,84 @@
+#include "metrics/Metrics.h"
+
+namespace
+{
+// Constant-initialised, so it is valid before any dynamic initialiser runs
+// regardless of translation unit order.
+Metric *registryHead = nullptr;
+}
+
+Metric::Metric(const char *name, MetricKind kind)
+    : metricName(name), metricKind(kind), nextMetric(registryHead)
+{
+    registryHead = this;
+}
+
+const char *Metric::name() const
+{
+    return metricName;
+}
+
+MetricKind Metric::kind() const
+{
+    return metricKind;
+}
+
+Metric *Metric::next() const
+{
+    return nextMetric;
+}
+
+Metric *Metric::first()
+{
+    return registryHead;
+}
+
+MetricCounter::MetricCounter(const char *name)
+    : Metric(name, MetricKind::Counter)
+{
+}
+
+void MetricCounter::increment(uint32_t amount)
+{
+    total.fetch_add(amount, std::memory_order_relaxed);
+}
+
+uint32_t MetricCounter::value() const
+{
+    return total.load(std::memory_order_relaxed);
+}
+
+MetricGauge::MetricGauge(const char *name)
+    : Metric(name, MetricKind::Gauge)
+{
+}
+
+void MetricGauge::set(int32_t value)
+{
+    current.store(value, std::memory_order_relaxed);
+}
+
+int32_t MetricGauge::value() const
+{
+    return current.load(std::memory_order_relaxed);
+}
+
+MetricHistogram::MetricHistogram(const char *name)
+    : Metric(name, MetricKind::Histogram)
+{
+}
+
+void MetricHistogram::record(uint32_t micros)
+{
+    histogram.record(micros);
+}
+
+LatencyHistogram::Snapshot MetricHistogram::snapshot() const
+{
+    return histogram.snapshot();
+}
+
+LatencyHistogram::Snapshot MetricHistogram::takeSnapshot()
+{
+    return histogram.takeSnapshot();
+}
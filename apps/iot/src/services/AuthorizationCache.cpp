@@ -0,0 +1,368 @@
+#include "services/AuthorizationCache.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+
+#include "hal/Clock.h"
+#include "logging/DeferredLog.h"
+#include "metrics/Metrics.h"
+
+namespace
+{
+constexpr LogModule LOG_MODULE = LogModule::Auth;
+
+constexpr uint32_t SLOT_MAGIC = 0x43545541; // "AUTC"
+constexpr uint32_t COMMITTED_MARK = 0x0000C0DE;
+constexpr size_t SECTOR_SIZE = hal::FlashRegion::SECTOR_SIZE;
+// Entries staged on the stack per flash write.
+constexpr size_t WRITE_CHUNK = 16;
+
+MetricGauge cachedEntries("auth.entries");
+MetricHistogram lookupLatency("auth.lookup_us");
+
+// CRC-32 (IEEE), a nibble at a time so the table stays at 64 bytes. Chains:
+// pass the previous result back in as crc.
+uint32_t crc32(uint32_t crc, const uint8_t *bytes, size_t length)
+{
+    static constexpr std::array<uint32_t, 16> TABLE = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    crc = ~crc;
+    for (size_t index = 0; index < length; ++index)
+    {
+        crc = TABLE[(crc ^ bytes[index]) & 0x0F] ^ (crc >> 4);
+        crc = TABLE[(crc ^ (bytes[index] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+bool newerSequence(uint32_t candidate, uint32_t current)
+{
+    return static_cast<int32_t>(candidate - current) > 0;
+}
+}
+
+const char *AuthorizationCache::syncResultName(SyncResult result)
+{
+    switch (result)
+    {
+    case SyncResult::Ok:
+        return "ok";
+    case SyncResult::Unavailable:
+        return "unavailable";
+    case SyncResult::TooLarge:
+        return "too_large";
+    case SyncResult::OutOfOrder:
+        return "out_of_order";
+    case SyncResult::Unsorted:
+        return "unsorted";
+    case SyncResult::Incomplete:
+        return "incomplete";
+    case SyncResult::WriteFailed:
+        return "write_failed";
+    case SyncResult::Corrupt:
+        return "corrupt";
+    }
+    return "unknown";
+}
+
+std::optional<uint64_t> AuthorizationCache::cardKey(std::string_view cardUid)
+{
+    if (cardUid.empty())
+    {
+        return std::nullopt;
+    }
+
+    uint64_t value = 0;
+    for (const char character : cardUid)
+    {
+        if (character < '0' || character > '9')
+        {
+            return std::nullopt;
+        }
+        const uint64_t digit = static_cast<uint64_t>(character - '0');
+        if (value > (std::numeric_limits<uint64_t>::max() - digit) / 10)
+        {
+            return std::nullopt;
+        }
+        value = value * 10 + digit;
+    }
+    return value;
+}
+
+AuthorizationCache::AuthorizationCache(hal::FlashRegion &flash)
+    : flash(flash)
+{
+}
+
+bool AuthorizationCache::begin()
+{
+    if (!flash.begin())
+    {
+        LOGW("No authorization partition, offline unlocks are off\n");
+        return false;
+    }
+
+    slotSize = std::min(flash.size() / SLOT_COUNT / SECTOR_SIZE, MAX_SLOT_SECTORS) * SECTOR_SIZE;
+    if (slotSize == 0)
+    {
+        LOGW("Authorization partition is too small\n");
+        return false;
+    }
+
+    for (uint8_t slot = 0; slot < SLOT_COUNT; ++slot)
+    {
+        Snapshot snapshot;
+        if (readSnapshot(slot, snapshot) && (!active.has_value() || newerSequence(snapshot.sequence, active->sequence)))
+        {
+            active = snapshot;
+        }
+    }
+
+    cachedEntries.set(static_cast<int32_t>(entryCount()));
+    if (active.has_value())
+    {
+        LOGI("Authorization snapshot %lu with %lu cards\n",
+             static_cast<unsigned long>(active->generation),
+             static_cast<unsigned long>(active->count));
+    }
+    return true;
+}
+
+bool AuthorizationCache::hasSnapshot() const
+{
+    return active.has_value();
+}
+
+uint32_t AuthorizationCache::generation() const
+{
+    return active.has_value() ? active->generation : 0;
+}
+
+uint32_t AuthorizationCache::entryCount() const
+{
+    return active.has_value() ? active->count : 0;
+}
+
+uint32_t AuthorizationCache::capacity() const
+{
+    if (slotSize < HEADER_SIZE)
+    {
+        return 0;
+    }
+    return static_cast<uint32_t>((slotSize - HEADER_SIZE) / (sizeof(uint64_t) + sizeof(uint32_t)));
+}
+
+AuthorizationCache::Verdict AuthorizationCache::check(uint64_t cardKey, uint32_t nowEpochS) const
+{
+    if (!active.has_value())
+    {
+        return Verdict::NotCached;
+    }
+
+    const uint64_t startedUs = hal::uptimeUs();
+    const uint64_t *end = active->keys + active->count;
+    const uint64_t *found = std::lower_bound(active->keys, end, cardKey);
+    Verdict verdict = Verdict::NotCached;
+    if (found != end && *found == cardKey)
+    {
+        verdict = active->expiries[found - active->keys] > nowEpochS ? Verdict::Granted : Verdict::Expired;
+    }
+    lookupLatency.record(static_cast<uint32_t>(hal::uptimeUs() - startedUs));
+    return verdict;
+}
+
+AuthorizationCache::SyncResult AuthorizationCache::beginSync(uint32_t generation, uint32_t count)
+{
+    if (slotSize == 0)
+    {
+        return SyncResult::Unavailable;
+    }
+    if (count > capacity())
+    {
+        return SyncResult::TooLarge;
+    }
+
+    Sync next;
+    next.generation = generation;
+    next.count = count;
+    next.slot = active.has_value() ? static_cast<uint8_t>(1 - active->slot) : 0;
+    next.sequence = active.has_value() ? active->sequence + 1 : 1;
+    sync = next;
+
+    // The checksums and the commit mark stay erased until commitSync().
+    const uint32_t head[] = {SLOT_MAGIC, next.sequence, generation, count};
+    if (!writeSlot(0, head, sizeof(head)))
+    {
+        sync.reset();
+        return SyncResult::WriteFailed;
+    }
+    LOGI("Authorization sync %lu started, %lu cards\n",
+         static_cast<unsigned long>(generation),
+         static_cast<unsigned long>(count));
+    return SyncResult::Ok;
+}
+
+AuthorizationCache::SyncResult AuthorizationCache::appendEntries(uint32_t generation,
+                                                                 uint32_t offset,
+                                                                 const Entry *entries,
+                                                                 size_t count)
+{
+    if (!sync.has_value() || sync->generation != generation)
+    {
+        return SyncResult::Unavailable;
+    }
+    if (offset > sync->written)
+    {
+        return SyncResult::OutOfOrder;
+    }
+
+    const size_t alreadyWritten = sync->written - offset;
+    if (alreadyWritten >= count)
+    {
+        return SyncResult::Ok;
+    }
+    entries += alreadyWritten;
+    count -= alreadyWritten;
+    if (sync->written + count > sync->count)
+    {
+        return SyncResult::TooLarge;
+    }
+
+    std::array<uint64_t, WRITE_CHUNK> keys;
+    std::array<uint32_t, WRITE_CHUNK> expiries;
+    while (count > 0)
+    {
+        const size_t chunk = std::min(count, WRITE_CHUNK);
+        for (size_t index = 0; index < chunk; ++index)
+        {
+            if ((sync->written > 0 || index > 0) && entries[index].cardKey <= sync->lastKey)
+            {
+                LOGW("Authorization sync %lu abandoned, cards out of order\n", static_cast<unsigned long>(generation));
+                sync.reset();
+                return SyncResult::Unsorted;
+            }
+            keys[index] = entries[index].cardKey;
+            expiries[index] = entries[index].expiresAt;
+            sync->lastKey = entries[index].cardKey;
+        }
+
+        const size_t keysAt = HEADER_SIZE + static_cast<size_t>(sync->written) * sizeof(uint64_t);
+        const size_t expiriesAt = HEADER_SIZE + static_cast<size_t>(sync->count) * sizeof(uint64_t) +
+                                  static_cast<size_t>(sync->written) * sizeof(uint32_t);
+        if (!writeSlot(keysAt, keys.data(), chunk * sizeof(uint64_t)) ||
+            !writeSlot(expiriesAt, expiries.data(), chunk * sizeof(uint32_t)))
+        {
+            sync.reset();
+            return SyncResult::WriteFailed;
+        }
+        sync->keysCrc = crc32(sync->keysCrc, reinterpret_cast<const uint8_t *>(keys.data()), chunk * sizeof(uint64_t));
+        sync->expiriesCrc = crc32(sync->expiriesCrc, reinterpret_cast<const uint8_t *>(expiries.data()), chunk * sizeof(uint32_t));
+        sync->written += static_cast<uint32_t>(chunk);
+        entries += chunk;
+        count -= chunk;
+    }
+    return SyncResult::Ok;
+}
+
+AuthorizationCache::SyncResult AuthorizationCache::commitSync(uint32_t generation)
+{
+    if (!sync.has_value() || sync->generation != generation)
+    {
+        return SyncResult::Unavailable;
+    }
+    if (sync->written != sync->count)
+    {
+        return SyncResult::Incomplete;
+    }
+
+    const uint32_t tail[] = {sync->keysCrc, sync->expiriesCrc, COMMITTED_MARK};
+    const uint8_t slot = sync->slot;
+    const bool written = writeSlot(offsetof(SlotHeader, keysCrc), tail, sizeof(tail));
+    sync.reset();
+    if (!written)
+    {
+        return SyncResult::WriteFailed;
+    }
+
+    // Read back through the mapping, checksums and all, as begin() would.
+    Snapshot snapshot;
+    if (!readSnapshot(slot, snapshot))
+    {
+        LOGE("Authorization snapshot %lu did not read back\n", static_cast<unsigned long>(generation));
+        return SyncResult::Corrupt;
+    }
+
+    active = snapshot;
+    cachedEntries.set(static_cast<int32_t>(snapshot.count));
+    LOGN("Authorization snapshot %lu active, %lu cards\n",
+         static_cast<unsigned long>(generation),
+         static_cast<unsigned long>(snapshot.count));
+    return SyncResult::Ok;
+}
+
+uint32_t AuthorizationCache::syncedCount() const
+{
+    return sync.has_value() ? sync->written : 0;
+}
+
+size_t AuthorizationCache::slotOffset(uint8_t slot) const
+{
+    return static_cast<size_t>(slot) * slotSize;
+}
+
+bool AuthorizationCache::readSnapshot(uint8_t slot, Snapshot &snapshot) const
+{
+    const uint8_t *base = flash.data() + slotOffset(slot);
+    SlotHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    if (header.magic != SLOT_MAGIC || header.committed != COMMITTED_MARK || header.count > capacity())
+    {
+        return false;
+    }
+
+    const uint8_t *keys = base + HEADER_SIZE;
+    const uint8_t *expiries = keys + static_cast<size_t>(header.count) * sizeof(uint64_t);
+    if (crc32(0, keys, static_cast<size_t>(header.count) * sizeof(uint64_t)) != header.keysCrc ||
+        crc32(0, expiries, static_cast<size_t>(header.count) * sizeof(uint32_t)) != header.expiriesCrc)
+    {
+        LOGW("Authorization slot %u fails its checksum\n", static_cast<unsigned>(slot));
+        return false;
+    }
+
+    // Slots are sector aligned and the header keeps the keys 8-byte aligned.
+    snapshot.keys = reinterpret_cast<const uint64_t *>(keys);
+    snapshot.expiries = reinterpret_cast<const uint32_t *>(expiries);
+    snapshot.count = header.count;
+    snapshot.generation = header.generation;
+    snapshot.sequence = header.sequence;
+    snapshot.slot = slot;
+    return true;
+}
+
+bool AuthorizationCache::writeSlot(size_t offset, const void *bytes, size_t length)
+{
+    if (length == 0)
+    {
+        return true;
+    }
+
+    const size_t base = slotOffset(sync->slot);
+    for (size_t sector = offset / SECTOR_SIZE; sector <= (offset + length - 1) / SECTOR_SIZE; ++sector)
+    {
+        const uint64_t bit = 1ULL << sector;
+        if ((sync->erasedSectors & bit) == 0)
+        {
+            if (!flash.eraseSector(base + sector * SECTOR_SIZE))
+            {
+                return false;
+            }
+            sync->erasedSectors |= bit;
+        }
+    }
+    return flash.write(base + offset, bytes, length);
+}
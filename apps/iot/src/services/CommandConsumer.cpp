@@ -1,166 +1,562 @@
 #include "services/CommandConsumer.h"
 
 #include <ArduinoJson.h>
-#include <ArduinoLog.h>
+#include <cstdio>
 
-#include "MQTTManager.h"
-#include "services/FeedbackController.h"
+#include "hal/Clock.h"
+#include "logging/DeferredLog.h"
+#include "metrics/Metrics.h"
+#include "services/DiagnosticsReporter.h"
+#include "services/OutboundMessages.h"
 
 namespace
 {
-std::optional<std::string> readOptionalStringField(const JsonDocument &doc, const char *key)
+constexpr LogModule LOG_MODULE = LogModule::Command;
+
+// Commands carry a "trace" object next to their own fields, and an
+// auth_batch a full payload's worth of entries.
+constexpr size_t COMMAND_DOC_CAPACITY = 768;
+
+// Hex digits per auth_batch entry: the card key, then the expiry.
+constexpr size_t AUTH_KEY_DIGITS = 16;
+constexpr size_t AUTH_ENTRY_DIGITS = AUTH_KEY_DIGITS + 8;
+
+// From the MQTT callback on the network task to pickup on the device task.
+MetricHistogram commandHandoffLatency("command.handoff_us");
+MetricCounter offlineGrants("auth.offline_grants");
+MetricCounter offlineDenials("auth.offline_denials");
+MetricCounter offlineDecisionsDropped("auth.decisions_dropped");
+
+// Copies a string field; false if it is present but does not fit.
+template <size_t MaxLength>
+bool readStringField(const JsonDocument &doc, const char *key, FixedString<MaxLength> &field)
+{
+    const char *text = doc[key] | "";
+    return field.assign(text);
+}
+
+bool parseHex(std::string_view digits, uint64_t &value)
+{
+    value = 0;
+    for (const char digit : digits)
+    {
+        uint8_t nibble = 0;
+        if (digit >= '0' && digit <= '9')
+        {
+            nibble = static_cast<uint8_t>(digit - '0');
+        }
+        else if (digit >= 'a' && digit <= 'f')
+        {
+            nibble = static_cast<uint8_t>(digit - 'a' + 10);
+        }
+        else if (digit >= 'A' && digit <= 'F')
+        {
+            nibble = static_cast<uint8_t>(digit - 'A' + 10);
+        }
+        else
+        {
+            return false;
+        }
+        value = (value << 4) | nibble;
+    }
+    return true;
+}
+
+// False unless text is whole entries and at most CommandConsumer's batch.
+bool parseAuthEntries(std::string_view text, AuthorizationCache::Entry *entries, size_t &count)
 {
-    JsonVariantConst value = doc[key];
-    if (value.isUnbound() || value.isNull())
+    if (text.size() % AUTH_ENTRY_DIGITS != 0 ||
+        text.size() / AUTH_ENTRY_DIGITS > CommandConsumer::MAX_AUTH_BATCH_ENTRIES)
     {
-        return std::nullopt;
+        return false;
     }
 
-    const char *text = value.as<const char *>();
-    if (text == nullptr || text[0] == '\0')
+    count = text.size() / AUTH_ENTRY_DIGITS;
+    for (size_t index = 0; index < count; ++index)
     {
-        return std::nullopt;
+        const std::string_view record = text.substr(index * AUTH_ENTRY_DIGITS, AUTH_ENTRY_DIGITS);
+        uint64_t expiresAt = 0;
+        if (!parseHex(record.substr(0, AUTH_KEY_DIGITS), entries[index].cardKey) ||
+            !parseHex(record.substr(AUTH_KEY_DIGITS), expiresAt))
+        {
+            return false;
+        }
+        entries[index].expiresAt = static_cast<uint32_t>(expiresAt);
     }
+    return true;
+}
+}
 
-    return std::string(text);
+CommandConsumer::CommandConsumer(const DeviceContext &deviceContext,
+                                 const WallClock &wallClock,
+                                 InboundCommandRing &inboundCommands,
+                                 AppEventBus &events)
+    : deviceContext(deviceContext), wallClock(wallClock), inboundCommands(inboundCommands), events(events)
+{
 }
+
+void CommandConsumer::subscribe(AppEventBus &events)
+{
+    events.subscribe<TapDetected, &CommandConsumer::onTapDetected>(*this);
+    events.subscribe<LockActuated, &CommandConsumer::onLockActuated>(*this);
 }
 
-CommandConsumer *CommandConsumer::activeInstance = nullptr;
+void CommandConsumer::setDiagnosticsReporter(DiagnosticsReporter &reporter)
+{
+    diagnosticsReporter = &reporter;
+}
 
-CommandConsumer::CommandConsumer(const DeviceContext &deviceContext)
-    : deviceContext(deviceContext)
+void CommandConsumer::setAuthorizationCache(AuthorizationCache &cache)
 {
+    authorizationCache = &cache;
 }
 
-void CommandConsumer::attach(MQTTManager &mqttManager)
+void CommandConsumer::setLockActuator(LockActuator &actuator)
 {
-    activeInstance = this;
-    mqttManager.setCallback(mqttCallback);
+    lockActuator = &actuator;
 }
 
-bool CommandConsumer::processPending(MQTTManager &mqttManager, FeedbackController &feedbackController)
+bool CommandConsumer::processPending(OutboundQueue &outboundQueue)
 {
-    if (!hasPendingMessage)
+    if (!outboundQueue.canAccept(OutboundPriority::Interactive))
     {
         return false;
     }
+    // The unlock ack carries the trace of the command in progress, so the
+    // next command is not started until it is out.
+    if (pendingUnlock.has_value())
+    {
+        if (!unlockResult.has_value())
+        {
+            return reportOfflineDecision(outboundQueue);
+        }
+        finishUnlock(outboundQueue);
+        return true;
+    }
+
+    const InboundCommand *inbound = inboundCommands.front();
+    if (inbound == nullptr)
+    {
+        return reportOfflineDecision(outboundQueue);
+    }
 
+    commandHandoffLatency.record(static_cast<uint32_t>(hal::uptimeUs() - inbound->receivedAtUs));
+    commandTrace.clear();
+    commandTrace.markAt(TraceStage::CommandReceived, inbound->receivedAtUs);
+    echoedTrace.clear();
     DeviceCommand command;
-    if (!parsePendingCommand(command))
+    StaticJsonDocument<COMMAND_DOC_CAPACITY> doc;
+    const bool parsed = parseCommand(*inbound, command, doc);
+    // Everything the command needs has been copied out of the slot.
+    inboundCommands.pop();
+
+    if (!parsed)
     {
-        const DeviceCommand invalidCommand{"invalid", "", std::nullopt, 0};
-        publishAck(mqttManager, invalidCommand, "rejected", "invalid_payload");
-        feedbackController.signalCommandFailed();
-        hasPendingMessage = false;
-        pendingPayload.clear();
+        DeviceCommand invalidCommand;
+        invalidCommand.action.assign("invalid");
+        announce(CommandOutcome::Rejected);
+        publishAck(outboundQueue, invalidCommand, "rejected", "invalid_payload");
         return true;
     }
 
-    hasPendingMessage = false;
-    pendingPayload.clear();
-
+    // Feedback stamps mark when the LED state was decided; FeedbackController
+    // takes the event in this pass's dispatch and App::applyFeedback drives
+    // the pins right after.
     if (command.action == "unlock")
     {
-        feedbackController.signalUnlockGranted();
-        publishAck(mqttManager, command, "done", "unlock_simulated");
-        Log.notice("Executed unlock command %s\n", command.requestId.c_str());
+        executeUnlock(outboundQueue, command);
         return true;
     }
 
     if (command.action == "deny")
     {
-        feedbackController.signalAccessDenied();
-        publishAck(mqttManager,
+        announce(CommandOutcome::Denied);
+        publishAck(outboundQueue,
                    command,
                    "done",
-                   command.reason.has_value() ? std::optional<std::string_view>(*command.reason) : std::optional<std::string_view>("denied"));
-        Log.notice("Executed deny command %s\n", command.requestId.c_str());
+                   command.reason.empty() ? std::string_view("denied") : command.reason.view());
+        LOGN("Executed deny command %s\n", command.requestId.c_str());
         return true;
     }
 
     if (command.action == "ping")
     {
-        publishAck(mqttManager, command, "done", "pong");
-        Log.notice("Executed ping command %s\n", command.requestId.c_str());
+        announce(CommandOutcome::Handled);
+        publishAck(outboundQueue, command, "done", "pong");
+        LOGN("Executed ping command %s\n", command.requestId.c_str());
+        return true;
+    }
+
+    if (command.action == "diagnostics")
+    {
+        announce(CommandOutcome::Handled);
+        if (diagnosticsReporter == nullptr || !diagnosticsReporter->publishDiagnostics(outboundQueue))
+        {
+            publishAck(outboundQueue, command, "failed", "diagnostics_unavailable");
+            LOGW("Diagnostics command %s could not be served\n", command.requestId.c_str());
+            return true;
+        }
+
+        publishAck(outboundQueue, command, "done", "diagnostics_published");
+        LOGN("Executed diagnostics command %s\n", command.requestId.c_str());
+        return true;
+    }
+
+    if (command.action == "auth_begin" || command.action == "auth_batch" || command.action == "auth_commit")
+    {
+        announce(CommandOutcome::Handled);
+        handleAuthCommand(outboundQueue, command, doc);
         return true;
     }
 
-    publishAck(mqttManager, command, "rejected", "unknown_action");
-    feedbackController.signalCommandFailed();
-    Log.warning("Unknown device action: %s\n", command.action.c_str());
+    announce(CommandOutcome::Rejected);
+    publishAck(outboundQueue, command, "rejected", "unknown_action");
+    LOGW("Unknown device action: %s\n", command.action.c_str());
     return true;
 }
 
-void CommandConsumer::mqttCallback(char *topic, byte *payload, unsigned int length)
+bool CommandConsumer::hasPending() const
+{
+    if (pendingUnlock.has_value())
+    {
+        return unlockResult.has_value() || decisionCount > 0;
+    }
+    return !inboundCommands.empty() || decisionCount > 0;
+}
+
+void CommandConsumer::executeUnlock(OutboundQueue &outboundQueue, const DeviceCommand &command)
+{
+    if (lockActuator == nullptr)
+    {
+        announce(CommandOutcome::Granted);
+        publishAck(outboundQueue, command, "done", "unlock_simulated");
+        LOGN("Executed unlock command %s\n", command.requestId.c_str());
+        return;
+    }
+
+    // Only an offline grant can be holding the lock here.
+    if (!lockActuator->unlock(command.durationMs))
+    {
+        announce(CommandOutcome::Rejected);
+        publishAck(outboundQueue, command, "failed", lockActuator->busy() ? "lock_busy" : "lock_unavailable");
+        LOGW("Unlock command %s could not drive the lock\n", command.requestId.c_str());
+        return;
+    }
+
+    announce(CommandOutcome::Granted);
+    pendingUnlock = command;
+    pendingPulse = lockActuator->lastPulse();
+    unlockResult.reset();
+}
+
+void CommandConsumer::finishUnlock(OutboundQueue &outboundQueue)
+{
+    const LockActuation &actuation = *unlockResult;
+    const bool opened = actuation.outcome == LockOutcome::Released || actuation.outcome == LockOutcome::Pulsed;
+    publishAck(outboundQueue,
+               *pendingUnlock,
+               opened ? "done" : "failed",
+               lockOutcomeName(actuation.outcome),
+               opened ? std::optional<uint32_t>(actuation.actuationMs) : std::nullopt);
+    if (opened)
+    {
+        LOGN("Executed unlock command %s, lock %s after %lu ms\n",
+             pendingUnlock->requestId.c_str(),
+             lockOutcomeName(actuation.outcome),
+             static_cast<unsigned long>(actuation.actuationMs));
+    }
+    else
+    {
+        LOGW("Unlock command %s failed, lock %s\n", pendingUnlock->requestId.c_str(), lockOutcomeName(actuation.outcome));
+    }
+    pendingUnlock.reset();
+    unlockResult.reset();
+}
+
+void CommandConsumer::onLockActuated(const LockActuated &event)
+{
+    // Pulses for offline grants have no ack to fill in.
+    if (pendingUnlock.has_value() && event.actuation.pulse == pendingPulse)
+    {
+        unlockResult = event.actuation;
+    }
+}
+
+bool CommandConsumer::authorizesOffline() const
 {
-    if (activeInstance != nullptr)
+    return authorizationCache != nullptr && authorizationCache->hasSnapshot();
+}
+
+void CommandConsumer::handleAuthCommand(OutboundQueue &outboundQueue, const DeviceCommand &command, const JsonDocument &doc)
+{
+    if (authorizationCache == nullptr)
+    {
+        publishAck(outboundQueue, command, "rejected", "no_auth_cache");
+        return;
+    }
+
+    const uint32_t generation = doc["generation"] | 0u;
+    AuthorizationCache::SyncResult result = AuthorizationCache::SyncResult::Ok;
+    if (command.action == "auth_begin")
+    {
+        result = authorizationCache->beginSync(generation, doc["count"] | 0u);
+    }
+    else if (command.action == "auth_batch")
+    {
+        std::array<AuthorizationCache::Entry, MAX_AUTH_BATCH_ENTRIES> entries;
+        size_t count = 0;
+        if (!parseAuthEntries(doc["entries"] | "", entries.data(), count))
+        {
+            publishAck(outboundQueue, command, "rejected", "invalid_entries");
+            return;
+        }
+        result = authorizationCache->appendEntries(generation, doc["offset"] | 0u, entries.data(), count);
+    }
+    else
+    {
+        result = authorizationCache->commitSync(generation);
+    }
+
+    if (result != AuthorizationCache::SyncResult::Ok)
     {
-        activeInstance->onMessage(topic, payload, length);
+        publishAck(outboundQueue, command, "rejected", AuthorizationCache::syncResultName(result));
+        LOGW("%s for snapshot %lu rejected: %s\n",
+             command.action.c_str(),
+             static_cast<unsigned long>(generation),
+             AuthorizationCache::syncResultName(result));
+        return;
     }
+
+    // The backend resumes from the count after a lost ack.
+    char detail[24];
+    if (command.action == "auth_commit")
+    {
+        std::snprintf(detail, sizeof(detail), "active:%lu", static_cast<unsigned long>(authorizationCache->entryCount()));
+    }
+    else
+    {
+        std::snprintf(detail, sizeof(detail), "written:%lu", static_cast<unsigned long>(authorizationCache->syncedCount()));
+    }
+    publishAck(outboundQueue, command, "done", detail);
 }
 
-void CommandConsumer::onMessage(char *topic, byte *payload, unsigned int length)
+void CommandConsumer::onTapDetected(const TapDetected &event)
 {
-    if (topic == nullptr || deviceContext.topics.commandTopic != topic)
+    // Queued taps are for the backend to decide.
+    if (event.queued || authorizationCache == nullptr)
     {
         return;
     }
 
-    pendingPayload.assign(reinterpret_cast<const char *>(payload), length);
-    hasPendingMessage = true;
+    OfflineDecision decision;
+    decision.cardKey = event.cardKey;
+    decision.decidedAtUs = hal::uptimeUs();
+    decision.cacheGeneration = authorizationCache->generation();
+    decision.bay = event.bay;
+
+    // Expiries mean nothing without wall-clock time, so a device that has
+    // not synced since boot refuses everyone.
+    const WallTime time = wallClock.now();
+    if (time.quality == TimeSyncQuality::None)
+    {
+        decision.denialReason = "no_time";
+    }
+    // Either card could be the rider's, and the other one's rental would
+    // be the one unlocked.
+    else if (event.ambiguous)
+    {
+        decision.denialReason = "ambiguous";
+    }
+    else if (event.cardKey == 0)
+    {
+        decision.denialReason = "not_cached";
+    }
+    else
+    {
+        switch (authorizationCache->check(event.cardKey, static_cast<uint32_t>(time.epochMs / 1000)))
+        {
+        case AuthorizationCache::Verdict::Granted:
+            break;
+        case AuthorizationCache::Verdict::Expired:
+            decision.denialReason = "expired";
+            break;
+        case AuthorizationCache::Verdict::NotCached:
+            decision.denialReason = "not_cached";
+            break;
+        }
+    }
+
+    // The same rider feedback and unlock as a command from the backend.
+    if (decision.denialReason == nullptr)
+    {
+        if (lockActuator != nullptr && !lockActuator->unlock(0))
+        {
+            LOGW("Lock busy, offline unlock on bay %u not driven\n", static_cast<unsigned>(event.bay));
+        }
+        events.publish(CommandReceived{CommandOutcome::Granted});
+        offlineGrants.increment();
+        LOGN("Offline unlock granted on bay %u\n", static_cast<unsigned>(event.bay));
+    }
+    else
+    {
+        events.publish(CommandReceived{CommandOutcome::Denied});
+        offlineDenials.increment();
+        LOGN("Offline unlock denied on bay %u: %s\n", static_cast<unsigned>(event.bay), decision.denialReason);
+    }
+
+    if (decisionCount == offlineDecisions.size())
+    {
+        firstDecision = (firstDecision + 1) % offlineDecisions.size();
+        --decisionCount;
+        offlineDecisionsDropped.increment();
+    }
+    offlineDecisions[(firstDecision + decisionCount) % offlineDecisions.size()] = decision;
+    ++decisionCount;
+}
+
+bool CommandConsumer::reportOfflineDecision(OutboundQueue &outboundQueue)
+{
+    if (decisionCount == 0)
+    {
+        return false;
+    }
+
+    OutboundQueue::Message *slot = outboundQueue.acquire(OutboundPriority::Interactive);
+    if (slot == nullptr)
+    {
+        return false;
+    }
+
+    const OfflineDecision &decision = offlineDecisions[firstDecision];
+    char cardUid[21];
+    OfflineDecisionMessage message;
+    message.deviceId = deviceContext.deviceId.c_str();
+    message.event = "offline_decision";
+    if (decision.cardKey != 0)
+    {
+        std::snprintf(cardUid, sizeof(cardUid), "%llu", static_cast<unsigned long long>(decision.cardKey));
+        message.cardUid = cardUid;
+    }
+    message.bay = decision.bay;
+    message.decision = decision.denialReason == nullptr ? "granted" : "denied";
+    if (decision.denialReason != nullptr)
+    {
+        message.reason = decision.denialReason;
+    }
+    message.cacheGeneration = decision.cacheGeneration;
+    message.timestampMs = decision.decidedAtUs / 1000;
+    // The clock may have synced since, which places the decision after all.
+    const WallTime decidedAt = wallClock.at(decision.decidedAtUs);
+    message.epochMs = decidedAt.quality != TimeSyncQuality::None ? std::optional<uint64_t>(decidedAt.epochMs) : std::nullopt;
+    message.timeSync = timeSyncQualityName(decidedAt.quality);
+    message.boot = wallClock.bootCount();
+
+    const size_t payloadLength = serializeOfflineDecision(message, slot->payload, sizeof(slot->payload));
+    if (payloadLength == 0)
+    {
+        LOGE("Failed to serialize offline decision\n");
+        outboundQueue.release(*slot);
+        return false;
+    }
+
+    outboundQueue.submit(*slot, deviceContext.topics.cardEventTopic.c_str(), payloadLength, false);
+    firstDecision = (firstDecision + 1) % offlineDecisions.size();
+    --decisionCount;
+    return true;
+}
+
+void CommandConsumer::announce(CommandOutcome outcome)
+{
+    events.publish(CommandReceived{outcome});
+    if (outcome != CommandOutcome::Handled)
+    {
+        commandTrace.mark(TraceStage::FeedbackApplied);
+    }
 }
 
-bool CommandConsumer::parsePendingCommand(DeviceCommand &command)
+bool CommandConsumer::parseCommand(const InboundCommand &inbound, DeviceCommand &command, JsonDocument &doc)
 {
-    if (pendingPayload.empty())
+    if (inbound.payload.empty())
     {
         return false;
     }
 
-    StaticJsonDocument<192> doc;
-    const DeserializationError error = deserializeJson(doc, pendingPayload.c_str());
+    const DeserializationError error = deserializeJson(doc, inbound.payload.c_str());
+    commandTrace.mark(TraceStage::CommandParsed);
     if (error)
     {
-        command.action = pendingPayload;
-        command.requestId = "";
-        command.reason = std::nullopt;
+        // Bare "unlock" style payloads name the action directly.
+        command.action.assign(inbound.payload.view());
+        command.requestId.clear();
+        command.reason.clear();
         command.durationMs = 0;
         return !command.action.empty();
     }
 
-    const char *action = doc["action"] | "";
-    command.action = action;
-    command.requestId = doc["requestId"] | "";
-    command.reason = readOptionalStringField(doc, "reason");
+    if (!readStringField(doc, "action", command.action) || !readStringField(doc, "requestId", command.requestId))
+    {
+        return false;
+    }
+    // A reason that does not fit falls back to the default one.
+    readStringField(doc, "reason", command.reason);
     command.durationMs = doc["durationMs"] | 0;
+
+    JsonVariantConst trace = doc["trace"];
+    if (trace.is<JsonObjectConst>())
+    {
+        echoedTrace.set(trace);
+    }
     return !command.action.empty();
 }
 
-void CommandConsumer::publishAck(MQTTManager &mqttManager,
+void CommandConsumer::publishAck(OutboundQueue &outboundQueue,
                                  const DeviceCommand &command,
                                  const char *status,
-                                 std::optional<std::string_view> detail)
-{
-    StaticJsonDocument<192> doc;
-    std::optional<std::string> ownedDetail;
-    doc["deviceId"] = deviceContext.deviceId.c_str();
-    doc["requestId"] = command.requestId.c_str();
-    doc["action"] = command.action.c_str();
-    doc["status"] = status;
+                                 std::optional<std::string_view> detail,
+                                 std::optional<uint32_t> actuationMs)
+{
+    CommandAckMessage message;
+    FixedString<DeviceCommand::MAX_REASON_LENGTH> detailText;
+    message.deviceId = deviceContext.deviceId.c_str();
+    message.requestId = command.requestId.c_str();
+    message.action = command.action.c_str();
+    message.status = status;
+    wallClock.stamp(message);
     if (detail.has_value())
     {
-        ownedDetail.emplace(detail->data(), detail->size());
-        doc["detail"] = ownedDetail->c_str();
+        detailText.assign(*detail);
+        message.detail = detailText.c_str();
+    }
+    message.actuationMs = actuationMs;
+
+    commandTrace.mark(TraceStage::AckSent);
+    // A stage the sender already echoed keeps its place in the object and
+    // takes our stamp, as it did when the echo was merged into a document.
+    for (size_t index = 0; index < RequestTrace::STAGE_COUNT; ++index)
+    {
+        const TraceStage stage = static_cast<TraceStage>(index);
+        if (commandTrace.has(stage) && echoedTrace.containsKey(traceStageKey(stage)))
+        {
+            echoedTrace[traceStageKey(stage)] = commandTrace.at(stage);
+        }
+    }
+    message.trace.stages = &commandTrace;
+    message.trace.echoed = &echoedTrace;
+
+    OutboundQueue::Message *slot = outboundQueue.acquire(OutboundPriority::Interactive);
+    if (slot == nullptr)
+    {
+        LOGE("No outbound slot for command ack\n");
+        return;
     }
 
-    char payload[192];
-    const size_t payloadLength = serializeJson(doc, payload, sizeof(payload));
-    if (payloadLength == 0 || payloadLength >= sizeof(payload))
+    const size_t payloadLength = serializeCommandAck(message, slot->payload, sizeof(slot->payload));
+    if (payloadLength == 0)
     {
-        Log.error("Failed to serialize command ack\n");
+        LOGE("Failed to serialize command ack\n");
+        outboundQueue.release(*slot);
         return;
     }
 
-    mqttManager.publish(deviceContext.topics.ackTopic, payload, false);
+    outboundQueue.submit(*slot, deviceContext.topics.ackTopic.c_str(), payloadLength, false);
 }
@@ -1,29 +1,57 @@
 #include "services/ConnectivityService.h"
 
-#include <ArduinoLog.h>
-#include <WiFi.h>
+#include "hal/Clock.h"
+#include "logging/DeferredLog.h"
+#include "metrics/Metrics.h"
 
 namespace
 {
+constexpr LogModule LOG_MODULE = LogModule::Connectivity;
+
 constexpr unsigned long WIFI_RETRY_INTERVAL_MS = 5000;
 constexpr unsigned long MQTT_RETRY_INTERVAL_MS = 3000;
+// Keepalive housekeeping only; inbound data wakes the loop through the socket.
+constexpr unsigned long MQTT_IDLE_SERVICE_INTERVAL_MS = 1000;
+
+MetricCounter wifiDisconnects("wifi.disconnects");
+MetricCounter wifiReconnectAttempts("wifi.reconnect_attempts");
+MetricGauge wifiRssi("wifi.rssi");
+MetricCounter mqttSessionDrops("mqtt.session_drops");
+
+constexpr char CLIENT_ID_PREFIX[] = "iot-device-";
+static_assert(sizeof(CLIENT_ID_PREFIX) - 1 + MAX_DEVICE_ID_LENGTH <= MQTTManager::MAX_CLIENT_ID_LENGTH,
+              "client id must fit the longest device id");
+
+FixedString<MQTTManager::MAX_CLIENT_ID_LENGTH> makeClientId(std::string_view deviceId)
+{
+    FixedString<MQTTManager::MAX_CLIENT_ID_LENGTH> clientId;
+    clientId.assign(CLIENT_ID_PREFIX);
+    clientId.append(deviceId);
+    return clientId;
+}
 }
 
-ConnectivityService::ConnectivityService(const AppConfig &config, const DeviceContext &deviceContext)
-    : config(config),
-      deviceContext(deviceContext),
-      mqttManager(wifiClient,
-                  std::string("iot-device-") + deviceContext.deviceId,
+ConnectivityService::ConnectivityService(const AppConfig &config,
+                                         const DeviceContext &deviceContext,
+                                         hal::WifiLink &wifi,
+                                         hal::MqttTransport &transport)
+    : deviceContext(deviceContext),
+      wifi(wifi),
+      transport(transport),
+      mqttManager(transport,
+                  makeClientId(deviceContext.deviceId),
                   config.mqttBrokerIP,
                   config.mqttPort,
                   config.mqttUsername,
                   config.mqttPassword)
 {
+    wifiSsid.assign(config.wifiSsid);
+    wifiPassword.assign(config.wifiPass);
 }
 
 void ConnectivityService::begin()
 {
-    WiFi.mode(WIFI_STA);
+    wifi.startStation();
     lastWifiAttemptAt = 0;
     lastMqttAttemptAt = 0;
     wifiStarted = false;
@@ -36,25 +64,39 @@ void ConnectivityService::loop()
 
     if (!isWifiConnected())
     {
+        if (wifiLinkUp)
+        {
+            wifiDisconnects.increment();
+        }
+        wifiLinkUp = false;
+        mqttSessionUp = false;
         commandTopicSubscribed = false;
         return;
     }
+    wifiLinkUp = true;
+    wifiRssi.set(wifi.rssi());
 
     ensureMqttConnected();
 
     if (mqttManager.isConnected())
     {
+        mqttSessionUp = true;
         mqttManager.loop();
     }
     else
     {
+        if (mqttSessionUp)
+        {
+            mqttSessionDrops.increment();
+        }
+        mqttSessionUp = false;
         commandTopicSubscribed = false;
     }
 }
 
 bool ConnectivityService::isWifiConnected() const
 {
-    return WiFi.status() == WL_CONNECTED;
+    return wifi.isConnected();
 }
 
 bool ConnectivityService::isReady()
@@ -62,9 +104,36 @@ bool ConnectivityService::isReady()
     return isWifiConnected() && mqttManager.isConnected();
 }
 
-void ConnectivityService::setCommandTopic(const std::string &topic)
+uint64_t ConnectivityService::nextServiceAt(uint64_t now)
+{
+    if (!isWifiConnected())
+    {
+        return wifiStarted ? lastWifiAttemptAt + WIFI_RETRY_INTERVAL_MS : now;
+    }
+
+    if (!mqttManager.isConnected())
+    {
+        return lastMqttAttemptAt + MQTT_RETRY_INTERVAL_MS;
+    }
+
+    // PubSubClient handles one packet per loop() call, so anything already
+    // buffered by the client will not show up as socket readability.
+    if (transport.bytesBuffered() > 0 || (!commandTopicSubscribed && !commandTopic.empty()))
+    {
+        return now;
+    }
+
+    return now + MQTT_IDLE_SERVICE_INTERVAL_MS;
+}
+
+int ConnectivityService::socketFd() const
+{
+    return transport.socketFd();
+}
+
+void ConnectivityService::setCommandTopic(std::string_view topic)
 {
-    commandTopic = topic;
+    commandTopic.assign(topic);
 }
 
 MQTTManager &ConnectivityService::mqtt()
@@ -74,7 +143,7 @@ MQTTManager &ConnectivityService::mqtt()
 
 void ConnectivityService::ensureWifiConnected()
 {
-    const unsigned long now = millis();
+    const uint64_t now = hal::uptimeMs();
     if (isWifiConnected())
     {
         return;
@@ -88,14 +157,15 @@ void ConnectivityService::ensureWifiConnected()
     lastWifiAttemptAt = now;
     if (!wifiStarted)
     {
-        Log.notice("Connecting WiFi SSID %s\n", config.wifiSsid.c_str());
-        WiFi.begin(config.wifiSsid.c_str(), config.wifiPass.c_str());
+        LOGN("Connecting WiFi SSID %s\n", wifiSsid.c_str());
+        wifi.begin(wifiSsid.c_str(), wifiPassword.c_str());
         wifiStarted = true;
     }
     else
     {
-        Log.warning("WiFi disconnected, retrying connection\n");
-        WiFi.reconnect();
+        LOGW("WiFi disconnected, retrying connection\n");
+        wifiReconnectAttempts.increment();
+        wifi.reconnect();
     }
 }
 
@@ -103,14 +173,14 @@ void ConnectivityService::ensureMqttConnected()
 {
     if (mqttManager.isConnected())
     {
-        if (!commandTopicSubscribed && commandTopic.has_value())
+        if (!commandTopicSubscribed && !commandTopic.empty())
         {
-            commandTopicSubscribed = mqttManager.subscribe(*commandTopic);
+            commandTopicSubscribed = mqttManager.subscribe(commandTopic.c_str());
         }
         return;
     }
 
-    const unsigned long now = millis();
+    const uint64_t now = hal::uptimeMs();
     if (now - lastMqttAttemptAt < MQTT_RETRY_INTERVAL_MS)
     {
         return;
@@ -123,9 +193,9 @@ void ConnectivityService::ensureMqttConnected()
     }
 
     commandTopicSubscribed = false;
-    if (commandTopic.has_value())
+    if (!commandTopic.empty())
     {
-        commandTopicSubscribed = mqttManager.subscribe(*commandTopic);
+        commandTopicSubscribed = mqttManager.subscribe(commandTopic.c_str());
     }
-    Log.notice("Device MQTT session ready on %s\n", deviceContext.topics.commandTopic.c_str());
+    LOGN("Device MQTT session ready on %s\n", deviceContext.topics.commandTopic.c_str());
 }
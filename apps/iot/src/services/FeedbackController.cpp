@@ -1,32 +1,23 @@
 #include "services/FeedbackController.h"
 
-void FeedbackController::signalTapPublished()
-{
-    setOverride(OverrideMode::TapPublished, 900);
-}
-
-void FeedbackController::signalUnlockGranted()
-{
-    setOverride(OverrideMode::UnlockGranted, 1600);
-}
-
-void FeedbackController::signalAccessDenied()
-{
-    setOverride(OverrideMode::AccessDenied, 1400);
-}
+#include "app/Scheduler.h"
+#include "hal/Clock.h"
 
-void FeedbackController::signalCommandFailed()
+void FeedbackController::subscribe(AppEventBus &events)
 {
-    setOverride(OverrideMode::CommandFailed, 1600);
+    events.subscribe<TapDetected, &FeedbackController::onTapDetected>(*this);
+    events.subscribe<CommandReceived, &FeedbackController::onCommandReceived>(*this);
+    events.subscribe<LockActuated, &FeedbackController::onLockActuated>(*this);
 }
 
 void FeedbackController::update(LedController &ledController, RuntimeState baseState)
 {
-    const unsigned long now = millis();
+    const uint64_t now = hal::uptimeMs();
+    overridePending = false;
 
     if (overrideMode != OverrideMode::None)
     {
-        if (now >= overrideUntil)
+        if (deadlineReached(now, overrideUntil))
         {
             overrideMode = OverrideMode::None;
         }
@@ -81,8 +72,56 @@ void FeedbackController::update(LedController &ledController, RuntimeState baseS
     ledController.update();
 }
 
+uint64_t FeedbackController::nextUpdateAt(const LedController &ledController, uint64_t now) const
+{
+    if (overridePending)
+    {
+        return now;
+    }
+
+    const uint64_t ledDeadline = ledController.nextUpdateAt(now);
+    if (overrideMode == OverrideMode::None)
+    {
+        return ledDeadline;
+    }
+    return earlierDeadline(ledDeadline, overrideUntil);
+}
+
+void FeedbackController::onTapDetected(const TapDetected &)
+{
+    setOverride(OverrideMode::TapPublished, 900);
+}
+
+void FeedbackController::onCommandReceived(const CommandReceived &event)
+{
+    switch (event.outcome)
+    {
+    case CommandOutcome::Granted:
+        setOverride(OverrideMode::UnlockGranted, 1600);
+        break;
+    case CommandOutcome::Denied:
+        setOverride(OverrideMode::AccessDenied, 1400);
+        break;
+    case CommandOutcome::Rejected:
+        setOverride(OverrideMode::CommandFailed, 1600);
+        break;
+    case CommandOutcome::Handled:
+        break;
+    }
+}
+
+// The unlock already showed green; a lock that did not open overrides it.
+void FeedbackController::onLockActuated(const LockActuated &event)
+{
+    if (event.actuation.outcome == LockOutcome::Jammed || event.actuation.outcome == LockOutcome::WatchdogTripped)
+    {
+        setOverride(OverrideMode::CommandFailed, 1600);
+    }
+}
+
 void FeedbackController::setOverride(OverrideMode mode, unsigned long durationMs)
 {
     overrideMode = mode;
-    overrideUntil = millis() + durationMs;
+    overrideUntil = hal::uptimeMs() + durationMs;
+    overridePending = true;
 }
@@ -0,0 +1,200 @@
+#include "services/MetricsPublisher.h"
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+
+#include "hal/Clock.h"
+#include "logging/DeferredLog.h"
+#include "metrics/Metrics.h"
+
+namespace
+{
+constexpr LogModule LOG_MODULE = LogModule::Metrics;
+
+constexpr unsigned long METRICS_FLUSH_INTERVAL_MS = 60000;
+constexpr size_t METRIC_FRAGMENT_CAPACITY = 256;
+// Closing braces for "metrics" and the envelope plus the terminator.
+constexpr size_t BATCH_TRAILER_LENGTH = 3;
+
+size_t appendFormatted(char *buffer, size_t capacity, size_t length, const char *format, ...)
+{
+    if (length >= capacity)
+    {
+        return capacity;
+    }
+
+    va_list args;
+    va_start(args, format);
+    const int written = vsnprintf(buffer + length, capacity - length, format, args);
+    va_end(args);
+    if (written < 0)
+    {
+        return capacity;
+    }
+    return length + static_cast<size_t>(written);
+}
+
+// Renders one `"name":value` member. Histograms become
+// {"n":count,"p99":us,"max":us,"b":[trimmed log2 buckets]}.
+size_t formatMetric(Metric &metric, bool rollWindow, char *fragment, size_t capacity)
+{
+    switch (metric.kind())
+    {
+    case MetricKind::Counter:
+        return appendFormatted(fragment, capacity, 0, "\"%s\":%lu", metric.name(),
+                               static_cast<unsigned long>(static_cast<MetricCounter &>(metric).value()));
+    case MetricKind::Gauge:
+        return appendFormatted(fragment, capacity, 0, "\"%s\":%ld", metric.name(),
+                               static_cast<long>(static_cast<MetricGauge &>(metric).value()));
+    case MetricKind::Histogram:
+    {
+        MetricHistogram &histogram = static_cast<MetricHistogram &>(metric);
+        const LatencyHistogram::Snapshot snapshot = rollWindow ? histogram.takeSnapshot() : histogram.snapshot();
+        size_t length = appendFormatted(fragment, capacity, 0, "\"%s\":{\"n\":%lu,\"p99\":%lu,\"max\":%lu,\"b\":[",
+                                        metric.name(),
+                                        static_cast<unsigned long>(snapshot.count),
+                                        static_cast<unsigned long>(snapshot.percentileMicros(99)),
+                                        static_cast<unsigned long>(snapshot.maxMicros));
+        const size_t usedBuckets = snapshot.usedBucketCount();
+        for (size_t bucket = 0; bucket < usedBuckets; ++bucket)
+        {
+            length = appendFormatted(fragment, capacity, length, bucket == 0 ? "%lu" : ",%lu",
+                                     static_cast<unsigned long>(snapshot.buckets[bucket]));
+        }
+        return appendFormatted(fragment, capacity, length, "]}");
+    }
+    }
+    return capacity;
+}
+}
+
+MetricsPublisher::MetricsPublisher(const DeviceContext &deviceContext, const WallClock &wallClock)
+    : deviceContext(deviceContext), wallClock(wallClock), lastFlushAt(hal::uptimeMs())
+{
+}
+
+void MetricsPublisher::publishIfDue(OutboundQueue &outboundQueue)
+{
+    const uint64_t now = hal::uptimeMs();
+    if (now - lastFlushAt < METRICS_FLUSH_INTERVAL_MS)
+    {
+        return;
+    }
+
+    // Wait for the queue to drain rather than roll a window nobody sees.
+    if (!outboundQueue.canAccept(OutboundPriority::Telemetry))
+    {
+        return;
+    }
+
+    // A failed export still rolls the histogram window so a long outage
+    // doesn't fold hours of samples into one report.
+    flush(outboundQueue, "interval", true);
+    lastFlushAt = now;
+}
+
+uint64_t MetricsPublisher::nextPublishAt() const
+{
+    return lastFlushAt + METRICS_FLUSH_INTERVAL_MS;
+}
+
+bool MetricsPublisher::publishDiagnostics(OutboundQueue &outboundQueue)
+{
+    return flush(outboundQueue, "diagnostics", false);
+}
+
+bool MetricsPublisher::flush(OutboundQueue &outboundQueue, const char *trigger, bool rollWindow)
+{
+    char fragment[METRIC_FRAGMENT_CAPACITY];
+    bool allPublished = true;
+    uint8_t part = 0;
+
+    if (!openBatch(outboundQueue, trigger, part))
+    {
+        return false;
+    }
+    for (Metric *metric = Metric::first(); metric != nullptr; metric = metric->next())
+    {
+        const size_t fragmentLength = formatMetric(*metric, rollWindow, fragment, sizeof(fragment));
+        if (fragmentLength >= sizeof(fragment))
+        {
+            LOGE("Metric %s does not fit an export fragment\n", metric->name());
+            continue;
+        }
+
+        const size_t separatorLength = batchEmpty ? 0 : 1;
+        if (payloadLength + separatorLength + fragmentLength + BATCH_TRAILER_LENGTH > OutboundQueue::PAYLOAD_CAPACITY)
+        {
+            allPublished = closeAndQueueBatch(outboundQueue) && allPublished;
+            if (!openBatch(outboundQueue, trigger, ++part))
+            {
+                LOGW("Outbound queue full, dropping the rest of metrics flush %lu\n",
+                     static_cast<unsigned long>(flushSequence));
+                ++flushSequence;
+                return false;
+            }
+        }
+
+        char *payload = batch->payload;
+        if (!batchEmpty)
+        {
+            payload[payloadLength++] = ',';
+        }
+        std::memcpy(payload + payloadLength, fragment, fragmentLength);
+        payloadLength += fragmentLength;
+        batchEmpty = false;
+    }
+
+    allPublished = closeAndQueueBatch(outboundQueue) && allPublished;
+    ++flushSequence;
+    return allPublished;
+}
+
+bool MetricsPublisher::openBatch(OutboundQueue &outboundQueue, const char *trigger, uint8_t part)
+{
+    batch = outboundQueue.acquire(OutboundPriority::Telemetry);
+    if (batch == nullptr)
+    {
+        return false;
+    }
+
+    char *payload = batch->payload;
+    const size_t capacity = OutboundQueue::PAYLOAD_CAPACITY;
+    const WallTime time = wallClock.now();
+    payloadLength = appendFormatted(payload, capacity, 0,
+                                    "{\"deviceId\":\"%s\",\"seq\":%lu,\"part\":%u,\"trigger\":\"%s\",\"uptimeMs\":%llu,\"boot\":%lu,\"timeSync\":\"%s\"",
+                                    deviceContext.deviceId.c_str(),
+                                    static_cast<unsigned long>(flushSequence),
+                                    static_cast<unsigned>(part),
+                                    trigger,
+                                    static_cast<unsigned long long>(hal::uptimeMs()),
+                                    static_cast<unsigned long>(wallClock.bootCount()),
+                                    timeSyncQualityName(time.quality));
+    if (time.quality != TimeSyncQuality::None)
+    {
+        payloadLength = appendFormatted(payload, capacity, payloadLength, ",\"epochMs\":%llu",
+                                        static_cast<unsigned long long>(time.epochMs));
+    }
+    payloadLength = appendFormatted(payload, capacity, payloadLength, ",\"metrics\":{");
+    batchEmpty = true;
+    return true;
+}
+
+bool MetricsPublisher::closeAndQueueBatch(OutboundQueue &outboundQueue)
+{
+    OutboundQueue::Message &message = *batch;
+    batch = nullptr;
+    if (payloadLength + BATCH_TRAILER_LENGTH > OutboundQueue::PAYLOAD_CAPACITY)
+    {
+        LOGE("Failed to serialize metrics batch\n");
+        outboundQueue.release(message);
+        return false;
+    }
+
+    message.payload[payloadLength++] = '}';
+    message.payload[payloadLength++] = '}';
+    message.payload[payloadLength] = '\0';
+    outboundQueue.submit(message, deviceContext.topics.metricsTopic.c_str(), payloadLength, false, false);
+    return true;
+}
@@ -0,0 +1,158 @@
+#include "services/OutboundMessages.h"
+
+#include "JsonSchema.h"
+
+namespace
+{
+constexpr auto TAP_EVENT_SCHEMA = jsonSchema(jsonField("requestId", &TapEventMessage::requestId),
+                                             jsonField("deviceId", &TapEventMessage::deviceId),
+                                             jsonField("cardUid", &TapEventMessage::cardUid),
+                                             jsonField("cardType", &TapEventMessage::cardType),
+                                             jsonField("ambiguous", &TapEventMessage::ambiguous),
+                                             jsonField("otherCardUid", &TapEventMessage::otherCardUid),
+                                             jsonField("bay", &TapEventMessage::bay),
+                                             jsonField("timestampMs", &TapEventMessage::timestampMs),
+                                             jsonField("epochMs", &TapEventMessage::epochMs),
+                                             jsonField("timeSync", &TapEventMessage::timeSync),
+                                             jsonField("boot", &TapEventMessage::boot),
+                                             jsonField("trace", &TapEventMessage::trace));
+
+constexpr auto CARD_EVENT_SCHEMA = jsonSchema(jsonField("deviceId", &CardEventMessage::deviceId),
+                                              jsonField("event", &CardEventMessage::event),
+                                              jsonField("cardUid", &CardEventMessage::cardUid),
+                                              jsonField("cardType", &CardEventMessage::cardType),
+                                              jsonField("bay", &CardEventMessage::bay),
+                                              jsonField("tapRequestId", &CardEventMessage::tapRequestId),
+                                              jsonField("dwellMs", &CardEventMessage::dwellMs),
+                                              jsonField("timestampMs", &CardEventMessage::timestampMs),
+                                              jsonField("epochMs", &CardEventMessage::epochMs),
+                                              jsonField("timeSync", &CardEventMessage::timeSync),
+                                              jsonField("boot", &CardEventMessage::boot));
+
+constexpr auto TAPS_LIMITED_SCHEMA = jsonSchema(jsonField("deviceId", &TapsLimitedMessage::deviceId),
+                                                jsonField("event", &TapsLimitedMessage::event),
+                                                jsonField("bay", &TapsLimitedMessage::bay),
+                                                jsonField("suppressed", &TapsLimitedMessage::suppressed),
+                                                jsonField("cardUid", &TapsLimitedMessage::cardUid),
+                                                jsonField("windowMs", &TapsLimitedMessage::windowMs),
+                                                jsonField("timestampMs", &TapsLimitedMessage::timestampMs),
+                                                jsonField("epochMs", &TapsLimitedMessage::epochMs),
+                                                jsonField("timeSync", &TapsLimitedMessage::timeSync),
+                                                jsonField("boot", &TapsLimitedMessage::boot));
+
+constexpr auto OFFLINE_DECISION_SCHEMA = jsonSchema(jsonField("deviceId", &OfflineDecisionMessage::deviceId),
+                                                    jsonField("event", &OfflineDecisionMessage::event),
+                                                    jsonField("cardUid", &OfflineDecisionMessage::cardUid),
+                                                    jsonField("bay", &OfflineDecisionMessage::bay),
+                                                    jsonField("decision", &OfflineDecisionMessage::decision),
+                                                    jsonField("reason", &OfflineDecisionMessage::reason),
+                                                    jsonField("cacheGeneration", &OfflineDecisionMessage::cacheGeneration),
+                                                    jsonField("timestampMs", &OfflineDecisionMessage::timestampMs),
+                                                    jsonField("epochMs", &OfflineDecisionMessage::epochMs),
+                                                    jsonField("timeSync", &OfflineDecisionMessage::timeSync),
+                                                    jsonField("boot", &OfflineDecisionMessage::boot));
+
+constexpr auto RUNTIME_STATUS_SCHEMA = jsonSchema(jsonField("deviceId", &RuntimeStatusMessage::deviceId),
+                                                  jsonField("runtimeState", &RuntimeStatusMessage::runtimeState),
+                                                  jsonField("wifiConnected", &RuntimeStatusMessage::wifiConnected),
+                                                  jsonField("mqttConnected", &RuntimeStatusMessage::mqttConnected),
+                                                  jsonField("nfcHealthy", &RuntimeStatusMessage::nfcHealthy),
+                                                  jsonField("nfcHealthyBays", &RuntimeStatusMessage::nfcHealthyBays),
+                                                  jsonField("timestampMs", &RuntimeStatusMessage::timestampMs),
+                                                  jsonField("epochMs", &RuntimeStatusMessage::epochMs),
+                                                  jsonField("timeSync", &RuntimeStatusMessage::timeSync),
+                                                  jsonField("boot", &RuntimeStatusMessage::boot));
+
+constexpr auto COMMAND_ACK_SCHEMA = jsonSchema(jsonField("deviceId", &CommandAckMessage::deviceId),
+                                               jsonField("requestId", &CommandAckMessage::requestId),
+                                               jsonField("action", &CommandAckMessage::action),
+                                               jsonField("status", &CommandAckMessage::status),
+                                               jsonField("epochMs", &CommandAckMessage::epochMs),
+                                               jsonField("timeSync", &CommandAckMessage::timeSync),
+                                               jsonField("boot", &CommandAckMessage::boot),
+                                               jsonField("detail", &CommandAckMessage::detail),
+                                               jsonField("actuationMs", &CommandAckMessage::actuationMs),
+                                               jsonField("trace", &CommandAckMessage::trace));
+
+// Writes the echoed object without its closing brace; false if it is empty.
+bool writeEchoedMembers(JsonWriter &writer, const JsonDocument &echoed)
+{
+    const size_t room = writer.remaining();
+    const size_t written = serializeJson(echoed, writer.cursor(), room);
+    // serializeJson stops one short of room when it truncates, and the
+    // stamps still have to follow, so anything that close counts as full.
+    if (written < 2 || written + 1 >= room)
+    {
+        writer.fail();
+        return false;
+    }
+    writer.commit(written - 1);
+    return written > 2;
+}
+}
+
+void writeJsonValue(JsonWriter &writer, const TraceJson &trace)
+{
+    const bool echoed = trace.echoed != nullptr && !trace.echoed->isNull();
+    bool hasMembers = false;
+    if (echoed)
+    {
+        hasMembers = writeEchoedMembers(writer, *trace.echoed);
+    }
+    else
+    {
+        writer.writeRaw('{');
+    }
+
+    if (trace.stages != nullptr)
+    {
+        for (size_t index = 0; index < RequestTrace::STAGE_COUNT; ++index)
+        {
+            const TraceStage stage = static_cast<TraceStage>(index);
+            const char *key = traceStageKey(stage);
+            if (!trace.stages->has(stage) || (echoed && trace.echoed->containsKey(key)))
+            {
+                continue;
+            }
+            if (hasMembers)
+            {
+                writer.writeRaw(',');
+            }
+            writer.writeString(key);
+            writer.writeRaw(':');
+            writer.writeUnsigned(trace.stages->at(stage));
+            hasMembers = true;
+        }
+    }
+    writer.writeRaw('}');
+}
+
+size_t serializeTapEvent(const TapEventMessage &message, char *buffer, size_t capacity)
+{
+    return TAP_EVENT_SCHEMA.serialize(message, buffer, capacity);
+}
+
+size_t serializeCardEvent(const CardEventMessage &message, char *buffer, size_t capacity)
+{
+    return CARD_EVENT_SCHEMA.serialize(message, buffer, capacity);
+}
+
+size_t serializeTapsLimited(const TapsLimitedMessage &message, char *buffer, size_t capacity)
+{
+    return TAPS_LIMITED_SCHEMA.serialize(message, buffer, capacity);
+}
+
+size_t serializeOfflineDecision(const OfflineDecisionMessage &message, char *buffer, size_t capacity)
+{
+    return OFFLINE_DECISION_SCHEMA.serialize(message, buffer, capacity);
+}
+
+size_t serializeRuntimeStatus(const RuntimeStatusMessage &message, char *buffer, size_t capacity)
+{
+    return RUNTIME_STATUS_SCHEMA.serialize(message, buffer, capacity);
+}
+
+size_t serializeCommandAck(const CommandAckMessage &message, char *buffer, size_t capacity)
+{
+    return COMMAND_ACK_SCHEMA.serialize(message, buffer, capacity);
+}
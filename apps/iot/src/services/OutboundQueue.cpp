@@ -0,0 +1,161 @@
+#include "services/OutboundQueue.h"
+
+#include "MQTTManager.h"
+#include "app/WakeSignal.h"
+#include "logging/DeferredLog.h"
+#include "metrics/Metrics.h"
+
+namespace
+{
+constexpr LogModule LOG_MODULE = LogModule::Mqtt;
+
+constexpr size_t PRIORITY_COUNT = static_cast<size_t>(OutboundPriority::Count);
+
+MetricCounter backpressureEvents("outbound.backpressure");
+MetricCounter droppedMessages("outbound.dropped");
+MetricGauge queuedMessages("outbound.queued");
+}
+
+const char *outboundPriorityName(OutboundPriority priority)
+{
+    switch (priority)
+    {
+    case OutboundPriority::Interactive:
+        return "interactive";
+    case OutboundPriority::State:
+        return "state";
+    case OutboundPriority::Telemetry:
+        return "telemetry";
+    default:
+        return "unknown";
+    }
+}
+
+template <typename Queue, typename Visitor>
+auto OutboundQueue::visitRing(Queue &queue, OutboundPriority priority, Visitor &&visitor)
+{
+    switch (priority)
+    {
+    case OutboundPriority::State:
+        return visitor(queue.stateRing);
+    case OutboundPriority::Telemetry:
+        return visitor(queue.telemetryRing);
+    default:
+        return visitor(queue.interactiveRing);
+    }
+}
+
+OutboundQueue::Message *OutboundQueue::acquire(OutboundPriority priority)
+{
+    Message *message = visitRing(*this, priority, [](auto &ring)
+                                 { return ring.reserve(); });
+    if (message == nullptr)
+    {
+        backpressureEvents.increment();
+        return nullptr;
+    }
+
+    message->topic = nullptr;
+    message->length = 0;
+    message->priority = priority;
+    message->payload[0] = '\0';
+    return message;
+}
+
+void OutboundQueue::submit(Message &message, const char *topic, size_t length, bool retained, bool logPayload)
+{
+    const bool committed = visitRing(*this, message.priority, [&](auto &ring)
+                                     {
+                                         // Only the slot acquire() handed out may be committed.
+                                         if (ring.reserve() != &message)
+                                         {
+                                             return false;
+                                         }
+                                         message.topic = topic;
+                                         message.length = length;
+                                         message.retained = retained;
+                                         message.logPayload = logPayload;
+                                         ring.commit();
+                                         return true; });
+    if (!committed)
+    {
+        return;
+    }
+
+    queuedMessages.set(static_cast<int32_t>(queuedCount()));
+    if (consumerWake != nullptr)
+    {
+        consumerWake->notify(WakeEvent::OUTBOUND_QUEUED);
+    }
+}
+
+void OutboundQueue::release(Message &message)
+{
+    // An uncommitted slot is simply handed out again by the next acquire().
+    message.length = 0;
+    message.payload[0] = '\0';
+}
+
+bool OutboundQueue::canAccept(OutboundPriority priority) const
+{
+    return visitRing(*this, priority, [](const auto &ring)
+                     { return !ring.full(); });
+}
+
+void OutboundQueue::setConsumerWake(WakeSignal &wakeSignal)
+{
+    consumerWake = &wakeSignal;
+}
+
+bool OutboundQueue::empty() const
+{
+    return interactiveRing.empty() && stateRing.empty() && telemetryRing.empty();
+}
+
+size_t OutboundQueue::queuedCount() const
+{
+    return interactiveRing.size() + stateRing.size() + telemetryRing.size();
+}
+
+size_t OutboundQueue::drain(MQTTManager &mqttManager, size_t byteBudget)
+{
+    size_t sentBytes = 0;
+    bool stopped = false;
+    for (size_t index = 0; index < PRIORITY_COUNT && !stopped; ++index)
+    {
+        stopped = visitRing(*this, static_cast<OutboundPriority>(index), [&](auto &ring)
+                            {
+                                for (Message *message = ring.front(); message != nullptr; message = ring.front())
+                                {
+                                    if (sentBytes > 0 && sentBytes + message->length > byteBudget)
+                                    {
+                                        return true;
+                                    }
+
+                                    if (mqttManager.publish(message->topic, message->payload, message->retained, message->logPayload))
+                                    {
+                                        sentBytes += message->length;
+                                    }
+                                    else if (!mqttManager.isConnected())
+                                    {
+                                        // Keep it for the next session rather than losing an ack.
+                                        return true;
+                                    }
+                                    else
+                                    {
+                                        // The session is fine, so this message will never go; do
+                                        // not let it hold up the ones behind it.
+                                        LOGE("Dropping %u byte %s message to %s\n",
+                                             static_cast<unsigned>(message->length),
+                                             outboundPriorityName(message->priority),
+                                             message->topic);
+                                        droppedMessages.increment();
+                                    }
+                                    ring.pop();
+                                }
+                                return false; });
+    }
+
+    queuedMessages.set(static_cast<int32_t>(queuedCount()));
+    return sentBytes;
+}
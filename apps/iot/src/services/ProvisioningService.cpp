@@ -1,11 +1,16 @@
 #include "services/ProvisioningService.h"
 
-#include <Arduino.h>
 #include <ArduinoJson.h>
-#include <ArduinoLog.h>
+
+#include <cstring>
+
+#include "hal/Clock.h"
+#include "logging/DeferredLog.h"
 
 namespace
 {
+constexpr LogModule LOG_MODULE = LogModule::Provisioning;
+
 constexpr size_t MAX_PROVISIONING_LINE_LENGTH = 512;
 constexpr const char *PROVISIONING_PREFIX = "CFG ";
 
@@ -25,10 +30,36 @@ std::optional<std::string_view> readOptionalStringField(const JsonDocument &doc,
 
     return std::string_view(text);
 }
+
+// Log output comes from another task, so a response must reach the UART in
+// one write or a log line can land in the middle of it. Returns false, and
+// writes nothing, if the document did not fit in the line or in itself.
+bool writeProvisioningLine(hal::SerialPort &serial, const JsonDocument &document)
+{
+    char line[MAX_PROVISIONING_LINE_LENGTH];
+    const size_t prefixLength = strlen(PROVISIONING_PREFIX);
+    if (document.overflowed() || prefixLength + measureJson(document) + 1 > sizeof(line))
+    {
+        return false;
+    }
+    memcpy(line, PROVISIONING_PREFIX, prefixLength);
+    size_t length = prefixLength + serializeJson(document, line + prefixLength, sizeof(line) - prefixLength - 1);
+    line[length++] = '\n';
+    serial.write(reinterpret_cast<const uint8_t *>(line), length);
+    return true;
+}
+
+// Sent when even the error response is too long, which only echoed request
+// fields can cause.
+void writeOversizedLine(hal::SerialPort &serial)
+{
+    static constexpr char LINE[] = "CFG {\"channel\":\"config\",\"ok\":false,\"error\":\"response_too_large\"}\n";
+    serial.write(reinterpret_cast<const uint8_t *>(LINE), sizeof(LINE) - 1);
+}
 }
 
-ProvisioningService::ProvisioningService(Stream &serial)
-    : serial(serial)
+ProvisioningService::ProvisioningService(hal::SerialPort &serial, hal::FileStorage &storage, hal::System &system)
+    : serial(serial), storage(storage), system(system)
 {
 }
 
@@ -62,7 +93,7 @@ void ProvisioningService::poll(AppConfig &config)
         if (buffer.size() > MAX_PROVISIONING_LINE_LENGTH)
         {
             buffer.clear();
-            Log.warning("Provisioning input too long, dropping line\n");
+            LOGW("Provisioning input too long, dropping line\n");
         }
     }
 }
@@ -81,7 +112,7 @@ void ProvisioningService::handleLine(const std::string &line, AppConfig &config)
 
     if (error)
     {
-        writeResponse(requestId, false, nullptr, error.c_str(), "invalid_json");
+        writeResponse(requestId, false, std::nullopt, error.c_str(), "invalid_json");
         return;
     }
 
@@ -124,18 +155,54 @@ void ProvisioningService::handleLine(const std::string &line, AppConfig &config)
         {
             nextConfig.mqttPassword = request["mqttPassword"] | "";
         }
+        if (request.containsKey("ntpServer"))
+        {
+            nextConfig.ntpServer = request["ntpServer"] | "";
+        }
+        if (request.containsKey("nfcBus"))
+        {
+            nextConfig.nfcBus = request["nfcBus"] | "";
+        }
+        if (request.containsKey("nfcIdlePollMs"))
+        {
+            nextConfig.nfcIdlePollMs = request["nfcIdlePollMs"] | -1;
+        }
+        if (request.containsKey("nfcActiveHoldMs"))
+        {
+            nextConfig.nfcActiveHoldMs = request["nfcActiveHoldMs"] | -1;
+        }
+        if (request.containsKey("nfcPowerDown"))
+        {
+            nextConfig.nfcPowerDown = request["nfcPowerDown"] | true;
+        }
+        if (request.containsKey("nfcProtocols"))
+        {
+            nextConfig.nfcProtocols = request["nfcProtocols"] | "";
+        }
+        if (request.containsKey("nfcRetapMs"))
+        {
+            nextConfig.nfcRetapMs = request["nfcRetapMs"] | -1;
+        }
+        if (request.containsKey("tapBurst"))
+        {
+            nextConfig.tapBurst = request["tapBurst"] | -1;
+        }
+        if (request.containsKey("tapRatePerMin"))
+        {
+            nextConfig.tapRatePerMin = request["tapRatePerMin"] | -1;
+        }
 
         if (!isConfigValid(nextConfig))
         {
             writeResponse(requestId,
                           false,
                           type,
-                          "bikeId, wifiSsid, mqttBrokerIP, and mqttPort are required",
+                          "bikeId, wifiSsid, mqttBrokerIP, and mqttPort are required and must fit the device limits; nfcBus must be i2c, i2c-100k or spi; nfcIdlePollMs 0 or 80-1000; nfcProtocols a list of iso14443a, iso14443b, felica; nfcRetapMs 0 or 1000-600000; tapBurst 1-60; tapRatePerMin 0-100",
                           "invalid_config");
             return;
         }
 
-        if (!saveConfig(nextConfig))
+        if (!saveConfig(storage, nextConfig))
         {
             writeResponse(requestId, false, type, "failed to persist config", "save_failed");
             return;
@@ -147,6 +214,35 @@ void ProvisioningService::handleLine(const std::string &line, AppConfig &config)
         return;
     }
 
+    if (type == "set-log-level")
+    {
+        const std::optional<std::string_view> moduleName = readOptionalStringField(request, "module");
+        const int level = request["level"] | -1;
+        if (level < LOG_LEVEL_SILENT || level > LOG_LEVEL_VERBOSE)
+        {
+            writeResponse(requestId, false, type, "level must be between 0 and 6", "invalid_level");
+            return;
+        }
+
+        if (!moduleName.has_value() || moduleName == "all")
+        {
+            DeferredLog::setLevel(static_cast<uint8_t>(level));
+        }
+        else
+        {
+            LogModule module;
+            if (!parseLogModule(*moduleName, module))
+            {
+                writeResponse(requestId, false, type, *moduleName, "unknown_module");
+                return;
+            }
+            DeferredLog::setModuleLevel(module, static_cast<uint8_t>(level));
+        }
+
+        writeResponse(requestId, true, type, "log level updated");
+        return;
+    }
+
     if (type == "restart")
     {
         writeResponse(requestId, true, type, "restarting");
@@ -163,7 +259,7 @@ void ProvisioningService::writeResponse(std::optional<std::string_view> requestI
                                         std::optional<std::string_view> message,
                                         std::optional<std::string_view> error) const
 {
-    StaticJsonDocument<384> response;
+    StaticJsonDocument<528> response;
     response["channel"] = "config";
     response["ok"] = ok;
 
@@ -184,14 +280,16 @@ void ProvisioningService::writeResponse(std::optional<std::string_view> requestI
         response["message"] = message->data();
     }
 
-    serial.print(PROVISIONING_PREFIX);
-    serializeJson(response, serial);
-    serial.print('\n');
+    if (!writeProvisioningLine(serial, response))
+    {
+        LOGW("Provisioning response too large, sent without its fields\n");
+        writeOversizedLine(serial);
+    }
 }
 
 void ProvisioningService::writeConfigResponse(const AppConfig &config, std::optional<std::string_view> requestId) const
 {
-    StaticJsonDocument<384> response;
+    StaticJsonDocument<496> response;
     response["channel"] = "config";
     response["ok"] = true;
     response["type"] = "get-config";
@@ -206,15 +304,29 @@ void ProvisioningService::writeConfigResponse(const AppConfig &config, std::opti
     response["mqttPort"] = config.mqttPort;
     response["mqttUsername"] = config.mqttUsername.c_str();
     response["mqttPassword"] = config.mqttPassword.c_str();
+    response["ntpServer"] = config.ntpServer.c_str();
+    response["nfcBus"] = config.nfcBus.c_str();
+    response["nfcIdlePollMs"] = config.nfcIdlePollMs;
+    response["nfcActiveHoldMs"] = config.nfcActiveHoldMs;
+    response["nfcPowerDown"] = config.nfcPowerDown;
+    response["nfcProtocols"] = config.nfcProtocols.c_str();
+    response["nfcRetapMs"] = config.nfcRetapMs;
+    response["tapBurst"] = config.tapBurst;
+    response["tapRatePerMin"] = config.tapRatePerMin;
 
-    serial.print(PROVISIONING_PREFIX);
-    serializeJson(response, serial);
-    serial.print('\n');
+    // Long credentials and hosts together can outgrow the line; the tool
+    // gets an error rather than a config cut off mid-field.
+    if (!writeProvisioningLine(serial, response))
+    {
+        LOGW("Config exceeds the %u byte provisioning line\n", static_cast<unsigned>(MAX_PROVISIONING_LINE_LENGTH));
+        writeResponse(requestId, false, "get-config", std::nullopt, "response_too_large");
+    }
 }
 
 void ProvisioningService::restartDevice() const
 {
+    DeferredLog::flush();
     serial.flush();
-    delay(200);
-    ESP.restart();
+    hal::delayMs(200);
+    system.restart();
 }
@@ -0,0 +1,52 @@
+#include "services/RequestTrace.h"
+
+#include "hal/Clock.h"
+
+const char *traceStageKey(TraceStage stage)
+{
+    switch (stage)
+    {
+    case TraceStage::CardDetected:
+        return "cardDetectedUs";
+    case TraceStage::TapPublished:
+        return "tapPublishedUs";
+    case TraceStage::CommandReceived:
+        return "commandReceivedUs";
+    case TraceStage::CommandParsed:
+        return "commandParsedUs";
+    case TraceStage::FeedbackApplied:
+        return "feedbackAppliedUs";
+    case TraceStage::AckSent:
+        return "ackSentUs";
+    default:
+        return "unknownUs";
+    }
+}
+
+void RequestTrace::mark(TraceStage stage)
+{
+    markAt(stage, hal::uptimeUs());
+}
+
+void RequestTrace::markAt(TraceStage stage, uint64_t stampUs)
+{
+    const size_t index = static_cast<size_t>(stage);
+    stampsUs[index] = stampUs;
+    markedStages |= static_cast<uint8_t>(1U << index);
+}
+
+void RequestTrace::clear()
+{
+    stampsUs.fill(0);
+    markedStages = 0;
+}
+
+bool RequestTrace::has(TraceStage stage) const
+{
+    return (markedStages & (1U << static_cast<size_t>(stage))) != 0;
+}
+
+uint64_t RequestTrace::at(TraceStage stage) const
+{
+    return stampsUs[static_cast<size_t>(stage)];
+}
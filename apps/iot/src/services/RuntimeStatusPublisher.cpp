@@ -1,80 +1,98 @@
 #include "services/RuntimeStatusPublisher.h"
 
-#include <Arduino.h>
-#include <ArduinoJson.h>
-#include <ArduinoLog.h>
-
-#include "MQTTManager.h"
+#include "hal/Clock.h"
+#include "logging/DeferredLog.h"
+#include "services/OutboundMessages.h"
 
 namespace
 {
+constexpr LogModule LOG_MODULE = LogModule::Status;
+
 constexpr unsigned long STATUS_HEARTBEAT_INTERVAL_MS = 15000;
 }
 
-RuntimeStatusPublisher::RuntimeStatusPublisher(const DeviceContext &deviceContext)
-    : deviceContext(deviceContext)
+RuntimeStatusPublisher::RuntimeStatusPublisher(const DeviceContext &deviceContext, const WallClock &wallClock)
+    : deviceContext(deviceContext), wallClock(wallClock)
 {
 }
 
-void RuntimeStatusPublisher::publishIfNeeded(MQTTManager &mqttManager,
+void RuntimeStatusPublisher::publishIfNeeded(OutboundQueue &outboundQueue,
                                              RuntimeState runtimeState,
                                              bool wifiConnected,
                                              bool mqttConnected,
                                              bool nfcHealthy,
+                                             std::optional<uint32_t> nfcHealthyBays,
                                              bool force)
 {
-    const unsigned long now = millis();
-    const bool stateChanged = runtimeState != lastPublishedState;
+    const uint64_t now = hal::uptimeMs();
+    const bool stateChanged = runtimeState != lastPublishedState || nfcHealthyBays != lastPublishedBays;
     const bool heartbeatDue = !lastPublishedAt.has_value() || now - *lastPublishedAt >= STATUS_HEARTBEAT_INTERVAL_MS;
     if (!force && !stateChanged && !heartbeatDue)
     {
         return;
     }
 
-    StaticJsonDocument<192> doc;
-    doc["deviceId"] = deviceContext.deviceId.c_str();
-    doc["runtimeState"] = runtimeStateName(runtimeState);
-    doc["wifiConnected"] = wifiConnected;
-    doc["mqttConnected"] = mqttConnected;
-    doc["nfcHealthy"] = nfcHealthy;
-    doc["timestampMs"] = now;
+    // Still due on the next pass if the queue is backed up.
+    OutboundQueue::Message *slot = outboundQueue.acquire(OutboundPriority::State);
+    if (slot == nullptr)
+    {
+        return;
+    }
 
-    char payload[192];
-    const size_t payloadLength = serializeJson(doc, payload, sizeof(payload));
-    if (payloadLength == 0 || payloadLength >= sizeof(payload))
+    RuntimeStatusMessage message;
+    message.deviceId = deviceContext.deviceId.c_str();
+    message.runtimeState = runtimeStateName(runtimeState);
+    message.wifiConnected = wifiConnected;
+    message.mqttConnected = mqttConnected;
+    message.nfcHealthy = nfcHealthy;
+    message.nfcHealthyBays = nfcHealthyBays;
+    message.timestampMs = now;
+    wallClock.stamp(message);
+
+    const size_t payloadLength = serializeRuntimeStatus(message, slot->payload, sizeof(slot->payload));
+    if (payloadLength == 0)
     {
-        Log.error("Failed to serialize runtime status\n");
+        LOGE("Failed to serialize runtime status\n");
+        outboundQueue.release(*slot);
         return;
     }
 
-    if (mqttManager.publish(deviceContext.topics.statusTopic, payload, true, false))
+    outboundQueue.submit(*slot, deviceContext.topics.statusTopic.c_str(), payloadLength, true, false);
+    lastPublishedState = runtimeState;
+    lastPublishedBays = nfcHealthyBays;
+    lastPublishedAt = now;
+    logPublishedStatus(runtimeState, now, wifiConnected, mqttConnected, nfcHealthy);
+}
+
+uint64_t RuntimeStatusPublisher::nextPublishAt(RuntimeState runtimeState, std::optional<uint32_t> nfcHealthyBays, uint64_t now) const
+{
+    if (runtimeState != lastPublishedState || nfcHealthyBays != lastPublishedBays || !lastPublishedAt.has_value())
     {
-        lastPublishedState = runtimeState;
-        lastPublishedAt = now;
-        logPublishedStatus(runtimeState, now, wifiConnected, mqttConnected, nfcHealthy);
+        return now;
     }
+    return *lastPublishedAt + STATUS_HEARTBEAT_INTERVAL_MS;
 }
 
 void RuntimeStatusPublisher::logPublishedStatus(RuntimeState runtimeState,
-                                                unsigned long timestampMs,
+                                                uint64_t timestampMs,
                                                 bool wifiConnected,
                                                 bool mqttConnected,
                                                 bool nfcHealthy) const
 {
-    Log.info(
-        "Published runtime status\n"
+    LOGI(
+        "Queued runtime status\n"
         "  topic: %s\n"
         "  deviceId: %s\n"
         "  runtimeState: %s\n"
         "  wifiConnected: %s\n"
         "  mqttConnected: %s\n"
         "  nfcHealthy: %s\n"
-        "  timestampMs: %lu\n",
+        "  timestampMs: %llu\n",
         deviceContext.topics.statusTopic.c_str(),
         deviceContext.deviceId.c_str(),
         runtimeStateName(runtimeState),
         wifiConnected ? "true" : "false",
         mqttConnected ? "true" : "false",
         nfcHealthy ? "true" : "false",
-        timestampMs);
+        static_cast<unsigned long long>(timestampMs));
 }
@@ -1,61 +1,412 @@
 #include "services/TapPublisher.h"
 
-#include <ArduinoJson.h>
-#include <ArduinoLog.h>
+#include <algorithm>
+#include <cstdio>
+#include <limits>
 
-#include "MQTTManager.h"
+#include "hal/Clock.h"
+#include "logging/DeferredLog.h"
+#include "metrics/Metrics.h"
+#include "services/AuthorizationCache.h"
+#include "services/OutboundMessages.h"
 
-TapPublisher::TapPublisher(NFCManager &nfcManager, const DeviceContext &deviceContext)
-    : watcher(nfcManager), deviceContext(deviceContext)
+namespace
 {
+constexpr LogModule LOG_MODULE = LogModule::Tap;
+
+MetricCounter heldBackTaps("tap.rate_limited");
+MetricCounter limitSummaries("tap.limit_summaries");
+// Bit n set while bay n is holding taps back.
+MetricGauge limitedBays("tap.limited_bays");
+// Tokens left in the emptiest bucket.
+MetricGauge minTokens("tap.min_tokens");
+}
+
+TapPublisher::TapPublisher(ReaderScanScheduler &readers,
+                           const DeviceContext &deviceContext,
+                           const WallClock &wallClock,
+                           AppEventBus &events,
+                           const TapRateLimit &rateLimit)
+    : readers(readers),
+      deviceContext(deviceContext),
+      wallClock(wallClock),
+      events(events),
+      bayTaps(std::make_unique<BayTaps[]>(readers.bayCount()))
+{
+    const uint32_t refillMs = rateLimit.perMinute == 0 ? 0 : 60000 / rateLimit.perMinute;
+    const uint64_t now = hal::uptimeMs();
+    for (size_t bay = 0; bay < readers.bayCount(); ++bay)
+    {
+        bayTaps[bay].bucket.configure(rateLimit.burst, refillMs, now);
+    }
+}
+
+void TapPublisher::begin()
+{
+    for (size_t bay = 0; bay < readers.bayCount(); ++bay)
+    {
+        reportedHealth[bay] = readerHealth(bay);
+        events.publish(reportedHealth[bay]);
+    }
+}
+
+void TapPublisher::subscribe(AppEventBus &events)
+{
+    events.subscribe<CommandReceived, &TapPublisher::onCommandReceived>(*this);
+    events.subscribe<ConnectivityChanged, &TapPublisher::onConnectivityChanged>(*this);
+}
+
+bool TapPublisher::pollAndPublish(OutboundQueue &outboundQueue)
+{
+    // Health only moves while a bay scans or recovers, both of which happen
+    // inside the poll.
+    const bool published = pollOnce(outboundQueue);
+    reportReaderHealth();
+    updateLimitMetrics(hal::uptimeMs());
+    return published;
+}
+
+bool TapPublisher::pollOnce(OutboundQueue &outboundQueue)
+{
+    if (!online)
+    {
+        return pollOffline();
+    }
+
+    const uint64_t now = hal::uptimeMs();
+    uint8_t bay = 0;
+    // Summaries go out with telemetry, nobody is waiting on them.
+    if (outboundQueue.canAccept(OutboundPriority::Telemetry) && findDueSummary(now, bay))
+    {
+        publishSummary(outboundQueue, bay, now);
+    }
+
+    if (!outboundQueue.canAccept(OutboundPriority::Interactive))
+    {
+        return false;
+    }
+
+    CardRemoval removal;
+    while (readers.takeRemoval(bay, removal))
+    {
+        // A held-back tap's removal would be the only trace of it, and a
+        // flapping card would publish one per debounce window.
+        const BayTaps &taps = bayTaps[bay];
+        const bool heldBack = taps.lastCardUid == removal.cardUid ? taps.lastRequestId.empty() : taps.heldBack != 0;
+        if (!heldBack)
+        {
+            return publishRemoval(outboundQueue, bay, removal);
+        }
+    }
+
+    CardTap tap;
+    if (!readers.poll(bay, tap))
+    {
+        return false;
+    }
+
+    RequestTrace trace;
+    trace.mark(TraceStage::CardDetected);
+    if (!bayTaps[bay].bucket.tryTake(now))
+    {
+        holdBack(bay, tap, now);
+        return false;
+    }
+    return publishTap(outboundQueue, bay, tap, trace);
 }
 
-bool TapPublisher::pollAndPublish(MQTTManager &mqttManager)
+bool TapPublisher::pollOffline()
 {
-    std::string cardUid;
-    if (!watcher.poll(cardUid))
+    // Queued now, these would reach the backend long after anyone could act
+    // on them; a tap in particular could unlock a bike nobody is at.
+    uint8_t bay = 0;
+    CardRemoval removal;
+    while (readers.takeRemoval(bay, removal))
     {
+    }
+
+    CardTap tap;
+    if (!readers.poll(bay, tap))
+    {
+        return false;
+    }
+
+    // The cache unlocks without asking anyone, so a flapping card is held
+    // to the same rate as online; its window is reported once MQTT is back.
+    const uint64_t now = hal::uptimeMs();
+    if (!bayTaps[bay].bucket.tryTake(now))
+    {
+        holdBack(bay, tap, now);
         return false;
     }
 
-    return publishTap(mqttManager, cardUid);
+    TapDetected detected;
+    detected.cardDetectedUs = hal::uptimeUs();
+    detected.cardKey = AuthorizationCache::cardKey(tap.cardUid).value_or(0);
+    detected.bay = bay;
+    detected.queued = false;
+    detected.ambiguous = tap.ambiguous();
+    events.publish(detected);
+    LOGN("Offline tap on bay %u left to the authorization cache\n", static_cast<unsigned>(bay));
+    return true;
 }
 
-const std::string &TapPublisher::lastRequestId() const
+uint64_t TapPublisher::nextPollDueAt() const
+{
+    uint64_t dueAt = readers.nextPollDueAt();
+    if (!online)
+    {
+        return dueAt;
+    }
+    for (size_t bay = 0; bay < readers.bayCount(); ++bay)
+    {
+        dueAt = std::min(dueAt, summaryDueAt(bay));
+    }
+    return dueAt;
+}
+
+std::string_view TapPublisher::lastRequestId() const
 {
     return lastPublishedRequestId;
 }
 
-bool TapPublisher::publishTap(MQTTManager &mqttManager, const std::string &cardUid)
+bool TapPublisher::publishTap(OutboundQueue &outboundQueue, uint8_t bay, const CardTap &tap, RequestTrace &trace)
+{
+    OutboundQueue::Message *slot = outboundQueue.acquire(OutboundPriority::Interactive);
+    if (slot == nullptr)
+    {
+        LOGE("No outbound slot for tap event\n");
+        return false;
+    }
+
+    advanceRequestId();
+
+    TapEventMessage message;
+    message.requestId = lastPublishedRequestId.c_str();
+    message.deviceId = deviceContext.deviceId.c_str();
+    message.cardUid = tap.cardUid.c_str();
+    if (tap.protocol != hal::CardProtocol::Iso14443A)
+    {
+        message.cardType = cardProtocolName(tap.protocol);
+    }
+    if (tap.ambiguous())
+    {
+        message.ambiguous = true;
+        message.otherCardUid = tap.otherCardUid.c_str();
+    }
+    // Single-reader devices keep the payload they always had.
+    if (readers.bayCount() > 1)
+    {
+        message.bay = bay;
+    }
+    message.timestampMs = hal::uptimeMs();
+    wallClock.stamp(message);
+    trace.mark(TraceStage::TapPublished);
+    message.trace.stages = &trace;
+
+    const size_t payloadLength = serializeTapEvent(message, slot->payload, sizeof(slot->payload));
+    if (payloadLength == 0)
+    {
+        LOGE("Failed to serialize tap payload\n");
+        outboundQueue.release(*slot);
+        return false;
+    }
+
+    outboundQueue.submit(*slot, deviceContext.topics.tapEventTopic.c_str(), payloadLength, false);
+    LOGN("Queued card tap request %s from bay %u\n", lastPublishedRequestId.c_str(), static_cast<unsigned>(bay));
+    bayTaps[bay].lastCardUid.assign(tap.cardUid);
+    bayTaps[bay].lastRequestId = lastPublishedRequestId;
+    TapDetected detected;
+    detected.cardDetectedUs = trace.at(TraceStage::CardDetected);
+    detected.cardKey = AuthorizationCache::cardKey(tap.cardUid).value_or(0);
+    detected.bay = bay;
+    detected.ambiguous = tap.ambiguous();
+    events.publish(detected);
+    return true;
+}
+
+bool TapPublisher::publishRemoval(OutboundQueue &outboundQueue, uint8_t bay, const CardRemoval &removal)
 {
-    lastPublishedRequestId = nextRequestId();
+    // canAccept() was checked before the removal was taken.
+    OutboundQueue::Message *slot = outboundQueue.acquire(OutboundPriority::Interactive);
+    if (slot == nullptr)
+    {
+        LOGE("No outbound slot for card event\n");
+        return false;
+    }
 
-    StaticJsonDocument<192> doc;
-    doc["requestId"] = lastPublishedRequestId.c_str();
-    doc["deviceId"] = deviceContext.deviceId.c_str();
-    doc["cardUid"] = cardUid.c_str();
-    doc["timestampMs"] = millis();
+    CardEventMessage message;
+    message.deviceId = deviceContext.deviceId.c_str();
+    message.event = "card_removed";
+    message.cardUid = removal.cardUid.c_str();
+    if (removal.protocol != hal::CardProtocol::Iso14443A)
+    {
+        message.cardType = cardProtocolName(removal.protocol);
+    }
+    if (readers.bayCount() > 1)
+    {
+        message.bay = bay;
+    }
+    if (bayTaps[bay].lastCardUid == removal.cardUid)
+    {
+        message.tapRequestId = bayTaps[bay].lastRequestId.c_str();
+    }
+    message.dwellMs = removal.dwellMs;
+    message.timestampMs = hal::uptimeMs();
+    wallClock.stamp(message);
+
+    const size_t payloadLength = serializeCardEvent(message, slot->payload, sizeof(slot->payload));
+    if (payloadLength == 0)
+    {
+        LOGE("Failed to serialize card event\n");
+        outboundQueue.release(*slot);
+        return false;
+    }
+
+    outboundQueue.submit(*slot, deviceContext.topics.cardEventTopic.c_str(), payloadLength, false);
+    return true;
+}
+
+void TapPublisher::holdBack(uint8_t bay, const CardTap &tap, uint64_t now)
+{
+    BayTaps &taps = bayTaps[bay];
+    if (taps.heldBack == 0)
+    {
+        taps.firstHeldAt = now;
+        LOGW("Bay %u is over its tap rate, holding taps back\n", static_cast<unsigned>(bay));
+    }
+    ++taps.heldBack;
+    taps.heldBackUid.assign(tap.cardUid);
+    taps.lastCardUid.assign(tap.cardUid);
+    taps.lastRequestId.clear();
+    heldBackTaps.increment();
+}
+
+bool TapPublisher::findDueSummary(uint64_t now, uint8_t &bay)
+{
+    for (size_t index = 0; index < readers.bayCount(); ++index)
+    {
+        if (now >= summaryDueAt(index))
+        {
+            bay = static_cast<uint8_t>(index);
+            return true;
+        }
+    }
+    return false;
+}
 
-    char payload[192];
-    const size_t payloadLength = serializeJson(doc, payload, sizeof(payload));
-    if (payloadLength == 0 || payloadLength >= sizeof(payload))
+bool TapPublisher::publishSummary(OutboundQueue &outboundQueue, uint8_t bay, uint64_t now)
+{
+    OutboundQueue::Message *slot = outboundQueue.acquire(OutboundPriority::Telemetry);
+    if (slot == nullptr)
     {
-        Log.error("Failed to serialize tap payload\n");
         return false;
     }
 
-    if (!mqttManager.publish(deviceContext.topics.tapEventTopic, payload, false))
+    BayTaps &taps = bayTaps[bay];
+    TapsLimitedMessage message;
+    message.deviceId = deviceContext.deviceId.c_str();
+    message.event = "taps_limited";
+    if (readers.bayCount() > 1)
     {
-        Log.error("Failed to publish tap event\n");
+        message.bay = bay;
+    }
+    message.suppressed = taps.heldBack;
+    message.cardUid = taps.heldBackUid.c_str();
+    message.windowMs = static_cast<uint32_t>(now - taps.firstHeldAt);
+    message.timestampMs = now;
+    wallClock.stamp(message);
+
+    const size_t payloadLength = serializeTapsLimited(message, slot->payload, sizeof(slot->payload));
+    if (payloadLength == 0)
+    {
+        LOGE("Failed to serialize taps_limited event\n");
+        outboundQueue.release(*slot);
         return false;
     }
 
-    Log.notice("Published card tap request %s\n", lastPublishedRequestId.c_str());
+    outboundQueue.submit(*slot, deviceContext.topics.cardEventTopic.c_str(), payloadLength, false);
+    LOGI("Bay %u held back %lu taps in %lu ms\n",
+         static_cast<unsigned>(bay),
+         static_cast<unsigned long>(taps.heldBack),
+         static_cast<unsigned long>(message.windowMs));
+    taps.heldBack = 0;
+    limitSummaries.increment();
     return true;
 }
 
-std::string TapPublisher::nextRequestId()
+uint64_t TapPublisher::summaryDueAt(size_t bay) const
+{
+    const BayTaps &taps = bayTaps[bay];
+    if (taps.heldBack == 0)
+    {
+        return std::numeric_limits<uint64_t>::max();
+    }
+    return std::min(taps.firstHeldAt + SUMMARY_WINDOW_MS, taps.bucket.fullAt());
+}
+
+void TapPublisher::updateLimitMetrics(uint64_t now)
+{
+    uint32_t limited = 0;
+    uint16_t fewestTokens = std::numeric_limits<uint16_t>::max();
+    for (size_t bay = 0; bay < readers.bayCount(); ++bay)
+    {
+        if (bayTaps[bay].heldBack != 0)
+        {
+            limited |= 1u << bay;
+        }
+        fewestTokens = std::min(fewestTokens, bayTaps[bay].bucket.available(now));
+    }
+    limitedBays.set(static_cast<int32_t>(limited));
+    minTokens.set(readers.bayCount() == 0 ? 0 : fewestTokens);
+}
+
+void TapPublisher::advanceRequestId()
 {
     ++requestSequence;
-    return deviceContext.deviceId + "-" + std::to_string(millis()) + "-" + std::to_string(requestSequence);
+    // The boot counter keeps ids unique across reboots, when uptime and the
+    // sequence both start over.
+    char suffix[MAX_REQUEST_ID_LENGTH - MAX_DEVICE_ID_LENGTH + 1];
+    std::snprintf(suffix, sizeof(suffix), "-%lu-%llu-%lu",
+                  static_cast<unsigned long>(wallClock.bootCount()),
+                  static_cast<unsigned long long>(hal::uptimeMs()),
+                  static_cast<unsigned long>(requestSequence));
+    lastPublishedRequestId.assign(deviceContext.deviceId);
+    lastPublishedRequestId.append(suffix);
+}
+
+void TapPublisher::reportReaderHealth()
+{
+    for (size_t bay = 0; bay < readers.bayCount(); ++bay)
+    {
+        const ReaderHealthChanged current = readerHealth(bay);
+        ReaderHealthChanged &reported = reportedHealth[bay];
+        if (current.healthy == reported.healthy && current.recovering == reported.recovering)
+        {
+            continue;
+        }
+
+        reported = current;
+        events.publish(current);
+    }
+}
+
+void TapPublisher::onCommandReceived(const CommandReceived &event)
+{
+    // Pings and diagnostics come from the backend, not from a rider.
+    if (event.outcome != CommandOutcome::Handled)
+    {
+        readers.noteActivity();
+    }
+}
+
+void TapPublisher::onConnectivityChanged(const ConnectivityChanged &event)
+{
+    online = event.mqttConnected;
+}
+
+ReaderHealthChanged TapPublisher::readerHealth(size_t bay) const
+{
+    const NFCManager &reader = readers.reader(bay);
+    return ReaderHealthChanged{static_cast<uint8_t>(bay), reader.isHealthy(), reader.isRecovering()};
 }
@@ -1,12 +1,11 @@
 #include "DeviceUtils.h"
 
-#include <WiFi.h>
 #include <cstdio>
 
-std::string getMacAddress()
+std::string getMacAddress(const hal::WifiLink &wifi)
 {
     uint8_t raw[6] = {0};
-    WiFi.macAddress(raw);
+    wifi.macAddress(raw);
 
     char macBuffer[13] = {0};
     for (size_t i = 0; i < 6; ++i)
@@ -17,11 +16,11 @@ std::string getMacAddress()
     return std::string(macBuffer, 12);
 }
 
-std::string makeTopicWithMac(const std::string &baseTopic)
+std::string makeTopicWithMac(const hal::WifiLink &wifi, const std::string &baseTopic)
 {
     std::string sanitizedBase = baseTopic;
    
-    std::string mac = getMacAddress();
+    std::string mac = getMacAddress(wifi);
     if (mac.empty())
     {
         return sanitizedBase;
@@ -0,0 +1,70 @@
+#include "JsonWriter.h"
+
+namespace
+{
+// Same set as ArduinoJson's EscapeSequence; '/' and other control
+// characters are written as they are.
+char escapeFor(char c)
+{
+    switch (c)
+    {
+    case '"':
+        return '"';
+    case '\\':
+        return '\\';
+    case '\b':
+        return 'b';
+    case '\f':
+        return 'f';
+    case '\n':
+        return 'n';
+    case '\r':
+        return 'r';
+    case '\t':
+        return 't';
+    default:
+        return 0;
+    }
+}
+}
+
+void JsonWriter::writeString(const char *text)
+{
+    if (text == nullptr)
+    {
+        writeRaw("null", 4);
+        return;
+    }
+
+    writeRaw('"');
+    // Copy runs of plain characters in one go; identifiers and topics rarely
+    // need escaping at all.
+    const char *run = text;
+    for (const char *next = text; *next != '\0'; ++next)
+    {
+        const char escaped = escapeFor(*next);
+        if (escaped == 0)
+        {
+            continue;
+        }
+        writeRaw(run, static_cast<size_t>(next - run));
+        const char sequence[2] = {'\\', escaped};
+        writeRaw(sequence, sizeof(sequence));
+        run = next + 1;
+    }
+    writeRaw(run, std::strlen(run));
+    writeRaw('"');
+}
+
+void JsonWriter::writeUnsigned(uint64_t value)
+{
+    char digits[20];
+    size_t count = 0;
+    do
+    {
+        digits[sizeof(digits) - 1 - count] = static_cast<char>('0' + value % 10);
+        value /= 10;
+        ++count;
+    } while (value != 0);
+    writeRaw(digits + sizeof(digits) - count, count);
+}
@@ -14,6 +14,7 @@ import { DeviceAccessCommandServiceTag } from "./device-access-command.service";
 export type DeviceDenyReason
   = | "ACTIVE_RENTAL_EXISTS"
     | "ACTIVE_RESERVATION_EXISTS"
+    | "AMBIGUOUS_TAP"
     | "BIKE_ALREADY_RENTED"
     | "BIKE_DISABLED"
     | "BIKE_BROKEN"
@@ -219,6 +220,11 @@ const makeDeviceTapDecisionServiceEffect = Effect.gen(function* () {
       Effect.gen(function* () {
         const now = options?.now ?? new Date();
 
+        // Hai thẻ cùng lúc: mở khóa theo thẻ nào cũng có thể tính tiền nhầm người.
+        if (event.ambiguous) {
+          return yield* deny("AMBIGUOUS_TAP");
+        }
+
         const cardOpt = yield* nfcCardQueryService.findByUid(event.cardUid);
         if (Option.isNone(cardOpt)) {
           return yield* deny("CARD_NOT_FOUND");
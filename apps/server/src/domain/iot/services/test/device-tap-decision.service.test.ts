@@ -19,6 +19,47 @@ const emptyCardList = {
 };
 
 describe("device tap decision service", () => {
+  it("denies ambiguous taps before looking up either card", async () => {
+    const event = DeviceTapEventSchema.parse({
+      requestId: "req-wallet",
+      deviceId: "bike-1",
+      cardUid: "77740817",
+      timestampMs: 1,
+      ambiguous: true,
+      otherCardUid: "73144702",
+    });
+
+    const deps = Layer.mergeAll(
+      Layer.succeed(NfcCardQueryServiceTag, NfcCardQueryServiceTag.make({
+        getById: () => Effect.die("card lookup should not run for ambiguous tap"),
+        findByUid: () => Effect.die("card lookup should not run for ambiguous tap"),
+        findByAssignedUserId: () => Effect.die("card lookup should not run for ambiguous tap"),
+        list: () => Effect.succeed(emptyCardList),
+      })),
+      Layer.succeed(BikeRepository, BikeRepository.make({
+        getById: () => Effect.die("bike lookup should not run for ambiguous tap"),
+      } as never)),
+      Layer.succeed(ReservationQueryServiceTag, ReservationQueryServiceTag.make({
+        getCurrentHoldForUserNow: () => Effect.die("reservation lookup should not run for ambiguous tap"),
+      } as never)),
+      Layer.succeed(DeviceAccessCommandServiceTag, DeviceAccessCommandServiceTag.make({
+        confirmReservation: () => Effect.die("reservation confirm should not run for ambiguous tap"),
+        startRental: () => Effect.die("rental start should not run for ambiguous tap"),
+      })),
+    );
+    const layer = DeviceTapDecisionServiceLive.pipe(Layer.provide(deps));
+
+    const result = await runEffectWithLayer(
+      Effect.flatMap(DeviceTapDecisionServiceTag, service => service.decideTapEvent(event)),
+      layer,
+    );
+
+    expect(result).toEqual({
+      _tag: "Deny",
+      reason: "AMBIGUOUS_TAP",
+    });
+  });
+
   it("denies lost cards as CARD_LOST before assignment fallback", async () => {
     const event = DeviceTapEventSchema.parse({
       requestId: "req-lost",
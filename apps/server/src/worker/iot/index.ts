@@ -76,15 +76,19 @@ async function main() {
 
     yield* mqtt.subscribe([
       DEVICE_TOPIC_PATTERNS.tapEvents,
+      DEVICE_TOPIC_PATTERNS.cardEvents,
       DEVICE_TOPIC_PATTERNS.status,
       DEVICE_TOPIC_PATTERNS.acknowledgements,
+      DEVICE_TOPIC_PATTERNS.metrics,
     ]);
 
     logger.info({
       topics: [
         DEVICE_TOPIC_PATTERNS.tapEvents,
+        DEVICE_TOPIC_PATTERNS.cardEvents,
         DEVICE_TOPIC_PATTERNS.status,
         DEVICE_TOPIC_PATTERNS.acknowledgements,
+        DEVICE_TOPIC_PATTERNS.metrics,
       ],
     }, "IoT MQTT runtime started");
 
@@ -9,8 +9,13 @@ import type { IncomingDeviceRuntimeMessage } from "./types";
  * Xử lý một thông điệp IoT đã được validate từ queue nội bộ.
  *
  * Tap event đi vào domain workflow vì nó có thể mở khóa xe, xác nhận thuê xe,
- * hoặc phát lệnh xuống thiết bị. Status và acknowledgement hiện chỉ được quan
- * sát qua log để phục vụ vận hành.
+ * hoặc phát lệnh xuống thiết bị. Sự kiện thẻ, status và acknowledgement hiện
+ * chỉ được quan sát qua log để phục vụ vận hành; ack `failed` được log ở mức
+ * error vì rental hoặc reservation vừa được xác nhận cho `requestId` đó có thể
+ * chưa mở được khóa, còn lần mở khóa offline được log ở mức warn vì xe đã mở
+ * mà server chưa có rental tương ứng, cần đối soát. Metrics định kỳ chỉ log ở
+ * mức debug vì mỗi thiết bị gửi một batch mỗi phút; snapshot do lệnh
+ * `diagnostics` yêu cầu được log ở mức info.
  *
  * Lỗi domain được bắt và log tại đây để một thông điệp lỗi không làm chết fiber
  * xử lý queue. Retry ở tầng MQTT không tồn tại trong runtime này, nên handler
@@ -38,13 +43,37 @@ export function handleDeviceRuntimeMessage(
             Effect.asVoid,
           )),
       );
+    case "card":
+      return Effect.sync(() => {
+        const event = message.payload;
+        if (event.event === "offline_decision" && event.decision === "granted") {
+          logger.warn({ topic: message.topic, cardEvent: event }, "Device unlocked offline from its authorization cache");
+          return;
+        }
+
+        logger.info({ topic: message.topic, cardEvent: event }, "Received device card event");
+      });
     case "status":
       return Effect.sync(() => {
         logger.info({ topic: message.topic, status: message.payload }, "Received device runtime status");
       });
     case "ack":
       return Effect.sync(() => {
+        if (message.payload.status === "failed") {
+          logger.error({ topic: message.topic, acknowledgement: message.payload }, "Device failed to execute command");
+          return;
+        }
+
         logger.info({ topic: message.topic, acknowledgement: message.payload }, "Received device acknowledgement");
       });
+    case "metrics":
+      return Effect.sync(() => {
+        if (message.payload.trigger === "diagnostics") {
+          logger.info({ topic: message.topic, metrics: message.payload }, "Received device diagnostics snapshot");
+          return;
+        }
+
+        logger.debug({ topic: message.topic, metrics: message.payload }, "Received device metrics batch");
+      });
   }
 }
@@ -2,6 +2,8 @@ import type { Buffer } from "node:buffer";
 
 import {
   DeviceAcknowledgementSchema,
+  DeviceCardEventSchema,
+  DeviceMetricsBatchSchema,
   DeviceRuntimeStatusSchema,
   DeviceTapEventSchema,
 } from "@mebike/shared";
@@ -19,11 +21,15 @@ import type { IncomingDeviceRuntimeMessage } from "./types";
  * @param topic Topic MQTT nhận từ broker.
  * @returns Loại thông điệp nội bộ, hoặc `null` nếu topic không thuộc runtime này.
  */
-export function resolveDeviceRuntimeTopicKind(topic: string): "tap" | "status" | "ack" | null {
+export function resolveDeviceRuntimeTopicKind(topic: string): "tap" | "card" | "status" | "ack" | "metrics" | null {
   if (/^device\/[^/]+\/events\/tap$/.test(topic)) {
     return "tap";
   }
 
+  if (/^device\/[^/]+\/events\/card$/.test(topic)) {
+    return "card";
+  }
+
   if (/^device\/[^/]+\/status$/.test(topic)) {
     return "status";
   }
@@ -32,6 +38,10 @@ export function resolveDeviceRuntimeTopicKind(topic: string): "tap" | "status" |
     return "ack";
   }
 
+  if (/^device\/[^/]+\/metrics$/.test(topic)) {
+    return "metrics";
+  }
+
   return null;
 }
 
@@ -75,6 +85,15 @@ export function parseDeviceRuntimeMessage(
 
         return { kind, topic, payload: parsed.data };
       }
+      case "card": {
+        const parsed = DeviceCardEventSchema.safeParse(payload);
+        if (!parsed.success) {
+          logger.warn({ topic, issues: parsed.error.flatten() }, "Discarded invalid device card event");
+          return null;
+        }
+
+        return { kind, topic, payload: parsed.data };
+      }
       case "status": {
         const parsed = DeviceRuntimeStatusSchema.safeParse(payload);
         if (!parsed.success) {
@@ -91,6 +110,15 @@ export function parseDeviceRuntimeMessage(
           return null;
         }
 
+        return { kind, topic, payload: parsed.data };
+      }
+      case "metrics": {
+        const parsed = DeviceMetricsBatchSchema.safeParse(payload);
+        if (!parsed.success) {
+          logger.warn({ topic, issues: parsed.error.flatten() }, "Discarded invalid device metrics batch");
+          return null;
+        }
+
         return { kind, topic, payload: parsed.data };
       }
     }
@@ -1,4 +1,10 @@
-import type { DeviceAcknowledgement, DeviceRuntimeStatus, DeviceTapEvent } from "@mebike/shared";
+import type {
+  DeviceAcknowledgement,
+  DeviceCardEvent,
+  DeviceMetricsBatch,
+  DeviceRuntimeStatus,
+  DeviceTapEvent,
+} from "@mebike/shared";
 
 export const IOT_MESSAGE_QUEUE_CAPACITY = 256;
 export const IOT_MESSAGE_WORKER_CONCURRENCY = 4;
@@ -9,12 +15,14 @@ export const IOT_SHUTDOWN_DRAIN_TIMEOUT_MS = 5000;
  *
  * Worker chỉ xử lý kiểu này sau khi topic và payload thô đã đi qua lớp router.
  * Nhờ vậy phần xử lý domain không cần lặp lại logic parse JSON hoặc validate
- * payload cho từng nhánh tap/status/ack.
+ * payload cho từng nhánh tap/card/status/ack/metrics.
  */
 export type IncomingDeviceRuntimeMessage
   = | { kind: "tap"; topic: string; payload: DeviceTapEvent }
+    | { kind: "card"; topic: string; payload: DeviceCardEvent }
     | { kind: "status"; topic: string; payload: DeviceRuntimeStatus }
-    | { kind: "ack"; topic: string; payload: DeviceAcknowledgement };
+    | { kind: "ack"; topic: string; payload: DeviceAcknowledgement }
+    | { kind: "metrics"; topic: string; payload: DeviceMetricsBatch };
 
 export type IotMessageQueueRuntime = {
   /**
@@ -12,9 +12,11 @@ export const DEVICE_TOPIC_ROOT = "device" as const;
  */
 export const DEVICE_TOPIC_PATTERNS = {
   tapEvents: `${DEVICE_TOPIC_ROOT}/+/events/tap` as const,
+  cardEvents: `${DEVICE_TOPIC_ROOT}/+/events/card` as const,
   commands: `${DEVICE_TOPIC_ROOT}/+/commands` as const,
   acknowledgements: `${DEVICE_TOPIC_ROOT}/+/acks` as const,
   status: `${DEVICE_TOPIC_ROOT}/+/status` as const,
+  metrics: `${DEVICE_TOPIC_ROOT}/+/metrics` as const,
 } as const;
 
 /**
@@ -24,6 +26,14 @@ export function deviceTapEventTopic(deviceId: string) {
   return `${DEVICE_TOPIC_ROOT}/${deviceId}/events/tap` as const;
 }
 
+/**
+ * Tạo topic thiết bị publish các sự kiện thẻ khác ngoài tap: thẻ rời đầu đọc,
+ * tap bị giới hạn tần suất, và quyết định mở khóa offline.
+ */
+export function deviceCardEventTopic(deviceId: string) {
+  return `${DEVICE_TOPIC_ROOT}/${deviceId}/events/card` as const;
+}
+
 /**
  * Tạo topic server gửi lệnh điều khiển xuống thiết bị.
  */
@@ -45,6 +55,14 @@ export function deviceStatusTopic(deviceId: string) {
   return `${DEVICE_TOPIC_ROOT}/${deviceId}/status` as const;
 }
 
+/**
+ * Tạo topic thiết bị publish metrics định kỳ và snapshot chẩn đoán theo lệnh
+ * `diagnostics`.
+ */
+export function deviceMetricsTopic(deviceId: string) {
+  return `${DEVICE_TOPIC_ROOT}/${deviceId}/metrics` as const;
+}
+
 /**
  * Trạng thái runtime tối giản của firmware thiết bị.
  */
@@ -59,13 +77,38 @@ export const DeviceRuntimeStateSchema = z.enum([
 
 /**
  * Tập lệnh server hiện được phép gửi xuống thiết bị.
+ *
+ * `auth_begin`, `auth_batch`, `auth_commit` đồng bộ snapshot danh sách thẻ được
+ * mở khóa khi thiết bị mất kết nối: begin khai báo `generation` và `count`, các
+ * batch gửi `entries` theo `offset`, commit kích hoạt snapshot. Mỗi lệnh được
+ * ack riêng; batch gửi lại đã ghi sẽ được ack mà không ghi lại.
+ *
+ * `diagnostics` yêu cầu thiết bị publish ngay một snapshot metrics lên topic
+ * `metrics` (trigger `diagnostics`); ack `done` khi snapshot đã vào hàng đợi,
+ * `failed` nếu không gửi được.
  */
 export const DeviceCommandActionSchema = z.enum([
   "unlock",
   "deny",
   "ping",
+  "diagnostics",
+  "auth_begin",
+  "auth_batch",
+  "auth_commit",
 ]);
 
+/** Số entry tối đa firmware nhận trong một `auth_batch`. */
+export const DEVICE_AUTH_BATCH_MAX_ENTRIES = 16;
+
+/**
+ * Một entry trong `auth_batch`: 16 chữ số hex của card key (UID thập phân của
+ * thẻ, dạng số) rồi 8 chữ số hex thời điểm hết hạn theo Unix giây. Các entry
+ * nối liền nhau và sắp xếp tăng dần theo card key trên toàn snapshot.
+ */
+export const DeviceAuthBatchEntriesSchema = z.string()
+  .regex(/^(?:[0-9a-f]{24})+$/i)
+  .max(DEVICE_AUTH_BATCH_MAX_ENTRIES * 24);
+
 /**
  * Payload sự kiện quẹt thẻ từ thiết bị.
  */
@@ -74,6 +117,12 @@ export const DeviceTapEventSchema = z.object({
   deviceId: z.string().min(1).describe("Current convention: Bike.id"),
   cardUid: z.string().min(1),
   timestampMs: z.number().int().nonnegative(),
+  /**
+   * Hai thẻ cùng nằm trong vùng đọc (ví dụ cả ví đặt lên đầu đọc); không xác
+   * định được thẻ nào là của người thuê nên server phải từ chối.
+   */
+  ambiguous: z.boolean().optional(),
+  otherCardUid: z.string().min(1).optional().describe("The second card when ambiguous"),
 });
 
 /**
@@ -84,14 +133,24 @@ export const DeviceCommandSchema = z.object({
   action: DeviceCommandActionSchema,
   reason: z.string().min(1).optional(),
   durationMs: z.number().int().positive().optional(),
+  generation: z.number().int().positive().optional().describe("auth_* only: snapshot being synced"),
+  count: z.number().int().nonnegative().optional().describe("auth_begin only: entries in the snapshot"),
+  offset: z.number().int().nonnegative().optional().describe("auth_batch only: index of the first entry"),
+  entries: DeviceAuthBatchEntriesSchema.optional(),
 });
 
 /**
  * Trạng thái phản hồi của thiết bị sau khi nhận lệnh.
+ *
+ * - `done`: lệnh đã được thực thi.
+ * - `rejected`: payload hoặc action không hợp lệ, thiết bị không làm gì.
+ * - `failed`: lệnh hợp lệ nhưng thiết bị không thực thi được, ví dụ khóa bị kẹt
+ *   hoặc đang bận; `detail` cho biết lý do.
  */
 export const DeviceAcknowledgementStatusSchema = z.enum([
   "done",
   "rejected",
+  "failed",
 ]);
 
 /**
@@ -103,6 +162,85 @@ export const DeviceAcknowledgementSchema = z.object({
   action: z.string().min(1),
   status: DeviceAcknowledgementStatusSchema,
   detail: z.string().min(1).optional(),
+  actuationMs: z.number().int().nonnegative().optional().describe("Unlock only: time until the lock opened"),
+});
+
+const DeviceCardEventBaseSchema = z.object({
+  deviceId: z.string().min(1).describe("Current convention: Bike.id"),
+  bay: z.number().int().nonnegative().optional().describe("Only on stations with more than one reader"),
+  timestampMs: z.number().int().nonnegative(),
+  epochMs: z.number().int().nonnegative().optional().describe("Wall-clock time, once the device has synced"),
+});
+
+/**
+ * Thẻ đã rời đầu đọc; `tapRequestId` trỏ về tap đã publish của chính thẻ đó.
+ */
+export const DeviceCardRemovedEventSchema = DeviceCardEventBaseSchema.extend({
+  event: z.literal("card_removed"),
+  cardUid: z.string().min(1),
+  cardType: z.string().min(1).optional(),
+  tapRequestId: z.string().min(1).optional(),
+  dwellMs: z.number().int().nonnegative(),
+});
+
+/**
+ * Tổng hợp các tap bị giữ lại vì vượt giới hạn tần suất của một bay.
+ */
+export const DeviceTapsLimitedEventSchema = DeviceCardEventBaseSchema.extend({
+  event: z.literal("taps_limited"),
+  suppressed: z.number().int().positive(),
+  cardUid: z.string().min(1).describe("The last card held back"),
+  windowMs: z.number().int().nonnegative(),
+});
+
+/**
+ * Quyết định mở khóa thiết bị tự đưa ra từ cache ủy quyền khi mất MQTT, gửi
+ * lên sau khi kết nối lại để server đối soát. `timestampMs`/`epochMs` là lúc
+ * quyết định, không phải lúc gửi.
+ */
+export const DeviceOfflineDecisionEventSchema = DeviceCardEventBaseSchema.extend({
+  event: z.literal("offline_decision"),
+  cardUid: z.string().min(1).optional(),
+  decision: z.enum(["granted", "denied"]),
+  reason: z.string().min(1).optional().describe("expired, not_cached, no_time or ambiguous when denied"),
+  cacheGeneration: z.number().int().nonnegative(),
+});
+
+/**
+ * Payload trên topic `events/card`, phân biệt theo `event`.
+ */
+export const DeviceCardEventSchema = z.discriminatedUnion("event", [
+  DeviceCardRemovedEventSchema,
+  DeviceTapsLimitedEventSchema,
+  DeviceOfflineDecisionEventSchema,
+]);
+
+/**
+ * Histogram trong batch metrics: số mẫu, p99 và max (micro giây), cùng các
+ * bucket log2 đã cắt bỏ phần 0 ở cuối.
+ */
+export const DeviceMetricHistogramSchema = z.object({
+  n: z.number().int().nonnegative(),
+  p99: z.number().int().nonnegative(),
+  max: z.number().int().nonnegative(),
+  b: z.array(z.number().int().nonnegative()),
+});
+
+/**
+ * Payload trên topic `metrics`. Một lần flush có thể chia thành nhiều `part`
+ * cùng `seq`. Counter cộng dồn từ lúc boot, gauge là giá trị tức thời, còn
+ * histogram chỉ tính cửa sổ từ lần flush `interval` trước.
+ */
+export const DeviceMetricsBatchSchema = z.object({
+  deviceId: z.string().min(1).describe("Current convention: Bike.id"),
+  seq: z.number().int().nonnegative(),
+  part: z.number().int().nonnegative(),
+  trigger: z.enum(["interval", "diagnostics"]),
+  uptimeMs: z.number().int().nonnegative(),
+  boot: z.number().int().nonnegative(),
+  timeSync: z.enum(["none", "synced", "stale"]),
+  epochMs: z.number().int().nonnegative().optional().describe("Wall-clock time, once the device has synced"),
+  metrics: z.record(z.string(), z.union([z.number().int(), DeviceMetricHistogramSchema])),
 });
 
 /**
@@ -129,5 +267,11 @@ export type DeviceCommand = z.infer<typeof DeviceCommandSchema>;
 export type DeviceAcknowledgement = z.infer<typeof DeviceAcknowledgementSchema>;
 /** Kiểu status ack từ firmware. */
 export type DeviceAcknowledgementStatus = z.infer<typeof DeviceAcknowledgementStatusSchema>;
+/** Kiểu sự kiện thẻ (rời đầu đọc, bị giới hạn, quyết định offline) từ firmware. */
+export type DeviceCardEvent = z.infer<typeof DeviceCardEventSchema>;
+/** Kiểu quyết định offline thiết bị gửi lên để đối soát. */
+export type DeviceOfflineDecisionEvent = z.infer<typeof DeviceOfflineDecisionEventSchema>;
+/** Kiểu batch metrics/chẩn đoán từ firmware. */
+export type DeviceMetricsBatch = z.infer<typeof DeviceMetricsBatchSchema>;
 /** Kiểu runtime status chuẩn hóa của firmware. */
 export type DeviceRuntimeStatus = z.infer<typeof DeviceRuntimeStatusSchema>;